@@ -0,0 +1,174 @@
+// Replays a trace of tools/panel_bench (--trace) through syncDocument() of
+// src/patch.js, with a stand-in of the SSE store and of fetch() that
+// revalidates with the ETag like the browser cache, and checks the pages'
+// documents against the ones the server served.
+//
+//   node scripts/patch_check.js trace.jsonl [--drop 0] [--lag 0] [--post 1]
+//
+// --post 0 leaves out the POST answers, as a second panel window sees the
+// changes, so a task moving between list and current comes as a delta.
+// --drop N loses every Nth SSE frame, the next delta of that document
+// must find the gap and fetch it again before the change is over.
+// --lag N answers a fetch only N trace lines later, so deltas and POST
+// answers overtake it. Otherwise the pages must match the server after
+// every change, and always once an UPDATE frame was handled at the end.
+
+import { readFileSync } from "node:fs";
+import { isDeepStrictEqual } from "node:util";
+import { syncDocument } from "../src/patch.js";
+
+const args = process.argv.slice(2);
+const options = { drop: 0, lag: 0, post: 1 };
+for (let i = 1; i + 1 < args.length; i += 2) {
+  const flag = args[i].replace(/^--/, "");
+  if (!(flag in options)) {
+    console.error(`patch_check: unknown option ${args[i]}`);
+    process.exit(2);
+  }
+  options[flag] = Number(args[i + 1]);
+}
+if (args.length == 0) {
+  console.error("usage: node scripts/patch_check.js trace.jsonl [options]");
+  process.exit(2);
+}
+
+const urls = { "/api/profile": "profile", "/api/task": "tasks" };
+// what a GET answers now, by type
+const served = {};
+// the browser cache, by url
+const cache = {};
+const counts = { fetches: 0, notModified: 0, frames: 0, dropped: 0 };
+let line = 0;
+let pending = [];
+
+globalThis.fetch = (url) => {
+  const doc = served[urls[url]];
+  counts.fetches++;
+  let body = doc.body;
+  if (cache[url] && cache[url].etag == doc.etag) {
+    counts.notModified++;
+    body = cache[url].body;
+  }
+  cache[url] = { etag: doc.etag, body };
+  const text = JSON.stringify(body);
+  return new Promise((resolve) => {
+    pending.push({
+      at: line + options.lag,
+      resolve: () => resolve({ json: () => Promise.resolve(JSON.parse(text)) }),
+    });
+  });
+};
+
+// svelte's writable as src/sse.js uses it
+const subscribers = new Set();
+let frame = null;
+const sse = {
+  subscribe(run) {
+    subscribers.add(run);
+    run(frame);
+    return () => subscribers.delete(run);
+  },
+};
+function send(data) {
+  frame = { data, ts: Date.now() };
+  for (const run of subscribers) {
+    run(frame);
+  }
+}
+
+const pages = {};
+const accept = {};
+// the pages open once the server has both documents
+function open() {
+  for (const [url, type] of Object.entries(urls)) {
+    accept[type] = syncDocument(url, type, sse, (data) => {
+      pages[type] = data;
+    });
+  }
+}
+
+// let answered fetches and the promise chains behind them run
+async function settle(all) {
+  for (let round = 0; round < 4; round++) {
+    const due = pending.filter((p) => all || p.at <= line);
+    pending = pending.filter((p) => !due.includes(p));
+    due.forEach((p) => p.resolve());
+    await new Promise((resolve) => setImmediate(resolve));
+  }
+}
+
+// types whose page differs from what the server serves
+function mismatches() {
+  return Object.values(urls).filter(
+    (type) => !isDeepStrictEqual(pages[type], served[type].body),
+  );
+}
+
+const trace = readFileSync(args[0], "utf8").split("\n").filter(Boolean);
+const strict = options.drop == 0 && options.lag == 0;
+let steps = 0;
+let behind = 0;
+// types whose latest frame in this change was delivered
+const delivered = new Set();
+let failed = 0;
+for (const text of trace) {
+  const entry = JSON.parse(text);
+  if (entry.serve) {
+    const opened = Object.keys(served).length == 2;
+    served[entry.serve] = { etag: entry.etag, body: entry.body };
+    if (!opened && Object.keys(served).length == 2) {
+      open();
+    }
+  } else if (entry.post) {
+    if (options.post) {
+      accept[entry.post](entry.body);
+    }
+  } else if (entry.event !== undefined) {
+    counts.frames++;
+    const type = JSON.parse(entry.event).type;
+    if (options.drop > 0 && counts.frames % options.drop == 0) {
+      counts.dropped++;
+      delivered.delete(type);
+    } else {
+      send(entry.event);
+      delivered.add(type);
+    }
+  } else if (entry.step !== undefined) {
+    steps++;
+    const off = mismatches();
+    if (off.length > 0) {
+      behind++;
+    }
+    // a dropped frame shows once the next one of its type arrives
+    const wrong = off.filter(
+      (type) => strict || (options.lag == 0 && delivered.has(type)),
+    );
+    if (wrong.length > 0 && failed++ < 5) {
+      console.log(`change ${steps}: ${wrong.join(", ")} off the server's`);
+    }
+    delivered.clear();
+  }
+  line++;
+  await settle(false);
+}
+// what the server sends a client that fell behind, the second time nothing
+// changed in between and the fetches revalidate to 304
+for (let i = 0; i < 2; i++) {
+  send("UPDATE");
+  await settle(true);
+  const off = mismatches();
+  if (off.length > 0) {
+    failed++;
+    console.log(`after UPDATE: ${off.join(", ")} off the server's`);
+  }
+}
+
+console.log(
+  `${steps} changes, ${counts.frames} frames (${counts.dropped} dropped), ` +
+    `${counts.fetches} fetches (${counts.notModified} 304), ` +
+    `${behind} changes with a page behind`,
+);
+if (failed > 0) {
+  console.log("FAILED");
+  process.exit(1);
+}
@@ -0,0 +1,83 @@
+// Apply a JSON patch (RFC 6902) from the server's deltas: add, remove and
+// replace. Returns a patched copy, doc is left as it is.
+export function applyPatch(doc, patch) {
+  const root = { "": structuredClone(doc) };
+  for (const op of patch) {
+    const keys = op.path
+      .split("/")
+      .slice(1)
+      .map((key) => key.replace(/~1/g, "/").replace(/~0/g, "~"));
+    let parent = root;
+    let key = "";
+    for (const k of keys) {
+      parent = parent[key];
+      key = k;
+    }
+    if (Array.isArray(parent)) {
+      const index = key === "-" ? parent.length : Number(key);
+      if (op.op === "add") {
+        parent.splice(index, 0, op.value);
+      } else if (op.op === "remove") {
+        parent.splice(index, 1);
+      } else {
+        parent[index] = op.value;
+      }
+    } else if (op.op === "remove") {
+      delete parent[key];
+    } else {
+      parent[key] = op.value;
+    }
+  }
+  return root[""];
+}
+
+// Keep a document fetched from url up to date with the deltas of type
+// pushed over SSE. set is called with every new version. Returns a function
+// to hand it the document a POST answered with.
+export function syncDocument(url, type, sse, set) {
+  let doc = null;
+  function fetchDocument() {
+    // revalidated with the ETag, unchanged it comes from the browser cache
+    fetch(url)
+      .then((res) => res.json())
+      .then((data) => {
+        doc = data;
+        set(doc);
+      });
+  }
+  function accept(data) {
+    if (!doc || data.version >= doc.version) {
+      doc = data;
+      set(doc);
+    }
+  }
+  sse.subscribe((e) => {
+    if (!e) {
+      return;
+    }
+    // sent to clients that fell behind, or after a restart
+    if (e.data == "UPDATE") {
+      fetchDocument();
+      return;
+    }
+    if (!e.data.startsWith("{")) {
+      return;
+    }
+    const delta = JSON.parse(e.data);
+    // before the first fetch is back, that fetch has it or the next delta
+    // finds the gap
+    if (delta.type != type || !doc) {
+      return;
+    }
+    if (delta.from == doc.version) {
+      doc = applyPatch(doc, delta.patch);
+      doc.version = delta.version;
+      set(doc);
+    } else if (delta.version > doc.version) {
+      // missed one in between
+      fetchDocument();
+    }
+  });
+  fetchDocument();
+  return accept;
+}
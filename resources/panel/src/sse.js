@@ -9,9 +9,9 @@ function createSSE(url) {
     update(() => ({data: event.data, ts: Date.now()}));
   };
 
+  // EventSource reconnects by itself and resumes after the last event seen
   eventSource.onerror = error => {
     console.error("SSE error:", error);
-    eventSource.close();
   };
 
   return {
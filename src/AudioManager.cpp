@@ -3,6 +3,7 @@
 #include "DataManager.hpp"
 #include "LAppDefine.hpp"
 #include "LAppPal.hpp"
+#include "Random.hpp"
 using namespace LAppDefine;
 
 namespace {
@@ -57,7 +58,7 @@ bool AudioManager::IsPlay() {
 
 
 void AudioManager::Play3dSound(AudioType t) {
-  Play3dSound(t, rand() % 100);
+  Play3dSound(t, Random::Below(100));
 }
 
 void AudioManager::Play3dSound(AudioType t, int no) {
@@ -94,7 +95,8 @@ void AudioManager::Play3dSound(AudioType t, int no) {
 
 void AudioManager::Play3dSound(const wstring& target_audio_file) {
   LAppPal::PrintLog(LogLevel::Debug, L"[AudioManager]Play Sound: %ls", target_audio_file.c_str());
-  if (DataManager::GetInstance()->GetConfig<bool>("audio", "mute", false)) {
+  const auto& config = DataManager::GetInstance()->Config();
+  if (config.mute) {
     return;
   }
   bool isPlay;
@@ -106,7 +108,7 @@ void AudioManager::Play3dSound(const wstring& target_audio_file) {
   } else {
     sound = iter->second;
   }
-  float volume = float(DataManager::GetInstance()->GetConfig<int>("audio", "volume", 20)) / 10;
+  float volume = float(config.volume) / 10;
   if (_channel) {
     _channel->isPlaying(&isPlay);
     if (!isPlay) {
@@ -0,0 +1,300 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <initializer_list>
+#include <map>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include "JsonScan.hpp"
+
+/**
+ * @brief  The fields JPet reads from bilibili API responses, picked out
+ * with JsonScan instead of parsing the whole body. Each Parse* returns
+ * nullopt when the body is not JSON or a field the caller relies on is
+ * missing; a non-zero code is returned as is, with nothing else read.
+ * Shared by the watchers, BuffManager, the panel and tools/json_bench.
+ */
+namespace bili {
+
+/**
+ * @brief  x/polymer/web-dynamic/v1/feed/space
+ */
+struct Feed {
+  int code = 0;
+  bool empty = false;
+  // newest pub_ts of the first two items, the first may be pinned
+  int64_t latest = 0;
+  // the newest dynamic that is not a live card nor pinned
+  bool found = false;
+  std::string id;
+  std::string type;
+  std::string desc;
+};
+
+/**
+ * @brief  x/space/wbi/acc/info
+ */
+struct Account {
+  int code = 0;
+  std::string name;
+  // live_room is null or missing for users without a room
+  bool has_room = false;
+  std::string room_title;
+  std::string room_id;
+};
+
+/**
+ * @brief  room/v1/Room/getRoomInfoOld
+ */
+struct Room {
+  int code = 0;
+  // roomStatus 0 is a user without a room
+  bool has_room = true;
+  bool live = false;
+  std::string title;
+  std::string room_id;
+};
+
+/**
+ * @brief  room/v1/Room/get_status_info_by_uids, rooms by uid
+ */
+struct RoomBatch {
+  int code = 0;
+  std::map<std::string, Room> rooms;
+};
+
+/**
+ * @brief  xlive/web-ucenter/user/MedalWall, the medal of one streamer
+ */
+struct Medal {
+  int code = 0;
+  bool found = false;
+  int level = 0;
+  int guard_level = 0;
+};
+
+namespace detail {
+
+// code of the response, nullopt if the body is not an API response
+inline std::optional<int> Code(const JsonScan& json) {
+  JsonScan code = json.Field("code");
+  if (!code) {
+    return std::nullopt;
+  }
+  return static_cast<int>(code.Int());
+}
+
+inline JsonScan Path(JsonScan json,
+                     std::initializer_list<std::string_view> path) {
+  for (auto name : path) {
+    json = json.Field(name);
+  }
+  return json;
+}
+
+}  // namespace detail
+
+inline std::optional<Feed> ParseFeed(std::string_view body) {
+  constexpr std::string_view kLiveCard = "\"DYNAMIC_TYPE_LIVE_RCMD\"";
+  JsonScan json(body);
+  auto code = detail::Code(json);
+  if (!code) {
+    return std::nullopt;
+  }
+  Feed feed;
+  feed.code = *code;
+  if (feed.code != 0) {
+    return feed;
+  }
+  JsonScan items = detail::Path(json, {"data", "items"});
+  if (!items.IsArray()) {
+    return std::nullopt;
+  }
+  // stops once the dynamic to show is known, the rest of the feed is
+  // never looked at
+  JsonScan first;
+  JsonScan second;
+  bool pinned = false;
+  bool broken = false;
+  size_t index = 0;
+  items.ForEach([&](JsonScan item) {
+    static constexpr std::string_view kNames[] = {"type", "modules"};
+    auto [type, modules] = item.Fields(kNames);
+    if (!type.IsString() || !modules.IsObject()) {
+      broken = true;
+      return false;
+    }
+    if (index < 2) {
+      JsonScan pub_ts = detail::Path(modules, {"module_author", "pub_ts"});
+      if (!pub_ts) {
+        broken = true;
+        return false;
+      }
+      feed.latest = std::max(feed.latest, pub_ts.Int());
+    }
+    // compared with the quotes, a type never has escapes
+    if (type.Raw() != kLiveCard) {
+      if (!first) {
+        first = item;
+        pinned = index == 0 && modules.Field("module_tag").Valid();
+      } else if (!second) {
+        second = item;
+      }
+    }
+    index++;
+    return index < 2 || !first || (pinned && !second);
+  });
+  if (broken) {
+    return std::nullopt;
+  }
+  feed.empty = index == 0;
+  // a pinned dynamic is shown only if nothing else is
+  JsonScan valid = pinned && second ? second : first;
+  if (!valid) {
+    return feed;
+  }
+  static constexpr std::string_view kNames[] = {"id_str", "type", "modules"};
+  auto [id, type, modules] = valid.Fields(kNames);
+  if (!id.IsString()) {
+    return std::nullopt;
+  }
+  feed.found = true;
+  feed.id = id.String();
+  feed.type = type.String();
+  JsonScan dynamic = modules.Field("module_dynamic");
+  if (feed.type == "DYNAMIC_TYPE_AV") {
+    feed.desc =
+        detail::Path(dynamic, {"major", "archive", "title"}).String();
+  } else {
+    feed.desc = detail::Path(dynamic, {"desc", "text"}).String();
+  }
+  return feed;
+}
+
+inline std::optional<Account> ParseAccount(std::string_view body) {
+  JsonScan json(body);
+  auto code = detail::Code(json);
+  if (!code) {
+    return std::nullopt;
+  }
+  Account account;
+  account.code = *code;
+  if (account.code != 0) {
+    return account;
+  }
+  static constexpr std::string_view kNames[] = {"name", "live_room"};
+  auto [name, live_room] = json.Field("data").Fields(kNames);
+  if (!name.IsString()) {
+    return std::nullopt;
+  }
+  account.name = name.String();
+  if (live_room.IsObject()) {
+    static constexpr std::string_view kRoom[] = {"title", "roomid"};
+    auto [title, roomid] = live_room.Fields(kRoom);
+    account.has_room = true;
+    account.room_title = title.String();
+    account.room_id = std::to_string(roomid.Int());
+  }
+  return account;
+}
+
+inline std::optional<Room> ParseRoom(std::string_view body) {
+  JsonScan json(body);
+  auto code = detail::Code(json);
+  if (!code) {
+    return std::nullopt;
+  }
+  Room room;
+  room.code = *code;
+  if (room.code != 0) {
+    return room;
+  }
+  static constexpr std::string_view kNames[] = {"roomStatus", "liveStatus",
+                                                "title", "roomid"};
+  auto [status, live, title, roomid] = json.Field("data").Fields(kNames);
+  room.has_room = status.Int(1) != 0;
+  if (!room.has_room) {
+    return room;
+  }
+  if (!live || !title.IsString() || !roomid) {
+    return std::nullopt;
+  }
+  room.live = live.Int() == 1;
+  room.title = title.String();
+  room.room_id = std::to_string(roomid.Int());
+  return room;
+}
+
+inline std::optional<RoomBatch> ParseRoomBatch(std::string_view body) {
+  JsonScan json(body);
+  auto code = detail::Code(json);
+  if (!code) {
+    return std::nullopt;
+  }
+  RoomBatch batch;
+  batch.code = *code;
+  if (batch.code != 0) {
+    return batch;
+  }
+  bool broken = false;
+  // an empty array when none of the uids has a room
+  json.Field("data").ForEachMember([&](std::string_view uid, JsonScan data) {
+    static constexpr std::string_view kNames[] = {"live_status", "title",
+                                                  "room_id"};
+    auto [live, title, roomid] = data.Fields(kNames);
+    if (!live || !title.IsString() || !roomid) {
+      broken = true;
+      return false;
+    }
+    Room& room = batch.rooms[std::string(uid)];
+    room.live = live.Int() == 1;
+    room.title = title.String();
+    room.room_id = std::to_string(roomid.Int());
+    return true;
+  });
+  if (broken) {
+    return std::nullopt;
+  }
+  return batch;
+}
+
+inline std::optional<Medal> ParseMedal(std::string_view body,
+                                       int64_t target_id) {
+  JsonScan json(body);
+  auto code = detail::Code(json);
+  if (!code) {
+    return std::nullopt;
+  }
+  Medal medal;
+  medal.code = *code;
+  if (medal.code != 0) {
+    return medal;
+  }
+  bool broken = false;
+  detail::Path(json, {"data", "list"}).ForEach([&](JsonScan entry) {
+    static constexpr std::string_view kNames[] = {"medal_info", "uinfo_medal"};
+    auto [info, uinfo] = entry.Fields(kNames);
+    if (info.Field("target_id").Int() != target_id) {
+      return true;
+    }
+    static constexpr std::string_view kMedal[] = {"level", "guard_level"};
+    auto [level, guard_level] = uinfo.Fields(kMedal);
+    if (!level || !guard_level) {
+      broken = true;
+      return false;
+    }
+    medal.found = true;
+    medal.level = static_cast<int>(level.Int());
+    medal.guard_level = static_cast<int>(guard_level.Int());
+    return false;
+  });
+  if (broken) {
+    return std::nullopt;
+  }
+  return medal;
+}
+
+}  // namespace bili
@@ -1,169 +1,202 @@
 #include "BuffManager.hpp"
+#include "BiliResponse.hpp"
+#include "CookieStore.hpp"
 #include "DataManager.hpp"
+#include "HttpPool.hpp"
 #include "LAppPal.hpp"
 #include "PanelServer.hpp"
 #include "Wbi.hpp"
 
+#include <algorithm>
 #include <httplib.h>
 
 void BuffManager::thread() {
-  time_t last = 0;
-  while(running_) {
+  {
+    // game data buffs, later changes come through SetFail()
+    DataManager* dm = DataManager::GetInstance();
+    bool fail = dm->Get(keys::FailCount) >= 2;
+    bool legacy = dm->Get(keys::Legacy) > 0;
+    std::lock_guard<std::mutex> lock(mutex_);
+    timeline_.SetFail(fail);
+    timeline_.SetLegacy(legacy);
+  }
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (running_) {
     time_t now = time(nullptr);
-    if (now - last >= 10) {
-      last = now;
-      Update();
+    if (now >= timeline_.NextRefresh()) {
+      lock.unlock();
+      refresh();
+      lock.lock();
+      continue;
+    }
+    time_t wake =
+        std::min(timeline_.NextRefresh(), timeline_.NextTransition(now));
+    cv_.wait_until(lock, std::chrono::system_clock::from_time_t(wake));
+    if (!running_) {
+      break;
     }
-    std::this_thread::sleep_for(std::chrono::seconds(1));
+    // a buff started or ended by itself, or SetFail() woke us up
+    lock.unlock();
+    publish(time(nullptr), false);
+    lock.lock();
   }
   LAppPal::PrintLog(LogLevel::Info, "[BuffManager]Worker exit");
 }
 
 void BuffManager::Update() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    timeline_.RefreshNow();
+  }
+  cv_.notify_all();
+}
+
+void BuffManager::SetFail(bool fail) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    timeline_.SetFail(fail);
+  }
+  cv_.notify_all();
+}
+
+ExpFactors BuffManager::Factors() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return timeline_.At(time(nullptr));
+}
+
+void BuffManager::refresh() {
   auto start_time = std::chrono::high_resolution_clock::now();
-  DataManager* dm = DataManager::GetInstance();
-  auto cookies = dm->GetWithDefault("cookies", "");
-  auto user_agent = dm->GetWithDefault("user-agent", "");
-  if (cookies.empty()) {
-    // not login, just skip
-    PanelServer::GetInstance()->Notify("UPDATE");
-    return;
+  auto cookies = CookieStore::GetInstance()->Login();
+  // not login, keep what was seen before
+  if (cookies->Valid()) {
+    auto user_agent = DataManager::GetInstance()->Get(keys::UserAgent);
+    httplib::Headers headers = {{"cookie", cookies->Header()},
+                                {"User-Agent", user_agent}};
+    updateDynamic(headers);
+    updateLive(headers);
+    updateGuard(headers, cookies->Uid());
+    auto end_time = std::chrono::high_resolution_clock::now();
+    auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(
+        end_time - start_time);
+    if (duration.count() >= 1500) {
+      LAppPal::PrintLog(LogLevel::Info,
+                        "[BuffManager]Update buffs status cost=%dms",
+                        duration.count());
+    }
   }
-  httplib::Headers headers = {{"cookie", cookies}, {"User-Agent", user_agent}};
-  updateDynamic(headers);
-  updateLive(headers);
-  updateGuard(headers);
-  auto end_time = std::chrono::high_resolution_clock::now();
-  auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time);
-  if (duration.count() >= 1500) {
-    LAppPal::PrintLog(LogLevel::Info,
-                      "[BuffManager]Update buffs status cost=%dms",
-                      duration.count());
-  }
-  PanelServer::GetInstance()->Notify("UPDATE");
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    timeline_.SetDynamic(latest_);
+    timeline_.SetLive(is_live_);
+    timeline_.SetGuard(is_guard_, medal_level_);
+  }
+  publish(time(nullptr), true);
 }
 
-void BuffManager::updateDynamic(const httplib::Headers& headers) {
-  httplib::SSLClient dynamicCli("api.bilibili.com", 443);
-  dynamicCli.set_connection_timeout(std::chrono::seconds(1));
+void BuffManager::publish(time_t now, bool refreshed) {
+  bool changed = false;
+  BuffState buffs;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    changed = timeline_.Publish(now);
+    if (refreshed) {
+      timeline_.Refreshed(now, changed);
+    }
+    buffs = timeline_.Published().buffs;
+  }
+  // every refresh is recorded, unchanged or not, so exp accrual can tell
+  // buffs that hold from buffs nobody looked at while asleep
+  if (changed || refreshed) {
+    DataManager::GetInstance()->RecordBuffs(buffs);
+  }
+  if (changed) {
+    PanelServer::GetInstance()->Changed(PanelData::PROFILE);
+  }
+}
 
-  auto dres = dynamicCli.Get(
+void BuffManager::updateDynamic(const httplib::Headers& headers) {
+  auto dres = HttpPool::GetInstance()->Get(
+      "api.bilibili.com",
       "/x/polymer/web-dynamic/v1/feed/space?host_mid=61639371", headers);
   if (dres && dres->status == 200) {
-    try {
-      time_t new_latest_ = 0;
-      auto json = nlohmann::json::parse(dres->body);
-      if (json["code"].get<int>() != 0) {
-        LAppPal::PrintLog(LogLevel::Warn, "[BuffManager]Fetch dynamic failed code %d", json["code"].get<int>());
-        return;
-      }
-      auto dynamic_items = json["data"]["items"];
-      if (dynamic_items.size() > 0) {
-        new_latest_ = dynamic_items[0]["modules"]["module_author"]["pub_ts"];
-        // in case there is a topmost dynamic
-        if (dynamic_items.size() > 1) {
-          new_latest_ = std::max(
-              new_latest_, dynamic_items[1]["modules"]["module_author"]["pub_ts"]
-                           .get<time_t>());
-        }
-      }
-      if (new_latest_ > latest_) {
-        latest_ = new_latest_;
-        LAppPal::PrintLog(LogLevel::Info, "[BuffManager]Latest dynamic posted: %d", latest_);
-      }
-      time_t current = time(NULL);
-      if (current - latest_ <= 4 * 60 * 60) {
-        is_dynamic_ = true;
-      }
-    } catch(const std::exception& e) {
-      is_dynamic_ = false;
+    auto feed = bili::ParseFeed(dres->body);
+    if (!feed) {
+      // the buff still ends 4 hours after the last post seen
       LAppPal::PrintLog(LogLevel::Error, "[BuffManager]Parse dynamic response failed");
+      return;
+    }
+    if (feed->code != 0) {
+      LAppPal::PrintLog(LogLevel::Warn, "[BuffManager]Fetch dynamic failed code %d", feed->code);
+      return;
+    }
+    // in case there is a topmost dynamic, latest is of the first two
+    time_t new_latest_ = static_cast<time_t>(feed->latest);
+    if (new_latest_ > latest_) {
+      latest_ = new_latest_;
+      LAppPal::PrintLog(LogLevel::Info, "[BuffManager]Latest dynamic posted: %d", latest_);
     }
-  } else {
-    is_dynamic_ = false;
   }
 }
 
 void BuffManager::updateLive(const httplib::Headers &headers) {
-  httplib::SSLClient live_cli("api.live.bilibili.com", 443);
-  live_cli.set_connection_timeout(std::chrono::seconds(1));
-
   nlohmann::json Params;
   Params["mid"] = 61639371;
 
-  auto infores = live_cli.Get(
-      ("/room/v1/Room/getRoomInfoOld?" + Wbi::Json_to_url_encode_str(Params))
-          .c_str(),
+  auto infores = HttpPool::GetInstance()->Get(
+      "api.live.bilibili.com",
+      "/room/v1/Room/getRoomInfoOld?" + Wbi::Json_to_url_encode_str(Params),
       headers);
   if (infores && infores->status == 200) {
-    try {
-      auto json = nlohmann::json::parse(infores->body);
-      int code = json["code"].get<int>();
-      if (code != 0) {
-        LAppPal::PrintLog(LogLevel::Warn,
-                          "[BuffManager]Fetch room status failed %d", code);
-        is_live_ = false;
-        return;
-      }
-      is_live_ = json.at("data").at("liveStatus").get<int>() == 1;
-    } catch (const std::exception &e) {
+    auto room = bili::ParseRoom(infores->body);
+    if (!room) {
+      is_live_ = false;
+      LAppPal::PrintLog(LogLevel::Error, "[BuffManager]Parse room info failed");
+      return;
+    }
+    if (room->code != 0) {
+      LAppPal::PrintLog(LogLevel::Warn,
+                        "[BuffManager]Fetch room status failed %d", room->code);
       is_live_ = false;
-      LAppPal::PrintLog(LogLevel::Error, "[BuffManager]Parse room info failed %s", e.what());
+      return;
     }
+    is_live_ = room->live;
   } else {
     is_live_ = false;
     LAppPal::PrintLog(LogLevel::Error, "[BuffManager]Fetch room info failed");
   }
 }
 
-void BuffManager::updateGuard(const httplib::Headers& headers) {
-  httplib::SSLClient guard_cli("api.live.bilibili.com", 443);
-  guard_cli.set_connection_timeout(std::chrono::seconds(1));
-
-  string uid = DataManager::GetInstance()->GetWithDefault("uid", "");
+void BuffManager::updateGuard(const httplib::Headers& headers,
+                              std::string_view uid) {
   if (uid.empty()) {
-    string cookies = DataManager::GetInstance()->GetWithDefault("cookies", "");
-    // get uid from cookies string, find DedeUserID
-    std::regex pattern("DedeUserID=([0-9]+)");
-    std::smatch match;
-    std::regex_search(cookies, match, pattern);
-    if (match.size() < 2) {
-      LAppPal::PrintLog(LogLevel::Warn, "[BuffManager]No valid uid");
-      return;
-    }
-    uid = match[1];
-    DataManager::GetInstance()->SetRaw("uid", uid);
+    LAppPal::PrintLog(LogLevel::Warn, "[BuffManager]No valid uid");
+    return;
   }
-  
+
   nlohmann::json Params;
-  Params["target_id"] = uid;
+  Params["target_id"] = std::string(uid);
 
-  auto infores = guard_cli.Get(
-      ("/xlive/web-ucenter/user/MedalWall?" + Wbi::Json_to_url_encode_str(Params))
-          .c_str(),
+  auto infores = HttpPool::GetInstance()->Get(
+      "api.live.bilibili.com",
+      "/xlive/web-ucenter/user/MedalWall?" + Wbi::Json_to_url_encode_str(Params),
       headers);
   if (infores && infores->status == 200) {
-    try {
-      auto json = nlohmann::json::parse(infores->body);
-      int code = json["code"].get<int>();
-      if (code != 0) {
-        LAppPal::PrintLog(LogLevel::Warn,
-                          "[BuffManager]Fetch medal failed %d", code);
-        is_guard_ = false;
-        return;
-      }
-      for (const auto& entry : json["data"]["list"]) {
-        if (entry["medal_info"]["target_id"].get<long long>() != 61639371) {
-          continue;
-        }
-        medal_level_ = entry["uinfo_medal"]["level"].get<int>();
-        if (entry["uinfo_medal"]["guard_level"].get<int>() > 0) {
-          is_guard_ = true;
-        }
-      }
-    } catch(const std::exception& e) {
+    auto medal = bili::ParseMedal(infores->body, 61639371);
+    if (!medal) {
+      is_guard_ = false;
+      LAppPal::PrintLog(LogLevel::Error, "[BuffManager]Parse medal info failed");
+      return;
+    }
+    if (medal->code != 0) {
+      LAppPal::PrintLog(LogLevel::Warn,
+                        "[BuffManager]Fetch medal failed %d", medal->code);
       is_guard_ = false;
-      LAppPal::PrintLog(LogLevel::Error, "[BuffManager]Parse medal info failed %s", e.what());
+      return;
+    }
+    if (medal->found) {
+      medal_level_ = medal->level;
+      // an expired guard ends the buff
+      is_guard_ = medal->guard_level > 0;
     }
   } else {
     is_guard_ = false;
@@ -172,49 +205,28 @@ void BuffManager::updateGuard(const httplib::Headers& headers) {
 }
 
 std::vector<std::string> BuffManager::GetBuffList() {
+  ExpFactors factors = Factors();
   std::vector<std::string> buffs;
-  if (is_live_) {
+  if (factors.buffs.live) {
     buffs.push_back("live");
   }
-  if (is_dynamic_) {
+  if (factors.buffs.dynamic) {
     buffs.push_back("dynamic");
   }
-  if (is_guard_) {
+  if (factors.buffs.guard) {
     buffs.push_back("guard");
   }
-  if (IsFail()) {
+  if (factors.fail) {
     buffs.push_back("fail");
   }
-  if (IsMonday()) {
+  if (factors.monday) {
     buffs.push_back("monday");
   }
-  if (IsBirthday()) {
+  if (factors.birthday) {
     buffs.push_back("birthday");
   }
-  if (IsLegacy()) {
+  if (factors.legacy) {
     buffs.push_back("legacy");
   }
   return buffs;
 }
-
-bool BuffManager::IsFail() {
-  return DataManager::GetInstance()->GetWithDefault("buff.failcount", 0) >= 2;
-}
-
-bool BuffManager::IsMonday() {
-  time_t now = time(0);
-  tm ltm;
-  localtime_s(&ltm, &now);
-  return ltm.tm_wday == 1;
-}
-
-bool BuffManager::IsBirthday() {
-  time_t now = time(0);
-  tm ltm;
-  localtime_s(&ltm, &now);
-  return ltm.tm_mon == 10 && ltm.tm_mday == 25;
-}
-
-bool BuffManager::IsLegacy() {
-  return DataManager::GetInstance()->GetWithDefault("legacy", 0) > 0;
-}
@@ -1,15 +1,27 @@
 #pragma once
+#include <condition_variable>
+#include <mutex>
 #include <vector>
 #include <string>
+#include <string_view>
 
 #include "httplib.h"
+#include "BuffTimeline.hpp"
+#include "CookieStore.hpp"
+#include "HttpPool.hpp"
 
 // BuffManager manages buff status. buffs are stored in memory, no need to persist.
+// The worker sleeps until the next remote refresh or the next time a buff
+// starts or ends by itself, and reports only real changes.
 class BuffManager {
 private:
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  BuffTimeline timeline_;
+
+  // what the last remote refresh saw, only touched by the worker
   time_t latest_ = 0;
   bool is_live_ = false;
-  bool is_dynamic_ = false;
   bool is_guard_ = false;
   int medal_level_ = 0;
 
@@ -18,48 +30,71 @@ private:
 
   void updateDynamic(const httplib::Headers& headers);
   void updateLive(const httplib::Headers& headers);
-  void updateGuard(const httplib::Headers& headers);
+  void updateGuard(const httplib::Headers& headers, std::string_view uid);
 
   void thread();
-  
+
+  // fetch the remote buffs, runs on the worker
+  void refresh();
+
+  // move the timeline to now, then record and notify if the buffs changed
+  void publish(time_t now, bool refreshed);
+
 public:
   static BuffManager* GetInstance() {
     static BuffManager instance;
     return &instance;
   }
 
-  BuffManager() { worker_ = std::thread(&BuffManager::thread, this); }
+  BuffManager() {
+    // the pool and the cookies are used until the worker exits, construct
+    // them first so they are destroyed after us
+    HttpPool::GetInstance();
+    CookieStore::GetInstance();
+    worker_ = std::thread(&BuffManager::thread, this);
+  }
 
   ~BuffManager() {
-    running_ = false;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      running_ = false;
+    }
+    cv_.notify_all();
     worker_.join();
   }
 
   std::vector<std::string> GetBuffList();
 
+  /**
+   * @brief  Refresh the remote buffs soon, e.g. right after login.
+   */
   void Update();
 
-  bool IsLive() {
-    return is_live_;
-  }
+  /**
+   * @brief  Game data buffs, called when the stored values change.
+   */
+  void SetFail(bool fail);
 
-  bool IsDynamic() {
-    return is_dynamic_;
-  }
+  /**
+   * @brief  Buffs in effect now, intellect and star count left 0.
+   */
+  ExpFactors Factors();
 
-  bool IsGuard() {
-    return is_guard_;
-  }
+  bool IsLive() { return Factors().buffs.live; }
 
-  bool IsFail();
+  bool IsDynamic() { return Factors().buffs.dynamic; }
 
-  bool IsMonday();
+  bool IsGuard() { return Factors().buffs.guard; }
 
-  bool IsBirthday();
+  bool IsFail() { return Factors().fail; }
 
-  bool IsLegacy();
+  bool IsMonday() { return Factors().monday; }
 
-  int MedalLevel() {
-    return medal_level_;
-  }
+  bool IsBirthday() { return Factors().birthday; }
+
+  bool IsLegacy() { return Factors().legacy; }
+
+  int MedalLevel() { return Factors().buffs.medal_level; }
+
+  BuffState Buffs() { return Factors().buffs; }
 };
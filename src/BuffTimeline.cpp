@@ -0,0 +1,56 @@
+#include "BuffTimeline.hpp"
+
+#include <algorithm>
+
+#include "ExpAccrual.hpp"
+
+ExpFactors BuffTimeline::At(time_t now) const {
+  ExpFactors factors;
+  factors.buffs.live = live_;
+  factors.buffs.dynamic =
+      latest_post_ != 0 && latest_post_ <= now &&
+      now < latest_post_ + kDynamicLasts;
+  factors.buffs.guard = guard_;
+  factors.buffs.medal_level = medal_level_;
+  factors.fail = fail_;
+  factors.legacy = legacy_;
+  if (day_begin_ <= now && now < day_end_) {
+    factors.monday = monday_;
+    factors.birthday = birthday_;
+  } else {
+    // not published since midnight yet
+    CalendarBuffs(now, &factors.monday, &factors.birthday);
+  }
+  return factors;
+}
+
+time_t BuffTimeline::NextTransition(time_t now) const {
+  time_t next = day_end_ > now ? day_end_ : now;
+  if (latest_post_ > now) {
+    next = std::min(next, latest_post_);
+  } else if (latest_post_ != 0 && latest_post_ + kDynamicLasts > now) {
+    next = std::min(next, latest_post_ + kDynamicLasts);
+  }
+  return next;
+}
+
+bool BuffTimeline::Publish(time_t now) {
+  if (now < day_begin_ || now >= day_end_) {
+    CalendarBuffs(now, &monday_, &birthday_);
+    day_begin_ = now;
+    day_end_ = NextMidnight(now);
+  }
+  ExpFactors current = At(now);
+  bool changed = current.buffs != published_.buffs ||
+                 current.monday != published_.monday ||
+                 current.birthday != published_.birthday ||
+                 current.fail != published_.fail ||
+                 current.legacy != published_.legacy;
+  published_ = current;
+  return changed;
+}
+
+void BuffTimeline::Refreshed(time_t now, bool changed) {
+  interval_ = changed ? kMinRefresh : std::min(interval_ * 2, kMaxRefresh);
+  next_refresh_ = now + interval_;
+}
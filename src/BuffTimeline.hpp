@@ -0,0 +1,85 @@
+#pragma once
+
+#include <ctime>
+
+#include "GameFormula.hpp"
+
+/**
+ * @brief  When each buff starts and ends, so the current buffs are known
+ * between remote refreshes. The dynamic buff lasts kDynamicLasts from the
+ * latest post, monday and birthday last until local midnight; live, guard,
+ * medal, fail and legacy hold until set again. Time is always passed in,
+ * nothing here reads the clock.
+ */
+class BuffTimeline {
+ public:
+  static constexpr time_t kDynamicLasts = 4 * 60 * 60;
+  // remote refresh interval, doubling while nothing changes. Capped below
+  // ExpTimeline::kStale so accrual never sees the buffs go stale
+  static constexpr time_t kMinRefresh = 10;
+  static constexpr time_t kMaxRefresh = 60;
+
+  void SetDynamic(time_t latest_post) { latest_post_ = latest_post; }
+  void SetLive(bool live) { live_ = live; }
+  void SetGuard(bool guard, int medal_level) {
+    guard_ = guard;
+    medal_level_ = medal_level;
+  }
+  void SetFail(bool fail) { fail_ = fail; }
+  void SetLegacy(bool legacy) { legacy_ = legacy; }
+
+  /**
+   * @brief  Buffs in effect at now, intellect and star count left 0.
+   */
+  ExpFactors At(time_t now) const;
+
+  /**
+   * @brief  First instant after now where At() changes by itself.
+   */
+  time_t NextTransition(time_t now) const;
+
+  /**
+   * @brief  Move the published state to At(now).
+   * @return true if it differs from the state published before
+   */
+  bool Publish(time_t now);
+
+  /**
+   * @brief  State of the last Publish().
+   */
+  const ExpFactors& Published() const { return published_; }
+
+  /**
+   * @brief  A remote refresh finished at now. Refreshes come quickly after
+   * a change or at start and back off while the buffs hold.
+   */
+  void Refreshed(time_t now, bool changed);
+
+  time_t NextRefresh() const { return next_refresh_; }
+
+  /**
+   * @brief  Refresh at the next chance, e.g. after login.
+   */
+  void RefreshNow() {
+    interval_ = kMinRefresh;
+    next_refresh_ = 0;
+  }
+
+ private:
+  time_t latest_post_ = 0;
+  bool live_ = false;
+  bool guard_ = false;
+  int medal_level_ = 0;
+  bool fail_ = false;
+  bool legacy_ = false;
+
+  // calendar of the local day [day_begin_, day_end_), updated by Publish()
+  time_t day_begin_ = 0;
+  time_t day_end_ = 0;
+  bool monday_ = false;
+  bool birthday_ = false;
+
+  ExpFactors published_;
+  time_t interval_ = kMinRefresh;
+  time_t next_refresh_ = 0;
+};
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <toml++/toml.hpp>
+#include <vector>
+
+/**
+ * @brief  Typed, immutable copy of the jpet.toml settings read at runtime.
+ * DataManager publishes a new one after every config change, readers keep
+ * using the one they hold until they ask again, see DataManager::Config().
+ */
+struct ConfigSnapshot {
+  // bumped on every publish, 0 is never published
+  uint64_t version = 0;
+
+  // [audio]
+  int volume = 20;
+  bool mute = false;
+  bool idle_audio = true;
+  bool touch_audio = true;
+
+  // [display]
+  float scale = 1.0f;
+  bool green = false;
+  bool rate_limit = false;
+
+  // [other]
+  bool dropfile = true;
+  bool track = true;
+
+  // [notify]
+  bool notify_dynamic = true;
+  bool notify_live = true;
+  bool notify_update = true;
+  std::vector<std::string> follow_list;
+
+  /**
+   * @brief  Read settings from the table, missing or mistyped entries keep
+   * their defaults.
+   */
+  static ConfigSnapshot From(const toml::table& data) {
+    ConfigSnapshot config;
+    auto audio = data["audio"];
+    config.volume = audio["volume"].value_or(config.volume);
+    config.mute = audio["mute"].value_or(config.mute);
+    config.idle_audio = audio["idle_audio"].value_or(config.idle_audio);
+    config.touch_audio = audio["touch_audio"].value_or(config.touch_audio);
+
+    auto display = data["display"];
+    config.scale = display["scale"].value_or(config.scale);
+    config.green = display["green"].value_or(config.green);
+    config.rate_limit = display["rateLimit"].value_or(config.rate_limit);
+
+    auto other = data["other"];
+    config.dropfile = other["dropfile"].value_or(config.dropfile);
+    config.track = other["track"].value_or(config.track);
+
+    auto notify = data["notify"];
+    config.notify_dynamic = notify["dynamic"].value_or(config.notify_dynamic);
+    config.notify_live = notify["live"].value_or(config.notify_live);
+    config.notify_update = notify["update"].value_or(config.notify_update);
+    if (auto follows = notify["followList"].as_array()) {
+      for (const auto& follow : *follows) {
+        if (auto uid = follow.value<std::string>()) {
+          config.follow_list.push_back(*uid);
+        }
+      }
+    }
+    return config;
+  }
+};
@@ -0,0 +1,120 @@
+#include "CookieStore.hpp"
+
+#include <charconv>
+
+#include "DataManager.hpp"
+
+namespace {
+
+std::string_view Trim(std::string_view s) {
+  size_t begin = s.find_first_not_of(" \t");
+  if (begin == std::string_view::npos) {
+    return {};
+  }
+  return s.substr(begin, s.find_last_not_of(" \t") - begin + 1);
+}
+
+time_t ParseTime(std::string_view s) {
+  long long value = 0;
+  auto [end, ec] = std::from_chars(s.data(), s.data() + s.size(), value);
+  return ec == std::errc() && end == s.data() + s.size()
+             ? static_cast<time_t>(value)
+             : 0;
+}
+
+// SESSDATA is "<token>,<expires>,<check>", the commas url encoded
+time_t SessionExpires(std::string_view sessdata) {
+  for (std::string_view comma : {"%2C", "%2c", ","}) {
+    size_t begin = sessdata.find(comma);
+    if (begin == std::string_view::npos) {
+      continue;
+    }
+    begin += comma.size();
+    size_t end = sessdata.find(comma, begin);
+    if (end == std::string_view::npos) {
+      continue;
+    }
+    return ParseTime(sessdata.substr(begin, end - begin));
+  }
+  return 0;
+}
+
+}  // namespace
+
+CookieJar::CookieJar(std::string_view cookies) {
+  while (!cookies.empty()) {
+    size_t semicolon = cookies.find(';');
+    std::string_view pair = Trim(cookies.substr(0, semicolon));
+    cookies = semicolon == std::string_view::npos
+                  ? std::string_view()
+                  : cookies.substr(semicolon + 1);
+    if (pair.empty()) {
+      continue;
+    }
+    size_t equal = pair.find('=');
+    std::string_view name = Trim(pair.substr(0, equal));
+    std::string_view value = equal == std::string_view::npos
+                                 ? std::string_view()
+                                 : Trim(pair.substr(equal + 1));
+    if (!_header.empty()) {
+      _header.append("; ");
+    }
+    _header.append(pair);
+    _cookies.try_emplace(std::string(name), value);
+  }
+  // the login url carries Expires next to the cookies
+  _expires = ParseTime(Get("Expires"));
+  if (_expires == 0) {
+    _expires = SessionExpires(Get("SESSDATA"));
+  }
+}
+
+std::string_view CookieJar::Get(std::string_view name) const {
+  auto it = _cookies.find(name);
+  return it == _cookies.end() ? std::string_view() : it->second;
+}
+
+void CookieStore::Load() {
+  auto jar = std::make_shared<CookieJar>(
+      DataManager::GetInstance()->Get(keys::Cookies));
+  std::lock_guard<std::mutex> lock(_mutex);
+  std::atomic_store(&_login, std::shared_ptr<const CookieJar>(std::move(jar)));
+}
+
+void CookieStore::SetLogin(std::string_view cookies) {
+  auto jar = std::make_shared<CookieJar>(cookies);
+  std::lock_guard<std::mutex> lock(_mutex);
+  DataManager* dm = DataManager::GetInstance();
+  auto txn = dm->BeginTransaction();
+  dm->Set(txn, keys::Cookies, jar->Header());
+  dm->Set(txn, keys::Uid, std::string(jar->Uid()));
+  txn.Commit();
+  std::atomic_store(&_login, std::shared_ptr<const CookieJar>(std::move(jar)));
+}
+
+void CookieStore::ClearLogin() {
+  std::lock_guard<std::mutex> lock(_mutex);
+  DataManager::GetInstance()->Set(keys::Cookies, std::string());
+  std::atomic_store(
+      &_login, std::shared_ptr<const CookieJar>(std::make_shared<CookieJar>()));
+}
+
+void CookieStore::SetBrowser(std::string_view cookies) {
+  auto jar = std::make_shared<CookieJar>(cookies);
+  std::lock_guard<std::mutex> lock(_mutex);
+  std::atomic_store(&_browser,
+                    std::shared_ptr<const CookieJar>(std::move(jar)));
+}
+
+std::shared_ptr<const CookieJar> CookieStore::Login() const {
+  return std::atomic_load(&_login);
+}
+
+std::shared_ptr<const CookieJar> CookieStore::Browser() const {
+  return std::atomic_load(&_browser);
+}
+
+std::shared_ptr<const CookieJar> CookieStore::Requests() const {
+  auto login = Login();
+  return login->Valid() ? login : Browser();
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <ctime>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+
+/**
+ * @brief  Cookies parsed once from "name=value; name=value", indexed by
+ * name, with the cookie header to send them as. Never changes after
+ * construction, CookieStore replaces a jar whole.
+ */
+class CookieJar {
+ public:
+  CookieJar() = default;
+
+  // ';' separated, as document.cookie and the stored login cookies
+  explicit CookieJar(std::string_view cookies);
+
+  bool Empty() const { return _header.empty(); }
+
+  // not empty and not past Expires()
+  bool Valid(time_t now = time(nullptr)) const {
+    return !Empty() && (_expires == 0 || now < _expires);
+  }
+
+  // "" if there is no such cookie, the first one if there are several
+  std::string_view Get(std::string_view name) const;
+
+  // value of the cookie header, "name=value; name=value"
+  const std::string& Header() const { return _header; }
+
+  // unix time the login runs out, 0 if unknown
+  time_t Expires() const { return _expires; }
+
+  std::string_view Uid() const { return Get("DedeUserID"); }
+
+  // csrf token of form posts
+  std::string_view Csrf() const { return Get("bili_jct"); }
+
+ private:
+  std::map<std::string, std::string, std::less<>> _cookies;
+  std::string _header;
+  time_t _expires = 0;
+};
+
+/**
+ * @brief  The cookies every remote API call sends. The login cookies from
+ * the panel are kept in GameData and read once by Load(), the cookie
+ * window's come in through SetBrowser(). Readers get a shared jar without
+ * touching the store or parsing again.
+ */
+class CookieStore {
+ public:
+  static CookieStore* GetInstance() {
+    static CookieStore instance;
+    return &instance;
+  }
+
+  // login cookies saved in GameData
+  void Load();
+
+  // parse and save login cookies, and the uid they belong to
+  void SetLogin(std::string_view cookies);
+
+  void ClearLogin();
+
+  // cookies of the cookie window, not saved
+  void SetBrowser(std::string_view cookies);
+
+  std::shared_ptr<const CookieJar> Login() const;
+
+  std::shared_ptr<const CookieJar> Browser() const;
+
+  /**
+   * @brief  Login cookies while valid, else the cookie window's.
+   */
+  std::shared_ptr<const CookieJar> Requests() const;
+
+ private:
+  // serializes writers, readers std::atomic_load the jars
+  std::mutex _mutex;
+  std::shared_ptr<const CookieJar> _login = std::make_shared<CookieJar>();
+  std::shared_ptr<const CookieJar> _browser = std::make_shared<CookieJar>();
+
+  CookieStore() = default;
+};
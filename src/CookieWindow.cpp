@@ -1,4 +1,5 @@
 #include "CookieWindow.hpp"
+#include "CookieStore.hpp"
 #include "DataManager.hpp"
 #include "LAppPal.hpp"
 #include "LAppDefine.hpp"
@@ -127,11 +128,12 @@ void CookieWindow::WindowProc() {
                                 std::wstring wstr(message.get());
                                 auto str = LAppPal::WStringToString(wstr);
                                 if (str[0] == 'C') {
-                                  cookie = str.substr(1);
+                                  CookieStore::GetInstance()->SetBrowser(
+                                      std::string_view(str).substr(1));
                                   LAppPal::PrintLog(LogLevel::Info, "[CookieWindow]New cookie received");
                                 } else if (str[0] == 'U') {
                                   userAgent = str.substr(1);
-                                  DataManager::GetInstance()->SetRaw("user-agent", userAgent);
+                                  DataManager::GetInstance()->Set(keys::UserAgent, userAgent);
                                 }
                                 return S_OK;
                               })
@@ -13,7 +13,6 @@
 class CookieWindow {
  public:
   std::string userAgent;
-  std::string cookie;
   /**
    * @brief Construct a new GamePanel object
    *
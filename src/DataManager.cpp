@@ -1,19 +1,52 @@
 #include "DataManager.hpp"
 
-#include "BuffManager.hpp"
 #include "LAppDefine.hpp"
 #include "LAppPal.hpp"
-#include "LAppLive2DManager.hpp"
-#include "PanelServer.hpp"
+#include "TaskScheduler.hpp"
 
+#include <algorithm>
+#include <array>
+#include <cmath>
 #include <filesystem>
+#include <sstream>
+
+namespace {
+// sections and keys the settings panel expects, written back on Save()
+void FillDefaults(toml::table& data) {
+  auto section = [&data](std::string_view name) -> toml::table& {
+    if (!data[name].is_table()) {
+      data.insert_or_assign(name, toml::table{});
+    }
+    return *data[name].as_table();
+  };
+  auto& audio = section("audio");
+  audio.insert("volume", 20);
+  audio.insert("mute", false);
+  audio.insert("idle_audio", true);
+  audio.insert("touch_audio", true);
+  auto& display = section("display");
+  display.insert("scale", 1.0f);
+  display.insert("green", false);
+  display.insert("rateLimit", false);
+  auto& other = section("other");
+  other.insert("dropfile", true);
+  other.insert("track", true);
+  auto& notify = section("notify");
+  if (!notify["followList"].is_array()) {
+    notify.insert_or_assign("followList", toml::array{});
+  }
+  notify.insert("dynamic", true);
+  notify.insert("live", true);
+  notify.insert("update", true);
+}
+}  // namespace
 
 bool DataManager::init() {
   const std::wstring configPath = LAppDefine::documentPath + L"/jpet.toml";
   // check file existence
   if (!std::filesystem::exists(std::filesystem::path(configPath))) {
     // create a new config file
-    std::ofstream file(configPath);
+    std::ofstream file(std::filesystem::path{configPath});
     if (!file.is_open()) {
       LAppPal::PrintLog("Failed to create config file: %s", configPath.c_str());
       return false;
@@ -24,82 +57,114 @@ bool DataManager::init() {
                       configPath.c_str());
   } else {
     try {
-      data = toml::parse_file(configPath);
+      data = toml::parse_file(LAppPal::WStringToString(configPath));
     } catch (const toml::parse_error& err) {
       LAppPal::PrintLog("Failed to parse config file: %s", err.what());
       return false;
     }
   }
+  editConfig(FillDefaults);
 
   // check reset marker
   const std::wstring markerPath = LAppDefine::documentPath + L"/.reset";
   const std::wstring oldDataPath = LAppDefine::documentPath + L"/jpet.dat";
-  const std::wstring dataPath = LAppDefine::documentPath + L"/GameData";
   if (IsResetMarked()) {
     std::filesystem::remove(std::filesystem::path(markerPath));
     std::filesystem::remove(std::filesystem::path(oldDataPath));
-    std::filesystem::remove_all(std::filesystem::path(dataPath));
+    GameData::Destroy(LAppDefine::documentPath);
     LAppPal::PrintLog(LogLevel::Info, "[DataManager]Data reseted due to marker");
   }
   // initialize game data
-  bool firstData = !std::filesystem::exists(std::filesystem::path(dataPath)) && !std::filesystem::exists(std::filesystem::path(oldDataPath));
-  gameData = std::make_shared<GameData>(oldDataPath);
+  gameData = std::make_shared<GameData>(
+      oldDataPath, GetConfig<std::string>("data", "backend", ""));
   if (!gameData->Initialized()) {
     LAppPal::PrintLog(LogLevel::Error, "[DataManager]Failed to initialize GameData");
     return false;
   }
+  bool firstData = gameData->Fresh();
+  gameData->SetDurabilityWindow(
+      std::chrono::milliseconds(GetConfig<int>("data", "commit_window", 0)));
   if (firstData) {
-    SetRaw("data.version", 1);
-    AddAttribute("speed", 2);
-    AddAttribute("strength", 1);
-    AddAttribute("endurance", 1);
-    AddAttribute("will", 3);
-    AddAttribute("intellect", 4);
+    auto txn = gameData->Begin();
+    Set(txn, keys::DataVersion, kDataVersion);
+    AddAttribute(txn, Attr::Speed, 2);
+    AddAttribute(txn, Attr::Strength, 1);
+    AddAttribute(txn, Attr::Endurance, 1);
+    AddAttribute(txn, Attr::Will, 3);
+    AddAttribute(txn, Attr::Intellect, 4);
+    txn.Commit();
   }
   
   // check attributes that more than limit by adding 0
   // details are in AddAttribute()
-  for (const auto &attr :
-       {"speed", "endurance", "strength", "will", "intellect"}) {
-    AddAttribute(attr, 0);
-  }
-  
-  // if legacy player
-  if (GetWithDefault("data.version", 0) == 0) {
-    // prepare some extra benefit
-    int extra = 1;
-    if (GetWithDefault("clothes.1.active", 0) > 0) {
-      extra = 2;
-    }
-    if (GetWithDefault("clothes.2.active", 0) > 0) {
-      extra = 3;
-    }
-    // save login cookies
-    auto cookies = GetWithDefault("cookies", "");
-    auto user_agent = GetWithDefault("user-agent", "");
-    // drop old data
-    gameData->Drop();
-    // apply initial
-    AddAttribute("speed", 2);
-    AddAttribute("strength", 1);
-    AddAttribute("endurance", 1);
-    AddAttribute("will", 3);
-    AddAttribute("intellect", 4);
-    // apply benefit
-    for (const auto &attr :
-         {"speed", "endurance", "strength", "will", "intellect"}) {
-      AddAttribute(attr, extra);
-    }
-    SetRaw("legacy", 1);
-    // apply login cookies
-    SetRaw("cookies", cookies);
-    SetRaw("user-agent", user_agent);
-    // set data version
-    SetRaw("data.version", 1);
+  {
+    auto txn = gameData->Begin();
+    for (Attr attr : kBaseAttrs) {
+      AddAttribute(txn, attr, 0);
+    }
+    txn.Commit();
   }
+
+  migrate();
   return true;
 }
 
+namespace {
+// legacy player, data from before data.version existed
+void MigrateLegacy(DataManager* dm, GameData* gameData) {
+  // prepare some extra benefit
+  int extra = 1;
+  if (dm->Get(keys::ClothesActive[1]) > 0) {
+    extra = 2;
+  }
+  if (dm->Get(keys::ClothesActive[2]) > 0) {
+    extra = 3;
+  }
+  // save login cookies
+  auto cookies = dm->Get(keys::Cookies);
+  auto user_agent = dm->Get(keys::UserAgent);
+  // drop old data
+  gameData->Drop();
+  auto txn = gameData->Begin();
+  // apply initial
+  dm->AddAttribute(txn, Attr::Speed, 2);
+  dm->AddAttribute(txn, Attr::Strength, 1);
+  dm->AddAttribute(txn, Attr::Endurance, 1);
+  dm->AddAttribute(txn, Attr::Will, 3);
+  dm->AddAttribute(txn, Attr::Intellect, 4);
+  // apply benefit
+  for (Attr attr : kBaseAttrs) {
+    dm->AddAttribute(txn, attr, extra);
+  }
+  dm->Set(txn, keys::Legacy, 1);
+  // apply login cookies
+  dm->Set(txn, keys::Cookies, cookies);
+  dm->Set(txn, keys::UserAgent, user_agent);
+  txn.Commit();
+}
+
+// steps[i] upgrades stored data from version i to i + 1
+using MigrateStep = void (*)(DataManager*, GameData*);
+constexpr std::array<MigrateStep, kDataVersion> kMigrateSteps = {
+    MigrateLegacy};
+}  // namespace
+
+void DataManager::migrate() {
+  int version = Get(keys::DataVersion);
+  if (version > kDataVersion) {
+    LAppPal::PrintLog(LogLevel::Warn,
+                      "[DataManager]Data version %d is newer than %d", version,
+                      kDataVersion);
+    return;
+  }
+  for (; version < kDataVersion; version++) {
+    LAppPal::PrintLog(LogLevel::Info, "[DataManager]Migrate data %d -> %d",
+                      version, version + 1);
+    kMigrateSteps[version](this, gameData.get());
+    Set(keys::DataVersion, version + 1);
+  }
+}
+
 DataManager::DataManager() {
   if (!init()) {
     LAppPal::PrintLog(LogLevel::Error, "Failed to initialize DataManager");
@@ -112,252 +177,436 @@ DataManager* DataManager::GetInstance() {
   return &instance;
 }
 
+void DataManager::publishConfig() {
+  auto next = std::make_shared<ConfigSnapshot>(ConfigSnapshot::From(data));
+  next->version = configVersion.load(std::memory_order_relaxed) + 1;
+  std::atomic_store(&config,
+                    std::shared_ptr<const ConfigSnapshot>(std::move(next)));
+  configVersion.fetch_add(1, std::memory_order_release);
+}
+
 void DataManager::GetWindowPos(int* x, int* y) {
-  // get x,y from data
-  if (!data.contains("window")) {
-    // update x,y in data
-    data.insert_or_assign("window", toml::table{{"x", 0}, {"y", 0}});
+  std::lock_guard<std::mutex> lock(configMtx);
+  auto window = data["window"];
+  if (!window.is_table()) {
+    // keep the caller's position, it is saved on exit
     return;
   }
-  *x = GetConfig("window", "x", 0);
-  *y = GetConfig("window", "y", 0);
+  *x = window["x"].value_or(*x);
+  *y = window["y"].value_or(*y);
 }
 
 void DataManager::UpdateWindowPos(int x, int y) {
-  // update x,y in data
+  // window position is not part of the snapshot
+  std::lock_guard<std::mutex> lock(configMtx);
   data.insert_or_assign("window", toml::table{{"x", x}, {"y", y}});
 }
 
 void DataManager::GetAudio(int* volume, bool* mute, bool* idle_audio, bool* touch_audio) {
-  // if audio doesn't exist, create it
-  if (!data.contains("audio")) {
-    data.insert("audio", toml::table{{"volume", 20},
-                                     {"mute", false},
-                                     {"idle_audio", true},
-                                     {"touch_audio", true}});
-  }
-  // get volume, mute from data
-  *volume = GetConfig("audio", "volume", 20);
-  *mute = GetConfig("audio", "mute", false);
-  *idle_audio = GetConfig("audio", "idle_audio", true);
-  *touch_audio = GetConfig("audio", "touch_audio", true);
+  const auto& current = Config();
+  *volume = current.volume;
+  *mute = current.mute;
+  *idle_audio = current.idle_audio;
+  *touch_audio = current.touch_audio;
 }
 
 void DataManager::UpdateAudio(int volume, bool mute, bool idle_audio, bool touch_audio) {
-  // update volume in data
-  data.insert_or_assign("audio", toml::table{{"volume", volume},
-                                             {"mute", mute},
-                                             {"idle_audio", idle_audio},
-                                             {"touch_audio", touch_audio}});
+  editConfig([&](toml::table& table) {
+    table.insert_or_assign("audio", toml::table{{"volume", volume},
+                                                {"mute", mute},
+                                                {"idle_audio", idle_audio},
+                                                {"touch_audio", touch_audio}});
+  });
 }
 
 void DataManager::GetDisplay(float* scale, bool* green, bool* rateLimit) {
-  if (!data.contains("display")) {
-    // update scale, green, rateLimit in data
-    data.insert_or_assign(
-        "display",
-        toml::table{{"scale", 1.0f}, {"green", false}, {"rateLimit", false}});
-    return;
-  }
-  // get scale, green, rateLimit from data
-  *scale = GetConfig("display", "scale", 1.0f);
-  *green = GetConfig("display", "green", false);
-  *rateLimit = GetConfig("display", "rateLimit", false);
+  const auto& current = Config();
+  *scale = current.scale;
+  *green = current.green;
+  *rateLimit = current.rate_limit;
 }
 
 void DataManager::UpdateDisplay(float scale, bool green, bool rateLimit) {
-  // update scale, green, rateLimit in data
-  data.insert_or_assign("display", toml::table{{"scale", scale},
-                                               {"green", green},
-                                               {"rateLimit", rateLimit}});
+  editConfig([&](toml::table& table) {
+    table.insert_or_assign("display", toml::table{{"scale", scale},
+                                                  {"green", green},
+                                                  {"rateLimit", rateLimit}});
+  });
 }
 
-bool DataManager::GetDropFile() {
-  if (!data.contains("other")) {
-    data.insert_or_assign("other", toml::table{});
-    return true;
-  }
-  auto other = data.at("other").as_table();
-  if (!other->contains("dropfile")) {
-    other->insert("dropfile", true);
-    return true;
-  }
-  return GetConfig("other", "dropfile", true);
-}
+bool DataManager::GetDropFile() { return Config().dropfile; }
 
 void DataManager::UpdateDropFile(bool enable) {
-  if (!data.contains("other")) {
-    data.insert_or_assign("other", toml::table{});
-  }
-  auto other = data.at("other").as_table();
-  other->insert_or_assign("dropfile", enable);
+  editConfig([&](toml::table& table) {
+    table["other"].as_table()->insert_or_assign("dropfile", enable);
+  });
 }
 
-bool DataManager::IsTracking() {
-  if (!data.contains("other")) {
-    data.insert_or_assign("other", toml::table{});
-    return true;
-  }
-  auto other = data.at("other").as_table();
-  if (!other->contains("track")) {
-    other->insert("track", true);
-    return true;
-  }
-  return GetConfig("other", "track", true);
-}
+bool DataManager::IsTracking() { return Config().track; }
 
 void DataManager::IsTracking(bool enable) {
-  if (!data.contains("other")) {
-    data.insert_or_assign("other", toml::table{});
-  }
-  auto other = data.at("other").as_table();
-  other->insert_or_assign("track", enable);
-}
-
-void DataManager::initNotifySection() {
-  if (!data.contains("notify")) {
-    data.insert("notify", toml::table{});
-    auto notifyTable = data.at("notify").as_table();
-    notifyTable->insert("followList", toml::array{});
-    notifyTable->insert("dynamic", true);
-    notifyTable->insert("live", true);
-    notifyTable->insert("update", true);
-  }
+  editConfig([&](toml::table& table) {
+    table["other"].as_table()->insert_or_assign("track", enable);
+  });
 }
 
 void DataManager::GetNotify(bool *dynamic, bool *live, bool *update) {
-  initNotifySection();
-  // get followList, dynamic, live, update from data
-  *dynamic = GetConfig("notify", "dynamic", true);
-  *live = GetConfig("notify", "live", true);
-  *update = GetConfig("notify", "update", true);
+  const auto& current = Config();
+  *dynamic = current.notify_dynamic;
+  *live = current.notify_live;
+  *update = current.notify_update;
 }
 
-void DataManager::UpdateNotify(
-                               bool dynamic, bool live, bool update) {
-  // update followList, dynamic, live, update in data
-  initNotifySection();
-  auto notifyTable = data.at("notify").as_table();
-  notifyTable->insert_or_assign("dynamic", dynamic);
-  notifyTable->insert_or_assign("live", live);
-  notifyTable->insert_or_assign("update", update);
+void DataManager::UpdateNotify(bool dynamic, bool live, bool update) {
+  editConfig([&](toml::table& table) {
+    auto notifyTable = table["notify"].as_table();
+    notifyTable->insert_or_assign("dynamic", dynamic);
+    notifyTable->insert_or_assign("live", live);
+    notifyTable->insert_or_assign("update", update);
+  });
 }
 
 std::vector<std::string> DataManager::GetFollowList() {
-  std::vector<std::string> ret;
-  initNotifySection();
-  auto notifyTable = data.at("notify").as_table();
-  auto& followListArray = *notifyTable->get_as<toml::array>("followList");
-  for (const auto& follow : followListArray) {
-    ret.push_back(follow.as_string()->get());
-  }
-  return ret;
+  return Config().follow_list;
 }
 
 void DataManager::AddFollow(const std::string& uid) {
-  auto notifyTable = data.at("notify").as_table();
-  auto& followListArray = *notifyTable->get_as<toml::array>("followList");
-  // check exist
-  for (const auto& follow : followListArray) {
-    if (follow.as_string()->get() == uid) {
-      return;
+  editConfig([&](toml::table& table) {
+    auto& followListArray = *table["notify"]["followList"].as_array();
+    // check exist
+    for (const auto& follow : followListArray) {
+      if (follow.value<std::string>() == uid) {
+        return;
+      }
     }
-  }
-  followListArray.push_back(uid);
+    followListArray.push_back(uid);
+  });
 }
 
 void DataManager::RemoveFollow(const std::string& uid) {
-  auto notifyTable = data.at("notify").as_table();
-  auto& followListArray = *notifyTable->get_as<toml::array>("followList");
-  auto iter = followListArray.cbegin();
-  for (;iter != followListArray.cend();) {
-    if (iter->as_string()->get() == uid) {
-      iter = followListArray.erase(iter);
-    } else {
-      iter++;
+  editConfig([&](toml::table& table) {
+    auto& followListArray = *table["notify"]["followList"].as_array();
+    auto iter = followListArray.cbegin();
+    for (; iter != followListArray.cend();) {
+      if (iter->value<std::string>() == uid) {
+        iter = followListArray.erase(iter);
+      } else {
+        iter++;
+      }
     }
-  }
+  });
 }
 
 void DataManager::Save() {
-  const std::wstring configPath = LAppDefine::documentPath + L"\\jpet.toml";
-  std::ofstream file(configPath);
-  if (!file.is_open()) {
-    LAppPal::PrintLog("Failed to open config file for writing");
-    return;
+  {
+    std::lock_guard<std::mutex> lock(saveMtx);
+    if (saveStopping) {
+      return;
+    }
+    saveDirty = true;
+    if (!saver.joinable()) {
+      saver = std::thread(&DataManager::doSave, this);
+    }
   }
-  file << data;
-  file.close();
+  saveCv.notify_one();
 }
 
-int DataManager::CurrentExpDiff() {
-  int currentExp = GetAttribute("exp");
-  int intellect = GetAttribute("intellect");
-  int starcnt = GetWithDefault("starcnt", 0);
-  int medal = BuffManager::GetInstance()->MedalLevel();
-  double exp = 1 + ceil(499 * LAppPal::EaseOut(intellect + medal / 3 - 4) / 100);
-  BuffManager* bf = BuffManager::GetInstance();
-  if (bf->IsDynamic()) {
-    exp *= 2;
-  }
-  if (bf->IsLive()) {
-    exp *= 3;
+void DataManager::Flush() {
+  {
+    std::lock_guard<std::mutex> lock(saveMtx);
+    saveStopping = true;
+    saveDirty = false;
   }
-  if (bf->IsGuard()) {
-    exp *= 1.5f;
+  saveCv.notify_one();
+  if (saver.joinable()) {
+    saver.join();
   }
-  if (bf->IsMonday()) {
-    exp *= 1.5f;
-  }
-  if (bf->IsFail()) {
-    exp *= 1.5f;
+  // always write, not every setting change calls Save()
+  writeConfig();
+}
+
+void DataManager::doSave() {
+  std::unique_lock<std::mutex> lock(saveMtx);
+  while (!saveStopping) {
+    saveCv.wait(lock, [this] { return saveDirty || saveStopping; });
+    if (!saveStopping) {
+      // coalesce every save within the window into one write
+      saveCv.wait_for(lock, kSaveWindow, [this] { return saveStopping; });
+    }
+    if (!saveDirty || saveStopping) {
+      // Flush() writes whatever is left
+      continue;
+    }
+    saveDirty = false;
+    lock.unlock();
+    writeConfig();
+    lock.lock();
   }
-  if (bf->IsBirthday()) {
-    exp *= 6;
+}
+
+bool DataManager::writeConfig() {
+  std::stringstream content;
+  {
+    std::lock_guard<std::mutex> lock(configMtx);
+    content << data;
   }
-  if (bf->IsLegacy()) {
-    exp *= 1.2f;
+  if (!LAppPal::WriteFileAtomic(LAppDefine::documentPath + L"/jpet.toml",
+                                content.str())) {
+    LAppPal::PrintLog(LogLevel::Error, "[DataManager]Failed to save config");
+    return false;
   }
-  exp *= (1 + 0.1 * starcnt);
-  return std::min(static_cast<int>(exp), 99999999);
+  configWrites.fetch_add(1, std::memory_order_relaxed);
+  return true;
 }
 
-void DataManager::AddExp() {
-  int diff = CurrentExpDiff();
-  AddAttribute("exp", diff);
-  LAppPal::PrintLog(LogLevel::Debug, "[DataManager]Added %d exp", diff);
-  PanelServer::GetInstance()->Notify("UPDATE");
+int DataManager::CurrentExpDiff() {
+  return expDiff(GetAttribute(Attr::Intellect), Get(keys::StarCnt));
+}
+
+int DataManager::expDiff(int intellect, int starcnt) {
+  ExpFactors factors = hooks.factors ? hooks.factors() : ExpFactors{};
+  factors.intellect = intellect;
+  factors.starcnt = starcnt;
+  return formula::ExpPerMinute(factors);
+}
+
+int64_t DataManager::accrueExp() {
+  time_t now = time(nullptr);
+  const time_t stored = Get(keys::ExpCheckpoint);
+  if (stored > now) {
+    LAppPal::PrintLog(LogLevel::Warn,
+                      "[DataManager]Exp checkpoint %lld is in the future",
+                      static_cast<long long>(stored));
+  }
+  ExpFactors factors;
+  factors.intellect = GetAttribute(Attr::Intellect);
+  factors.starcnt = Get(keys::StarCnt);
+  factors.fail = Get(keys::FailCount) >= 2;
+  factors.legacy = Get(keys::Legacy) > 0;
+  time_t checkpoint = stored;
+  int64_t exp = expTimeline.Settle(checkpoint, now, factors);
+  if (checkpoint == stored) {
+    // no minute started since, skip the write
+    return 0;
+  }
+  // exp and checkpoint land together, a crash never pays a minute twice
+  auto txn = gameData->Begin();
+  if (exp > 0) {
+    AddAttribute(txn, Attr::Exp,
+                 static_cast<int>(std::min<int64_t>(exp, 99999999)));
+  }
+  Set(txn, keys::ExpCheckpoint, static_cast<int>(now));
+  txn.Commit();
+  return exp;
+}
+
+void DataManager::AccrueExp() {
+  int64_t exp = 0;
+  {
+    std::unique_lock<std::shared_mutex> lock(attrMtx);
+    exp = accrueExp();
+  }
+  if (exp > 0) {
+    LAppPal::PrintLog(LogLevel::Debug, "[DataManager]Added %lld exp",
+                      static_cast<long long>(exp));
+    if (hooks.profileChanged) {
+      hooks.profileChanged();
+    }
+  }
 }
 
-std::vector<int> DataManager::GetAttributeList() {
-  std::vector<int> attributes;
-  for (const auto& attr : {"speed", "endurance", "strength", "will",
-                           "intellect", "exp", "buycnt"}) {
-    int value = GetAttribute(attr);
-    attributes.push_back(value);
+void DataManager::RecordBuffs(const BuffState& buffs) {
+  int64_t exp = 0;
+  {
+    std::unique_lock<std::shared_mutex> lock(attrMtx);
+    if (expTimeline.Record(time(nullptr), buffs)) {
+      exp = accrueExp();
+    }
   }
+  // exp owed while the buffs were stale changes the profile too
+  if (exp > 0 && hooks.profileChanged) {
+    hooks.profileChanged();
+  }
+}
+
+AttrArray DataManager::GetAttributeList() {
+  static const std::vector<std::string_view> attr_keys(keys::Attrs.begin(),
+                                                       keys::Attrs.end());
+  std::vector<int32_t> values(kAttrCount, 0);
+  gameData->GetMany(attr_keys, values);
+  AttrArray attributes{};
+  std::copy(values.begin(), values.end(), attributes.begin());
   return attributes;
 }
 
+std::unordered_map<std::string, float> DataManager::LoadParts() {
+  std::unordered_map<std::string, float> parts;
+  gameData->Scan<float>(keys::kPartPrefix, [&parts](std::string_view key, float value) {
+    parts.emplace(key.substr(keys::kPartPrefix.size()), value);
+  });
+  return parts;
+}
+
+GameSnapshot DataManager::LoadSnapshot() {
+  GameSnapshot snapshot;
+  snapshot.attributes = GetAttributeList();
+  gameData->Scan<int32_t>(keys::kTaskPrefix, [&snapshot](std::string_view key,
+                                                         int32_t value) {
+    int id = 0;
+    size_t field = 0;
+    if (keys::ParseTaskKey(key, id, field)) {
+      snapshot.tasks[id][field] = value;
+    }
+  });
+  snapshot.parts = LoadParts();
+  return snapshot;
+}
+
 void DataManager::FetchStar() {
-  for (const auto &attr :
-       {"speed", "endurance", "strength", "will", "intellect"}) {
+  std::unique_lock<std::shared_mutex> lock(attrMtx);
+  accrueExp();
+  for (Attr attr : kBaseAttrs) {
     int value = GetAttribute(attr);
-    if (value < 53) {
+    if (value < formula::kStarCost) {
       return;
     }
   }
 
-  for (const auto &attr :
-       {"speed", "endurance", "strength", "will", "intellect"}) {
-    AddAttribute(attr, -53);
+  auto txn = gameData->Begin();
+  for (Attr attr : kBaseAttrs) {
+    AddAttribute(txn, attr, -formula::kStarCost);
   }
-  int current = 0;
-  gameData->Get("starcnt", current);
-  gameData->Update("starcnt", current + 1);
+  int current = keys::StarCnt.def;
+  txn.Get(keys::StarCnt.name, current);
+  Set(txn, keys::StarCnt, current + 1);
+  txn.Commit();
 }
 
-int DataManager::GetWithDefault(const std::string& key, int default_value) {
+BuyResult DataManager::BuyAttribute(Attr attr, std::optional<int> count,
+                                    int* done) {
+  *done = 0;
+  if (attr == Attr::Exp || attr == Attr::BuyCnt) {
+    return BuyResult::NOT_FOUND;
+  }
+  if (count && *count < 1) {
+    return BuyResult::INVALID;
+  }
+  std::unique_lock<std::shared_mutex> lock(attrMtx);
+  accrueExp();
+  // cannot add attributes to more than limit
+  int room = GetAttrLimit() - GetAttribute(attr);
+  if (room <= 0 || (count && *count > room)) {
+    return BuyResult::AT_LIMIT;
+  }
+  int buycnt = GetAttribute(Attr::BuyCnt);
+  int exp = GetAttribute(Attr::Exp);
+  int n = 0;
+  if (count) {
+    n = formula::BulkCost(buycnt, *count) <= exp ? *count : 0;
+  } else {
+    n = formula::Affordable(buycnt, exp, room);
+  }
+  if (n == 0) {
+    return BuyResult::NO_EXP;
+  }
+  auto txn = gameData->Begin();
+  AddAttribute(txn, attr, n);
+  AddAttribute(txn, Attr::Exp,
+               -static_cast<int>(formula::BulkCost(buycnt, n)));
+  AddAttribute(txn, Attr::BuyCnt, n);
+  txn.Commit();
+  *done = n;
+  return BuyResult::OK;
+}
+
+BuyResult DataManager::RevertAttribute(Attr attr, std::optional<int> count,
+                                       int* done) {
+  *done = 0;
+  if (attr == Attr::Exp || attr == Attr::BuyCnt) {
+    return BuyResult::NOT_FOUND;
+  }
+  if (count && *count < 1) {
+    return BuyResult::INVALID;
+  }
+  std::unique_lock<std::shared_mutex> lock(attrMtx);
+  accrueExp();
+  int current = GetAttribute(attr);
+  int n = count.value_or(current);
+  if (n == 0 || n > current) {
+    return BuyResult::NO_POINTS;
+  }
+  int buycnt = GetAttribute(Attr::BuyCnt);
+  int64_t refund = formula::BulkRefund(buycnt, n);
+  LAppPal::PrintLog(LogLevel::Debug,
+                    "[DataManager]Revert %d attr buycnt=%d refund=%lld", n,
+                    buycnt, static_cast<long long>(refund));
+  auto txn = gameData->Begin();
+  AddAttribute(txn, attr, -n);
+  AddAttribute(txn, Attr::Exp,
+               static_cast<int>(std::min<int64_t>(refund, 99999999)));
+  AddAttribute(txn, Attr::BuyCnt, -n);
+  txn.Commit();
+  *done = n;
+  return BuyResult::OK;
+}
+
+Profile DataManager::LoadProfile() {
+  static const std::vector<std::string_view> profile_keys = [] {
+    std::vector<std::string_view> list(keys::Attrs.begin(), keys::Attrs.end());
+    list.push_back(keys::ClothesCurrent.name);
+    list.push_back(keys::ClothesActive[1].name);
+    list.push_back(keys::ClothesActive[2].name);
+    list.push_back(keys::StarCnt.name);
+    return list;
+  }();
+  std::vector<int32_t> values(profile_keys.size(), 0);
+  values[kAttrCount] = keys::ClothesCurrent.def;
+  values[kAttrCount + 3] = keys::StarCnt.def;
+  {
+    // no attribute write can land between the reads
+    std::shared_lock<std::shared_mutex> lock(attrMtx);
+    gameData->GetMany(profile_keys, values);
+  }
+  Profile profile;
+  std::copy_n(values.begin(), kAttrCount, profile.attributes.begin());
+  profile.clothes_current = values[kAttrCount];
+  profile.clothes_unlock = {true, values[kAttrCount + 1] == 1,
+                            values[kAttrCount + 2] == 1};
+  profile.starcnt = values[kAttrCount + 3];
+  profile.expdiff =
+      expDiff(profile.attributes[AttrIndex(Attr::Intellect)], profile.starcnt);
+  return profile;
+}
+
+int DataManager::Get(const Key<int>& key) {
+  return GetWithDefault(key.name, key.def);
+}
+
+std::string DataManager::Get(const Key<std::string_view>& key) {
+  return GetWithDefault(key.name, std::string(key.def));
+}
+
+void DataManager::Set(const Key<int>& key, int value) {
+  SetRaw(key.name, value);
+}
+
+void DataManager::Set(const Key<std::string_view>& key,
+                      const std::string& value) {
+  gameData->Update(key.name, value);
+}
+
+void DataManager::Set(GameData::Transaction& txn, const Key<int>& key,
+                      int value) {
+  txn.Update(key.name, value);
+}
+
+void DataManager::Set(GameData::Transaction& txn,
+                      const Key<std::string_view>& key,
+                      const std::string& value) {
+  txn.Update(key.name, value);
+}
+
+int DataManager::GetWithDefault(std::string_view key, int default_value) {
   int value = 0;
   if (gameData->Get(key, value)) {
     return value;
@@ -365,7 +614,7 @@ int DataManager::GetWithDefault(const std::string& key, int default_value) {
   return default_value;
 }
 
-float DataManager::GetWithDefault(const std::string& key, float default_value) {
+float DataManager::GetWithDefault(std::string_view key, float default_value) {
   float value = 0;
   if (gameData->Get(key, value)) {
     return value;
@@ -373,7 +622,7 @@ float DataManager::GetWithDefault(const std::string& key, float default_value) {
   return default_value;
 }
 
-string DataManager::GetWithDefault(const std::string& key, const string& default_value) {
+string DataManager::GetWithDefault(std::string_view key, const string& default_value) {
   string value = default_value;
   if (gameData->Get(key, value)) {
     return value;
@@ -381,76 +630,312 @@ string DataManager::GetWithDefault(const std::string& key, const string& default
   return default_value;
 }
 
-void DataManager::PostProcess(const std::string& key, int value) {
+void DataManager::PostProcess(std::string_view key, int value) {
   // change clothes
-  if (key == "clothes.current") {
-    LAppLive2DManager::GetInstance()->SwitchClothes(value);
+  if (key == keys::ClothesCurrent.name.View()) {
+    if (hooks.clothesChanged) {
+      hooks.clothesChanged(value);
+    }
   }
 }
 
-int DataManager::GetAttribute(const std::string& key) {
+int DataManager::GetAttribute(Attr attr) {
   int value = 0;
+  const KeyName& key = keys::AttrKey(attr);
   try {
-    gameData->Get("attr." + key, value);
+    gameData->Get(key, value);
   } catch (const std::exception& e) {
     LAppPal::PrintLog(LogLevel::Error,
                       "[DataManager]Get Attribute failed %s: %s reset to 0",
-                      key.c_str(), e.what());
-    gameData->Update("attr." + key, 0);
+                      std::string(AttrName(attr)).c_str(), e.what());
+    gameData->Update(key, 0);
   }
   return value;
 }
 
 int DataManager::GetAttrLimit() {
-  int starcnt = GetWithDefault("starcnt", 0);
-  return 100 + starcnt * 10;
+  return formula::AttrLimit(Get(keys::StarCnt));
+}
+
+void DataManager::AddAttribute(Attr attr, int value) {
+  std::unique_lock<std::shared_mutex> lock(attrMtx);
+  accrueExp();
+  auto txn = gameData->Begin();
+  AddAttribute(txn, attr, value);
+  txn.Commit();
 }
 
-void DataManager::AddAttribute(const std::string& key, int value) {
+void DataManager::AddAttribute(GameData::Transaction& txn, Attr attr,
+                               int value) {
+  const KeyName& key = keys::AttrKey(attr);
   int current = 0;
-  gameData->Get("attr." + key, current);
+  txn.Get(key, current);
   // WARN not support negative value yet
   int new_value = std::min(std::max(current + value, 0), 99999999);
   // normal attributes are limited
-  if (key != "exp" && key != "buycnt") {
+  if (attr != Attr::Exp && attr != Attr::BuyCnt) {
     // extra is returned as exp
     int limit = GetAttrLimit();
     if (new_value > limit) {
-      AddAttribute("exp", (new_value - limit) * 53000 / 2);
+      AddAttribute(txn, Attr::Exp,
+                   (new_value - limit) * formula::kFlatCost / 2);
       new_value = limit;
     }
   }
-  gameData->Update("attr." + key, new_value);
+  txn.Update(key, new_value);
 }
 
-std::vector<int> DataManager::TaskStatus(int id) {
-  std::vector<int> status_vec;
-  int start_time = 0;
-  int end_time = 0;
-  int success = 0;
-  int status = 0;
-  int cost_snapshot = 0;
-  gameData->Get("task." + std::to_string(id) + ".start_time", start_time);
-  gameData->Get("task." + std::to_string(id) + ".end_time", end_time);
-  gameData->Get("task." + std::to_string(id) + ".success", success);
-  gameData->Get("task." + std::to_string(id) + ".status", status);
-  gameData->Get("task." + std::to_string(id) + ".cost_snapshot", cost_snapshot);
-  status_vec.push_back(start_time);
-  status_vec.push_back(end_time);
-  status_vec.push_back(success);
-  status_vec.push_back(status);
-  status_vec.push_back(cost_snapshot);
-  return status_vec;
+TaskRecord DataManager::TaskStatus(const TaskKeys& task_keys) {
+  std::vector<int32_t> values(kTaskFields.size(), 0);
+  gameData->GetMany({task_keys.start_time, task_keys.end_time,
+                     task_keys.success, task_keys.status,
+                     task_keys.cost_snapshot},
+                    values);
+  TaskRecord record{};
+  std::copy(values.begin(), values.end(), record.begin());
+  return record;
 }
 
-void DataManager::DumpTask(int id, int start_time, int end_time, int success,
+void DataManager::DumpTask(const TaskKeys& task_keys, int start_time,
+                           int end_time, int success, int status,
+                           int cost_snapshot) {
+  auto txn = gameData->Begin();
+  DumpTask(txn, task_keys, start_time, end_time, success, status, cost_snapshot);
+  txn.Commit();
+}
+
+void DataManager::DumpTask(GameData::Transaction& txn, const TaskKeys& task_keys,
+                           int start_time, int end_time, int success,
                            int status, int cost_snapshot) {
-  gameData->Update("task." + std::to_string(id) + ".start_time", start_time);
-  gameData->Update("task." + std::to_string(id) + ".end_time", end_time);
-  gameData->Update("task." + std::to_string(id) + ".success", success);
-  gameData->Update("task." + std::to_string(id) + ".status", status);
-  gameData->Update("task." + std::to_string(id) + ".cost_snapshot",
-                   cost_snapshot);
+  txn.Update(task_keys.start_time, start_time);
+  txn.Update(task_keys.end_time, end_time);
+  txn.Update(task_keys.success, success);
+  txn.Update(task_keys.status, status);
+  txn.Update(task_keys.cost_snapshot, cost_snapshot);
+}
+
+std::vector<GameTask>& DataManager::loadTasks() {
+  if (!taskCatalog) {
+    taskCatalog = TaskCatalog::Load(LAppDefine::execPath +
+                                    L"resources/tasks.bin");
+    if (!taskCatalog) {
+      // no tasks rather than no app, a fixed file is picked up on reload
+      LAppPal::PrintLog(LogLevel::Error, "[DataManager]No task catalog");
+      return tasks;
+    }
+    tasks = GameTask::InitTasks(taskCatalog, LoadSnapshot().tasks);
+  }
+  return tasks;
+}
+
+void DataManager::reloadTasks(std::shared_ptr<const TaskCatalog> catalog) {
+  std::lock_guard<std::mutex> lock(taskMtx);
+  std::unordered_map<int, TaskRecord> records;
+  if (!taskCatalog) {
+    records = LoadSnapshot().tasks;
+  }
+  std::vector<GameTask> reloaded = GameTask::InitTasks(catalog, records);
+  for (GameTask& task : reloaded) {
+    auto old = std::find_if(tasks.begin(), tasks.end(),
+                            [&task](const GameTask& t) { return t.id == task.id; });
+    if (old != tasks.end()) {
+      // progress lives in memory first, the stored record may lag
+      task.start_time = old->start_time;
+      task.end_time = old->end_time;
+      task.cost_snapshot = old->cost_snapshot;
+      task.success = old->success;
+      task.status = old->status;
+    } else if (taskCatalog) {
+      task.Load();
+    }
+  }
+  const GameTask* current = nullptr;
+  for (const GameTask& task : tasks) {
+    bool kept = std::any_of(reloaded.begin(), reloaded.end(),
+                            [&task](const GameTask& t) { return t.id == task.id; });
+    // an active task removed from the file finishes with its old definition
+    if (!kept && task.Active()) {
+      reloaded.push_back(task);
+    }
+  }
+  for (const GameTask& task : reloaded) {
+    if (task.Active()) {
+      current = &task;
+    }
+  }
+  taskCatalog = std::move(catalog);
+  tasks = std::move(reloaded);
+  // a running task read back from the store has no timer yet
+  if (current && current->status == TStatus::RUNNING && !settleTask) {
+    scheduleSettle(*current);
+  }
+  publishCurrent(current);
+}
+
+std::vector<GameTask> DataManager::GetTasks() {
+  std::lock_guard<std::mutex> lock(taskMtx);
+  return loadTasks();
+}
+
+void DataManager::scheduleSettle(const GameTask& task) {
+  cancelSettle();
+  int id = task.id;
+  time_t deadline = task.start_time + task.cost_snapshot;
+  settleTask = std::make_shared<SettleTimer>(
+      deadline, [this, id, deadline] { SettleTask(id, deadline); });
+  TaskScheduler::GetInstance()->AddTask(settleTask);
+}
+
+void DataManager::cancelSettle() {
+  if (settleTask) {
+    TaskScheduler::GetInstance()->RemoveTask(settleTask);
+    settleTask.reset();
+  }
+}
+
+void DataManager::publishCurrent(const GameTask* task) {
+  std::atomic_store(&currentTask,
+                    task ? std::make_shared<const GameTask>(*task)
+                         : std::shared_ptr<const GameTask>());
+  if (hooks.tasksChanged) {
+    hooks.tasksChanged();
+  }
+}
+
+TaskResult DataManager::StartTask(int id) {
+  std::lock_guard<std::mutex> lock(taskMtx);
+  GameTask* target = nullptr;
+  for (auto& task : loadTasks()) {
+    // cannot start a new task while old one is running
+    if (task.Active()) {
+      return TaskResult::BUSY;
+    }
+    if (task.id == id) {
+      target = &task;
+    }
+  }
+  if (!target) {
+    return TaskResult::NOT_FOUND;
+  }
+  if (target->status == TStatus::ARCHIVED) {
+    return TaskResult::ARCHIVED;
+  }
+  target->start_time = time(nullptr);
+  target->success = false;
+  target->status = TStatus::RUNNING;
+  target->cost_snapshot = target->GetCurrentCost();
+  target->Dump();
+  scheduleSettle(*target);
+  publishCurrent(target);
+  return TaskResult::OK;
+}
+
+TaskResult DataManager::ConfirmTask(int id, bool* success) {
+  std::lock_guard<std::mutex> lock(taskMtx);
+  for (auto& task : loadTasks()) {
+    if (task.id != id) {
+      continue;
+    }
+    if (task.status != TStatus::WAIT_SETTLE) {
+      return TaskResult::BAD_STATE;
+    }
+    // complete this task
+    task.end_time = time(nullptr);
+    // rewards, fail count and task state land together
+    std::unique_lock<std::shared_mutex> attrLock(attrMtx);
+    accrueExp();
+    auto txn = gameData->Begin();
+    if (task.success) {
+      // update attribute
+      task.Rewards().ForEach([&](Attr attr, int value) {
+        AddAttribute(txn, attr, value);
+      });
+      if (task.id == 1) {
+        AddAttribute(txn, Attr::Exp, 10 * CurrentExpDiff());
+      }
+      // if with special, update related key
+      if (auto special = task.Special()) {
+        SetRaw(txn, special->linked_key, 1);
+      }
+      Set(txn, keys::FailCount, 0);
+      LAppPal::PrintLog("[DataManager]Failcount set to 0");
+    } else {
+      int failcount = Get(keys::FailCount) + 1;
+      Set(txn, keys::FailCount, failcount);
+      LAppPal::PrintLog("[DataManager]Failcount set to %d", failcount);
+    }
+    if (task.Repeatable()) {
+      task.status = TStatus::IDLE;
+    } else {
+      task.status = task.success ? TStatus::ARCHIVED : TStatus::IDLE;
+    }
+    task.Dump(txn);
+    txn.Commit();
+    if (hooks.fail) {
+      hooks.fail(Get(keys::FailCount) >= 2);
+    }
+    publishCurrent(nullptr);
+    *success = task.success;
+    return TaskResult::OK;
+  }
+  return TaskResult::NOT_FOUND;
+}
+
+TaskResult DataManager::CancelTask(int id) {
+  std::lock_guard<std::mutex> lock(taskMtx);
+  for (auto& task : loadTasks()) {
+    if (task.id != id) {
+      continue;
+    }
+    if (task.status != TStatus::RUNNING) {
+      return TaskResult::BAD_STATE;
+    }
+    task.start_time = 0;
+    task.success = false;
+    task.status = TStatus::IDLE;
+    task.Dump();
+    cancelSettle();
+    publishCurrent(nullptr);
+    return TaskResult::OK;
+  }
+  return TaskResult::NOT_FOUND;
+}
+
+void DataManager::SettleTask(int id, time_t deadline) {
+  std::lock_guard<std::mutex> lock(taskMtx);
+  for (auto& task : loadTasks()) {
+    // a timer that fired while its run was cancelled must not settle the
+    // next run
+    if (task.id != id || task.status != TStatus::RUNNING ||
+        task.start_time + task.cost_snapshot != deadline) {
+      continue;
+    }
+    task.Settle();
+    publishCurrent(&task);
+    settleTask.reset();
+  }
+}
+
+void DataManager::ResumeTasks() {
+  {
+    std::lock_guard<std::mutex> lock(taskMtx);
+    for (auto& task : loadTasks()) {
+      if (!task.Active()) {
+        continue;
+      }
+      publishCurrent(&task);
+      if (task.status == TStatus::RUNNING) {
+        scheduleSettle(task);
+      }
+    }
+  }
+  if (!catalogWatcher) {
+    catalogWatcher = std::make_unique<TaskCatalogWatcher>(
+        LAppDefine::execPath + L"resources/tasks.bin",
+        [this](std::shared_ptr<const TaskCatalog> catalog) {
+          reloadTasks(std::move(catalog));
+        });
+  }
 }
 
 void DataManager::SetResetMark() {
@@ -458,7 +943,7 @@ void DataManager::SetResetMark() {
   // check file existence
   if (!std::filesystem::exists(std::filesystem::path(markerPath))) {
     // create a new config file
-    std::ofstream file(markerPath);
+    std::ofstream file(std::filesystem::path{markerPath});
     if (!file.is_open()) {
       LAppPal::PrintLog(LogLevel::Error, L"[DataManager]Failed to create marker file: %ls", markerPath.c_str());
       return;
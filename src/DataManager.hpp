@@ -1,37 +1,213 @@
 #pragma once
 
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
 #include <string>
+#include <thread>
 #include <toml++/toml.hpp>
+#include <unordered_map>
 #include <vector>
 
+#include "ConfigSnapshot.hpp"
+#include "ExpAccrual.hpp"
 #include "GameData.hpp"
+#include "GameSchema.hpp"
 #include "GameTask.hpp"
 
+class Task;
+
+/**
+ * @brief  Task, attribute and part state read in one pass.
+ */
+struct GameSnapshot {
+  AttrArray attributes{};
+  // by task id, tasks never started have no entry
+  std::unordered_map<int, TaskRecord> tasks;
+  // by parameter id, without the "part." prefix
+  std::unordered_map<std::string, float> parts;
+};
+
+/**
+ * @brief  Everything /api/profile shows, read at one point in time.
+ */
+struct Profile {
+  AttrArray attributes{};
+  int clothes_current = 0;
+  std::array<bool, 3> clothes_unlock{};
+  int starcnt = 0;
+  int expdiff = 0;
+};
+
+/**
+ * @brief  What DataManager tells the rest of the app. LAppDelegate points
+ * these at the buffs, the panel, the model and the toasts; tools that drive
+ * DataManager on its own leave them empty and need none of that.
+ */
+struct DataHooks {
+  // buffs and calendar for the exp rate, none when unset
+  std::function<ExpFactors()> factors;
+  // the fail debuff is on or off
+  std::function<void(bool)> fail;
+  std::function<void()> profileChanged;
+  std::function<void()> tasksChanged;
+  std::function<void(int)> clothesChanged;
+  // a task was settled, title and text to show
+  std::function<void(const std::wstring&, const std::wstring&)> notify;
+};
+
+enum class TaskResult { OK, NOT_FOUND, BUSY, ARCHIVED, BAD_STATE };
+
+enum class BuyResult { OK, NOT_FOUND, INVALID, AT_LIMIT, NO_EXP, NO_POINTS };
+
+/**
+ * @brief  Settings and game state, shared by the render, scheduler, buff,
+ * watcher and panel server threads.
+ * State is split in domains with a lock each, so a slow task transition
+ * never stalls a config read:
+ *  - config: configMtx, readers use the lock-free Config() snapshot
+ *  - tasks: taskMtx guards the task list and every GameTask in it
+ *  - attributes: attrMtx guards read-modify-write of attributes, exp, star
+ *    count, fail count and the exp timeline; readers that need several of
+ *    them at once take it shared
+ * When both are needed taskMtx is taken first.
+ */
 class DataManager {
  private:
+  static constexpr std::chrono::milliseconds kSaveWindow{500};
+
+  // the parsed jpet.toml, every access must hold configMtx
   toml::table data;
+  std::mutex configMtx;
+  std::shared_ptr<const ConfigSnapshot> config;
+  std::atomic<uint64_t> configVersion{0};
+  // writes jpet.toml in the background, see Save()
+  std::thread saver;
+  std::mutex saveMtx;
+  std::condition_variable saveCv;
+  bool saveDirty = false;
+  bool saveStopping = false;
+  // jpet.toml writes that succeeded, see ConfigWrites()
+  std::atomic<uint64_t> configWrites{0};
   std::shared_ptr<GameData> gameData;
-  std::vector<std::shared_ptr<GameTask>> tasks;
+  std::mutex taskMtx;
+  std::shared_ptr<const TaskCatalog> taskCatalog;
+  std::vector<GameTask> tasks;
+  // settles the running task at its deadline, guarded by taskMtx
+  std::shared_ptr<Task> settleTask;
+  // copy of the active task for per-frame reads, swapped atomically and
+  // only when a task starts, settles, is confirmed or is cancelled
+  std::shared_ptr<const GameTask> currentTask;
+  std::shared_mutex attrMtx;
+  // buffs since the exp checkpoint, guarded by attrMtx
+  ExpTimeline expTimeline;
+  // set once at startup, read without a lock
+  DataHooks hooks;
+  // declared last so it stops before anything it reloads into goes away
+  std::unique_ptr<TaskCatalogWatcher> catalogWatcher;
   bool init();
   DataManager();
 
-  void PostProcess(const std::string& key, int value);
+  void PostProcess(std::string_view key, int value);
+
+  void migrate();
+
+  // rebuild the snapshot from data and publish it, configMtx must be held
+  void publishConfig();
+
+  void doSave();
+
+  bool writeConfig();
 
-  void initNotifySection();
+  // taskMtx must be held
+  std::vector<GameTask>& loadTasks();
+
+  // swap in a reloaded catalog, keeps the state of every task
+  void reloadTasks(std::shared_ptr<const TaskCatalog> catalog);
+
+  // taskMtx must be held
+  void scheduleSettle(const GameTask& task);
+
+  // taskMtx must be held
+  void cancelSettle();
+
+  // taskMtx must be held, nullptr when no task is active. Also tells the
+  // panel the tasks changed
+  void publishCurrent(const GameTask* task);
+
+  int expDiff(int intellect, int starcnt);
+
+  /**
+   * @brief  Add the exp owed since the checkpoint and move it to now.
+   * Anything that changes an exp input must call this first, under the same
+   * lock. attrMtx must be held exclusively.
+   * @return exp added
+   */
+  int64_t accrueExp();
+
+  /**
+   * @brief  Modify data under configMtx, then publish a new snapshot.
+   */
+  template <typename F>
+  void editConfig(F&& edit) {
+    std::lock_guard<std::mutex> lock(configMtx);
+    edit(data);
+    publishConfig();
+  }
 
  public:
-  ~DataManager() { Save(); };
-
-  template <typename T> T GetConfig(const string &section, const string &key, T dvalue) {
-    T ret;
-    try {
-      ret = data.at(section).as_table()->at(key).value_or(dvalue);
-      return ret;
-    } catch(const std::exception& e) {
-      return dvalue;
+  ~DataManager() { Flush(); };
+
+  /**
+   * @brief  Read a setting straight from the table. Takes a lock, only for
+   * settings read once, e.g. at startup. Anything read per frame or per
+   * event goes through Config().
+   */
+  template <typename T>
+  T GetConfig(std::string_view section, std::string_view key, T dvalue) {
+    std::lock_guard<std::mutex> lock(configMtx);
+    return data[section][key].value_or(std::move(dvalue));
+  }
+
+  /**
+   * @brief  String entries of a section by key, e.g. [endpoints]. Read
+   * like GetConfig(), entries of other types are left out.
+   */
+  std::map<std::string, std::string> GetConfigStrings(
+      std::string_view section) {
+    std::lock_guard<std::mutex> lock(configMtx);
+    std::map<std::string, std::string> entries;
+    if (auto table = data[section].as_table()) {
+      for (const auto& [key, value] : *table) {
+        if (auto str = value.value<std::string>()) {
+          entries[std::string(key.str())] = *str;
+        }
+      }
     }
+    return entries;
   }
-  
+
+  /**
+   * @brief  Current settings. Wait-free unless the config changed since this
+   * thread last asked, the reference stays valid until this thread calls
+   * Config() again.
+   */
+  const ConfigSnapshot& Config() {
+    thread_local std::shared_ptr<const ConfigSnapshot> local;
+    if (!local ||
+        local->version != configVersion.load(std::memory_order_acquire)) {
+      local = std::atomic_load(&config);
+    }
+    return *local;
+  }
+
   void GetWindowPos(int *x, int *y);
   void UpdateWindowPos(int x, int y);
 
@@ -54,65 +230,180 @@ class DataManager {
   void RemoveFollow(const std::string &uid);
   void AddFollow(const std::string &uid);
 
+  /**
+   * @brief  Start a batch of game data writes, see GameData::Transaction.
+   */
+  GameData::Transaction BeginTransaction() { return gameData->Begin(); }
+
+  int Get(const Key<int>& key);
+  std::string Get(const Key<std::string_view>& key);
+
+  void Set(const Key<int>& key, int value);
+  void Set(const Key<std::string_view>& key, const std::string& value);
+  void Set(GameData::Transaction& txn, const Key<int>& key, int value);
+  void Set(GameData::Transaction& txn, const Key<std::string_view>& key,
+           const std::string& value);
+
+  // raw access for keys that come from data, e.g. task special rewards and
+  // model parts. everything known at compile time goes through keys::
   template <typename T>
-  void SetRaw(const std::string& key, T value) {
+  void SetRaw(std::string_view key, T value) {
     gameData->Update(key, value);
   }
 
-  void SetRaw(const std::string& key, int value) {
+  template <typename T>
+  void SetRaw(GameData::Transaction& txn, std::string_view key, T value) {
+    txn.Update(key, value);
+  }
+
+  void SetRaw(std::string_view key, int value) {
     gameData->Update(key, value);
     PostProcess(key, value);
   }
 
-  int GetWithDefault(const std::string& key, int default_value);
-  string GetWithDefault(const std::string& key, const string& default_value);
-  float GetWithDefault(const std::string& key, float default_value);
+  int GetWithDefault(std::string_view key, int default_value);
+  string GetWithDefault(std::string_view key, const string& default_value);
+  float GetWithDefault(std::string_view key, float default_value);
+
+  /**
+   * @brief  Add the exp owed since the last accrual, one CurrentExpDiff()
+   * per minute with the buffs of that minute.
+   */
+  void AccrueExp();
+
+  /**
+   * @brief  Buffs BuffManager just read. Settles the exp owed when the ones
+   * seen before had gone stale, e.g. after the machine resumes.
+   */
+  void RecordBuffs(const BuffState& buffs);
 
-  void AddExp();
   int CurrentExpDiff();
   void FetchStar();
 
   /**
-   * @brief   Get the list of attributes.
-   * @return The list of attributes.
-   * [0]speed,[1]endurance,[2]strength,[3]will,[4]intellect,[5]exp,[6]buycnt
+   * @brief   Spend exp on count points of attr, all or nothing, in one
+   * commit. Same result as count single purchases.
+   * @param   count  nullopt buys as many as exp and the limit allow
+   * @param   done   set to the points bought
    */
-  std::vector<int> GetAttributeList();
+  BuyResult BuyAttribute(Attr attr, std::optional<int> count, int* done);
+
+  /**
+   * @brief   Give back count points of attr, each refunds half of what the
+   * latest purchase cost. Same result as count single reverts.
+   * @param   count  nullopt reverts every point of attr
+   * @param   done   set to the points reverted
+   */
+  BuyResult RevertAttribute(Attr attr, std::optional<int> count, int* done);
+
+  Profile LoadProfile();
+
+  /**
+   * @brief   Get all attributes, indexed by Attr.
+   */
+  AttrArray GetAttributeList();
   
   int GetAttrLimit();
 
-  int GetAttribute(const std::string& key);
+  int GetAttribute(Attr attr);
 
-  void AddAttribute(const std::string& key, int value);
+  void AddAttribute(Attr attr, int value);
+  /**
+   * @brief   Add to attr within txn. Only for writes that do not depend on
+   * other state, e.g. initial data; the read and the commit are not atomic
+   * against other threads.
+   */
+  void AddAttribute(GameData::Transaction& txn, Attr attr, int value);
 
-  void DumpTask(int id, int start_time, int end_time, int success, int status,
+  void DumpTask(const TaskKeys& task_keys, int start_time, int end_time,
+                int success, int status, int cost_snapshot);
+  void DumpTask(GameData::Transaction& txn, const TaskKeys& task_keys,
+                int start_time, int end_time, int success, int status,
                 int cost_snapshot);
 
   /**
    * @brief   Get task status.
-   * @return  status list. [0]start_time, [1]end_time, [2]success, [3]status
+   * @return  fields in kTaskFields order
    */
-  std::vector<int> TaskStatus(int id);
-  std::vector<std::shared_ptr<GameTask>> GetTasks() {
-    if (tasks.empty()) {
-      tasks = GameTask::InitTasks();
-    }
-    return tasks;
-  }
-  std::shared_ptr<GameTask> GetCurrentTask() {
-    for (auto& task : tasks) {
-      if (task->status == TStatus::RUNNING || task->status == TStatus::WAIT_SETTLE) {
-        return task;
-      }
-    }
-    return nullptr;
+  TaskRecord TaskStatus(const TaskKeys& task_keys);
+
+  /**
+   * @brief   Read all task, attribute and part state with bulk reads
+   * instead of one point read per key. Also warms the read cache.
+   */
+  GameSnapshot LoadSnapshot();
+
+  std::unordered_map<std::string, float> LoadParts();
+
+  /**
+   * @brief   Copies of all tasks, changes go through the task methods below.
+   */
+  std::vector<GameTask> GetTasks();
+
+  /**
+   * @brief   The running or unsettled task, nullptr if none. Lock-free, meant
+   * for per-frame reads.
+   */
+  std::shared_ptr<const GameTask> GetCurrentTask() {
+    return std::atomic_load(&currentTask);
   }
 
+  /**
+   * @brief   Start task id, only one task runs at a time.
+   */
+  TaskResult StartTask(int id);
+
+  /**
+   * @brief   Settle a finished task and apply its rewards.
+   * @param   success set to whether the task succeeded
+   */
+  TaskResult ConfirmTask(int id, bool* success);
+
+  TaskResult CancelTask(int id);
+
+  /**
+   * @brief   Decide the outcome of a running task, called once at its
+   * deadline by the scheduler. Ignored unless the task is still running
+   * with that deadline.
+   */
+  void SettleTask(int id, time_t deadline);
+
+  /**
+   * @brief   Load tasks and schedule the deadline of one left running by
+   * the last session, it settles at once if the deadline already passed.
+   * Tasks reload from then on whenever resources/tasks.bin changes.
+   */
+  void ResumeTasks();
+
+  /**
+   * @brief  Schedule writing jpet.toml. Saves within kSaveWindow are written
+   * once, by a background thread, so callers never wait on the disk.
+   */
   void Save();
 
+  /**
+   * @brief  Stop the background writer and write pending changes now.
+   */
+  void Flush();
+
+  /**
+   * @brief  Times jpet.toml was written since startup.
+   */
+  uint64_t ConfigWrites() const {
+    return configWrites.load(std::memory_order_relaxed);
+  }
+
   void SetResetMark();
 
   bool IsResetMarked();
 
+  /**
+   * @brief  Connect DataManager to the rest of the app, before other threads
+   * use it.
+   */
+  void SetHooks(DataHooks appHooks) { hooks = std::move(appHooks); }
+
+  const DataHooks& Hooks() const { return hooks; }
+
   static DataManager* GetInstance();
 };
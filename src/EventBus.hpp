@@ -0,0 +1,128 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct EventBusStats {
+  uint64_t published = 0;
+  // dropped for a newer identical event
+  uint64_t coalesced = 0;
+  // readers that fell behind the buffer and were sent the resync event
+  uint64_t resyncs = 0;
+};
+
+/**
+ * @brief  The last capacity events, numbered from 1 up. Readers keep their
+ * own cursor, the id of the last event they saw, and read on from there at
+ * their own pace; nobody waits for them and nothing is lost for them while
+ * they stay within capacity events. A reader further behind, or with an id
+ * from before a restart, gets the resync event instead of what it missed.
+ *
+ * Events are signals to reload some state, so publishing one identical to
+ * an event still in the buffer drops the older copy: a flood of "UPDATE"
+ * takes one slot and a reader sees it once.
+ */
+class EventBus {
+ public:
+  explicit EventBus(size_t capacity = 256, std::string resync = "UPDATE")
+      : _ring(std::max<size_t>(capacity, 1)), _resync(std::move(resync)) {}
+
+  /**
+   * @brief  Append data, non empty, and return its id. Calls the listener
+   * outside the lock.
+   */
+  uint64_t Publish(const std::string& data) {
+    std::function<void()> listener;
+    uint64_t id;
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      id = ++_last;
+      if (_last - _oldest > _ring.size()) {
+        // full, the slot of the oldest event is reused
+        _oldest++;
+        auto it = _latest.find(_ring[_oldest % _ring.size()]);
+        if (it != _latest.end() && it->second == _oldest) {
+          _latest.erase(it);
+        }
+      }
+      auto [it, inserted] = _latest.try_emplace(data, id);
+      if (!inserted) {
+        // an empty slot is skipped by readers
+        _ring[it->second % _ring.size()].clear();
+        it->second = id;
+        _stats.coalesced++;
+      }
+      _ring[id % _ring.size()] = data;
+      _stats.published++;
+      listener = _listener;
+    }
+    if (listener) {
+      listener();
+    }
+    return id;
+  }
+
+  // id of the newest event, 0 before the first
+  uint64_t Last() const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _last;
+  }
+
+  /**
+   * @brief  Call f(id, data) for the events after cursor, oldest first,
+   * until it returns false. A cursor behind the buffer, or from before a
+   * restart, gets the resync event first and goes on from there.
+   * @return  the new cursor, the id of the last event passed to f
+   */
+  template <class F>
+  uint64_t Read(uint64_t cursor, F&& f) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (cursor < _oldest || cursor > _last) {
+      cursor = cursor < _oldest ? _oldest : _last;
+      _stats.resyncs++;
+      if (!f(cursor, _resync)) {
+        return cursor;
+      }
+    }
+    while (cursor < _last) {
+      cursor++;
+      const std::string& data = _ring[cursor % _ring.size()];
+      if (!data.empty() && !f(cursor, data)) {
+        break;
+      }
+    }
+    return cursor;
+  }
+
+  /**
+   * @brief  Called after each Publish(), e.g. to wake a thread serving
+   * readers. Set it before publishing starts.
+   */
+  void SetListener(std::function<void()> listener) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _listener = std::move(listener);
+  }
+
+  EventBusStats Stats() const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _stats;
+  }
+
+ private:
+  mutable std::mutex _mutex;
+  // event i is in _ring[i % size] while _oldest < i <= _last, _oldest is
+  // the last event dropped
+  std::vector<std::string> _ring;
+  uint64_t _oldest = 0;
+  uint64_t _last = 0;
+  // id of the newest event of each data in the buffer
+  std::unordered_map<std::string, uint64_t> _latest;
+  std::string _resync;
+  std::function<void()> _listener;
+  EventBusStats _stats;
+};
@@ -0,0 +1,109 @@
+#include "ExpAccrual.hpp"
+
+#include <algorithm>
+
+namespace {
+tm LocalTime(time_t t) {
+  tm ltm;
+#ifdef _WIN32
+  localtime_s(&ltm, &t);
+#else
+  localtime_r(&t, &ltm);
+#endif
+  return ltm;
+}
+}  // namespace
+
+void CalendarBuffs(time_t t, bool* monday, bool* birthday) {
+  tm ltm = LocalTime(t);
+  *monday = ltm.tm_wday == 1;
+  *birthday = ltm.tm_mon == 10 && ltm.tm_mday == 25;
+}
+
+time_t NextMidnight(time_t t) {
+  tm ltm = LocalTime(t);
+  ltm.tm_mday += 1;
+  ltm.tm_hour = 0;
+  ltm.tm_min = 0;
+  ltm.tm_sec = 0;
+  ltm.tm_isdst = -1;
+  return mktime(&ltm);
+}
+
+bool ExpTimeline::Record(time_t at, const BuffState& buffs) {
+  // keep segments ordered if the clock stepped back
+  at = std::max(at, last_seen_);
+  bool stale = last_seen_ != 0 && at > last_seen_ + kStale;
+  if (stale) {
+    push(last_seen_ + kStale, BuffState{});
+  }
+  push(at, buffs);
+  last_seen_ = at;
+  return stale;
+}
+
+void ExpTimeline::push(time_t start, const BuffState& buffs) {
+  Segment& last = segments_.back();
+  if (last.buffs == buffs) {
+    return;
+  }
+  if (last.start < start) {
+    segments_.push_back({start, buffs});
+    return;
+  }
+  last.buffs = buffs;
+  if (segments_.size() > 1 && segments_[segments_.size() - 2].buffs == buffs) {
+    segments_.pop_back();
+  }
+}
+
+int64_t ExpTimeline::Accrue(time_t from, time_t to, ExpFactors factors) {
+  int64_t exp = 0;
+  // a minute is owed when its first second is in [begin, end), split the
+  // range where buffs or the day change and price each piece at once
+  time_t begin = from + 1;
+  const time_t end = to + 1;
+  const time_t stale_at = last_seen_ + kStale;
+  size_t i = 0;
+  while (begin < end) {
+    while (i + 1 < segments_.size() && segments_[i + 1].start <= begin) {
+      i++;
+    }
+    time_t until = std::min(end, NextMidnight(begin));
+    if (i + 1 < segments_.size()) {
+      until = std::min(until, segments_[i + 1].start);
+    }
+    if (begin < stale_at) {
+      until = std::min(until, stale_at);
+      factors.buffs = segments_[i].buffs;
+    } else {
+      factors.buffs = BuffState{};
+    }
+    CalendarBuffs(begin, &factors.monday, &factors.birthday);
+    int64_t minutes = (until - 1) / 60 - (begin - 1) / 60;
+    exp += minutes * formula::ExpPerMinute(factors);
+    begin = until;
+  }
+  // keep only the segment in effect at to and the ones after it
+  size_t first = 0;
+  while (first + 1 < segments_.size() && segments_[first + 1].start <= to) {
+    first++;
+  }
+  segments_.erase(segments_.begin(), segments_.begin() + first);
+  return exp;
+}
+
+int64_t ExpTimeline::Settle(time_t& checkpoint, time_t now,
+                            const ExpFactors& factors) {
+  if (checkpoint == 0 || checkpoint > now) {
+    checkpoint = now;
+    return 0;
+  }
+  if (checkpoint / 60 == now / 60) {
+    // no minute started since
+    return 0;
+  }
+  int64_t exp = Accrue(std::max(checkpoint, now - kMaxAccrual), now, factors);
+  checkpoint = now;
+  return exp;
+}
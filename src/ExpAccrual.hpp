@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstdint>
+#include <ctime>
+#include <vector>
+
+#include "GameFormula.hpp"
+
+/**
+ * @brief  Calendar buffs of the local day containing t.
+ */
+void CalendarBuffs(time_t t, bool* monday, bool* birthday);
+
+/**
+ * @brief  Start of the local day after the one containing t.
+ */
+time_t NextMidnight(time_t t);
+
+/**
+ * @brief  Network buffs over time, and the exp owed over an interval.
+ * Exp is owed once per whole minute, with the buffs and calendar of that
+ * minute, exactly what a tick every minute would have added. Buffs not
+ * refreshed for kStale seconds, e.g. while the machine sleeps or before the
+ * first refresh after a start, count as none.
+ */
+class ExpTimeline {
+ public:
+  static constexpr time_t kStale = 120;
+  // longest stretch exp is owed for at once, e.g. after a long shutdown
+  static constexpr time_t kMaxAccrual = 7 * 24 * 60 * 60;
+
+  /**
+   * @brief  Buffs seen at time at, calls must come in time order.
+   * @return true if the buffs seen before had gone stale
+   */
+  bool Record(time_t at, const BuffState& buffs);
+
+  /**
+   * @brief  Exp owed for the minutes in (from, to]. Intellect, star count,
+   * fail and legacy must not have changed since from; buffs recorded
+   * before to are dropped.
+   */
+  int64_t Accrue(time_t from, time_t to, ExpFactors factors);
+
+  /**
+   * @brief  Exp owed from checkpoint to now, at most kMaxAccrual of it, and
+   * checkpoint moved to now. A checkpoint of 0 or in the future, the first
+   * run or a clock that went back, moves to now with nothing owed; within
+   * the minute it is in, nothing is owed and it stays.
+   */
+  int64_t Settle(time_t& checkpoint, time_t now, const ExpFactors& factors);
+
+ private:
+  struct Segment {
+    time_t start;
+    BuffState buffs;
+  };
+
+  // sorted by start, each one lasts until the next
+  std::vector<Segment> segments_{{0, BuffState{}}};
+  time_t last_seen_ = 0;
+
+  void push(time_t start, const BuffState& buffs);
+};
@@ -1,11 +1,24 @@
 #pragma once
 
-#include <string>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <filesystem>
 #include <fstream>
+#include <array>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
-#include <filesystem>
-#include <rocksdb/db.h>
-
+#include "GameStore.hpp"
 #include "LAppPal.hpp"
 #include "LAppDefine.hpp"
 
@@ -139,34 +152,345 @@ class Entry {
  * basicly a simple kv store for game data
  */
 class GameData {
+ public:
+  /**
+   * @brief  A batch of writes that is applied atomically on Commit().
+   * Reads through a transaction see its own pending writes first, so
+   * read-modify-write sequences (like attribute overflow) stay consistent.
+   * Pending writes are discarded if the transaction is destroyed uncommitted.
+   */
+  class Transaction {
+   private:
+    GameData* owner_;
+    std::map<std::string, std::string, std::less<>> puts_;
+
+    bool lookup(std::string_view key, std::string& raw) {
+      auto it = puts_.find(key);
+      if (it != puts_.end()) {
+        raw = it->second;
+        return true;
+      }
+      return owner_->getValue(key, raw);
+    }
+
+    void set(std::string_view key, std::string raw) {
+      auto it = puts_.find(key);
+      if (it != puts_.end()) {
+        it->second = std::move(raw);
+        return;
+      }
+      puts_.emplace(key, std::move(raw));
+    }
+
+   public:
+    explicit Transaction(GameData* owner) : owner_(owner) {}
+
+    Transaction(const Transaction&) = delete;
+    Transaction& operator=(const Transaction&) = delete;
+
+    Transaction(Transaction&& other) noexcept
+        : owner_(other.owner_), puts_(std::move(other.puts_)) {
+      other.puts_.clear();
+    }
+
+    ~Transaction() {
+      if (!puts_.empty()) {
+        LAppPal::PrintLog(LogLevel::Warn,
+                          "[GameData]Transaction dropped with %d pending writes",
+                          static_cast<int>(puts_.size()));
+      }
+    }
+
+    void Update(std::string_view key, int32_t value) {
+      set(key, encode(value));
+    }
+
+    void Update(std::string_view key, bool value) {
+      set(key, encode(value));
+    }
+
+    void Update(std::string_view key, float value) {
+      set(key, encode(value));
+    }
+
+    void Update(std::string_view key, const std::string& value) {
+      set(key, value);
+    }
+
+    template <typename T>
+    bool Get(std::string_view key, T& value) {
+      std::string raw;
+      if (!lookup(key, raw)) {
+        return false;
+      }
+      return decode(raw, value);
+    }
+
+    /**
+     * @brief  Apply all pending writes in one atomic store write.
+     * @return false if the underlying write failed, pending writes are kept
+     */
+    bool Commit() {
+      if (puts_.empty()) {
+        return true;
+      }
+      std::vector<GameStore::Entry> entries(puts_.begin(), puts_.end());
+      if (!owner_->write(entries)) {
+        return false;
+      }
+      puts_.clear();
+      return true;
+    }
+  };
+
  private:
-  rocksdb::DB* db;
-  rocksdb::WriteOptions writeOptions;
+  std::unique_ptr<GameStore> store_;
+  // fsync every write, until a durability window hands that to the flusher
+  bool syncWrites_ = true;
+  // nothing was stored before this run
+  bool fresh_ = false;
+
+  // group commit: with a non-zero window, writes skip the per-write fsync and
+  // a flusher syncs the store once per window instead
+  std::chrono::milliseconds durabilityWindow_{0};
+  std::thread flusher_;
+  std::mutex flushMtx_;
+  std::condition_variable flushCv_;
+  bool dirty_ = false;
+  bool stopping_ = false;
+
+  // held across a store write and its cache update, so two writers of one
+  // key leave the cache with the value the store ended up with
+  std::mutex writeMtx_;
+
+  // write-through cache of raw values. keys are interned once, so a lookup
+  // only hashes a string_view and never allocates. missing keys are cached
+  // too, most GetWithDefault calls hit keys that were never written.
+  struct CacheSlot {
+    bool present;
+    std::string raw;
+  };
+  std::shared_mutex cacheMtx_;
+  std::unordered_set<std::string> internedKeys_;
+  std::unordered_map<std::string_view, CacheSlot> cache_;
+  // bumped by Drop(), a fill that raced with it is thrown away
+  uint64_t cacheGen_ = 0;
+  std::atomic<uint64_t> cacheHits_{0};
+  std::atomic<uint64_t> cacheMisses_{0};
+
+  static std::string encode(int32_t value) {
+    return std::string(reinterpret_cast<char*>(&value), sizeof(int32_t));
+  }
+
+  static std::string encode(bool value) {
+    return std::string(reinterpret_cast<char*>(&value), sizeof(bool));
+  }
+
+  static std::string encode(float value) {
+    return std::string(reinterpret_cast<char*>(&value), sizeof(float));
+  }
+
+  static bool decode(const std::string& raw, int32_t& value) {
+    if (raw.size() < sizeof(int32_t)) {
+      return false;
+    }
+    memcpy(&value, raw.data(), sizeof(int32_t));
+    return true;
+  }
+
+  static bool decode(const std::string& raw, bool& value) {
+    if (raw.size() < sizeof(bool)) {
+      return false;
+    }
+    memcpy(&value, raw.data(), sizeof(bool));
+    return true;
+  }
+
+  static bool decode(const std::string& raw, float& value) {
+    if (raw.size() < sizeof(float)) {
+      return false;
+    }
+    memcpy(&value, raw.data(), sizeof(float));
+    return true;
+  }
+
+  static bool decode(const std::string& raw, std::string& value) {
+    value = raw;
+    return true;
+  }
+
+  // must hold cacheMtx_ exclusively
+  std::string_view intern(std::string_view key) {
+    return *internedKeys_.emplace(key).first;
+  }
+
+  // must hold cacheMtx_ exclusively
+  void cacheStore(std::string_view key, std::string_view raw) {
+    auto it = cache_.find(key);
+    if (it == cache_.end()) {
+      cache_.emplace(intern(key), CacheSlot{true, std::string(raw)});
+      return;
+    }
+    it->second.present = true;
+    it->second.raw = raw;
+  }
+
+  /**
+   * @brief  Read a value through the cache and decode it into value.
+   */
+  template <typename T>
+  bool getValue(std::string_view key, T& value) {
+    uint64_t gen;
+    {
+      std::shared_lock<std::shared_mutex> lock(cacheMtx_);
+      auto it = cache_.find(key);
+      if (it != cache_.end()) {
+        cacheHits_.fetch_add(1, std::memory_order_relaxed);
+        return it->second.present && decode(it->second.raw, value);
+      }
+      gen = cacheGen_;
+    }
+    cacheMisses_.fetch_add(1, std::memory_order_relaxed);
+    std::string raw;
+    bool present = store_->Get(key, raw);
+    {
+      std::unique_lock<std::shared_mutex> lock(cacheMtx_);
+      // a writer that got here first already holds the newer value
+      if (gen == cacheGen_ && cache_.find(key) == cache_.end()) {
+        cache_.emplace(intern(key), CacheSlot{present, raw});
+      }
+    }
+    return present && decode(raw, value);
+  }
+
+  /**
+   * @brief  Read many keys through the cache, misses go to the store in a
+   * single MultiGet.
+   */
+  std::vector<std::optional<std::string>> getMany(
+      const std::vector<std::string_view>& keys) {
+    std::vector<std::optional<std::string>> result(keys.size());
+    std::vector<size_t> missing;
+    uint64_t gen;
+    {
+      std::shared_lock<std::shared_mutex> lock(cacheMtx_);
+      for (size_t i = 0; i < keys.size(); i++) {
+        auto it = cache_.find(keys[i]);
+        if (it == cache_.end()) {
+          missing.push_back(i);
+        } else if (it->second.present) {
+          result[i] = it->second.raw;
+        }
+      }
+      gen = cacheGen_;
+    }
+    cacheHits_.fetch_add(keys.size() - missing.size(), std::memory_order_relaxed);
+    if (missing.empty()) {
+      return result;
+    }
+    cacheMisses_.fetch_add(missing.size(), std::memory_order_relaxed);
+    std::vector<std::string_view> missingKeys;
+    for (size_t i : missing) {
+      missingKeys.push_back(keys[i]);
+    }
+    auto values = store_->MultiGet(missingKeys);
+    std::unique_lock<std::shared_mutex> lock(cacheMtx_);
+    for (size_t j = 0; j < missing.size(); j++) {
+      std::string_view key = missingKeys[j];
+      bool present = values[j].has_value();
+      if (present) {
+        result[missing[j]] = values[j];
+      }
+      if (gen == cacheGen_ && cache_.find(key) == cache_.end()) {
+        cache_.emplace(intern(key),
+                       CacheSlot{present, present ? std::move(*values[j]) : ""});
+      }
+    }
+    return result;
+  }
+
+  /**
+   * @brief  Write entries to the store, then to the cache.
+   */
+  bool write(const std::vector<GameStore::Entry>& entries) {
+    std::lock_guard<std::mutex> writeLock(writeMtx_);
+    if (!store_->Write(entries, syncWrites_)) {
+      return false;
+    }
+    {
+      std::unique_lock<std::shared_mutex> lock(cacheMtx_);
+      for (const auto& [key, value] : entries) {
+        cacheStore(key, value);
+      }
+    }
+    markDirty();
+    return true;
+  }
+
+  void put(std::string_view key, const std::string& value) {
+    if (!write({{key, value}})) {
+      LAppPal::PrintLog(LogLevel::Error, "[GameData]Failed to update %s",
+                        std::string(key).c_str());
+    }
+  }
+
+  void markDirty() {
+    if (durabilityWindow_.count() == 0) {
+      return;
+    }
+    {
+      std::lock_guard<std::mutex> lock(flushMtx_);
+      dirty_ = true;
+    }
+    flushCv_.notify_one();
+  }
+
+  void doFlush() {
+    std::unique_lock<std::mutex> lock(flushMtx_);
+    while (!stopping_) {
+      flushCv_.wait(lock, [this] { return dirty_ || stopping_; });
+      if (!stopping_) {
+        // coalesce everything written within the window into one sync
+        flushCv_.wait_for(lock, durabilityWindow_, [this] { return stopping_; });
+      }
+      if (!dirty_) {
+        continue;
+      }
+      dirty_ = false;
+      lock.unlock();
+      store_->Sync();
+      lock.lock();
+    }
+  }
+
+  void invalidateCache() {
+    std::unique_lock<std::shared_mutex> lock(cacheMtx_);
+    cache_.clear();
+    cacheGen_++;
+  }
 
   void parse(const std::vector<char>& data) {
     try {
       size_t offset = 0;
+      std::vector<std::pair<std::string, std::string>> imported;
       while (offset < data.size()) {
         Entry entry(data, offset);
         switch (entry.type)
         {
         case EntryType::TypeInt: {
-          int32_t v = entry.getInt();
-          db->Put(writeOptions, entry.key, std::string(reinterpret_cast<char*>(&v), sizeof(int32_t)));
+          imported.emplace_back(entry.key, encode(static_cast<int32_t>(entry.getInt())));
           break;
         }
         case EntryType::TypeBool: {
-          bool b = entry.getBool();
-          db->Put(writeOptions, entry.key, std::string(reinterpret_cast<char*>(&b), sizeof(bool)));
+          imported.emplace_back(entry.key, encode(entry.getBool()));
           break;
         }
         case EntryType::TypeFloat: {
-          float f = entry.getFloat();
-          db->Put(writeOptions, entry.key, std::string(reinterpret_cast<char*>(&f), sizeof(float)));
+          imported.emplace_back(entry.key, encode(entry.getFloat()));
           break;
         }
         case EntryType::TypeString: {
-          db->Put(writeOptions, entry.key, entry.getString());
+          imported.emplace_back(entry.key, entry.getString());
           break;
         }
         default: {
@@ -175,27 +499,69 @@ class GameData {
         }
         }
       }
+      write(std::vector<GameStore::Entry>(imported.begin(), imported.end()));
     } catch (const std::exception& e) {
       LAppPal::PrintLog(LogLevel::Error, e.what());
     }
     LAppPal::PrintLog(LogLevel::Debug, "[GameData]Parse done");
   }
 
+  /**
+   * @brief  Copy data another backend left under dir, so switching
+   * [data] backend keeps progress. The other backend's files are kept.
+   */
+  bool importOther(const std::wstring& dir) {
+    for (auto name : GameStore::Backends()) {
+      if (name == store_->Name()) {
+        continue;
+      }
+      auto other = GameStore::Create(name);
+      if (!other->Exists(dir) || !other->Open(dir)) {
+        continue;
+      }
+      std::vector<std::pair<std::string, std::string>> data;
+      other->Scan("", [&data](std::string_view key, std::string_view value) {
+        data.emplace_back(key, value);
+      });
+      other->Close();
+      if (!store_->Write(
+              std::vector<GameStore::Entry>(data.begin(), data.end()), true)) {
+        return false;
+      }
+      LAppPal::PrintLog(LogLevel::Info, "[GameData]Imported %d keys from %s",
+                        static_cast<int>(data.size()), other->Name());
+      return true;
+    }
+    return false;
+  }
+
  public:
-  GameData(const std::wstring& old_datapath) {
-    writeOptions.sync = true;
-    rocksdb::Options options;
-    options.create_if_missing = true;
-    std::wstring dbPath = LAppDefine::documentPath + L"/GameData";
-    rocksdb::Status status =
-        rocksdb::DB::Open(options, LAppPal::WStringToString(dbPath), &db);
-    if (!status.ok()) {
-      LAppPal::PrintLog(LogLevel::Error, "[GameData]Failed to open db: %d", status.code());
+  /**
+   * @param  backend  GameStore backend name, an unknown name falls back to
+   * the default backend
+   */
+  GameData(const std::wstring& old_datapath, std::string_view backend) {
+    const std::wstring& dir = LAppDefine::documentPath;
+    store_ = GameStore::Create(backend);
+    if (store_ == nullptr) {
+      store_ = GameStore::Create(GameStore::Backends().front());
+      if (!backend.empty()) {
+        LAppPal::PrintLog(LogLevel::Warn, "[GameData]Unknown backend %s, using %s",
+                          std::string(backend).c_str(), store_->Name());
+      }
+    }
+    bool existed = store_->Exists(dir);
+    if (!store_->Open(dir)) {
+      store_.reset();
       return;
     }
+    LAppPal::PrintLog(LogLevel::Info, "[GameData]Using %s backend", store_->Name());
+    bool imported = !existed && importOther(dir);
+    fresh_ = !existed && !imported &&
+             !std::filesystem::exists(std::filesystem::path(old_datapath));
     // load old data from file, if file not exist, skip reading
     if (std::filesystem::exists(std::filesystem::path(old_datapath))) {
-      std::ifstream file(old_datapath, std::ios::binary | std::ios::ate);
+      std::ifstream file(std::filesystem::path(old_datapath), std::ios::binary | std::ios::ate);
       if (file.is_open()) {
         std::streamsize size = file.tellg();
         file.seekg(0, std::ios::beg);
@@ -213,106 +579,163 @@ class GameData {
   }
 
   ~GameData() {
-    db->Close();
-    delete db;
+    if (flusher_.joinable()) {
+      {
+        std::lock_guard<std::mutex> lock(flushMtx_);
+        stopping_ = true;
+      }
+      flushCv_.notify_one();
+      flusher_.join();
+    }
+    if (store_ == nullptr) {
+      return;
+    }
+    LAppPal::PrintLog(LogLevel::Debug, "[GameData]Cache hits=%llu misses=%llu",
+                      static_cast<unsigned long long>(cacheHits_.load()),
+                      static_cast<unsigned long long>(cacheMisses_.load()));
+    store_->LogStats();
+    store_->Close();
   }
 
   bool Initialized() {
-    return db != nullptr;
+    return store_ != nullptr;
   }
 
-  void Drop() {
-    rocksdb::Slice start("");
-    rocksdb::Slice end("\xFF");
-    auto status = db->DeleteRange(writeOptions, db->DefaultColumnFamily(), start, end);
-    if (!status.ok()) {
-      LAppPal::PrintLog(LogLevel::Error, "[GameData]Drop db failed: %d", status.code());
-      return;
-    }
-    LAppPal::PrintLog(LogLevel::Info, "[GameData]Database dropped");
+  /**
+   * @brief  Whether this is the first run, nothing was stored or imported.
+   */
+  bool Fresh() const {
+    return fresh_;
   }
 
-  void Update(const std::string& key, int32_t value) {
-    auto status = db->Put(writeOptions, key, std::string(reinterpret_cast<char*>(&value), sizeof(int32_t)));
-    if (!status.ok()) {
-      LAppPal::PrintLog(LogLevel::Error, "[GameData]Failed to update %s", key.c_str());
+  /**
+   * @brief  Delete stored data of every backend under dir.
+   */
+  static void Destroy(const std::wstring& dir) {
+    for (auto name : GameStore::Backends()) {
+      GameStore::Create(name)->Remove(dir);
     }
   }
 
-  void Update(const std::string& key, bool value) {
-    auto status = db->Put(writeOptions, key, std::string(reinterpret_cast<char*>(&value), sizeof(bool)));
-    if (!status.ok()) {
-      LAppPal::PrintLog(LogLevel::Error, "[GameData]Failed to update %s", key.c_str());
+  /**
+   * @brief  Set how long committed writes may stay unsynced.
+   * 0 means every write is fsync'd before returning (the default). A non-zero
+   * window trades at most that much of the latest data on power loss for one
+   * fsync per window instead of one per write.
+   */
+  void SetDurabilityWindow(std::chrono::milliseconds window) {
+    if (flusher_.joinable() || window.count() <= 0) {
+      return;
     }
+    durabilityWindow_ = window;
+    syncWrites_ = false;
+    flusher_ = std::thread(&GameData::doFlush, this);
+    LAppPal::PrintLog(LogLevel::Info, "[GameData]Group commit window %dms",
+                      static_cast<int>(window.count()));
   }
 
-  void Update(const std::string& key, float value) {
-    auto status = db->Put(writeOptions, key, std::string(reinterpret_cast<char*>(&value), sizeof(float)));
-    if (!status.ok()) {
-      LAppPal::PrintLog(LogLevel::Error, "[GameData]Failed to update %s", key.c_str());
-    }
+  Transaction Begin() {
+    return Transaction(this);
   }
 
-  void Update(const std::string& key, const std::string& value) {
-    auto status = db->Put(writeOptions, key, value);
-    if (!status.ok()) {
-      LAppPal::PrintLog(LogLevel::Error, "[GameData]Failed to update %s", key.c_str());
+  void Drop() {
+    {
+      std::lock_guard<std::mutex> writeLock(writeMtx_);
+      if (!store_->Clear(syncWrites_)) {
+        LAppPal::PrintLog(LogLevel::Error, "[GameData]Drop db failed");
+        return;
+      }
+      invalidateCache();
     }
+    markDirty();
+    LAppPal::PrintLog(LogLevel::Info, "[GameData]Database dropped");
   }
 
-  bool Get(const std::string& key, int32_t& value) {
-    try {
-      std::string v;
-      auto status = db->Get(rocksdb::ReadOptions(), key, &v);
-      if (status.ok()) {
-        value = *reinterpret_cast<int32_t *>(v.data());
-        return true;
-      }
-    } catch (const std::exception &e) {
-      LAppPal::PrintLog(LogLevel::Debug, "[GameData]Get key failed %s: %s", key.c_str(), e.what());
-    }
-    return false;
+  void Update(std::string_view key, int32_t value) {
+    put(key, encode(value));
   }
 
-  bool Get(const std::string& key, bool& value) {
-    try {
-      std::string v;
-      auto status = db->Get(rocksdb::ReadOptions(), key, &v);
-      if (status.ok()) {
-        value = *reinterpret_cast<bool *>(v.data());
-        return true;
-      }
-    } catch (const std::exception &e) {
-      LAppPal::PrintLog(LogLevel::Debug, "[GameData]Get key failed %s: %s", key.c_str(), e.what());
-    }
-    return false;
+  void Update(std::string_view key, bool value) {
+    put(key, encode(value));
   }
 
-  bool Get(const std::string& key, float& value) {
-    try {
-      std::string v;
-      auto status = db->Get(rocksdb::ReadOptions(), key, &v);
-      if (status.ok()) {
-        value = *reinterpret_cast<float *>(v.data());
-        return true;
+  void Update(std::string_view key, float value) {
+    put(key, encode(value));
+  }
+
+  void Update(std::string_view key, const std::string& value) {
+    put(key, value);
+  }
+
+  bool Get(std::string_view key, int32_t& value) {
+    return getValue(key, value);
+  }
+
+  bool Get(std::string_view key, bool& value) {
+    return getValue(key, value);
+  }
+
+  bool Get(std::string_view key, float& value) {
+    return getValue(key, value);
+  }
+
+  bool Get(std::string_view key, std::string& value) {
+    return getValue(key, value);
+  }
+
+  /**
+   * @brief  Bulk version of Get(). values must hold one default per key,
+   * entries that are found overwrite their default.
+   */
+  template <typename T>
+  void GetMany(const std::vector<std::string_view>& keys, std::vector<T>& values) {
+    auto raws = getMany(keys);
+    for (size_t i = 0; i < keys.size() && i < values.size(); i++) {
+      if (raws[i]) {
+        decode(*raws[i], values[i]);
       }
-    } catch (const std::exception &e) {
-      LAppPal::PrintLog(LogLevel::Debug, "[GameData]Get key failed %s: %s", key.c_str(), e.what());
     }
-    return false;
   }
 
-  bool Get(const std::string& key, std::string& value) {
-    try {
-      std::string v;
-      auto status = db->Get(rocksdb::ReadOptions(), key, &v);
-      if (status.ok()) {
-        value = v;
-        return true;
+  /**
+   * @brief  Visit every stored key that starts with prefix, in key order.
+   * The prefix must select a single family, e.g. "task." or "part.".
+   * Visited values are cached, so following point reads are hits.
+   */
+  template <typename T, typename F>
+  void Scan(std::string_view prefix, F&& f) {
+    uint64_t gen;
+    {
+      std::shared_lock<std::shared_mutex> lock(cacheMtx_);
+      gen = cacheGen_;
+    }
+    std::vector<std::pair<std::string, std::string>> entries;
+    store_->Scan(prefix, [&entries](std::string_view key, std::string_view raw) {
+      entries.emplace_back(key, raw);
+    });
+    {
+      std::unique_lock<std::shared_mutex> lock(cacheMtx_);
+      if (gen == cacheGen_) {
+        for (const auto& [key, raw] : entries) {
+          if (cache_.find(key) == cache_.end()) {
+            cache_.emplace(intern(key), CacheSlot{true, raw});
+          }
+        }
       }
-    } catch (const std::exception &e) {
-      LAppPal::PrintLog(LogLevel::Debug, "[GameData]Get key failed %s: %s", key.c_str(), e.what());
     }
-    return false;
+    for (const auto& [key, raw] : entries) {
+      T value{};
+      if (decode(raw, value)) {
+        f(std::string_view(key), value);
+      }
+    }
+  }
+
+  uint64_t CacheHits() const {
+    return cacheHits_.load(std::memory_order_relaxed);
+  }
+
+  uint64_t CacheMisses() const {
+    return cacheMisses_.load(std::memory_order_relaxed);
   }
 };
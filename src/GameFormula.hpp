@@ -0,0 +1,229 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief  Game balance formulas, see doc/attributes.md.
+ * Free of app state and platform headers, so tools/balance_sim runs the
+ * same code as the game.
+ */
+
+/**
+ * @brief  Buffs BuffManager reads from the network. The other exp inputs are
+ * stored game data or follow from the calendar.
+ */
+struct BuffState {
+  bool live = false;
+  bool dynamic = false;
+  bool guard = false;
+  int medal_level = 0;
+
+  bool operator==(const BuffState& other) const {
+    return live == other.live && dynamic == other.dynamic &&
+           guard == other.guard && medal_level == other.medal_level;
+  }
+
+  bool operator!=(const BuffState& other) const { return !(*this == other); }
+};
+
+/**
+ * @brief  Everything the exp of one minute depends on.
+ */
+struct ExpFactors {
+  int intellect = 0;
+  int starcnt = 0;
+  bool fail = false;
+  bool legacy = false;
+  bool monday = false;
+  bool birthday = false;
+  BuffState buffs;
+};
+
+namespace formula {
+
+// points every base attribute pays for a star
+constexpr int kStarCost = 53;
+// the first kCurveLength purchases grow geometrically, later ones are flat
+constexpr int kCurveLength = 25;
+constexpr int kFlatCost = 53000;
+// task outcomes roll in [0, kRollRange)
+constexpr int kRollRange = 400;
+constexpr int kMaxValue = 99999999;
+
+// 0 to 100 for x in [0, 100], fast at first then flattening
+inline double EaseOut(int x) {
+  if (x <= 0) {
+    return 0;
+  }
+  if (x >= 100) {
+    return 100;
+  }
+  double p = double(x) / 100.0f;
+  return 100 * (1 - (1 - p) * (1 - p));
+}
+
+inline int ExpPerMinute(const ExpFactors& factors) {
+  double exp = 1 + ceil(499 *
+                        EaseOut(factors.intellect +
+                                factors.buffs.medal_level / 3 - 4) /
+                        100);
+  if (factors.buffs.dynamic) {
+    exp *= 2;
+  }
+  if (factors.buffs.live) {
+    exp *= 3;
+  }
+  if (factors.buffs.guard) {
+    exp *= 1.5f;
+  }
+  if (factors.monday) {
+    exp *= 1.5f;
+  }
+  if (factors.fail) {
+    exp *= 1.5f;
+  }
+  if (factors.birthday) {
+    exp *= 6;
+  }
+  if (factors.legacy) {
+    exp *= 1.2f;
+  }
+  exp *= (1 + 0.1 * factors.starcnt);
+  return std::min(static_cast<int>(exp), kMaxValue);
+}
+
+/**
+ * @brief  ExpPerMinute() for n players sharing the buffs, calendar and
+ * legacy of shared, branch-free so the loop vectorizes. Results are
+ * identical: the multipliers before legacy are exact on the integer base,
+ * so grouping them changes no rounding.
+ */
+inline void ExpPerMinuteBatch(const ExpFactors& shared, size_t n,
+                              const int32_t* intellect, const int32_t* starcnt,
+                              const uint8_t* fail, int32_t* out) {
+  double before = 1;
+  before *= shared.buffs.dynamic ? 2.0 : 1.0;
+  before *= shared.buffs.live ? 3.0 : 1.0;
+  before *= shared.buffs.guard ? 1.5 : 1.0;
+  before *= shared.monday ? 1.5 : 1.0;
+  double after = 1;
+  after *= shared.birthday ? 6.0 : 1.0;
+  after *= shared.legacy ? double(1.2f) : 1.0;
+  const int medal = shared.buffs.medal_level / 3 - 4;
+  for (size_t i = 0; i < n; i++) {
+    double p = std::min(std::max(intellect[i] + medal, 0), 100) / 100.0;
+    double ease = 100 * (1 - (1 - p) * (1 - p));
+    double exp = 1 + ceil(499 * ease / 100);
+    exp *= before * (fail[i] ? 1.5 : 1.0) * after;
+    exp *= (1 + 0.1 * starcnt[i]);
+    out[i] = static_cast<int32_t>(std::min(exp, double(kMaxValue)));
+  }
+}
+
+inline int AttrLimit(int starcnt) { return 100 + starcnt * 10; }
+
+// seconds a task of base cost takes at speed
+inline int TaskCost(int cost, int speed) {
+  return cost * (1 - 0.75 * EaseOut(speed - 2) / 100);
+}
+
+/**
+ * @brief  A task fails when a roll in [0, kRollRange) is below this.
+ * @param  lack  attribute points missing from the requirements, summed
+ * @return kRollRange when the task cannot succeed whatever the will
+ */
+inline int FailThreshold(int lack, int will, int starcnt) {
+  // every lacking point costs 3%, a fully met task succeeds 70% of the time
+  // before will, harder with every star
+  int threshold = lack * 12 + 120 + 20 * starcnt;
+  if (threshold >= kRollRange) {
+    return kRollRange;
+  }
+  // every will point adds 0.25%, up to 95%
+  return std::max(threshold - will, 20);
+}
+
+// exp for the next attribute point after buycnt purchases
+inline int BuyCost(int buycnt) {
+  if (buycnt < kCurveLength) {
+    return static_cast<int>(
+        std::ceil(static_cast<float>(10.0f * pow(1.41, buycnt))));
+  }
+  return kFlatCost;
+}
+
+// running sums over the curve, built from BuyCost() itself so bulk and
+// single purchases round exactly the same way
+struct CostTable {
+  std::array<int64_t, kCurveLength + 1> cost{};
+  std::array<int64_t, kCurveLength + 1> refund{};
+
+  CostTable() {
+    for (int i = 0; i < kCurveLength; i++) {
+      cost[i + 1] = cost[i] + BuyCost(i);
+      refund[i + 1] = refund[i] + BuyCost(i) / 2;
+    }
+  }
+};
+
+inline const CostTable& Costs() {
+  static const CostTable table;
+  return table;
+}
+
+// exp spent on the first buycnt purchases
+inline int64_t TotalCost(int buycnt) {
+  if (buycnt <= kCurveLength) {
+    return Costs().cost[buycnt];
+  }
+  return Costs().cost[kCurveLength] +
+         static_cast<int64_t>(buycnt - kCurveLength) * kFlatCost;
+}
+
+// exp returned by reverting the first buycnt purchases one at a time
+inline int64_t TotalRefund(int buycnt) {
+  if (buycnt <= kCurveLength) {
+    return Costs().refund[buycnt];
+  }
+  return Costs().refund[kCurveLength] +
+         static_cast<int64_t>(buycnt - kCurveLength) * (kFlatCost / 2);
+}
+
+// exp for n purchases after buycnt, as n single BuyCost() steps
+inline int64_t BulkCost(int buycnt, int n) {
+  return TotalCost(buycnt + n) - TotalCost(buycnt);
+}
+
+/**
+ * @brief  Most purchases after buycnt that exp covers, at most room.
+ */
+inline int Affordable(int buycnt, int exp, int room) {
+  // cost grows with n
+  int n = 0;
+  int hi = std::max(room, 0);
+  while (n < hi) {
+    int mid = n + (hi - n + 1) / 2;
+    if (BulkCost(buycnt, mid) <= exp) {
+      n = mid;
+    } else {
+      hi = mid - 1;
+    }
+  }
+  return n;
+}
+
+/**
+ * @brief  Exp for reverting n points at buycnt. Each revert refunds half the
+ * latest purchase, once buycnt is down to 0 every further one refunds half
+ * the first.
+ */
+inline int64_t BulkRefund(int buycnt, int n) {
+  return TotalRefund(buycnt) - TotalRefund(std::max(buycnt - n, 0)) +
+         static_cast<int64_t>(std::max(n - buycnt, 0)) * (BuyCost(0) / 2);
+}
+
+}  // namespace formula
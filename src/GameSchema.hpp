@@ -0,0 +1,269 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <stdexcept>
+#include <string_view>
+
+/**
+ * @brief  Schema of the game data store.
+ * Every key the game reads or writes is declared here with its value type
+ * and default, and its bytes are built at compile time, so a typo in a key
+ * or a wrong value type is a compile error instead of a silent default.
+ */
+
+// bump when the stored layout changes, and add a step to DataManager::migrate
+constexpr int kDataVersion = 1;
+
+enum class Attr : uint8_t {
+  Speed,
+  Endurance,
+  Strength,
+  Will,
+  Intellect,
+  Exp,
+  BuyCnt,
+  Count,
+};
+
+constexpr size_t kAttrCount = static_cast<size_t>(Attr::Count);
+
+constexpr std::array<std::string_view, kAttrCount> kAttrNames = {
+    "speed", "endurance", "strength", "will", "intellect", "exp", "buycnt"};
+
+// the five trainable attributes, exp and buycnt are counters
+constexpr std::array<Attr, 5> kBaseAttrs = {
+    Attr::Speed, Attr::Endurance, Attr::Strength, Attr::Will, Attr::Intellect};
+
+using AttrArray = std::array<int, kAttrCount>;
+
+constexpr size_t AttrIndex(Attr attr) { return static_cast<size_t>(attr); }
+
+constexpr std::string_view AttrName(Attr attr) {
+  return kAttrNames[AttrIndex(attr)];
+}
+
+constexpr std::optional<Attr> ParseAttr(std::string_view name) {
+  for (size_t i = 0; i < kAttrCount; i++) {
+    if (kAttrNames[i] == name) {
+      return static_cast<Attr>(i);
+    }
+  }
+  return std::nullopt;
+}
+
+/**
+ * @brief  A sparse set of attribute values, e.g. task requirements.
+ */
+class AttrMap {
+ public:
+  void Set(Attr attr, int value) {
+    values_[AttrIndex(attr)] = value;
+    mask_ |= 1u << AttrIndex(attr);
+  }
+
+  bool Has(Attr attr) const { return (mask_ >> AttrIndex(attr)) & 1u; }
+
+  int Get(Attr attr) const { return values_[AttrIndex(attr)]; }
+
+  bool Empty() const { return mask_ == 0; }
+
+  template <typename F>
+  void ForEach(F&& f) const {
+    for (size_t i = 0; i < kAttrCount; i++) {
+      if ((mask_ >> i) & 1u) {
+        f(static_cast<Attr>(i), values_[i]);
+      }
+    }
+  }
+
+ private:
+  AttrArray values_{};
+  uint32_t mask_ = 0;
+};
+
+/**
+ * @brief  Fixed-capacity key bytes, buildable in constant expressions.
+ */
+struct KeyName {
+  static constexpr size_t kCapacity = 40;
+  char data[kCapacity] = {};
+  size_t size = 0;
+
+  constexpr KeyName() = default;
+
+  constexpr explicit KeyName(std::string_view s) { Append(s); }
+
+  constexpr KeyName& Append(std::string_view s) {
+    for (char c : s) {
+      Push(c);
+    }
+    return *this;
+  }
+
+  constexpr KeyName& Append(int n) {
+    if (n < 0) {
+      Append("-");
+      n = -n;
+    }
+    char digits[12] = {};
+    size_t count = 0;
+    do {
+      digits[count++] = static_cast<char>('0' + n % 10);
+      n /= 10;
+    } while (n > 0);
+    while (count > 0) {
+      Push(digits[--count]);
+    }
+    return *this;
+  }
+
+  constexpr void Push(char c) {
+    if (size >= kCapacity) {
+      throw std::length_error("key too long");
+    }
+    data[size++] = c;
+  }
+
+  constexpr std::string_view View() const { return std::string_view(data, size); }
+
+  constexpr operator std::string_view() const { return View(); }
+};
+
+constexpr KeyName MakeKey(std::string_view prefix, int index,
+                          std::string_view suffix) {
+  KeyName key(prefix);
+  key.Append(index).Append(suffix);
+  return key;
+}
+
+constexpr KeyName MakeKey(std::string_view prefix, std::string_view body) {
+  KeyName key(prefix);
+  key.Append(body);
+  return key;
+}
+
+/**
+ * @brief  A typed handle to one stored value.
+ * Strings use std::string_view as T so handles stay literal types.
+ */
+template <typename T>
+struct Key {
+  KeyName name;
+  T def{};
+};
+
+template <size_t N, typename T>
+constexpr std::array<Key<T>, N> MakeIndexedKeys(std::string_view prefix,
+                                                std::string_view suffix,
+                                                T def) {
+  std::array<Key<T>, N> keys{};
+  for (size_t i = 0; i < N; i++) {
+    keys[i].name = MakeKey(prefix, static_cast<int>(i), suffix);
+    keys[i].def = def;
+  }
+  return keys;
+}
+
+// stored task fields, in TaskRecord and TaskKeys order
+constexpr std::array<std::string_view, 5> kTaskFields = {
+    "start_time", "end_time", "success", "status", "cost_snapshot"};
+
+using TaskRecord = std::array<int, kTaskFields.size()>;
+
+struct TaskKeys {
+  KeyName start_time;
+  KeyName end_time;
+  KeyName success;
+  KeyName status;
+  KeyName cost_snapshot;
+};
+
+namespace keys {
+
+// key families, GameData stores each one in its own column family
+constexpr std::string_view kAttrPrefix = "attr.";
+constexpr std::string_view kTaskPrefix = "task.";
+constexpr std::string_view kPartPrefix = "part.";
+constexpr std::string_view kShortcutPrefix = "shortcut.";
+
+constexpr Key<int> DataVersion{KeyName("data.version"), 0};
+constexpr Key<int> StarCnt{KeyName("starcnt"), 0};
+constexpr Key<int> Legacy{KeyName("legacy"), 0};
+constexpr Key<int> FailCount{KeyName("buff.failcount"), 0};
+// unix time exp was last accrued up to, 0 until the first accrual
+constexpr Key<int> ExpCheckpoint{KeyName("exp.checkpoint"), 0};
+constexpr Key<int> ClothesCurrent{KeyName("clothes.current"), 0};
+constexpr Key<int> NeedUpdate{KeyName("need_update"), 0};
+constexpr Key<int> DataShare{KeyName("data-share"), 0};
+constexpr Key<std::string_view> LatestVersion{KeyName("latest_version"), ""};
+constexpr Key<std::string_view> Cookies{KeyName("cookies"), ""};
+constexpr Key<std::string_view> UserAgent{KeyName("user-agent"), ""};
+constexpr Key<std::string_view> Uid{KeyName("uid"), ""};
+
+// clothes.0 is always unlocked, the entry only keeps indices aligned
+constexpr auto ClothesActive = MakeIndexedKeys<3, int>("clothes.", ".active", 0);
+
+constexpr size_t kShortcutCount = 4;
+constexpr auto ShortcutType =
+    MakeIndexedKeys<kShortcutCount, int>(kShortcutPrefix, ".type", 3);
+constexpr auto ShortcutParam = MakeIndexedKeys<kShortcutCount, std::string_view>(
+    kShortcutPrefix, ".param", "");
+
+constexpr std::array<KeyName, kAttrCount> MakeAttrKeys() {
+  std::array<KeyName, kAttrCount> keys{};
+  for (size_t i = 0; i < kAttrCount; i++) {
+    keys[i] = MakeKey(kAttrPrefix, kAttrNames[i]);
+  }
+  return keys;
+}
+
+constexpr std::array<KeyName, kAttrCount> Attrs = MakeAttrKeys();
+
+constexpr const KeyName& AttrKey(Attr attr) { return Attrs[AttrIndex(attr)]; }
+
+constexpr KeyName MakeTaskKey(int id, size_t field) {
+  KeyName key = MakeKey(kTaskPrefix, id, ".");
+  key.Append(kTaskFields[field]);
+  return key;
+}
+
+constexpr TaskKeys MakeTaskKeys(int id) {
+  return TaskKeys{MakeTaskKey(id, 0), MakeTaskKey(id, 1), MakeTaskKey(id, 2),
+                  MakeTaskKey(id, 3), MakeTaskKey(id, 4)};
+}
+
+/**
+ * @brief  Split "task.<id>.<field>" into the task id and kTaskFields index.
+ */
+constexpr bool ParseTaskKey(std::string_view key, int& id, size_t& field) {
+  if (key.substr(0, kTaskPrefix.size()) != kTaskPrefix) {
+    return false;
+  }
+  key.remove_prefix(kTaskPrefix.size());
+  size_t dot = key.find('.');
+  if (dot == 0 || dot == std::string_view::npos) {
+    return false;
+  }
+  id = 0;
+  for (char c : key.substr(0, dot)) {
+    if (c < '0' || c > '9') {
+      return false;
+    }
+    id = id * 10 + (c - '0');
+  }
+  key.remove_prefix(dot + 1);
+  for (field = 0; field < kTaskFields.size(); field++) {
+    if (kTaskFields[field] == key) {
+      return true;
+    }
+  }
+  return false;
+}
+
+constexpr KeyName PartKey(std::string_view param) {
+  return MakeKey(kPartPrefix, param);
+}
+
+}  // namespace keys
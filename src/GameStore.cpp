@@ -0,0 +1,26 @@
+#include "GameStore.hpp"
+
+#include "LogStore.hpp"
+#ifdef JPET_WITH_ROCKSDB
+#include "RocksStore.hpp"
+#endif
+
+std::unique_ptr<GameStore> GameStore::Create(std::string_view name) {
+#ifdef JPET_WITH_ROCKSDB
+  if (name == "rocksdb") {
+    return std::make_unique<RocksStore>();
+  }
+#endif
+  if (name == "log") {
+    return std::make_unique<LogStore>();
+  }
+  return nullptr;
+}
+
+std::vector<std::string_view> GameStore::Backends() {
+  return {
+#ifdef JPET_WITH_ROCKSDB
+      "rocksdb",
+#endif
+      "log"};
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief  Storage backend of GameData.
+ * Values are opaque bytes here, typing, caching and group commit all live in
+ * GameData. Implementations must be safe to call from several threads.
+ */
+class GameStore {
+ public:
+  using Entry = std::pair<std::string_view, std::string_view>;
+  using Visitor =
+      std::function<void(std::string_view key, std::string_view value)>;
+
+  virtual ~GameStore() = default;
+
+  virtual const char* Name() const = 0;
+
+  /**
+   * @brief  Whether this backend has data under dir.
+   */
+  virtual bool Exists(const std::wstring& dir) const = 0;
+
+  /**
+   * @brief  Delete this backend's data under dir, the store must be closed.
+   */
+  virtual void Remove(const std::wstring& dir) const = 0;
+
+  virtual bool Open(const std::wstring& dir) = 0;
+
+  virtual void Close() = 0;
+
+  /**
+   * @return false if the key is absent or the read failed
+   */
+  virtual bool Get(std::string_view key, std::string& value) = 0;
+
+  virtual std::vector<std::optional<std::string>> MultiGet(
+      const std::vector<std::string_view>& keys) {
+    std::vector<std::optional<std::string>> result(keys.size());
+    std::string value;
+    for (size_t i = 0; i < keys.size(); i++) {
+      if (Get(keys[i], value)) {
+        result[i] = value;
+      }
+    }
+    return result;
+  }
+
+  /**
+   * @brief  Visit keys starting with prefix in key order, an empty prefix
+   * visits everything. visit must not call back into the store.
+   */
+  virtual bool Scan(std::string_view prefix, const Visitor& visit) = 0;
+
+  /**
+   * @brief  Apply puts atomically, sync makes them durable before returning.
+   */
+  virtual bool Write(const std::vector<Entry>& puts, bool sync) = 0;
+
+  /**
+   * @brief  Delete every key atomically.
+   */
+  virtual bool Clear(bool sync) = 0;
+
+  /**
+   * @brief  Make all earlier writes durable.
+   */
+  virtual bool Sync() = 0;
+
+  virtual void LogStats() {}
+
+  /**
+   * @brief  Create a backend by its [data] backend name.
+   * @return nullptr if the backend is unknown or not compiled in
+   */
+  static std::unique_ptr<GameStore> Create(std::string_view name);
+
+  /**
+   * @brief  Names of all compiled-in backends, the first is the default.
+   */
+  static std::vector<std::string_view> Backends();
+};
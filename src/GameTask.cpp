@@ -1,90 +1,91 @@
 ﻿#include "GameTask.hpp"
 #include "DataManager.hpp"
+#include "GameFormula.hpp"
 #include "LAppDefine.hpp"
+#include "Random.hpp"
 
-using namespace WinToastLib;
+GameTask::GameTask(std::shared_ptr<const TaskCatalog> catalog,
+                   const TaskDef& def)
+    : id(def.id),
+      data_keys(keys::MakeTaskKeys(def.id)),
+      catalog_(std::move(catalog)),
+      def_(&def) {}
+
+std::vector<GameTask> GameTask::InitTasks(
+    const std::shared_ptr<const TaskCatalog>& catalog,
+    const std::unordered_map<int, TaskRecord>& records) {
+  std::vector<GameTask> tasks;
+  tasks.reserve(catalog->Size());
+  for (const TaskDef& def : *catalog) {
+    if ((def.flags & catalog::kDebug) && !LAppDefine::DebugLogEnable) {
+      continue;
+    }
+    GameTask& task = tasks.emplace_back(catalog, def);
+    auto it = records.find(task.id);
+    task.Load(it == records.end() ? TaskRecord{} : it->second);
+  }
+  return tasks;
+}
 
 void GameTask::Load() {
-  auto status_vec = DataManager::GetInstance()->TaskStatus(id);
-  start_time = status_vec[0];
-  end_time = status_vec[1];
-  success = status_vec[2] == 1;
-  status = static_cast<TStatus>(status_vec[3]);
-  cost_snapshot = status_vec[4];
+  Load(DataManager::GetInstance()->TaskStatus(data_keys));
+}
+
+void GameTask::Load(const TaskRecord& record) {
+  start_time = record[0];
+  end_time = record[1];
+  success = record[2] == 1;
+  status = static_cast<TStatus>(record[3]);
+  cost_snapshot = record[4];
 }
 
 void GameTask::Dump() {
-  DataManager::GetInstance()->DumpTask(id, start_time, end_time, success, static_cast<int>(status), cost_snapshot);
+  DataManager::GetInstance()->DumpTask(data_keys, start_time, end_time, success, static_cast<int>(status), cost_snapshot);
 }
 
-int GameTask::GetCurrentCost() {
-  int speed = DataManager::GetInstance()->GetAttribute("speed");
-  return cost * (1 - 0.75 * LAppPal::EaseOut(speed - 2) / 100);
+void GameTask::Dump(GameData::Transaction& txn) {
+  DataManager::GetInstance()->DumpTask(txn, data_keys, start_time, end_time, success, static_cast<int>(status), cost_snapshot);
 }
 
-void GameTask::Notify(const wstring& title, const wstring& content,
-                              WinToastEventHandler* handler) {
-  WinToastTemplate templ = WinToastTemplate(WinToastTemplate::ImageAndText02);
-  // convert char* to wstring
-  templ.setTextField(title, WinToastTemplate::FirstLine);
-  templ.setTextField(content, WinToastTemplate::SecondLine);
-  std::wstring img = LAppDefine::execPath + std::wstring(L"resources/imgs/Avatar.png");
-  templ.setImagePath(img);
-  WinToast::instance()->showToast(templ, handler, nullptr);
+int GameTask::GetCurrentCost() {
+  int speed = DataManager::GetInstance()->GetAttribute(Attr::Speed);
+  return formula::TaskCost(Cost(), speed);
 }
 
-void GameTask::TryDone() {
+void GameTask::Settle() {
   // task not running now
   if (status != TStatus::RUNNING) {
     return;
   }
-  // compare start time + cost with current time
-  time_t current_time = time(NULL);
-  bool state = current_time >= start_time + cost_snapshot;
-  // time's up, set status now
-  if (state) {
-    // check success or not
-    int lack = 0;
-    for (auto it = requirements.begin(); it != requirements.end(); ++it) {
-      // get attribute from game data
-      int value = DataManager::GetInstance()->GetAttribute(it->first);
-      if (value < it->second) {
-        // if lack attribute
-        lack += it->second - value;
-      }
+  // check success or not
+  int lack = 0;
+  Requirements().ForEach([&lack](Attr attr, int required) {
+    // get attribute from game data
+    int value = DataManager::GetInstance()->GetAttribute(attr);
+    if (value < required) {
+      // if lack attribute
+      lack += required - value;
     }
-    srand(time(NULL));
-
-    // get willpower
-    int will = DataManager::GetInstance()->GetAttribute("will");
-    // every lack of attribute will reduce 3% -> 12
-    // every will will increase 0.25% -> 1
-    lack *= 12;
-    // if lack is 0, the full rate is 70%, lack 30% -> 120
-    int starcnt = DataManager::GetInstance()->GetWithDefault("starcnt", 0);
-    lack += 120 + 20 * starcnt;
-    if (lack >= 400) {
+  });
+  int will = DataManager::GetInstance()->GetAttribute(Attr::Will);
+  int starcnt = DataManager::GetInstance()->Get(keys::StarCnt);
+  int threshold = formula::FailThreshold(lack, will, starcnt);
+  if (threshold >= formula::kRollRange) {
+    success = false;
+    LAppPal::PrintLog(LogLevel::Info, "[GameTask]Task %d failed before will takes effect", id);
+  } else {
+    if (Random::Below(formula::kRollRange) < threshold) {
       success = false;
-      LAppPal::PrintLog(LogLevel::Info, "[GameTask]Task %d failed before will takes effect", id);
+      LAppPal::PrintLog(LogLevel::Info, "[GameTask]Task %d failed", id);
     } else {
-      lack -= will;
-      // max rate is 95%, 5% -> 20
-      if (lack < 20) {
-        lack = 20;
-      }
-      // using random number to determine success
-      int random = rand() % 400;
-      if (random < lack) {
-        success = false;
-        LAppPal::PrintLog(LogLevel::Info, "[GameTask]Task %d failed", id);
-      } else {
-        success = true;
-        LAppPal::PrintLog(LogLevel::Info, "[GameTask]Task %d success", id);
-      }
-      status = TStatus::WAIT_SETTLE;
-      Notify(L"任务完成", title, new WinToastEventHandler("TASK_COMPLETE"));
+      success = true;
+      LAppPal::PrintLog(LogLevel::Info, "[GameTask]Task %d success", id);
     }
-
-    Dump();
   }
+  // settled exactly once, a hopeless task fails instead of running forever
+  status = TStatus::WAIT_SETTLE;
+  if (const auto& notify = DataManager::GetInstance()->Hooks().notify) {
+    notify(L"任务完成", LAppPal::StringToWString(std::string(Title())));
+  }
+  Dump();
 }
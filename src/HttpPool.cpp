@@ -0,0 +1,272 @@
+#include "HttpPool.hpp"
+
+#include <algorithm>
+
+struct HttpPool::Host {
+  std::string name;
+  int port = 443;
+  std::mutex mutex;
+  std::vector<std::unique_ptr<httplib::SSLClient>> idle;
+  // clients lent out, for CancelAll()
+  std::vector<httplib::SSLClient*> busy;
+  // last session the server issued, new connections resume it
+  SSL_SESSION* session = nullptr;
+  std::string addr;
+  time_t resolved_at = 0;
+  // addr is fixed by HttpPool::Redirect(), never resolved
+  bool redirected = false;
+  HttpHostStats stats;
+};
+
+namespace {
+
+// ex_data slot of a pooled client's SSL_CTX holding its HttpPool::Host
+int HostIndex() {
+  static const int index =
+      SSL_CTX_get_ex_new_index(0, nullptr, nullptr, nullptr, nullptr);
+  return index;
+}
+
+// first address of name, empty if it does not resolve
+std::string Resolve(const std::string& name) {
+  addrinfo hints{};
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  addrinfo* result = nullptr;
+  if (getaddrinfo(name.c_str(), nullptr, &hints, &result) != 0) {
+    return {};
+  }
+  char buf[INET6_ADDRSTRLEN] = {};
+  for (addrinfo* ai = result; ai != nullptr; ai = ai->ai_next) {
+    void* addr = nullptr;
+    if (ai->ai_family == AF_INET) {
+      addr = &reinterpret_cast<sockaddr_in*>(ai->ai_addr)->sin_addr;
+    } else if (ai->ai_family == AF_INET6) {
+      addr = &reinterpret_cast<sockaddr_in6*>(ai->ai_addr)->sin6_addr;
+    }
+    if (addr && inet_ntop(ai->ai_family, addr, buf, sizeof(buf))) {
+      break;
+    }
+  }
+  freeaddrinfo(result);
+  return buf;
+}
+
+}  // namespace
+
+HttpPool::HttpPool() = default;
+
+HttpPool::~HttpPool() {
+  for (auto& [key, host] : hosts_) {
+    if (host->session) {
+      SSL_SESSION_free(host->session);
+    }
+  }
+}
+
+void HttpPool::onHandshake(const SSL* ssl, int where, int ret) {
+  // also called for alerts, e.g. from stop() under Host::mutex
+  if (!(where & (SSL_CB_HANDSHAKE_START | SSL_CB_HANDSHAKE_DONE))) {
+    return;
+  }
+  auto* host = static_cast<Host*>(
+      SSL_CTX_get_ex_data(SSL_get_SSL_CTX(ssl), HostIndex()));
+  if (!host) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(host->mutex);
+  if (where & SSL_CB_HANDSHAKE_START) {
+    // the client hello is not built yet, a session set now is offered
+    host->stats.handshakes++;
+    if (host->session) {
+      SSL_set_session(const_cast<SSL*>(ssl), host->session);
+    }
+  } else if (where & SSL_CB_HANDSHAKE_DONE) {
+    if (SSL_session_reused(const_cast<SSL*>(ssl))) {
+      host->stats.resumed++;
+    }
+  }
+}
+
+int HttpPool::onNewSession(SSL* ssl, SSL_SESSION* session) {
+  auto* host = static_cast<Host*>(
+      SSL_CTX_get_ex_data(SSL_get_SSL_CTX(ssl), HostIndex()));
+  if (!host) {
+    return 0;
+  }
+  std::lock_guard<std::mutex> lock(host->mutex);
+  if (host->session) {
+    SSL_SESSION_free(host->session);
+  }
+  // returning 1 keeps the reference OpenSSL handed over
+  host->session = session;
+  return 1;
+}
+
+HttpPool::Host& HttpPool::host(const std::string& name,
+                               const HttpOptions& options) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto redirect = redirects_.find(name);
+  if (redirect == redirects_.end()) {
+    redirect = redirects_.find("*");
+  }
+  int port = redirect == redirects_.end() ? options.port
+                                          : redirect->second.second;
+  auto& entry = hosts_[name + ":" + std::to_string(port)];
+  if (!entry) {
+    entry = std::make_unique<Host>();
+    entry->name = name;
+    entry->port = port;
+    if (redirect != redirects_.end()) {
+      entry->addr = redirect->second.first;
+      entry->redirected = true;
+    }
+  }
+  return *entry;
+}
+
+bool HttpPool::Redirect(const std::string& host, const std::string& target) {
+  std::string addr = target;
+  int port = 443;
+  // an IPv6 address is written in brackets, "[::1]:8443"
+  size_t colon = target.rfind(':');
+  if (colon != std::string::npos &&
+      target.find(']', colon) == std::string::npos) {
+    addr = target.substr(0, colon);
+    try {
+      size_t used = 0;
+      port = std::stoi(target.substr(colon + 1), &used);
+      if (used != target.size() - colon - 1 || port <= 0 || port > 65535) {
+        return false;
+      }
+    } catch (const std::exception&) {
+      return false;
+    }
+  }
+  if (addr.size() > 1 && addr.front() == '[' && addr.back() == ']') {
+    addr = addr.substr(1, addr.size() - 2);
+  }
+  if (addr.empty()) {
+    return false;
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  redirects_[host] = {addr, port};
+  return true;
+}
+
+std::unique_ptr<httplib::SSLClient> HttpPool::acquire(Host& host,
+                                                      const HttpOptions& options) {
+  std::unique_ptr<httplib::SSLClient> client;
+  std::string addr;
+  time_t now = time(nullptr);
+  {
+    std::lock_guard<std::mutex> lock(host.mutex);
+    if (!host.idle.empty()) {
+      client = std::move(host.idle.back());
+      host.idle.pop_back();
+    } else if (host.redirected || now < host.resolved_at + kDnsTtl) {
+      addr = host.addr;
+    }
+  }
+  if (!client) {
+    if (addr.empty()) {
+      addr = Resolve(host.name);
+      std::lock_guard<std::mutex> lock(host.mutex);
+      host.addr = addr;
+      host.resolved_at = addr.empty() ? 0 : now;
+    }
+    client = std::make_unique<httplib::SSLClient>(host.name, host.port);
+    client->set_keep_alive(true);
+    if (!addr.empty()) {
+      client->set_hostname_addr_map({{host.name, addr}});
+    }
+    SSL_CTX* ctx = client->ssl_context();
+    SSL_CTX_set_ex_data(ctx, HostIndex(), &host);
+    SSL_CTX_set_session_cache_mode(
+        ctx, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+    SSL_CTX_sess_set_new_cb(ctx, &HttpPool::onNewSession);
+    SSL_CTX_set_info_callback(ctx, &HttpPool::onHandshake);
+  }
+  client->set_connection_timeout(options.connect_timeout);
+  client->set_read_timeout(options.read_timeout);
+  client->set_write_timeout(options.read_timeout);
+  // a stand-in serves its own certificate
+  client->enable_server_certificate_verification(options.verify &&
+                                                 !host.redirected);
+  client->set_follow_location(options.follow_location);
+  std::lock_guard<std::mutex> lock(host.mutex);
+  host.busy.push_back(client.get());
+  return client;
+}
+
+void HttpPool::release(Host& host, std::unique_ptr<httplib::SSLClient> client,
+                       bool ok, double ms) {
+  std::lock_guard<std::mutex> lock(host.mutex);
+  host.busy.erase(std::find(host.busy.begin(), host.busy.end(), client.get()));
+  HttpHostStats& stats = host.stats;
+  stats.requests++;
+  stats.avg_ms = stats.requests == 1 ? ms : stats.avg_ms * 0.9 + ms * 0.1;
+  stats.max_ms = std::max(stats.max_ms, ms);
+  if (!ok) {
+    stats.failures++;
+    // the host may have moved, resolve again for the next connection
+    host.resolved_at = 0;
+    return;
+  }
+  if (host.idle.size() < kMaxIdle) {
+    host.idle.push_back(std::move(client));
+  }
+}
+
+httplib::Result HttpPool::request(
+    const std::string& name, const HttpOptions& options,
+    const std::function<httplib::Result(httplib::SSLClient&)>& send) {
+  Host& h = host(name, options);
+  auto client = acquire(h, options);
+  auto start = std::chrono::steady_clock::now();
+  httplib::Result res = send(*client);
+  double ms = std::chrono::duration<double, std::milli>(
+                  std::chrono::steady_clock::now() - start)
+                  .count();
+  release(h, std::move(client), static_cast<bool>(res), ms);
+  return res;
+}
+
+httplib::Result HttpPool::Get(const std::string& host, const std::string& path,
+                              const httplib::Headers& headers,
+                              const HttpOptions& options) {
+  return request(host, options, [&](httplib::SSLClient& client) {
+    return client.Get(path, headers);
+  });
+}
+
+httplib::Result HttpPool::Post(const std::string& host,
+                               const std::string& path,
+                               const httplib::Headers& headers,
+                               const std::string& body,
+                               const std::string& content_type,
+                               const HttpOptions& options) {
+  return request(host, options, [&](httplib::SSLClient& client) {
+    return client.Post(path, headers, body, content_type);
+  });
+}
+
+void HttpPool::CancelAll() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (auto& [key, host] : hosts_) {
+    std::lock_guard<std::mutex> host_lock(host->mutex);
+    for (httplib::SSLClient* client : host->busy) {
+      client->stop();
+    }
+  }
+}
+
+std::map<std::string, HttpHostStats> HttpPool::Stats() {
+  std::map<std::string, HttpHostStats> stats;
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (auto& [key, host] : hosts_) {
+    std::lock_guard<std::mutex> host_lock(host->mutex);
+    stats[key] = host->stats;
+  }
+  return stats;
+}
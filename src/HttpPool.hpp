@@ -0,0 +1,108 @@
+#pragma once
+
+#include <chrono>
+#include <ctime>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <httplib.h>
+
+// per request settings of HttpPool
+struct HttpOptions {
+  int port = 443;
+  std::chrono::milliseconds connect_timeout{1000};
+  std::chrono::milliseconds read_timeout{5000};
+  bool verify = true;
+  bool follow_location = false;
+};
+
+struct HttpHostStats {
+  uint64_t requests = 0;
+  uint64_t failures = 0;
+  // TLS handshakes, and how many of them resumed a session
+  uint64_t handshakes = 0;
+  uint64_t resumed = 0;
+  // moving average and maximum of the request latency
+  double avg_ms = 0;
+  double max_ms = 0;
+};
+
+/**
+ * @brief  HTTPS clients shared by every remote API call, pooled per host.
+ * A request borrows an idle client of its host or opens a new one, so
+ * requests run concurrently while connections stay alive between polls.
+ * New connections resume the host's last TLS session and connect to a
+ * cached address instead of resolving again.
+ */
+class HttpPool {
+ public:
+  // idle clients kept per host, more are closed after their request
+  static constexpr size_t kMaxIdle = 4;
+  static constexpr time_t kDnsTtl = 10 * 60;
+
+  static HttpPool* GetInstance() {
+    static HttpPool instance;
+    return &instance;
+  }
+
+  // out of line, Host is only complete in HttpPool.cpp
+  HttpPool();
+  ~HttpPool();
+
+  httplib::Result Get(const std::string& host, const std::string& path,
+                      const httplib::Headers& headers = {},
+                      const HttpOptions& options = {});
+
+  httplib::Result Post(const std::string& host, const std::string& path,
+                       const httplib::Headers& headers,
+                       const std::string& body,
+                       const std::string& content_type,
+                       const HttpOptions& options = {});
+
+  /**
+   * @brief  Abort requests in flight, they return Error::Canceled or a
+   * connection error. Later requests run as usual.
+   */
+  void CancelAll();
+
+  /**
+   * @brief  Per host and port, e.g. "api.bilibili.com:443".
+   */
+  std::map<std::string, HttpHostStats> Stats();
+
+  /**
+   * @brief  Send requests for host to target, "addr" or "addr:port",
+   * instead, e.g. to a local stand-in of the API. Host "*" redirects every
+   * host not redirected by name. The Host header and SNI stay those of
+   * host and the certificate is not verified. Call before the first
+   * request to host.
+   * @return false if target is malformed
+   */
+  bool Redirect(const std::string& host, const std::string& target);
+
+ private:
+  struct Host;
+
+  std::mutex mutex_;
+  // by "host:port", never erased so callbacks can keep a pointer
+  std::map<std::string, std::unique_ptr<Host>> hosts_;
+  // addr and port by host, see Redirect()
+  std::map<std::string, std::pair<std::string, int>> redirects_;
+
+  // TLS callbacks of every pooled client, find the host by the SSL_CTX
+  static void onHandshake(const SSL* ssl, int where, int ret);
+  static int onNewSession(SSL* ssl, SSL_SESSION* session);
+
+  Host& host(const std::string& name, const HttpOptions& options);
+  std::unique_ptr<httplib::SSLClient> acquire(Host& host,
+                                              const HttpOptions& options);
+  void release(Host& host, std::unique_ptr<httplib::SSLClient> client,
+               bool ok, double ms);
+  httplib::Result request(
+      const std::string& name, const HttpOptions& options,
+      const std::function<httplib::Result(httplib::SSLClient&)>& send);
+};
@@ -0,0 +1,370 @@
+#pragma once
+
+#include <array>
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+/**
+ * @brief  On-demand reads from a JSON text, no DOM. A JsonScan is a view of
+ * one value inside the text; Field() and At() find a member by skipping
+ * over what comes before it, so only the bytes up to the wanted value are
+ * looked at and nothing is allocated but the strings String() returns.
+ * Missing members and malformed text give an empty view, reads of an empty
+ * view return their default. The text must outlive every view of it.
+ */
+class JsonScan {
+ public:
+  JsonScan() = default;
+
+  explicit JsonScan(std::string_view text)
+      : JsonScan(text, skipSpace(text, 0)) {}
+
+  bool Valid() const { return _pos < _text.size(); }
+
+  explicit operator bool() const { return Valid(); }
+
+  bool IsObject() const { return peek() == '{'; }
+  bool IsArray() const { return peek() == '['; }
+  bool IsString() const { return peek() == '"'; }
+  bool IsNull() const { return Raw() == "null"; }
+
+  /**
+   * @brief  Member name of an object.
+   */
+  JsonScan Field(std::string_view name) const {
+    JsonScan found;
+    forEachMember([&](std::string_view key, JsonScan value) {
+      if (key == name) {
+        found = value;
+        return false;
+      }
+      return true;
+    });
+    return found;
+  }
+
+  /**
+   * @brief  Several members of an object in one pass, in the order of names.
+   */
+  template <size_t N>
+  std::array<JsonScan, N> Fields(const std::string_view (&names)[N]) const {
+    std::array<JsonScan, N> found;
+    size_t left = N;
+    forEachMember([&](std::string_view key, JsonScan value) {
+      for (size_t i = 0; i < N; i++) {
+        if (!found[i] && key == names[i]) {
+          found[i] = value;
+          left--;
+        }
+      }
+      return left > 0;
+    });
+    return found;
+  }
+
+  /**
+   * @brief  Element index of an array.
+   */
+  JsonScan At(size_t index) const {
+    JsonScan found;
+    ForEach([&](JsonScan value) {
+      if (index-- == 0) {
+        found = value;
+        return false;
+      }
+      return true;
+    });
+    return found;
+  }
+
+  /**
+   * @brief  Elements of an array, or members of an object.
+   */
+  size_t Size() const {
+    size_t size = 0;
+    if (IsObject()) {
+      forEachMember([&](std::string_view, JsonScan) {
+        size++;
+        return true;
+      });
+    } else {
+      ForEach([&](JsonScan) {
+        size++;
+        return true;
+      });
+    }
+    return size;
+  }
+
+  /**
+   * @brief  Call f with each element of an array in order, until it
+   * returns false.
+   */
+  template <typename F>
+  void ForEach(F&& f) const {
+    if (!IsArray()) {
+      return;
+    }
+    size_t pos = skipSpace(_text, _pos + 1);
+    if (pos < _text.size() && _text[pos] == ']') {
+      return;
+    }
+    while (pos < _text.size()) {
+      size_t end = skipValue(_text, pos);
+      if (end == npos) {
+        return;
+      }
+      if (!f(JsonScan(_text, pos))) {
+        return;
+      }
+      pos = skipSpace(_text, end);
+      if (pos >= _text.size() || _text[pos] != ',') {
+        return;
+      }
+      pos = skipSpace(_text, pos + 1);
+    }
+  }
+
+  /**
+   * @brief  Call f with the key and value of each member of an object, in
+   * order, until it returns false.
+   */
+  template <typename F>
+  void ForEachMember(F&& f) const {
+    forEachMember(f);
+  }
+
+  int64_t Int(int64_t dvalue = 0) const {
+    std::string_view raw = Raw();
+    int64_t value = 0;
+    auto [end, ec] = std::from_chars(raw.data(), raw.data() + raw.size(), value);
+    // a fraction or exponent is not an integer
+    if (ec != std::errc() || end != raw.data() + raw.size()) {
+      return dvalue;
+    }
+    return value;
+  }
+
+  bool Bool(bool dvalue = false) const {
+    std::string_view raw = Raw();
+    if (raw == "true") {
+      return true;
+    }
+    if (raw == "false") {
+      return false;
+    }
+    return dvalue;
+  }
+
+  /**
+   * @brief  A string value unescaped, dvalue for anything else.
+   */
+  std::string String(std::string dvalue = {}) const {
+    if (!IsString()) {
+      return dvalue;
+    }
+    std::string_view raw = Raw();
+    raw = raw.substr(1, raw.size() - 2);
+    if (raw.find('\\') == std::string_view::npos) {
+      return std::string(raw);
+    }
+    std::string out;
+    out.reserve(raw.size());
+    for (size_t i = 0; i < raw.size(); i++) {
+      if (raw[i] != '\\' || i + 1 >= raw.size()) {
+        out.push_back(raw[i]);
+        continue;
+      }
+      char c = raw[++i];
+      switch (c) {
+        case 'b': out.push_back('\b'); break;
+        case 'f': out.push_back('\f'); break;
+        case 'n': out.push_back('\n'); break;
+        case 'r': out.push_back('\r'); break;
+        case 't': out.push_back('\t'); break;
+        case 'u': {
+          uint32_t cp = hex4(raw, i + 1);
+          i += 4;
+          // a surrogate pair is one code point
+          if (cp >= 0xD800 && cp < 0xDC00 && i + 6 < raw.size() &&
+              raw[i + 1] == '\\' && raw[i + 2] == 'u') {
+            uint32_t low = hex4(raw, i + 3);
+            if (low >= 0xDC00 && low < 0xE000) {
+              cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+              i += 6;
+            }
+          }
+          appendUtf8(out, cp);
+          break;
+        }
+        default: out.push_back(c); break;
+      }
+    }
+    return out;
+  }
+
+  /**
+   * @brief  The text of the value, quotes and brackets included.
+   */
+  std::string_view Raw() const {
+    if (!Valid()) {
+      return {};
+    }
+    size_t end = skipValue(_text, _pos);
+    if (end == npos) {
+      return {};
+    }
+    return _text.substr(_pos, end - _pos);
+  }
+
+ private:
+  static constexpr size_t npos = std::string_view::npos;
+
+  std::string_view _text;
+  size_t _pos = npos;
+
+  JsonScan(std::string_view text, size_t pos) : _text(text), _pos(pos) {}
+
+  char peek() const { return Valid() ? _text[_pos] : '\0'; }
+
+  template <typename F>
+  void forEachMember(F&& f) const {
+    if (!IsObject()) {
+      return;
+    }
+    size_t pos = skipSpace(_text, _pos + 1);
+    while (pos < _text.size() && _text[pos] == '"') {
+      size_t key_end = skipString(_text, pos);
+      if (key_end == npos) {
+        return;
+      }
+      // keys are compared as written, the APIs never escape them
+      std::string_view key = _text.substr(pos + 1, key_end - pos - 2);
+      pos = skipSpace(_text, key_end);
+      if (pos >= _text.size() || _text[pos] != ':') {
+        return;
+      }
+      pos = skipSpace(_text, pos + 1);
+      size_t end = skipValue(_text, pos);
+      if (end == npos) {
+        return;
+      }
+      if (!f(key, JsonScan(_text, pos))) {
+        return;
+      }
+      pos = skipSpace(_text, end);
+      if (pos >= _text.size() || _text[pos] != ',') {
+        return;
+      }
+      pos = skipSpace(_text, pos + 1);
+    }
+  }
+
+  static size_t skipSpace(std::string_view text, size_t pos) {
+    while (pos < text.size() && (text[pos] == ' ' || text[pos] == '\n' ||
+                                 text[pos] == '\r' || text[pos] == '\t')) {
+      pos++;
+    }
+    return pos;
+  }
+
+  // past the closing quote of the string at pos
+  static size_t skipString(std::string_view text, size_t pos) {
+    for (pos++; pos < text.size(); pos++) {
+      const char* p = static_cast<const char*>(
+          std::memchr(text.data() + pos, '"', text.size() - pos));
+      if (p == nullptr) {
+        return npos;
+      }
+      pos = p - text.data();
+      // the quote is escaped if an odd number of backslashes precede it
+      size_t slashes = 0;
+      while (text[pos - 1 - slashes] == '\\') {
+        slashes++;
+      }
+      if (slashes % 2 == 0) {
+        return pos + 1;
+      }
+    }
+    return npos;
+  }
+
+  // past the end of the value at pos, npos if it does not end
+  static size_t skipValue(std::string_view text, size_t pos) {
+    if (pos >= text.size()) {
+      return npos;
+    }
+    char c = text[pos];
+    if (c == '"') {
+      return skipString(text, pos);
+    }
+    if (c == '{' || c == '[') {
+      int depth = 0;
+      while (pos < text.size()) {
+        c = text[pos];
+        if (c == '"') {
+          pos = skipString(text, pos);
+          if (pos == npos) {
+            return npos;
+          }
+          continue;
+        }
+        if (c == '{' || c == '[') {
+          depth++;
+        } else if (c == '}' || c == ']') {
+          if (--depth == 0) {
+            return pos + 1;
+          }
+        }
+        pos++;
+      }
+      return npos;
+    }
+    // number, true, false or null
+    size_t start = pos;
+    while (pos < text.size() && text[pos] != ',' && text[pos] != '}' &&
+           text[pos] != ']' && text[pos] != ' ' && text[pos] != '\n' &&
+           text[pos] != '\r' && text[pos] != '\t') {
+      pos++;
+    }
+    return pos > start ? pos : npos;
+  }
+
+  static uint32_t hex4(std::string_view text, size_t pos) {
+    uint32_t value = 0;
+    for (size_t i = pos; i < pos + 4 && i < text.size(); i++) {
+      char c = text[i];
+      value <<= 4;
+      if (c >= '0' && c <= '9') {
+        value |= c - '0';
+      } else if (c >= 'a' && c <= 'f') {
+        value |= c - 'a' + 10;
+      } else if (c >= 'A' && c <= 'F') {
+        value |= c - 'A' + 10;
+      }
+    }
+    return value;
+  }
+
+  static void appendUtf8(std::string& out, uint32_t cp) {
+    if (cp < 0x80) {
+      out.push_back(static_cast<char>(cp));
+    } else if (cp < 0x800) {
+      out.push_back(static_cast<char>(0xC0 | (cp >> 6)));
+      out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+    } else if (cp < 0x10000) {
+      out.push_back(static_cast<char>(0xE0 | (cp >> 12)));
+      out.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+      out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+    } else {
+      out.push_back(static_cast<char>(0xF0 | (cp >> 18)));
+      out.push_back(static_cast<char>(0x80 | ((cp >> 12) & 0x3F)));
+      out.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+      out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+    }
+  }
+};
@@ -30,7 +30,10 @@
 #define STB_IMAGE_WRITE_IMPLEMENTATION
 #include <stb_image_write.h>
 
+#include "BuffManager.hpp"
+#include "CookieStore.hpp"
 #include "DataManager.hpp"
+#include "HttpPool.hpp"
 #include "LAppDefine.hpp"
 #include "LAppLive2DManager.hpp"
 #include "LAppModel.hpp"
@@ -39,6 +42,7 @@
 #include "LAppView.hpp"
 #include "PanelServer.hpp"
 #include "PartStateManager.h"
+#include "Random.hpp"
 #include "TaskScheduler.hpp"
 #include "resource.h"
 
@@ -79,11 +83,50 @@ bool LAppDelegate::Initialize() {
   LAppPal::PrintLog(LogLevel::Debug, "[LAppDelegate]START");
   WinToastLib::WinToast::instance()->setShortcutPolicy(WinToastLib::WinToast::SHORTCUT_POLICY_IGNORE);
   DataManager *dataManager = DataManager::GetInstance();
+  DataHooks hooks;
+  hooks.factors = [] { return BuffManager::GetInstance()->Factors(); };
+  hooks.fail = [](bool fail) { BuffManager::GetInstance()->SetFail(fail); };
+  hooks.profileChanged = [] {
+    PanelServer::GetInstance()->Changed(PanelData::PROFILE);
+  };
+  hooks.tasksChanged = [] {
+    PanelServer::GetInstance()->Changed(PanelData::TASKS);
+  };
+  hooks.clothesChanged = [](int clothes) {
+    LAppLive2DManager::GetInstance()->SwitchClothes(clothes);
+  };
+  hooks.notify = [](const std::wstring &title, const std::wstring &content) {
+    WinToastLib::WinToastTemplate templ(
+        WinToastLib::WinToastTemplate::ImageAndText02);
+    templ.setTextField(title, WinToastLib::WinToastTemplate::FirstLine);
+    templ.setTextField(content, WinToastLib::WinToastTemplate::SecondLine);
+    templ.setImagePath(LAppDefine::execPath + L"resources/imgs/Avatar.png");
+    WinToastLib::WinToast::instance()->showToast(
+        templ, new WinToastEventHandler("TASK_COMPLETE"), nullptr);
+  };
+  dataManager->SetHooks(std::move(hooks));
   // 设置初始化
   dataManager->GetWindowPos(&_iposX, &_iposY);
   dataManager->GetDisplay(&_scale, &Green, &isLimit);
   _followlist = dataManager->GetFollowList();
   dataManager->GetNotify(&DynamicNotify, &LiveNotify, &UpdateNotify);
+  // [endpoints] sends a host's requests elsewhere, e.g. to tools/standin,
+  // before anything goes out
+  for (const auto &[host, target] : dataManager->GetConfigStrings("endpoints")) {
+    if (HttpPool::GetInstance()->Redirect(host, target)) {
+      LAppPal::PrintLog(LogLevel::Warn, "[LAppDelegate]Endpoint %s -> %s",
+                        host.c_str(), target.c_str());
+    } else {
+      LAppPal::PrintLog(LogLevel::Error, "[LAppDelegate]Bad endpoint %s = %s",
+                        host.c_str(), target.c_str());
+    }
+  }
+  CookieStore::GetInstance()->Load();
+  if (auto login = CookieStore::GetInstance()->Login();
+      !login->Empty() && !login->Valid()) {
+    LAppPal::PrintLog(LogLevel::Warn, "[LAppDelegate]Login expired at %lld",
+                      static_cast<long long>(login->Expires()));
+  }
 
   RenderTargetWidth = _scale * DRenderTargetWidth;
   RenderTargetHeight = _scale * DRenderTargetHeight;
@@ -232,7 +275,8 @@ bool LAppDelegate::Initialize() {
   // Cubism SDK 初始化
   InitializeCubism();
 
-  srand(time(NULL));
+  // [game] seed replays task outcomes and effects, 0 varies every run
+  Random::Seed(dataManager->GetConfig<int64_t>("game", "seed", 0));
 
   // Start panel server
   auto panelServer = PanelServer::GetInstance();
@@ -250,9 +294,11 @@ bool LAppDelegate::Initialize() {
   // Init task scheduler and basic tasks
   TaskScheduler *ts = TaskScheduler::GetInstance();
   auto expTask = std::make_shared<ExpTask>();
-  auto checkTask = std::make_shared<CheckTask>();
   ts->AddTask(expTask);
-  ts->AddTask(checkTask);
+  // a task left running by the last session settles on its deadline
+  DataManager::GetInstance()->ResumeTasks();
+  // exp owed since the last session
+  DataManager::GetInstance()->AccrueExp();
 
   return GL_TRUE;
 }
@@ -280,6 +326,9 @@ void LAppDelegate::SetLimit(bool limit) {
 }
 
 void LAppDelegate::Release() {
+  // workers waiting on the network exit without their timeouts
+  HttpPool::GetInstance()->CancelAll();
+
   // Windowの削除
   glfwDestroyWindow(_window);
 
@@ -305,7 +354,7 @@ void LAppDelegate::Run() {
   LAppLive2DManager::GetInstance()->UpdateViewPort();
   
   // 随机播放启动语音
-  _au->Play3dSound(AudioType::START, rand());
+  _au->Play3dSound(AudioType::START);
 
   // メインループ
   bool noskip = false;
@@ -385,10 +434,10 @@ void LAppDelegate::Run() {
     // Poll for and process events
     glfwPollEvents();
 
-    if (dataManager->GetConfig<bool>("audio", "idle_audio", true)) {
+    if (dataManager->Config().idle_audio) {
       if (glfwGetTime() - initial_audio_idle_time > 30.0f) {
         initial_audio_idle_time = glfwGetTime();
-        if (rand() % 100 >= 90) {
+        if (Random::Below(100) >= 90) {
           _au->Play3dSound(AudioType::IDLE);
         }
       }
@@ -559,13 +608,12 @@ void LAppDelegate::OnMouseCallBack(GLFWwindow *window, int button, int action,
       }
       }
       auto dm = DataManager::GetInstance();
-      auto prefix = "shortcut." + std::to_string(item_index);
       // handle setting item
-      int item_type = dm->GetWithDefault(prefix + ".type", 3);
+      int item_type = dm->Get(keys::ShortcutType[item_index]);
       switch (item_type) {
       case 0: {
         // open app
-        string param = dm->GetWithDefault(prefix + ".param", "");
+        string param = dm->Get(keys::ShortcutParam[item_index]);
         if (param.empty()) {
           break;
         }
@@ -575,7 +623,7 @@ void LAppDelegate::OnMouseCallBack(GLFWwindow *window, int button, int action,
       }
       case 1: {
         // open folder
-        string param = dm->GetWithDefault(prefix + ".param", "");
+        string param = dm->Get(keys::ShortcutParam[item_index]);
         if (param.empty()) {
           break;
         }
@@ -585,7 +633,7 @@ void LAppDelegate::OnMouseCallBack(GLFWwindow *window, int button, int action,
       }
       case 2: {
         // open link
-        string param = dm->GetWithDefault(prefix + ".param", "");
+        string param = dm->Get(keys::ShortcutParam[item_index]);
         if (param.empty()) {
           break;
         }
@@ -21,6 +21,7 @@
 #include "LAppPal.hpp"
 #include "LAppView.hpp"
 #include "PartStateManager.h"
+#include "Random.hpp"
 
 using namespace Csm;
 using namespace LAppDefine;
@@ -127,12 +128,11 @@ void LAppLive2DManager::OnTap(csmFloat32 x, csmFloat32 y) {
       return;
     }
     // no need to check other hitareas
-    if (!DataManager::GetInstance()->GetConfig<bool>("audio", "touch_audio",
-                                                    true)) {
+    if (!DataManager::GetInstance()->Config().touch_audio) {
       return;
     }
     // only 5% chance to trigger special audio
-    if (rand() % 100 < 95) {
+    if (Random::Below(100) < 95) {
       au->Play3dSound(AudioType::CLICK);
       return;
     }
@@ -23,6 +23,7 @@
 #include "LAppPal.hpp"
 #include "LAppTextureManager.hpp"
 #include "PartStateManager.h"
+#include "Random.hpp"
 #include "Type/CubismBasicType.hpp"
 
 using namespace Live2D::Cubism::Framework;
@@ -503,7 +504,7 @@ CubismMotionQueueEntryHandle LAppModel::StartRandomMotion(
     return InvalidMotionQueueEntryHandleValue;
   }
 
-  csmInt32 no = rand() % _modelSetting->GetMotionCount("All");
+  csmInt32 no = Random::Below(_modelSetting->GetMotionCount("All"));
 
   return StartMotion(no, priority, onFinishedMotionHandler);
 }
@@ -600,7 +601,7 @@ void LAppModel::SetRandomExpression() {
     return;
   }
 
-  csmInt32 no = rand() % _expressions.GetSize();
+  csmInt32 no = Random::Below(_expressions.GetSize());
   csmMap<csmString, ACubismMotion*>::const_iterator map_ite;
   csmInt32 i = 0;
   for (map_ite = _expressions.Begin(); map_ite != _expressions.End();
@@ -13,13 +13,22 @@
 #include <sys/stat.h>
 
 #include <Model/CubismMoc.hpp>
+#include <cmath>
 #include <cstdarg>
+#include <filesystem>
 #include <iostream>
 #include <codecvt>
 #include <locale>
+#ifdef _WIN32
 #include <windows.h>
 #include <commdlg.h>
 #include <ShlObj.h>
+#else
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 #include "LAppDefine.hpp"
 
@@ -33,7 +42,7 @@ double LAppPal::s_deltaTime = 0.0;
 std::wfstream LAppPal::s_logFile;
 
 void LAppPal::Init() {
-  LAppPal::s_logFile = std::wfstream(documentPath + L"\\jpet.log", std::ios::out | std::ios::app);
+  LAppPal::s_logFile = std::wfstream(std::filesystem::path(documentPath + L"/jpet.log"), std::ios::out | std::ios::app);
 }
 
 csmByte* LAppPal::LoadFileAsBytes(const string& filePath, csmSizeInt* outSize) {
@@ -82,7 +91,7 @@ void LAppPal::PrintLog(const csmChar* format, ...) {
   va_list args;
   csmChar buf[4096];
   va_start(args, format);
-  vsnprintf_s(buf, sizeof(buf), format, args);  // 標準出力でレンダリング
+  vsnprintf(buf, sizeof(buf), format, args);  // 標準出力でレンダリング
 #ifdef CSM_DEBUG_MEMORY_LEAKING
   // メモリリークチェック時は大量の標準出力がはしり重いのでprintfを利用する
   std::printf(buf);
@@ -106,7 +115,7 @@ void LAppPal::PrintLog(LogLevel level, const wchar_t* format, ...) {
   va_list args;
   wchar_t buf[4096];
   va_start(args, format);
-  vswprintf_s(buf, sizeof(buf) / sizeof(wchar_t), format, args);  // 標準出力でレンダリング
+  vswprintf(buf, sizeof(buf) / sizeof(wchar_t), format, args);  // 標準出力でレンダリング
   // add time info
   time_t now = time(nullptr);
   struct tm* pnow = localtime(&now);
@@ -129,7 +138,7 @@ void LAppPal::PrintLog(LogLevel level, const csmChar* format, ...) {
   va_list args;
   csmChar buf[4096];
   va_start(args, format);
-  vsnprintf_s(buf, sizeof(buf), format, args);  // 標準出力でレンダリング
+  vsnprintf(buf, sizeof(buf), format, args);  // 標準出力でレンダリング
 #ifdef CSM_DEBUG_MEMORY_LEAKING
   // メモリリークチェック時は大量の標準出力がはしり重いのでprintfを利用する
   std::printf(buf);
@@ -177,20 +186,10 @@ double LAppPal::EaseInOut(int x) {
   return 100 * (1 - 0.5 * pow(-0.03 * double(x) + 2.94, 3));
 }
 
-double LAppPal::EaseOut(int x) {
-  if (x <= 0) {
-    return 0;
-  }
-  if (x >= 100) {
-    return 100;
-  }
-  double p = double(x) / 100.0f;
-  return 100 * (1 - (1 - p)*(1 - p));
-}
-
 
 std::vector<std::wstring> LAppPal::ListFolder(const std::wstring& folder_path) {
     std::vector<std::wstring> ret;
+#ifdef _WIN32
     std::wstring searchPath = folder_path + L"\\*.mp3";
     WIN32_FIND_DATAW findData;
     HANDLE hFind = FindFirstFileW(searchPath.c_str(), &findData);
@@ -206,10 +205,73 @@ std::vector<std::wstring> LAppPal::ListFolder(const std::wstring& folder_path) {
     } else {
         std::wcout << L"Failed to read directory." << std::endl;
     }
+#else
+    std::error_code ec;
+    for (const auto& entry :
+         std::filesystem::directory_iterator(folder_path, ec)) {
+      if (entry.is_regular_file() && entry.path().extension() == ".mp3") {
+        ret.push_back(entry.path().filename().wstring());
+      }
+    }
+#endif
   return ret;
 }
 
+bool LAppPal::WriteFileAtomic(const std::wstring& path,
+                              std::string_view content) {
+  std::wstring tmpPath = path + L".tmp";
+#ifdef _WIN32
+  HANDLE file = CreateFileW(tmpPath.c_str(), GENERIC_WRITE, 0, nullptr,
+                            CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (file == INVALID_HANDLE_VALUE) {
+    PrintLog(LogLevel::Error, L"[LAppPal]Failed to create %ls: %lu",
+             tmpPath.c_str(), GetLastError());
+    return false;
+  }
+  DWORD written = 0;
+  bool ok = WriteFile(file, content.data(), static_cast<DWORD>(content.size()),
+                      &written, nullptr) &&
+            written == content.size() && FlushFileBuffers(file);
+  CloseHandle(file);
+  if (!ok || !MoveFileExW(tmpPath.c_str(), path.c_str(),
+                          MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH)) {
+    PrintLog(LogLevel::Error, L"[LAppPal]Failed to write %ls: %lu",
+             path.c_str(), GetLastError());
+    DeleteFileW(tmpPath.c_str());
+    return false;
+  }
+  return true;
+#else
+  const std::string file = std::filesystem::path(path).string();
+  const std::string tmpFile = std::filesystem::path(tmpPath).string();
+  int fd = open(tmpFile.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    PrintLog(LogLevel::Error, "[LAppPal]Failed to create %s: %s",
+             tmpFile.c_str(), strerror(errno));
+    return false;
+  }
+  size_t written = 0;
+  while (written < content.size()) {
+    ssize_t n = write(fd, content.data() + written, content.size() - written);
+    if (n <= 0) {
+      break;
+    }
+    written += n;
+  }
+  bool ok = written == content.size() && fsync(fd) == 0;
+  close(fd);
+  if (!ok || rename(tmpFile.c_str(), file.c_str()) != 0) {
+    PrintLog(LogLevel::Error, "[LAppPal]Failed to write %s: %s", file.c_str(),
+             strerror(errno));
+    unlink(tmpFile.c_str());
+    return false;
+  }
+  return true;
+#endif
+}
+
 bool LAppPal::BrowseFile(wstring &path) {
+#ifdef _WIN32
   OPENFILENAME ofn; // 公共对话框结构体
   wchar_t szFile[MAX_PATH]; // 缓冲区存放文件名
 
@@ -232,11 +294,13 @@ bool LAppPal::BrowseFile(wstring &path) {
     path = ofn.lpstrFile;
     return true;
   }
+#endif
   return false;
 }
 
 bool LAppPal::BrowseFolder(wstring &path) {
     bool ret = false;
+#ifdef _WIN32
     BROWSEINFO bi;
     ZeroMemory(&bi, sizeof(bi));
     bi.lpszTitle = L"请选择一个文件夹";
@@ -258,5 +322,6 @@ bool LAppPal::BrowseFolder(wstring &path) {
             imalloc->Release();
         }
     }
+#endif
     return ret;
 }
@@ -12,6 +12,7 @@
 #include <fstream>
 #include <vector>
 #include <string>
+#include <string_view>
 
 enum class LogLevel { Debug, Info, Warn, Error };
 
@@ -107,6 +108,14 @@ class LAppPal {
 
   static std::vector<std::wstring> ListFolder(const std::wstring& folder_path);
 
+  /**
+   * @brief Replace a file's content atomically.
+   * Writes to a side file, flushes it to disk, then renames it over path, so
+   * a crash leaves either the old or the new content.
+   */
+  static bool WriteFileAtomic(const std::wstring& path,
+                              std::string_view content);
+
   /**
    * @brief ease function
    * @param x [0,100]
@@ -114,8 +123,6 @@ class LAppPal {
    */
   static double EaseInOut(int x);
 
-  static double EaseOut(int x);
-
   static bool BrowseFile(std::wstring &path);
   static bool BrowseFolder(std::wstring &path);
 
@@ -0,0 +1,149 @@
+#include "LiveStatus.hpp"
+
+#include "BiliResponse.hpp"
+#include "Wbi.hpp"
+#include "WbiSigner.hpp"
+
+std::optional<std::map<std::string, LiveInfo>> BatchLiveBackend::Fetch(
+    const std::vector<std::string>& uids, const httplib::Headers& headers,
+    int& code) {
+  code = 0;
+  std::string path = "/room/v1/Room/get_status_info_by_uids?";
+  for (const auto& uid : uids) {
+    path += "uids%5B%5D=" + Wbi::Url_encode(uid) + "&";
+  }
+  path.pop_back();
+  auto res = HttpPool::GetInstance()->Get(_host, path, headers, _options);
+  if (!res || res->status != 200) {
+    return std::nullopt;
+  }
+  auto batch = bili::ParseRoomBatch(res->body);
+  if (!batch) {
+    return std::nullopt;
+  }
+  if (batch->code != 0) {
+    code = batch->code;
+    return std::nullopt;
+  }
+  std::map<std::string, LiveInfo> result;
+  for (auto& [uid, room] : batch->rooms) {
+    LiveInfo& info = result[uid];
+    info.live = room.live;
+    info.title = std::move(room.title);
+    info.roomid = std::move(room.room_id);
+  }
+  return result;
+}
+
+std::optional<std::map<std::string, LiveInfo>> RoomInfoLiveBackend::Fetch(
+    const std::vector<std::string>& uids, const httplib::Headers& headers,
+    int& code) {
+  code = 0;
+  std::map<std::string, LiveInfo> result;
+  bool fetched = false;
+  for (const auto& uid : uids) {
+    std::string request_path = "/room/v1/Room/getRoomInfoOld?";
+    if (_sign) {
+      request_path += WbiSigner::GetInstance()->Sign({{"mid", uid}});
+    } else {
+      request_path += "mid=" + Wbi::Url_encode(uid);
+    }
+    auto res = HttpPool::GetInstance()->Get(_host, request_path, headers,
+                                            _options);
+    if (!res || res->status != 200) {
+      continue;
+    }
+    auto room = bili::ParseRoom(res->body);
+    if (room && room->code == -352) {
+      code = room->code;
+      return std::nullopt;
+    }
+    if (!room || room->code != 0) {
+      // the others may still parse
+      continue;
+    }
+    fetched = true;
+    if (!room->has_room) {
+      continue;
+    }
+    LiveInfo& info = result[uid];
+    info.live = room->live;
+    info.title = std::move(room->title);
+    info.roomid = std::move(room->room_id);
+  }
+  if (!fetched) {
+    return std::nullopt;
+  }
+  return result;
+}
+
+bool LiveStatusProvider::batchUsable(time_t now) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _batch && now >= _batch_failed_at + kBatchRetry;
+}
+
+uint64_t LiveStatusProvider::BatchFailures() {
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _batch_failures;
+}
+
+size_t LiveStatusProvider::Requests(size_t count) {
+  size_t size = batchUsable(time(nullptr)) ? _batch->BatchSize()
+                                           : _fallback->BatchSize();
+  return (count + size - 1) / size;
+}
+
+std::optional<std::map<std::string, LiveInfo>> LiveStatusProvider::Fetch(
+    const std::vector<std::string>& uids, const httplib::Headers& headers,
+    LiveFetch& fetch) {
+  fetch = {};
+  std::map<std::string, LiveInfo> result;
+  bool fetched = false;
+  int code = 0;
+  auto fallback = [&](auto begin, auto end) {
+    size_t size = _fallback->BatchSize();
+    for (auto it = begin; it != end;) {
+      auto next = end - it > static_cast<ptrdiff_t>(size) ? it + size : end;
+      auto part = _fallback->Fetch({it, next}, headers, code);
+      fetch.requests++;
+      if (part) {
+        fetched = true;
+        result.insert(part->begin(), part->end());
+      } else if (code == -352) {
+        fetch.code = code;
+        return;
+      }
+      it = next;
+    }
+  };
+  if (!batchUsable(time(nullptr))) {
+    fallback(uids.begin(), uids.end());
+    return fetched ? std::optional(result) : std::nullopt;
+  }
+  size_t size = _batch->BatchSize();
+  for (auto it = uids.begin(); it != uids.end();) {
+    auto next = uids.end() - it > static_cast<ptrdiff_t>(size) ? it + size
+                                                               : uids.end();
+    auto part = _batch->Fetch({it, next}, headers, code);
+    fetch.requests++;
+    if (part) {
+      fetched = true;
+      result.insert(part->begin(), part->end());
+    } else if (code == -352) {
+      // restricted, the fallback would only spend more requests on it
+      fetch.code = code;
+      break;
+    } else {
+      {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _batch_failed_at = time(nullptr);
+        _batch_failures++;
+      }
+      // the rest too, the batch rests for kBatchRetry
+      fallback(it, uids.end());
+      break;
+    }
+    it = next;
+  }
+  return fetched ? std::optional(result) : std::nullopt;
+}
@@ -0,0 +1,132 @@
+#pragma once
+
+#include <cstdint>
+#include <ctime>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <httplib.h>
+
+#include "HttpPool.hpp"
+
+struct LiveInfo {
+  bool live = false;
+  std::string title;
+  std::string roomid;
+};
+
+/**
+ * @brief Where live status comes from. Fetch() asks for at most
+ * BatchSize() uids and returns what it learned about them, uids without a
+ * live room may be missing. nullopt if the request failed as a whole, code
+ * is then what the API answered, e.g. -352, or 0 if it did not answer.
+ */
+class LiveStatusBackend {
+ public:
+  virtual ~LiveStatusBackend() = default;
+
+  virtual size_t BatchSize() const = 0;
+
+  virtual std::optional<std::map<std::string, LiveInfo>> Fetch(
+      const std::vector<std::string>& uids, const httplib::Headers& headers,
+      int& code) = 0;
+};
+
+/**
+ * @brief Room/get_status_info_by_uids, many uids per request.
+ */
+class BatchLiveBackend : public LiveStatusBackend {
+ public:
+  static constexpr size_t kBatchSize = 50;
+
+  explicit BatchLiveBackend(std::string host = "api.live.bilibili.com",
+                            HttpOptions options = {})
+      : _host(std::move(host)), _options(options) {}
+
+  size_t BatchSize() const override { return kBatchSize; }
+
+  std::optional<std::map<std::string, LiveInfo>> Fetch(
+      const std::vector<std::string>& uids, const httplib::Headers& headers,
+      int& code) override;
+
+ private:
+  std::string _host;
+  HttpOptions _options;
+};
+
+/**
+ * @brief Room/getRoomInfoOld, one signed request per uid.
+ */
+class RoomInfoLiveBackend : public LiveStatusBackend {
+ public:
+  // sign with WbiSigner, off where no keys can be fetched
+  explicit RoomInfoLiveBackend(bool sign = true,
+                               std::string host = "api.live.bilibili.com",
+                               HttpOptions options = {})
+      : _sign(sign), _host(std::move(host)), _options(options) {}
+
+  size_t BatchSize() const override { return 1; }
+
+  // stops at the first -352, the rest would be refused too
+  std::optional<std::map<std::string, LiveInfo>> Fetch(
+      const std::vector<std::string>& uids, const httplib::Headers& headers,
+      int& code) override;
+
+ private:
+  bool _sign;
+  std::string _host;
+  HttpOptions _options;
+};
+
+struct LiveFetch {
+  // -352 if the API restricted us, nothing more was asked
+  int code = 0;
+  // requests made, more than Requests() said when a batch fell back
+  size_t requests = 0;
+};
+
+/**
+ * @brief Live status of the whole follow list in ⌈N / batch⌉ requests.
+ * A batch that fails is asked again uid by uid from the fallback, and the
+ * batch backend rests for kBatchRetry before it is tried again. A -352 is
+ * not the batch's fault, the fallback would be refused alike, so it ends
+ * the Fetch() instead.
+ */
+class LiveStatusProvider {
+ public:
+  static constexpr time_t kBatchRetry = 10 * 60;
+
+  LiveStatusProvider(std::unique_ptr<LiveStatusBackend> batch,
+                     std::unique_ptr<LiveStatusBackend> fallback)
+      : _batch(std::move(batch)), _fallback(std::move(fallback)) {}
+
+  /**
+   * @brief nullopt if no request succeeded.
+   */
+  std::optional<std::map<std::string, LiveInfo>> Fetch(
+      const std::vector<std::string>& uids, const httplib::Headers& headers,
+      LiveFetch& fetch);
+
+  /**
+   * @brief Requests the next Fetch() of count uids takes, if all goes well.
+   */
+  size_t Requests(size_t count);
+
+  /**
+   * @brief Batches that failed and were asked uid by uid.
+   */
+  uint64_t BatchFailures();
+
+ private:
+  std::unique_ptr<LiveStatusBackend> _batch;
+  std::unique_ptr<LiveStatusBackend> _fallback;
+  std::mutex _mutex;
+  time_t _batch_failed_at = 0;
+  uint64_t _batch_failures = 0;
+
+  bool batchUsable(time_t now);
+};
@@ -0,0 +1,618 @@
+#include "LogStore.hpp"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#include <chrono>
+#include <cryptopp/crc.h>
+#include <cstring>
+#include <filesystem>
+
+#include "LAppPal.hpp"
+
+namespace {
+const wchar_t* kFileName = L"/GameData.log";
+const wchar_t* kCompactSuffix = L".compact";
+constexpr char kMagic[8] = {'J', 'P', 'E', 'T', 'L', 'O', 'G', '1'};
+constexpr uint64_t kMinCapacity = 64 << 10;
+// below this much dead data a rewrite is not worth it
+constexpr uint64_t kCompactThreshold = 64 << 10;
+
+enum RecordType : uint8_t {
+  kBatch = 1,
+  kClear = 2,
+};
+
+// a record is this header and size bytes of payload. a batch payload is a
+// run of entries: u32 key size, u32 value size, key, value
+#pragma pack(push, 1)
+struct RecordHeader {
+  // crc32 of everything after this field, payload included
+  uint32_t crc;
+  uint32_t size;
+  uint8_t type;
+};
+#pragma pack(pop)
+
+uint32_t Checksum(const char* data, size_t size) {
+  CryptoPP::CRC32 crc;
+  crc.Update(reinterpret_cast<const CryptoPP::byte*>(data), size);
+  uint32_t value = 0;
+  crc.Final(reinterpret_cast<CryptoPP::byte*>(&value));
+  return value;
+}
+
+uint32_t ReadU32(const char* data) {
+  uint32_t value;
+  memcpy(&value, data, sizeof(value));
+  return value;
+}
+
+void AppendU32(std::string& out, uint32_t value) {
+  out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+std::string EncodeRecord(RecordType type,
+                         const std::vector<GameStore::Entry>& puts) {
+  std::string record(sizeof(RecordHeader), '\0');
+  for (const auto& [key, value] : puts) {
+    AppendU32(record, static_cast<uint32_t>(key.size()));
+    AppendU32(record, static_cast<uint32_t>(value.size()));
+    record.append(key);
+    record.append(value);
+  }
+  RecordHeader header{0, static_cast<uint32_t>(record.size() - sizeof(header)),
+                      type};
+  memcpy(record.data(), &header, sizeof(header));
+  header.crc = Checksum(record.data() + sizeof(uint32_t),
+                        record.size() - sizeof(uint32_t));
+  memcpy(record.data(), &header.crc, sizeof(header.crc));
+  return record;
+}
+
+uint64_t RoundCapacity(uint64_t size) {
+  uint64_t capacity = kMinCapacity;
+  while (capacity < size) {
+    capacity *= 2;
+  }
+  return capacity;
+}
+
+#ifdef _WIN32
+using File = HANDLE;
+constexpr File kNoFile = nullptr;
+
+unsigned long LastError() { return GetLastError(); }
+
+// the log is shared for reading, the compaction output is not shared
+File OpenStoreFile(const std::wstring& path, bool create) {
+  HANDLE file = CreateFileW(path.c_str(), GENERIC_READ | GENERIC_WRITE,
+                            create ? 0 : FILE_SHARE_READ, nullptr,
+                            create ? CREATE_ALWAYS : OPEN_ALWAYS,
+                            FILE_ATTRIBUTE_NORMAL, nullptr);
+  return file == INVALID_HANDLE_VALUE ? kNoFile : file;
+}
+
+void CloseFile(File file) { CloseHandle(file); }
+
+bool FileSize(File file, uint64_t* size) {
+  LARGE_INTEGER value;
+  if (!GetFileSizeEx(file, &value)) {
+    return false;
+  }
+  *size = value.QuadPart;
+  return true;
+}
+
+bool Truncate(File file, uint64_t size) {
+  LARGE_INTEGER end;
+  end.QuadPart = size;
+  return SetFilePointerEx(file, end, nullptr, FILE_BEGIN) &&
+         SetEndOfFile(file);
+}
+
+bool WriteAll(File file, const char* bytes, uint64_t size) {
+  DWORD written = 0;
+  return WriteFile(file, bytes, static_cast<DWORD>(size), &written, nullptr) &&
+         written == size;
+}
+
+bool SyncFile(File file) { return FlushFileBuffers(file); }
+
+bool RenameOver(const std::wstring& from, const std::wstring& to) {
+  return MoveFileExW(from.c_str(), to.c_str(),
+                     MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH);
+}
+#else
+using File = int;
+constexpr File kNoFile = -1;
+
+unsigned long LastError() { return errno; }
+
+File OpenStoreFile(const std::wstring& path, bool create) {
+  int flags = O_RDWR | O_CREAT | O_CLOEXEC | (create ? O_TRUNC : 0);
+  return open(std::filesystem::path(path).c_str(), flags, 0644);
+}
+
+void CloseFile(File file) { close(file); }
+
+bool FileSize(File file, uint64_t* size) {
+  struct stat st {};
+  if (fstat(file, &st) != 0) {
+    return false;
+  }
+  *size = st.st_size;
+  return true;
+}
+
+bool Truncate(File file, uint64_t size) {
+  return ftruncate(file, static_cast<off_t>(size)) == 0;
+}
+
+bool WriteAll(File file, const char* bytes, uint64_t size) {
+  while (size > 0) {
+    ssize_t written = write(file, bytes, size);
+    if (written <= 0) {
+      return false;
+    }
+    bytes += written;
+    size -= written;
+  }
+  return true;
+}
+
+bool SyncFile(File file) { return fsync(file) == 0; }
+
+// rename() replaces atomically, syncing the directory makes it last
+bool RenameOver(const std::wstring& from, const std::wstring& to) {
+  std::filesystem::path target(to);
+  if (rename(std::filesystem::path(from).c_str(), target.c_str()) != 0) {
+    return false;
+  }
+  int dir = open(target.parent_path().c_str(), O_RDONLY | O_CLOEXEC);
+  if (dir >= 0) {
+    fsync(dir);
+    close(dir);
+  }
+  return true;
+}
+#endif
+}  // namespace
+
+bool LogStore::Exists(const std::wstring& dir) const {
+  return std::filesystem::exists(std::filesystem::path(dir + kFileName));
+}
+
+void LogStore::Remove(const std::wstring& dir) const {
+  std::filesystem::remove(std::filesystem::path(dir + kFileName));
+  std::filesystem::remove(std::filesystem::path(dir + kFileName + kCompactSuffix));
+}
+
+bool LogStore::Open(const std::wstring& dir) {
+  path_ = dir + kFileName;
+  // a compaction that died before its rename leaves the output behind
+  std::filesystem::remove(std::filesystem::path(path_ + kCompactSuffix));
+  auto begin = std::chrono::steady_clock::now();
+  size_t count = 0;
+  {
+    std::unique_lock<std::shared_mutex> lock(mtx_);
+    if (!openFile()) {
+      return false;
+    }
+    count = index_.size();
+  }
+  stopping_ = false;
+  compactor_ = std::thread(&LogStore::doCompact, this);
+  LAppPal::PrintLog(
+      LogLevel::Debug, "[LogStore]Opened %d keys in %lldms",
+      static_cast<int>(count),
+      static_cast<long long>(
+          std::chrono::duration_cast<std::chrono::milliseconds>(
+              std::chrono::steady_clock::now() - begin)
+              .count()));
+  return true;
+}
+
+void LogStore::Close() {
+  if (compactor_.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock(compactMtx_);
+      stopping_ = true;
+    }
+    compactCv_.notify_one();
+    compactor_.join();
+  }
+  std::unique_lock<std::shared_mutex> lock(mtx_);
+  if (file_ == kNoFile) {
+    return;
+  }
+  flush();
+  closeFile(true);
+  index_.clear();
+  liveBytes_ = 0;
+}
+
+bool LogStore::openFile() {
+  File file = OpenStoreFile(path_, false);
+  if (file == kNoFile) {
+    LAppPal::PrintLog(LogLevel::Error, "[LogStore]Failed to open log: %lu",
+                      LastError());
+    return false;
+  }
+  file_ = file;
+  uint64_t size = 0;
+  if (!FileSize(file, &size) || !map(RoundCapacity(size)) || !replay(size)) {
+    closeFile(false);
+    return false;
+  }
+  return true;
+}
+
+void LogStore::closeFile(bool truncate) {
+  unmap();
+  if (file_ == kNoFile) {
+    return;
+  }
+  // the mapping grows the file to its capacity, give the slack back
+  if (truncate) {
+    Truncate(file_, tail_);
+  }
+  CloseFile(file_);
+  file_ = kNoFile;
+}
+
+bool LogStore::map(uint64_t capacity) {
+#ifdef _WIN32
+  LARGE_INTEGER size;
+  size.QuadPart = capacity;
+  mapping_ = CreateFileMappingW(file_, nullptr, PAGE_READWRITE, size.HighPart,
+                                size.LowPart, nullptr);
+  if (mapping_ == nullptr) {
+    LAppPal::PrintLog(LogLevel::Error, "[LogStore]Failed to map log: %lu",
+                      GetLastError());
+    return false;
+  }
+  base_ = static_cast<char*>(MapViewOfFile(mapping_, FILE_MAP_ALL_ACCESS, 0, 0, 0));
+  if (base_ == nullptr) {
+    LAppPal::PrintLog(LogLevel::Error, "[LogStore]Failed to map view: %lu",
+                      GetLastError());
+    CloseHandle(mapping_);
+    mapping_ = nullptr;
+    return false;
+  }
+#else
+  // a mapping past the end of the file faults, grow the file first
+  uint64_t size = 0;
+  if (!FileSize(file_, &size) ||
+      (size < capacity && !Truncate(file_, capacity))) {
+    LAppPal::PrintLog(LogLevel::Error, "[LogStore]Failed to grow log: %lu",
+                      LastError());
+    return false;
+  }
+  void* base = mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_SHARED,
+                    file_, 0);
+  if (base == MAP_FAILED) {
+    LAppPal::PrintLog(LogLevel::Error, "[LogStore]Failed to map log: %lu",
+                      LastError());
+    return false;
+  }
+  base_ = static_cast<char*>(base);
+#endif
+  capacity_ = capacity;
+  return true;
+}
+
+void LogStore::unmap() {
+#ifdef _WIN32
+  if (base_ != nullptr) {
+    UnmapViewOfFile(base_);
+    base_ = nullptr;
+  }
+  if (mapping_ != nullptr) {
+    CloseHandle(mapping_);
+    mapping_ = nullptr;
+  }
+#else
+  if (base_ != nullptr) {
+    munmap(base_, capacity_);
+    base_ = nullptr;
+  }
+#endif
+  capacity_ = 0;
+}
+
+bool LogStore::reserve(uint64_t size) {
+  if (size <= capacity_) {
+    return true;
+  }
+  // unsynced pages stay dirty in the file cache, flush() still covers them
+  unmap();
+  return map(RoundCapacity(size));
+}
+
+bool LogStore::replay(uint64_t size) {
+  index_.clear();
+  liveBytes_ = 0;
+  if (size < sizeof(kMagic)) {
+    memcpy(base_, kMagic, sizeof(kMagic));
+    tail_ = sizeof(kMagic);
+    synced_ = 0;
+    return flush();
+  }
+  if (memcmp(base_, kMagic, sizeof(kMagic)) != 0) {
+    LAppPal::PrintLog(LogLevel::Error, "[LogStore]Not a game data log");
+    return false;
+  }
+  uint64_t pos = sizeof(kMagic);
+  while (pos + sizeof(RecordHeader) <= size) {
+    RecordHeader header;
+    memcpy(&header, base_ + pos, sizeof(header));
+    if (header.type != kBatch && header.type != kClear) {
+      break;
+    }
+    uint64_t end = pos + sizeof(header) + header.size;
+    if (end > size) {
+      break;
+    }
+    if (Checksum(base_ + pos + sizeof(uint32_t), end - pos - sizeof(uint32_t)) !=
+        header.crc) {
+      break;
+    }
+    if (!apply(header.type, pos + sizeof(header), header.size)) {
+      break;
+    }
+    pos = end;
+  }
+  if (pos < size) {
+    // mapping slack or a torn write left by a crash, either way nothing
+    // past the tail may be replayed once new records land in front of it
+    LAppPal::PrintLog(LogLevel::Debug, "[LogStore]Discarded %llu bytes past tail",
+                      static_cast<unsigned long long>(size - pos));
+    memset(base_ + pos, 0, size - pos);
+  }
+  tail_ = pos;
+  synced_ = pos;
+  return true;
+}
+
+bool LogStore::apply(uint8_t type, uint64_t offset, uint32_t size) {
+  if (type == kClear) {
+    index_.clear();
+    liveBytes_ = 0;
+    return true;
+  }
+  uint64_t pos = offset;
+  uint64_t end = offset + size;
+  while (pos < end) {
+    if (end - pos < 2 * sizeof(uint32_t)) {
+      return false;
+    }
+    uint32_t keySize = ReadU32(base_ + pos);
+    uint32_t valueSize = ReadU32(base_ + pos + sizeof(uint32_t));
+    uint64_t entrySize = 2 * sizeof(uint32_t) + uint64_t(keySize) + valueSize;
+    if (end - pos < entrySize) {
+      return false;
+    }
+    const char* key = base_ + pos + 2 * sizeof(uint32_t);
+    Slot slot{pos + 2 * sizeof(uint32_t) + keySize, valueSize};
+    auto [it, inserted] = index_.try_emplace(std::string(key, keySize), slot);
+    if (!inserted) {
+      liveBytes_ -= 2 * sizeof(uint32_t) + it->first.size() + it->second.size;
+      it->second = slot;
+    }
+    liveBytes_ += entrySize;
+    pos += entrySize;
+  }
+  return true;
+}
+
+uint64_t LogStore::append(const std::string& record) {
+  if (!reserve(tail_ + record.size())) {
+    return 0;
+  }
+  uint64_t at = tail_;
+  memcpy(base_ + at, record.data(), record.size());
+  tail_ += record.size();
+  return at;
+}
+
+bool LogStore::flush() {
+  if (synced_ >= tail_) {
+    return true;
+  }
+#ifdef _WIN32
+  bool ok = FlushViewOfFile(base_ + synced_, tail_ - synced_);
+#else
+  // msync() wants a page aligned start
+  uint64_t page = static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+  uint64_t from = synced_ / page * page;
+  bool ok = msync(base_ + from, tail_ - from, MS_SYNC) == 0;
+#endif
+  if (!ok || !SyncFile(file_)) {
+    LAppPal::PrintLog(LogLevel::Error, "[LogStore]Flush failed: %lu",
+                      LastError());
+    return false;
+  }
+  synced_ = tail_;
+  return true;
+}
+
+bool LogStore::shouldCompact() const {
+  uint64_t dead = tail_ - sizeof(kMagic) - liveBytes_;
+  return dead > kCompactThreshold && dead > liveBytes_;
+}
+
+void LogStore::requestCompact() {
+  {
+    std::lock_guard<std::mutex> lock(compactMtx_);
+    compactPending_ = true;
+  }
+  compactCv_.notify_one();
+}
+
+void LogStore::doCompact() {
+  std::unique_lock<std::mutex> lock(compactMtx_);
+  while (true) {
+    compactCv_.wait(lock, [this] { return compactPending_ || stopping_; });
+    if (stopping_) {
+      return;
+    }
+    compactPending_ = false;
+    lock.unlock();
+    compact();
+    lock.lock();
+  }
+}
+
+/**
+ * Write live entries to a side file, then swap it in with an atomic rename.
+ * The image is built under the shared lock, so reads go on and writes wait
+ * only for the copy. Writes that land while the side file is written are
+ * appended to it as they are under the exclusive lock, just before the
+ * swap. A crash before the rename keeps the old log, the side file is
+ * dropped on the next open.
+ */
+void LogStore::compact() {
+  std::string data(kMagic, sizeof(kMagic));
+  uint64_t mark = 0;
+  {
+    std::shared_lock<std::shared_mutex> lock(mtx_);
+    if (base_ == nullptr || !shouldCompact()) {
+      return;
+    }
+    std::vector<Entry> live;
+    live.reserve(index_.size());
+    for (const auto& [key, slot] : index_) {
+      live.emplace_back(key, std::string_view(base_ + slot.offset, slot.size));
+    }
+    data += EncodeRecord(kBatch, live);
+    mark = tail_;
+  }
+
+  std::wstring tmpPath = path_ + kCompactSuffix;
+  File out = OpenStoreFile(tmpPath, true);
+  if (out == kNoFile) {
+    LAppPal::PrintLog(LogLevel::Error, "[LogStore]Compaction failed: %lu",
+                      LastError());
+    return;
+  }
+  auto writeOut = [out](const char* bytes, uint64_t size) {
+    return WriteAll(out, bytes, size) && SyncFile(out);
+  };
+  if (!writeOut(data.data(), data.size())) {
+    LAppPal::PrintLog(LogLevel::Error, "[LogStore]Compaction failed: %lu",
+                      LastError());
+    CloseFile(out);
+    std::filesystem::remove(std::filesystem::path(tmpPath));
+    return;
+  }
+
+  std::unique_lock<std::shared_mutex> lock(mtx_);
+  uint64_t before = tail_;
+  // records are self-contained, the ones written since the copy replay on
+  // top of it in the same order
+  bool ok = base_ != nullptr &&
+            (tail_ == mark || writeOut(base_ + mark, tail_ - mark));
+  CloseFile(out);
+  if (!ok) {
+    LAppPal::PrintLog(LogLevel::Error, "[LogStore]Compaction failed: %lu",
+                      LastError());
+    std::filesystem::remove(std::filesystem::path(tmpPath));
+    return;
+  }
+  flush();
+  closeFile(true);
+  if (!RenameOver(tmpPath, path_)) {
+    LAppPal::PrintLog(LogLevel::Error, "[LogStore]Compaction rename failed: %lu",
+                      LastError());
+    std::filesystem::remove(std::filesystem::path(tmpPath));
+  }
+  if (!openFile()) {
+    LAppPal::PrintLog(LogLevel::Error, "[LogStore]Reopen after compaction failed");
+    return;
+  }
+  compactions_++;
+  LAppPal::PrintLog(LogLevel::Debug, "[LogStore]Compacted %lluKB -> %lluKB",
+                    static_cast<unsigned long long>(before >> 10),
+                    static_cast<unsigned long long>(tail_ >> 10));
+}
+
+bool LogStore::Get(std::string_view key, std::string& value) {
+  std::shared_lock<std::shared_mutex> lock(mtx_);
+  auto it = index_.find(key);
+  if (base_ == nullptr || it == index_.end()) {
+    return false;
+  }
+  value.assign(base_ + it->second.offset, it->second.size);
+  return true;
+}
+
+bool LogStore::Scan(std::string_view prefix, const Visitor& visit) {
+  std::shared_lock<std::shared_mutex> lock(mtx_);
+  if (base_ == nullptr) {
+    return false;
+  }
+  for (auto it = index_.lower_bound(prefix); it != index_.end(); ++it) {
+    std::string_view key = it->first;
+    if (key.substr(0, prefix.size()) != prefix) {
+      break;
+    }
+    visit(key, std::string_view(base_ + it->second.offset, it->second.size));
+  }
+  return true;
+}
+
+bool LogStore::Write(const std::vector<Entry>& puts, bool sync) {
+  std::string record = EncodeRecord(kBatch, puts);
+  bool compact = false;
+  bool ok = false;
+  {
+    std::unique_lock<std::shared_mutex> lock(mtx_);
+    if (base_ == nullptr) {
+      return false;
+    }
+    uint64_t at = append(record);
+    if (at == 0) {
+      return false;
+    }
+    apply(kBatch, at + sizeof(RecordHeader),
+          static_cast<uint32_t>(record.size() - sizeof(RecordHeader)));
+    ok = !sync || flush();
+    compact = shouldCompact();
+  }
+  if (compact) {
+    requestCompact();
+  }
+  return ok;
+}
+
+bool LogStore::Clear(bool sync) {
+  std::string record = EncodeRecord(kClear, {});
+  std::unique_lock<std::shared_mutex> lock(mtx_);
+  if (base_ == nullptr || append(record) == 0) {
+    return false;
+  }
+  apply(kClear, 0, 0);
+  return !sync || flush();
+}
+
+bool LogStore::Sync() {
+  std::unique_lock<std::shared_mutex> lock(mtx_);
+  return base_ == nullptr || flush();
+}
+
+void LogStore::LogStats() {
+  std::shared_lock<std::shared_mutex> lock(mtx_);
+  LAppPal::PrintLog(LogLevel::Debug,
+                    "[LogStore]%d keys, log %lluKB, live %lluKB, %llu compactions",
+                    static_cast<int>(index_.size()),
+                    static_cast<unsigned long long>(tail_ >> 10),
+                    static_cast<unsigned long long>(liveBytes_ >> 10),
+                    static_cast<unsigned long long>(compactions_));
+}
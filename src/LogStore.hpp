@@ -0,0 +1,87 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+
+#include "GameStore.hpp"
+
+/**
+ * @brief  GameStore on a single memory-mapped append-only log.
+ * Every Write() appends one checksummed batch record, an in-memory index
+ * maps each key to its latest value in the mapping. Open replays the log
+ * and stops at the first torn or corrupt record, so a crash loses at most
+ * the unsynced tail. Once dead records outweigh live data a background
+ * thread rewrites the log with live entries only.
+ */
+class LogStore : public GameStore {
+ private:
+  struct Slot {
+    uint64_t offset;
+    uint32_t size;
+  };
+
+  std::wstring path_;
+#ifdef _WIN32
+  void* file_ = nullptr;
+  void* mapping_ = nullptr;
+#else
+  int file_ = -1;
+#endif
+  char* base_ = nullptr;
+  uint64_t capacity_ = 0;
+  uint64_t tail_ = 0;
+  uint64_t synced_ = 0;
+  uint64_t liveBytes_ = 0;
+  std::map<std::string, Slot, std::less<>> index_;
+  std::shared_mutex mtx_;
+
+  std::thread compactor_;
+  std::mutex compactMtx_;
+  std::condition_variable compactCv_;
+  bool compactPending_ = false;
+  bool stopping_ = false;
+  uint64_t compactions_ = 0;
+
+  bool openFile();
+  void closeFile(bool truncate);
+  bool map(uint64_t capacity);
+  void unmap();
+  bool reserve(uint64_t size);
+  bool replay(uint64_t size);
+  bool apply(uint8_t type, uint64_t offset, uint32_t size);
+  uint64_t append(const std::string& record);
+  bool flush();
+  void compact();
+  void doCompact();
+  void requestCompact();
+  bool shouldCompact() const;
+
+ public:
+  ~LogStore() override { Close(); }
+
+  const char* Name() const override { return "log"; }
+
+  bool Exists(const std::wstring& dir) const override;
+
+  void Remove(const std::wstring& dir) const override;
+
+  bool Open(const std::wstring& dir) override;
+
+  void Close() override;
+
+  bool Get(std::string_view key, std::string& value) override;
+
+  bool Scan(std::string_view prefix, const Visitor& visit) override;
+
+  bool Write(const std::vector<Entry>& puts, bool sync) override;
+
+  bool Clear(bool sync) override;
+
+  bool Sync() override;
+
+  void LogStats() override;
+};
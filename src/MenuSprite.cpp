@@ -186,8 +186,8 @@ void MenuSprite::renderItems() {
   updateScale(0.15f);
   glUniformMatrix2fv(scaleLoc, 1, GL_FALSE, scaleMatrix);
   glUniformMatrix2fv(texRotLoc, 1, GL_FALSE, dRotateMatrix);
-  for (size_t i = 0; i < 4; i++) {
-    int icon_t = dm->GetWithDefault("shortcut." + std::to_string(i)+".type", 3);
+  for (size_t i = 0; i < keys::kShortcutCount; i++) {
+    int icon_t = dm->Get(keys::ShortcutType[i]);
     // 4 is not enabled
     if (icon_t == 4) {
       continue;
@@ -1,194 +1,274 @@
 #include "PanelServer.hpp"
+#include "BiliResponse.hpp"
 #include "BuffManager.hpp"
+#include "CookieStore.hpp"
 #include "DataManager.hpp"
 #include "GameTask.hpp"
+#include "HttpPool.hpp"
 #include "LAppDefine.hpp"
 #include "LAppPal.hpp"
 #include "PartStateManager.h"
 #include "LAppDelegate.hpp"
-#include "Wbi.hpp"
+#include "WbiSigner.hpp"
 
+#include <algorithm>
 #include <shellapi.h>
 #include <winuser.h>
 
+namespace {
+// changes this close together go out as one delta
+constexpr std::chrono::milliseconds kRefreshWindow{200};
+}  // namespace
+
 void PanelServer::Start() {
   // start thread
   worker_ = std::thread(&PanelServer::doServe, this);
   worker_.detach();
+  refresher_ = std::thread(&PanelServer::doRefresh, this);
+  refresher_.detach();
 }
 
-void PanelServer::DataSinkHandle(httplib::DataSink &sink) {
-  std::unique_lock<std::mutex> lock(_mtx);
-  int id = _messageId + 1;
-  _cv.wait(lock, [&] { return _messageId == id; });
-  sink.write(_message.c_str(), _message.size());
+void PanelServer::Notify(const std::string &message) {
+  _events.Publish(message);
 }
 
-void PanelServer::Notify(const std::string &message) {
-  std::lock_guard<std::mutex> lock(_mtx);
-  _message = "data: " + message + "\n\n";
-  _messageId++;
-  _cv.notify_all();
+void PanelServer::Changed(PanelData data) {
+  (data == PanelData::PROFILE ? _profile : _tasks).Invalidate();
+  {
+    std::lock_guard<std::mutex> lock(_refreshMtx);
+    _refreshPending = true;
+  }
+  _refreshCv.notify_one();
+}
+
+void PanelServer::doRefresh() {
+  std::unique_lock<std::mutex> lock(_refreshMtx);
+  while (true) {
+    auto minute = std::chrono::time_point_cast<std::chrono::minutes>(
+                      std::chrono::system_clock::now()) +
+                  std::chrono::minutes(1);
+    bool changed = _refreshCv.wait_until(
+        lock, minute, [this] { return _refreshPending; });
+    if (changed) {
+      lock.unlock();
+      std::this_thread::sleep_for(kRefreshWindow);
+      lock.lock();
+    }
+    _refreshPending = false;
+    lock.unlock();
+    // nobody to push to, the next request builds them
+    if (_sse.Clients() > 0) {
+      if (!changed) {
+        // exp is owed per minute, an open panel sees it as it comes
+        DataManager::GetInstance()->AccrueExp();
+        // the accrual announced itself, the refresh below covers it
+        std::lock_guard<std::mutex> guard(_refreshMtx);
+        _refreshPending = false;
+      }
+      try {
+        _profile.Refresh();
+        _tasks.Refresh();
+      } catch (const std::exception &e) {
+        LAppPal::PrintLog(LogLevel::Error, "[PanelServer]Refresh failed: %s",
+                          e.what());
+      }
+    }
+    lock.lock();
+  }
+}
+
+void PanelServer::serveSnapshot(PanelSnapshot &snapshot,
+                                const httplib::Request &req,
+                                httplib::Response &res) {
+  auto document = snapshot.Get();
+  res.set_header("ETag", document->etag);
+  // the browser keeps it, but asks every time
+  res.set_header("Cache-Control", "no-cache");
+  if (req.get_header_value("If-None-Match").find(document->etag) !=
+      std::string::npos) {
+    res.status = 304;
+    return;
+  }
+  res.set_content(document->body, "application/json");
 }
 
 void PanelServer::initSSE() {
-  // client send a request and wait for response
-  // if any message is sent to the client, the client will wait for response
-  // again so we get a connection to notify the client
+  // a stream would pin one of the few server threads for as long as the
+  // panel is open, so the hub serves them on a port of its own and this
+  // only redirects there. EventSource comes back here on every reconnect
+  // and the hub resumes after its Last-Event-ID.
+  if (_sse.Start("127.0.0.1", 0)) {
+    LAppPal::PrintLog(LogLevel::Info, "[PanelServer]SSE on port %d",
+                      _sse.Port());
+  } else {
+    LAppPal::PrintLog(LogLevel::Error, "[PanelServer]Failed to start SSE");
+  }
   server->Get("/api/sse", [this](const httplib::Request &req,
                                  httplib::Response &res) {
-    LAppPal::PrintLog(LogLevel::Debug, "GET /api/sse");
-    res.set_chunked_content_provider(
-        "text/event-stream", [&](size_t /*offset*/, httplib::DataSink &sink) {
-          // this will block until server wants to send message
-          DataSinkHandle(sink);
-          return true;
-        });
+    if (_sse.Port() == 0) {
+      res.status = 503;
+      return;
+    }
+    std::string url =
+        "http://127.0.0.1:" + std::to_string(_sse.Port()) + "/api/sse";
+    // the hub is another origin, the id goes along in the query instead of
+    // a header that would need a preflight
+    std::string last = req.get_header_value("Last-Event-ID");
+    if (!last.empty() &&
+        std::all_of(last.begin(), last.end(),
+                    [](char c) { return c >= '0' && c <= '9'; })) {
+      url += "?last_id=" + last;
+    }
+    res.set_redirect(url, 307);
   });
 }
 
+nlohmann::json PanelServer::getProfile() {
+  auto json = nlohmann::json::object();
+  json["attributes"] = nlohmann::json::object();
+  auto profile = DataManager::GetInstance()->LoadProfile();
+  for (size_t i = 0; i < kAttrCount; i++) {
+    json["attributes"][string(kAttrNames[i])] = profile.attributes[i];
+  }
+  json["clothes"]["current"] = profile.clothes_current;
+  json["clothes"]["unlock"] = profile.clothes_unlock;
+  json["expdiff"] = profile.expdiff;
+  json["buffs"] = BuffManager::GetInstance()->GetBuffList();
+  json["starcnt"] = profile.starcnt;
+  return json;
+}
+
 nlohmann::json PanelServer::getTaskStatus() {
   auto tasks = DataManager::GetInstance()->GetTasks();
-  std::shared_ptr<GameTask> currentTask;
-  // find current task
-  for (auto task : tasks) {
-    if (task->status == TStatus::RUNNING ||
-        task->status == TStatus::WAIT_SETTLE) {
-      currentTask = task;
-      break;
+  auto toJson = [](const GameTask &task) {
+    nlohmann::json taskJson = {{"id", task.id},
+                               {"title", task.Title()},
+                               {"desc", task.Desc()},
+                               {"start_time", task.start_time},
+                               {"end_time", task.end_time},
+                               {"cost", task.Active() ? task.cost_snapshot
+                                                      : task.Cost()},
+                               {"success", task.success},
+                               {"status", task.status},
+                               {"requirements", task.Requirements()},
+                               {"rewards", task.Rewards()},
+                               {"repeatable", task.Repeatable()}};
+    if (auto special = task.Special()) {
+      taskJson["special"] = {{"title", special->title},
+                             {"desc", special->desc}};
     }
-  }
+    return taskJson;
+  };
+  // find current task
+  auto current = std::find_if(tasks.begin(), tasks.end(),
+                              [](const GameTask &task) { return task.Active(); });
   nlohmann::json data = nlohmann::json::object();
-  if (currentTask) {
+  if (current != tasks.end()) {
+    data["current"] = toJson(*current);
     // filter out current task
-    tasks.erase(std::remove(tasks.begin(), tasks.end(), currentTask),
-                tasks.end());
-    data["current"] = {
-        {"id", currentTask->id},
-        {"title", LAppPal::WStringToString(currentTask->title)},
-        {"desc", LAppPal::WStringToString(currentTask->desc)},
-        {"start_time", currentTask->start_time},
-        {"end_time", currentTask->end_time},
-        {"cost", currentTask->cost_snapshot},
-        {"success", currentTask->success},
-        {"status", currentTask->status},
-        {"repeatable", currentTask->repeatable},
-        {"requirements", currentTask->requirements},
-        {"rewards", currentTask->rewards},
-    };
-    if (currentTask->special) {
-      data["current"]["special"] = nlohmann::json::object();
-      data["current"]["special"]["title"] = LAppPal::WStringToString(currentTask->special->title);
-      data["current"]["special"]["desc"] = LAppPal::WStringToString(currentTask->special->desc);
-    }
+    tasks.erase(current);
   }
   nlohmann::json taskList = nlohmann::json::array();
-  for (auto task : tasks) {
-    nlohmann::json taskJson = {{"id", task->id},
-                               {"title", LAppPal::WStringToString(task->title)},
-                               {"desc", LAppPal::WStringToString(task->desc)},
-                               {"start_time", task->start_time},
-                               {"end_time", task->end_time},
-                               {"cost", task->cost},
-                               {"success", task->success},
-                               {"status", task->status},
-                               {"requirements", task->requirements},
-                               {"rewards", task->rewards},
-                               {"repeatable", task->repeatable}};
-    if (task->special) {
-      taskJson["special"] = nlohmann::json::object();
-      taskJson["special"]["title"] = LAppPal::WStringToString(task->special->title);
-      taskJson["special"]["desc"] = LAppPal::WStringToString(task->special->desc);
-    }
-    taskList.push_back(taskJson);
+  for (const auto &task : tasks) {
+    taskList.push_back(toJson(task));
   }
   data["list"] = taskList;
   return data;
 }
 
+// ?count=N, or ?count=max for as many as possible, defaults to 1
+bool PanelServer::parseCount(const httplib::Request &req,
+                             std::optional<int> &count) {
+  count = 1;
+  if (!req.has_param("count")) {
+    return true;
+  }
+  auto value = req.get_param_value("count");
+  if (value == "max") {
+    count.reset();
+    return true;
+  }
+  try {
+    size_t used = 0;
+    count = std::stoi(value, &used);
+    return used == value.size() && *count > 0;
+  } catch (const std::exception &) {
+    return false;
+  }
+}
+
 void PanelServer::doServe() {
   server->set_base_dir("resources/panel/dist");
   server->Post("/api/star",
                [&](const httplib::Request &req, httplib::Response &res) {
                  DataManager::GetInstance()->FetchStar();
-                 Notify("UPDATE");
+                 Changed(PanelData::PROFILE);
                });
   server->Post("/api/attr/:attr",
                [&](const httplib::Request &req, httplib::Response &res) {
-                 std::string targetAttribute = req.path_params.at("attr");
-                 if (targetAttribute.empty()) {
+                 auto attr = ParseAttr(req.path_params.at("attr"));
+                 if (!attr) {
                    res.status = 404;
                    return;
                  }
-                 // TODO check valid attribute
-                 auto dataManager = DataManager::GetInstance();
-                 // cannot add attributes to more than limit
-                 if (dataManager->GetAttribute(targetAttribute) >= dataManager->GetAttrLimit()) {
-                   res.status = 405;
-                   return;
-                 }
-                 int currentExperience = dataManager->GetAttribute("exp");
-                 int buycnt = dataManager->GetAttribute("buycnt");
-                 int currentCost = 53000;
-                 if (buycnt < 25) {
-                   currentCost = std::ceilf(10.0f * pow(1.41, buycnt));
-                 }
-                 if (currentCost > currentExperience) {
+                 std::optional<int> count;
+                 if (!parseCount(req, count)) {
                    res.status = 400;
                    return;
                  }
-                 dataManager->AddAttribute(targetAttribute, 1);
-                 dataManager->AddAttribute("exp", -currentCost);
-                 dataManager->AddAttribute("buycnt", 1);
-                 Notify("UPDATE");
+                 int bought = 0;
+                 switch (DataManager::GetInstance()->BuyAttribute(*attr, count,
+                                                                  &bought)) {
+                   case BuyResult::OK:
+                     break;
+                   case BuyResult::NOT_FOUND:
+                     res.status = 404;
+                     return;
+                   case BuyResult::AT_LIMIT:
+                     // cannot add attributes to more than limit
+                     res.status = 405;
+                     return;
+                   default:
+                     res.status = 400;
+                     return;
+                 }
+                 res.set_content(nlohmann::json{{"count", bought}}.dump(),
+                                 "application/json");
+                 Changed(PanelData::PROFILE);
                });
   server->Delete("/api/attr/:attr",
                  [&](const httplib::Request &req, httplib::Response &res) {
-                   std::string targetAttribute = req.path_params.at("attr");
-                   if (targetAttribute.empty()) {
+                   auto attr = ParseAttr(req.path_params.at("attr"));
+                   if (!attr) {
                      res.status = 404;
                      return;
                    }
-                   // TODO check valid attribute
-                   auto dataManager = DataManager::GetInstance();
-                   int buycnt = dataManager->GetAttribute("buycnt");
-                   int last_cost = 53000;
-                   // 10 * 1.41^25 = 53762
-                   if (buycnt < 26) {
-                     last_cost = std::ceilf(10.0f * pow(1.41, max(buycnt - 1, 0)));
+                   std::optional<int> count;
+                   if (!parseCount(req, count)) {
+                     res.status = 400;
+                     return;
+                   }
+                   int reverted = 0;
+                   switch (DataManager::GetInstance()->RevertAttribute(
+                       *attr, count, &reverted)) {
+                     case BuyResult::OK:
+                       break;
+                     case BuyResult::NOT_FOUND:
+                       res.status = 404;
+                       return;
+                     default:
+                       res.status = 400;
+                       return;
                    }
-                   LAppPal::PrintLog(LogLevel::Debug, "[PanelServer]Revert attr buycnt=%d last_cost=%d", buycnt, last_cost);
-                   int revertCost = last_cost / 2;
-                   dataManager->AddAttribute(targetAttribute, -1);
-                   dataManager->AddAttribute("exp", revertCost);
-                   dataManager->AddAttribute("buycnt", -1);
-                   Notify("UPDATE");
+                   res.set_content(nlohmann::json{{"count", reverted}}.dump(),
+                                   "application/json");
+                   Changed(PanelData::PROFILE);
                  });
-  server->Get("/api/profile", [](const httplib::Request &req,
+  server->Get("/api/profile", [&](const httplib::Request &req,
                                  httplib::Response &res) {
-    auto json = nlohmann::json::object();
-    json["attributes"] = nlohmann::json::object();
-    auto dataManager = DataManager::GetInstance();
-    auto attributes = dataManager->GetAttributeList();
-    json["attributes"]["speed"] = attributes[0];
-    json["attributes"]["endurance"] = attributes[1];
-    json["attributes"]["strength"] = attributes[2];
-    json["attributes"]["will"] = attributes[3];
-    json["attributes"]["intellect"] = attributes[4];
-    json["attributes"]["exp"] = attributes[5];
-    json["attributes"]["buycnt"] = attributes[6];
-    json["clothes"]["current"] = dataManager->GetWithDefault("clothes.current", 0);
-    json["clothes"]["unlock"] =
-        nlohmann::json::array({true, dataManager->GetWithDefault("clothes.1.active", 0) == 1,
-                               dataManager->GetWithDefault("clothes.2.active", 0) == 1});
-    json["expdiff"] = dataManager->CurrentExpDiff();
-    json["buffs"] = nlohmann::json::array();
-    json["starcnt"] = dataManager->GetWithDefault("starcnt", 0);
-    auto buffs_array = BuffManager::GetInstance()->GetBuffList();
-    for (const auto& buff : buffs_array) {
-      json["buffs"].push_back(buff);
-    }
-    res.set_content(json.dump(), "application/json");
+    // show exp up to this minute, not up to the last scheduled accrual
+    DataManager::GetInstance()->AccrueExp();
+    serveSnapshot(_profile, req, res);
   });
   server->Post("/api/data/reset", [](const httplib::Request &req, httplib::Response &res) {
     DataManager::GetInstance()->SetResetMark();
@@ -222,22 +302,21 @@ void PanelServer::doServe() {
     // check id valid, 0 is actived by default
     bool unlock = true;
     if (id > 0) {
-      unlock = DataManager::GetInstance()->GetWithDefault("clothes."+ std::to_string(id) + ".active", 0) == 1;
+      unlock = DataManager::GetInstance()->Get(keys::ClothesActive[id]) == 1;
     }
     if (!unlock) {
       LAppPal::PrintLog(LogLevel::Warn, "[PanelServer]Clothes id not active");
       res.status = 400;
       return;
     }
-    DataManager::GetInstance()->SetRaw("clothes.current", id);
-    Notify("UPDATE");
+    DataManager::GetInstance()->Set(keys::ClothesCurrent, id);
+    Changed(PanelData::PROFILE);
   });
   server->Get("/api/task",
               [&](const httplib::Request &req, httplib::Response &res) {
                 LAppPal::PrintLog(LogLevel::Debug, "GET /api/task");
                 try {
-                  auto data = getTaskStatus();
-                  res.set_content(data.dump(), "application/json");
+                  serveSnapshot(_tasks, req, res);
                 } catch (const std::exception &e) {
                   res.status = 500;
                   res.set_content(e.what(), "text/plain");
@@ -248,109 +327,55 @@ void PanelServer::doServe() {
                                           httplib::Response &res) {
     LAppPal::PrintLog(LogLevel::Debug, "POST /api/task/:id/start");
     int id = std::stoi(req.path_params.at("id"));
-    auto tasks = DataManager::GetInstance()->GetTasks();
-    std::shared_ptr<GameTask> targetTask;
-    for (auto task : tasks) {
-      // cannot start a new task while old one is running
-      if (task->status == TStatus::RUNNING ||
-          task->status == TStatus::WAIT_SETTLE) {
+    switch (DataManager::GetInstance()->StartTask(id)) {
+      case TaskResult::OK:
+        res.set_content(_tasks.Get()->body, "application/json");
+        return;
+      case TaskResult::BUSY:
         LAppPal::PrintLog(LogLevel::Warn,
                           "[PanelServer]Already exists a running task");
         res.status = 400;
         return;
-      }
-      if (task->id == id) {
-        targetTask = task;
-      }
-    }
-    if (targetTask) {
-        if (targetTask->status == TStatus::ARCHIVED) {
-          // obviously archived task cannot be started
-          res.status = 401;
-          return;
-        }
-        // do starting work
-        targetTask->start_time = time(nullptr);
-        targetTask->success = false;
-        targetTask->status = TStatus::RUNNING;
-        targetTask->cost_snapshot = targetTask->GetCurrentCost();
-        targetTask->Dump();
-        auto data = getTaskStatus();
-        res.set_content(data.dump(), "application/json");
+      default:
+        // unknown, or archived tasks obviously cannot be started
+        res.status = 401;
         return;
     }
-    res.status = 401;
   });
   server->Post("/api/task/:id/confirm", [&](const httplib::Request &req,
                                             httplib::Response &res) {
     LAppPal::PrintLog(LogLevel::Debug, "POST /api/task/:id/confirm");
     int id = std::stoi(req.path_params.at("id"));
-    auto dataManager = DataManager::GetInstance();
-    auto tasks = dataManager->GetTasks();
-    for (auto task : tasks) {
-      if (task->id == id) {
-        if (task->status != TStatus::WAIT_SETTLE) {
-          res.status = 400;
-          return;
-        }
-        // complete this task
-        task->end_time = time(nullptr);
-        if (task->success) {
-          // update attribute
-          for (auto it = task->rewards.begin(); it != task->rewards.end();
-               ++it) {
-            dataManager->AddAttribute(it->first, it->second);
-          }
-          if (task->id == 1) {
-            dataManager->AddAttribute("exp", 10 * dataManager->CurrentExpDiff());
-          }
-          // if with special, update related key
-          if (task->special) {
-            dataManager->SetRaw(task->special->linked_key, 1);
-          }
-          dataManager->SetRaw("buff.failcount", 0);
-          LAppPal::PrintLog("[PanelServer]Failcount set to 0");
-          Notify("UPDATE");
-        } else {
-          int failcount = dataManager->GetWithDefault("buff.failcount", 0);
-          failcount++;
-          dataManager->SetRaw("buff.failcount", failcount);
-          LAppPal::PrintLog("[PanelServer]Failcount set to %d", failcount);
-        }
-        if (task->repeatable) {
-            task->status = TStatus::IDLE;
-        } else {
-            task->status = task->success ? TStatus::ARCHIVED : TStatus::IDLE;
-        }
-        task->Dump();
-        auto data = getTaskStatus();
-        res.set_content(data.dump(), "application/json");
+    bool success = false;
+    switch (DataManager::GetInstance()->ConfirmTask(id, &success)) {
+      case TaskResult::OK:
+        // rewards, or the fail count
+        Changed(PanelData::PROFILE);
+        res.set_content(_tasks.Get()->body, "application/json");
+        return;
+      case TaskResult::NOT_FOUND:
+        res.status = 404;
+        return;
+      default:
+        res.status = 400;
         return;
-      }
     }
-    res.status = 404;
   });
   server->Post("/api/task/:id/cancel", [&](const httplib::Request &req,
                                            httplib::Response &res) {
     LAppPal::PrintLog(LogLevel::Debug, "POST /api/task/:id/cancel");
     int id = std::stoi(req.path_params.at("id"));
-    auto tasks = DataManager::GetInstance()->GetTasks();
-    for (auto task : tasks) {
-      if (task->id == id) {
-        if (task->status != TStatus::RUNNING) {
-          res.status = 400;
-          return;
-        }
-        task->start_time = 0;
-        task->success = false;
-        task->status = TStatus::IDLE;
-        task->Dump();
-        auto data = getTaskStatus();
-        res.set_content(data.dump(), "application/json");
+    switch (DataManager::GetInstance()->CancelTask(id)) {
+      case TaskResult::OK:
+        res.set_content(_tasks.Get()->body, "application/json");
+        return;
+      case TaskResult::NOT_FOUND:
+        res.status = 404;
+        return;
+      default:
+        res.status = 400;
         return;
-      }
     }
-    res.status = 404;
   });
   server->Post("/api/config/folder", [](const httplib::Request &req, httplib::Response &res) {
     ShellExecute(NULL, L"open", LAppDefine::documentPath.c_str(), NULL, NULL, SW_SHOWDEFAULT);
@@ -451,6 +476,7 @@ void PanelServer::doServe() {
                                         httplib::Response &res) {
     nlohmann::json json = nlohmann::json::parse(req.body);
     DataManager::GetInstance()->UpdateNotify(json.at("live"), json.at("dynamic"), json.at("update"));
+    DataManager::GetInstance()->Save();
     LAppDelegate::GetInstance()->LiveNotify = json.at("live");
     LAppDelegate::GetInstance()->DynamicNotify = json.at("dynamic");
     LAppDelegate::GetInstance()->UpdateNotify = json.at("update");
@@ -465,6 +491,7 @@ void PanelServer::doServe() {
     } else {
       LAppDelegate::GetInstance()->GetUserStateManager()->AddWatcher(uid);
       DataManager::GetInstance()->AddFollow(uid);
+      DataManager::GetInstance()->Save();
     }
     // response with updated follow list
     map<string, WatchTarget> followList;
@@ -486,6 +513,7 @@ void PanelServer::doServe() {
     std::string uid = json.at("uid");
     LAppDelegate::GetInstance()->GetUserStateManager()->RemoveWatcher(uid);
     DataManager::GetInstance()->RemoveFollow(uid);
+    DataManager::GetInstance()->Save();
     // response with updated follow list
     map<string, WatchTarget> followList;
     LAppDelegate::GetInstance()->GetUserStateManager()->GetTargetList(
@@ -504,23 +532,25 @@ void PanelServer::doServe() {
                                           httplib::Response &res) {
     nlohmann::json shortcuts;
     auto dm = DataManager::GetInstance();
-    // contain 4 items
-    for (int i = 0; i < 4; i++) {
-      shortcuts.push_back(
-          {{"type",
-            dm->GetWithDefault("shortcut." + std::to_string(i) + ".type", 3)},
-           {"param", dm->GetWithDefault(
-                         "shortcut." + std::to_string(i) + ".param", "")}});
+    for (size_t i = 0; i < keys::kShortcutCount; i++) {
+      shortcuts.push_back({{"type", dm->Get(keys::ShortcutType[i])},
+                           {"param", dm->Get(keys::ShortcutParam[i])}});
     }
     res.set_content(shortcuts.dump(), "application/json");
   });
   server->Post("/api/config/shortcut/:id",
                [](const httplib::Request &req, httplib::Response &res) {
-                 string id = req.path_params.at("id");
+                 const string& param = req.path_params.at("id");
+                 if (param.size() != 1 || param[0] < '0' ||
+                     param[0] >= '0' + static_cast<int>(keys::kShortcutCount)) {
+                   res.status = 400;
+                   return;
+                 }
+                 size_t id = param[0] - '0';
                  auto json = nlohmann::json::parse(req.body);
                  auto dm = DataManager::GetInstance();
-                 dm->SetRaw("shortcut." + id + ".type", json.at("type").get<int>());
-                 dm->SetRaw<string>("shortcut." + id + ".param", json.at("param").get<string>());
+                 dm->Set(keys::ShortcutType[id], json.at("type").get<int>());
+                 dm->Set(keys::ShortcutParam[id], json.at("param").get<string>());
                });
   server->Get("/api/dialog/browse/:type",
               [](const httplib::Request &req, httplib::Response &res) {
@@ -558,34 +588,45 @@ void PanelServer::doServe() {
                                           httplib::Response &res) {
       nlohmann::json response;
       LAppDelegate::GetInstance()->GetUserStateManager()->CheckUpdate(false);
-      response["need_update"] = DataManager::GetInstance()->GetWithDefault("need_update", 0) == 1;
+      response["need_update"] = DataManager::GetInstance()->Get(keys::NeedUpdate) == 1;
       response["local_version"] = VERSION;
-      response["latest_version"] = DataManager::GetInstance()->GetWithDefault("latest_version", "");
+      response["latest_version"] = DataManager::GetInstance()->Get(keys::LatestVersion);
       res.set_content(response.dump(), "application/json");
   });
 
-  httplib::SSLClient login_cli("passport.bilibili.com", 443);
-  login_cli.set_follow_location(true);
-  login_cli.enable_server_certificate_verification(false);
-  login_cli.set_connection_timeout(std::chrono::seconds(1));
+  // latency and connection reuse of remote API hosts
+  server->Get("/api/debug/http", [](const httplib::Request &req,
+                                    httplib::Response &res) {
+    nlohmann::json json = nlohmann::json::object();
+    for (const auto &[host, stats] : HttpPool::GetInstance()->Stats()) {
+      json[host] = {{"requests", stats.requests},
+                    {"failures", stats.failures},
+                    {"handshakes", stats.handshakes},
+                    {"resumed", stats.resumed},
+                    {"avg_ms", stats.avg_ms},
+                    {"max_ms", stats.max_ms}};
+    }
+    res.set_content(json.dump(), "application/json");
+  });
+
+  HttpOptions login;
+  login.follow_location = true;
+  login.verify = false;
   std::string oauth_key;
 
   server->Delete("/api/account", [&](const httplib::Request &req,
                                      httplib::Response &res) {
-    string cookies = DataManager::GetInstance()->GetWithDefault("cookies", "");
-    httplib::Headers headers = {{"cookie", cookies}};
-    // extract bili_jct from cookies
-    
-    std::regex pattern("bili_jct=([a-z0-9]+)");
-    std::smatch match;
-    std::regex_search(cookies, match, pattern);
-    if (match.size() < 2) {
+    auto cookies = CookieStore::GetInstance()->Login();
+    httplib::Headers headers = {{"cookie", cookies->Header()}};
+    if (cookies->Csrf().empty()) {
       LAppPal::PrintLog(LogLevel::Error, "[PanelServer]bili_jct not found");
       return;
     }
-    string bili_jct = match[1];
 
-    auto resp = login_cli.Post("/login/exit/v2", headers, "biliCSRF=" + bili_jct, "application/x-www-form-urlencoded");
+    auto resp = HttpPool::GetInstance()->Post(
+        "passport.bilibili.com", "/login/exit/v2", headers,
+        "biliCSRF=" + string(cookies->Csrf()),
+        "application/x-www-form-urlencoded", login);
     if (resp && resp->status == 200) {
       try {
         auto json = nlohmann::json::parse(resp->body);
@@ -601,14 +642,15 @@ void PanelServer::doServe() {
                           resp->body.c_str());
       }
     }
-    DataManager::GetInstance()->SetRaw("cookies", string(""));
+    CookieStore::GetInstance()->ClearLogin();
   });
 
   server->Get("/api/account", [](const httplib::Request &req,
                                  httplib::Response &res) {
-    string cookies = DataManager::GetInstance()->GetWithDefault("cookies", "");
+    auto cookies = CookieStore::GetInstance()->Login();
     nlohmann::json resp_json = {};
-    if (cookies.empty()) {
+    // expired cookies need a new login as well
+    if (!cookies->Valid()) {
       resp_json["login"] = false;
       res.set_content(resp_json.dump(), "application/json");
       return;
@@ -617,59 +659,39 @@ void PanelServer::doServe() {
     resp_json["info"] = nlohmann::json::object();
     resp_json["info"]["level"] = BuffManager::GetInstance()->MedalLevel();
     resp_json["info"]["confirm"] =
-        DataManager::GetInstance()->GetWithDefault("data-share", 0) == 1;
+        DataManager::GetInstance()->Get(keys::DataShare) == 1;
 
     httplib::Headers headers = {
-        {"cookie", cookies},
+        {"cookie", cookies->Header()},
         {"user-agent",
          "Mozilla/5.0 (Windows NT 10.0; Win64; x64) AppleWebKit/537.36 (KHTML, "
          "like Gecko) Chrome/128.0.0.0 Safari/537.36"}};
-    httplib::SSLClient client = httplib::SSLClient("api.bilibili.com", 443);
-    client.set_connection_timeout(std::chrono::seconds(1));
-
-    // get uid from cookies string, find DedeUserID
-    std::regex pattern("DedeUserID=([0-9]+)");
-    std::smatch match;
-    std::regex_search(cookies, match, pattern);
-    if (match.size() < 2) {
+    string uid(cookies->Uid());
+    if (uid.empty()) {
       resp_json["login"] = false;
       res.set_content(resp_json.dump(), "application/json");
       return;
     }
-    string uid = match[1];
-
-    DataManager::GetInstance()->SetRaw("uid", uid);
-
-    string request_path = "/x/space/wbi/acc/info?";
-    nlohmann::json Params;
-    Params["mid"] = uid;
 
-    auto wbi_config = LAppDelegate::GetInstance()->GetUserStateManager()->GetWbiKey();
-    if (wbi_config) {
-      const auto mixin_key = Wbi::Get_mixin_key(wbi_config->img_key, wbi_config->sub_key);
-      const auto w_rid = Wbi::Calc_sign(Params, mixin_key);
-      request_path += Wbi::Json_to_url_encode_str(Params) + "&w_rid=" + w_rid;
-    } else {
-      request_path += Wbi::Json_to_url_encode_str(Params);
-    }
+    string request_path = "/x/space/wbi/acc/info?" +
+                          WbiSigner::GetInstance()->Sign({{"mid", uid}});
 
-    auto resp = client.Get(request_path.c_str(), headers);
+    auto resp = HttpPool::GetInstance()->Get("api.bilibili.com", request_path,
+                                             headers);
     if (resp && resp->status == 200) {
-      auto json = nlohmann::json::parse(resp->body);
-      if (json.at("code") == 0 && json.contains("data")) {
-        try {
-          resp_json["info"]["uname"] =
-              json.at("data").at("name").get<std::string>();
-          resp_json["info"]["uid"] = uid;
-        } catch (const std::exception &e) {
-          LAppPal::PrintLog("[PanelServer]Exception: %s", e.what());
-        }
+      auto account = bili::ParseAccount(resp->body);
+      if (account && account->code == 0) {
+        resp_json["info"]["uname"] = account->name;
+        resp_json["info"]["uid"] = uid;
         res.set_content(resp_json.dump(), "application/json");
         return;
-      } else {
+      } else if (account) {
         res.status = 500;
         LAppPal::PrintLog("[PanelServer]Fetch account info failed with code %d",
-                          json.at("code").get<int>());
+                          account->code);
+      } else {
+        res.status = 500;
+        LAppPal::PrintLog("[PanelServer]Parse account info failed");
       }
     } else {
       res.status = 500;
@@ -679,7 +701,9 @@ void PanelServer::doServe() {
 
   server->Get("/api/account/qr", [&](const httplib::Request &req,
                                           httplib::Response &res) {
-      auto resp = login_cli.Get("/x/passport-login/web/qrcode/generate");
+      auto resp = HttpPool::GetInstance()->Get(
+          "passport.bilibili.com", "/x/passport-login/web/qrcode/generate", {},
+          login);
       if (resp && resp->status == 200) {
         auto json = nlohmann::json::parse(resp->body);
         oauth_key = json["data"]["qrcode_key"];
@@ -697,7 +721,10 @@ void PanelServer::doServe() {
   });
   server->Get("/api/account/qr-status", [&](const httplib::Request &req,
                                           httplib::Response &res) {
-      auto resp = login_cli.Get("/x/passport-login/web/qrcode/poll?qrcode_key=" + oauth_key);
+      auto resp = HttpPool::GetInstance()->Get(
+          "passport.bilibili.com",
+          "/x/passport-login/web/qrcode/poll?qrcode_key=" + oauth_key, {},
+          login);
       auto json = nlohmann::json::parse(resp->body);
       auto resp_json = nlohmann::json::object();
       if (json["data"]["code"] == 0) {
@@ -706,8 +733,8 @@ void PanelServer::doServe() {
         std::string url = json["data"]["url"].get<std::string>();
         std::string queryString = url.substr(url.find('?') + 1);
         // replace & as ;
-        queryString = std::regex_replace(queryString, std::regex("&"), ";");
-        DataManager::GetInstance()->SetRaw("cookies", queryString);
+        std::replace(queryString.begin(), queryString.end(), '&', ';');
+        CookieStore::GetInstance()->SetLogin(queryString);
         BuffManager::GetInstance()->Update();
       } else {
         resp_json["success"] = false;
@@ -716,7 +743,7 @@ void PanelServer::doServe() {
   });
   server->Post("/api/account/share",
                [](const httplib::Request &req, httplib::Response &res) {
-                 DataManager::GetInstance()->SetRaw("data-share", 1);
+                 DataManager::GetInstance()->Set(keys::DataShare, 1);
                });
 
   initSSE();
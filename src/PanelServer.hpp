@@ -1,28 +1,60 @@
 #pragma once
+#include <condition_variable>
 #include <httplib.h>
 #include <mutex>
 #include <nlohmann/json.hpp>
+#include <optional>
+#include <thread>
+
+#include "EventBus.hpp"
+#include "PanelSnapshot.hpp"
+#include "SseHub.hpp"
+
+// data the panel shows, see PanelServer::Changed()
+enum class PanelData { PROFILE, TASKS };
 
 class PanelServer {
  private:
   httplib::Server* server;
-  std::mutex _mtx;
-  std::string _message;
-  std::condition_variable _cv;
-  std::atomic_int _messageId = 0;
+  // events for the panel, streamed by _sse from its own thread
+  EventBus _events{256, "UPDATE"};
+  SseHub _sse{_events};
+  // built only when their data changed, the panel gets the deltas
+  PanelSnapshot _profile{"profile", [this] { return getProfile(); },
+                         [this](const std::string& event) {
+                           _events.Publish(event);
+                         }};
+  PanelSnapshot _tasks{"tasks", [this] { return getTaskStatus(); },
+                       [this](const std::string& event) {
+                         _events.Publish(event);
+                       }};
   std::thread worker_;
+  // rebuilds changed snapshots while a panel is open
+  std::thread refresher_;
+  std::mutex _refreshMtx;
+  std::condition_variable _refreshCv;
+  bool _refreshPending = false;
 
 
   PanelServer() { server = new httplib::Server(); };
 
   void initSSE();
 
-  void DataSinkHandle(httplib::DataSink& sink);
-
   void doServe();
 
+  void doRefresh();
+
+  nlohmann::json getProfile();
+
   nlohmann::json getTaskStatus();
 
+  // the snapshot, or 304 if the panel has it already
+  static void serveSnapshot(PanelSnapshot& snapshot,
+                            const httplib::Request& req,
+                            httplib::Response& res);
+
+  static bool parseCount(const httplib::Request& req, std::optional<int>& count);
+
  public:
   static PanelServer* GetInstance() {
     static PanelServer* instance = new PanelServer();
@@ -37,4 +69,11 @@ class PanelServer {
   void Start();
 
   void Notify(const std::string& message);
+
+  /**
+   * @brief  Data shown in the panel changed. Its snapshot is built again on
+   * the next request, or right away while a panel is open so the panel
+   * gets the delta.
+   */
+  void Changed(PanelData data);
 };
@@ -0,0 +1,218 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <nlohmann/json.hpp>
+#include <string>
+
+/**
+ * @brief  One version of a PanelSnapshot.
+ */
+struct PanelDocument {
+  uint64_t version = 0;
+  nlohmann::json data;
+  // data with "version" added, as served
+  std::string body;
+  std::string etag;
+};
+
+struct PanelSnapshotStats {
+  uint64_t builds = 0;
+  // builds that differed from the one before and got a new version
+  uint64_t versions = 0;
+};
+
+/**
+ * @brief  A document the panel reads, e.g. /api/profile, built once per
+ * change of its data instead of once per request. Invalidate() it when the
+ * data changes, the next Get() or Refresh() builds it again. A build equal
+ * to the last one is dropped; one that differs gets the next version and
+ * publishes the delta from the version before:
+ *
+ *   {"type": name, "from": 4, "version": 5, "patch": [see Diff()]}
+ */
+class PanelSnapshot {
+ public:
+  using Builder = std::function<nlohmann::json()>;
+  using Publisher = std::function<void(const std::string& event)>;
+
+  PanelSnapshot(std::string name, Builder build, Publisher publish)
+      : _name(std::move(name)),
+        _build(std::move(build)),
+        _publish(std::move(publish)),
+        // versions restart with the process, an ETag of a previous run
+        // must not match
+        _epoch(std::to_string(
+            std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::system_clock::now().time_since_epoch())
+                .count())) {}
+
+  void Invalidate() { _dirty = true; }
+
+  bool Dirty() const { return _dirty; }
+
+  /**
+   * @brief  The current document, built first if invalidated.
+   */
+  std::shared_ptr<const PanelDocument> Get() {
+    auto current = std::atomic_load(&_current);
+    if (!current || _dirty) {
+      Refresh();
+      current = std::atomic_load(&_current);
+    }
+    return current;
+  }
+
+  /**
+   * @brief  Build again if invalidated, and publish the delta if anything
+   * changed.
+   */
+  void Refresh() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto previous = std::atomic_load(&_current);
+    // cleared before building, a change during the build invalidates again
+    if (!_dirty.exchange(false) && previous) {
+      return;
+    }
+    nlohmann::json data;
+    try {
+      data = _build();
+    } catch (...) {
+      _dirty = true;
+      throw;
+    }
+    _stats.builds++;
+    if (previous && previous->data == data) {
+      return;
+    }
+    auto next = std::make_shared<PanelDocument>();
+    next->version = previous ? previous->version + 1 : 1;
+    next->etag = "\"" + _epoch + "-" + std::to_string(next->version) + "\"";
+    nlohmann::json body = data;
+    body["version"] = next->version;
+    next->body = body.dump();
+    next->data = std::move(data);
+    _stats.versions++;
+    std::string event;
+    if (previous) {
+      event = nlohmann::json{{"type", _name},
+                             {"from", previous->version},
+                             {"version", next->version},
+                             {"patch", Diff(previous->data, next->data)}}
+                  .dump();
+    }
+    // stored first, a client that GETs on the event sees this version
+    std::atomic_store(&_current,
+                      std::shared_ptr<const PanelDocument>(std::move(next)));
+    if (!event.empty()) {
+      _publish(event);
+    }
+  }
+
+  PanelSnapshotStats Stats() const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _stats;
+  }
+
+  /**
+   * @brief  JSON patch (RFC 6902) from one document to the other, with add,
+   * remove and replace. Unlike nlohmann::json::diff() an element added to or
+   * removed from the middle of an array is one op, not a replace of every
+   * element after it, e.g. a task moving from "list" to "current".
+   */
+  static nlohmann::json Diff(const nlohmann::json& from,
+                             const nlohmann::json& to) {
+    nlohmann::json patch = nlohmann::json::array();
+    diff(from, to, "", patch);
+    return patch;
+  }
+
+ private:
+  std::string _name;
+  Builder _build;
+  Publisher _publish;
+  std::string _epoch;
+  std::atomic<bool> _dirty{true};
+  // serializes builds, readers load _current without it
+  mutable std::mutex _mutex;
+  std::shared_ptr<const PanelDocument> _current;
+  PanelSnapshotStats _stats;
+
+  static void diff(const nlohmann::json& from, const nlohmann::json& to,
+                   const std::string& path, nlohmann::json& patch) {
+    if (from == to) {
+      return;
+    }
+    if (from.type() == nlohmann::json::value_t::object &&
+        to.type() == nlohmann::json::value_t::object) {
+      for (const auto& [key, value] : from.items()) {
+        std::string child = path + "/" + escape(key);
+        auto it = to.find(key);
+        if (it == to.end()) {
+          patch.push_back({{"op", "remove"}, {"path", child}});
+        } else {
+          diff(value, *it, child, patch);
+        }
+      }
+      for (const auto& [key, value] : to.items()) {
+        if (!from.contains(key)) {
+          patch.push_back({{"op", "add"},
+                           {"path", path + "/" + escape(key)},
+                           {"value", value}});
+        }
+      }
+      return;
+    }
+    if (from.type() == nlohmann::json::value_t::array &&
+        to.type() == nlohmann::json::value_t::array) {
+      // only what lies between the common head and tail differs
+      size_t head = 0;
+      while (head < from.size() && head < to.size() &&
+             from[head] == to[head]) {
+        head++;
+      }
+      size_t tail = 0;
+      while (tail < from.size() - head && tail < to.size() - head &&
+             from[from.size() - 1 - tail] == to[to.size() - 1 - tail]) {
+        tail++;
+      }
+      size_t removed = from.size() - head - tail;
+      size_t added = to.size() - head - tail;
+      size_t i = head;
+      for (; i < head + std::min(removed, added); i++) {
+        diff(from[i], to[i], path + "/" + std::to_string(i), patch);
+      }
+      for (size_t n = removed; n > added; n--) {
+        patch.push_back(
+            {{"op", "remove"}, {"path", path + "/" + std::to_string(i)}});
+      }
+      for (; i < head + added; i++) {
+        patch.push_back({{"op", "add"},
+                         {"path", path + "/" + std::to_string(i)},
+                         {"value", to[i]}});
+      }
+      return;
+    }
+    patch.push_back({{"op", "replace"}, {"path", path}, {"value", to}});
+  }
+
+  // a key as a JSON pointer token
+  static std::string escape(const std::string& key) {
+    std::string token;
+    for (char c : key) {
+      if (c == '~') {
+        token += "~0";
+      } else if (c == '/') {
+        token += "~1";
+      } else {
+        token += c;
+      }
+    }
+    return token;
+  }
+};
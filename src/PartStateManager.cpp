@@ -30,19 +30,22 @@ void PartStateManager::SnapshotState() {
   if (model == nullptr) {
     return;
   }
+  auto dm = DataManager::GetInstance();
+  auto txn = dm->BeginTransaction();
   for (auto& [_, entry] : param_map_) {
-    DataManager::GetInstance()->SetRaw(prefix_ + entry.key,
-                                       model->GetParameterValue(entry.id));
+    dm->SetRaw(txn, keys::PartKey(entry.key), model->GetParameterValue(entry.id));
   }
+  txn.Commit();
   LAppPal::PrintLog(LogLevel::Debug, "[PartStateManager]All state snapshot");
 }
 
 void PartStateManager::ApplyState() {
   if (model == nullptr) return;
+  auto stored = DataManager::GetInstance()->LoadParts();
   for (auto& [_, entry] : param_map_) {
+    auto it = stored.find(entry.key);
     model->SetParameterValue(entry.id,
-                             DataManager::GetInstance()->GetWithDefault(
-                                 prefix_ + entry.key, entry.value));
+                             it == stored.end() ? entry.value : it->second);
   }
   LAppPal::PrintLog(LogLevel::Info,
                     "[PartStateManager]Appy stored state to model");
@@ -48,7 +48,6 @@ class PartStateManager {
       {"ParamLegs", {"ParamLegs", nullptr, 30}},
       {"ParamTail", {"ParamTail", nullptr, 0}}};
 
-  const std::string prefix_ = "part.";
   const vector<string> clothes_keys_ = {"ParamCloth1", "ParamCloth2", "ParamCloth3"};
   const vector<string> mouth_keys_ = {"ParamMouth1", "ParamMouth2",
                                       "ParamMouth3", "ParamMouth4",
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <limits>
+
+/**
+ * @brief  xoshiro256** generator, small and fast with 2^256 - 1 period.
+ * Same sequence for a seed on every compiler, unlike std::mt19937 paired
+ * with std distributions.
+ */
+class Xoshiro256 {
+ public:
+  using result_type = uint64_t;
+
+  explicit Xoshiro256(uint64_t seed) {
+    // splitmix64 spreads any seed, including 0, over the whole state
+    for (uint64_t& word : s_) {
+      seed += 0x9e3779b97f4a7c15ull;
+      uint64_t z = seed;
+      z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+      z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+      word = z ^ (z >> 31);
+    }
+  }
+
+  static constexpr result_type min() { return 0; }
+
+  static constexpr result_type max() {
+    return std::numeric_limits<result_type>::max();
+  }
+
+  result_type operator()() {
+    const uint64_t result = rotl(s_[1] * 5, 7) * 9;
+    const uint64_t t = s_[1] << 17;
+    s_[2] ^= s_[0];
+    s_[3] ^= s_[1];
+    s_[1] ^= s_[2];
+    s_[0] ^= s_[3];
+    s_[2] ^= t;
+    s_[3] = rotl(s_[3], 45);
+    return result;
+  }
+
+  /**
+   * @brief  Uniform in [0, n), n must be positive.
+   */
+  int Below(int n) {
+    const uint64_t range = static_cast<uint64_t>(n);
+    // drop the top values that would make small results more likely
+    const uint64_t limit = max() - max() % range;
+    uint64_t x;
+    do {
+      x = (*this)();
+    } while (x >= limit);
+    return static_cast<int>(x % range);
+  }
+
+ private:
+  uint64_t s_[4];
+
+  static uint64_t rotl(uint64_t x, int k) { return (x << k) | (x >> (64 - k)); }
+};
+
+/**
+ * @brief  Random numbers for game logic and effects.
+ * Each thread draws from its own generator, so no lock is taken. Seeds
+ * derive from the seed given to Seed() and the order threads first draw in,
+ * so with a fixed seed every thread replays the same sequence.
+ */
+class Random {
+ public:
+  /**
+   * @brief  Restart every thread's sequence from seed, 0 seeds from the
+   * clock. Threads pick it up on their next draw.
+   */
+  static void Seed(uint64_t seed) {
+    if (seed == 0) {
+      seed = static_cast<uint64_t>(
+          std::chrono::steady_clock::now().time_since_epoch().count());
+    }
+    seed_.store(seed, std::memory_order_relaxed);
+    threads_.store(0, std::memory_order_relaxed);
+    epoch_.fetch_add(1, std::memory_order_release);
+  }
+
+  /**
+   * @brief  Uniform in [0, n), n must be positive.
+   */
+  static int Below(int n) { return engine().Below(n); }
+
+ private:
+  static inline std::atomic<uint64_t> seed_{0};
+  static inline std::atomic<uint64_t> threads_{0};
+  // bumped by Seed(), a thread whose engine is older reseeds
+  static inline std::atomic<uint64_t> epoch_{0};
+
+  static Xoshiro256& engine() {
+    struct Local {
+      uint64_t epoch = ~0ull;
+      Xoshiro256 engine{0};
+    };
+    thread_local Local local;
+    uint64_t epoch = epoch_.load(std::memory_order_acquire);
+    if (local.epoch != epoch) {
+      if (epoch == 0) {
+        // drawn before Seed(), still vary between runs
+        Seed(0);
+        epoch = epoch_.load(std::memory_order_acquire);
+      }
+      uint64_t index = threads_.fetch_add(1, std::memory_order_relaxed);
+      local.engine = Xoshiro256(seed_.load(std::memory_order_relaxed) +
+                                index * 0x9e3779b97f4a7c15ull);
+      local.epoch = epoch;
+    }
+    return local.engine;
+  }
+};
@@ -0,0 +1,287 @@
+#include "RocksStore.hpp"
+
+#include <chrono>
+#include <filesystem>
+#include <rocksdb/table.h>
+#include <rocksdb/write_batch.h>
+
+#include "GameSchema.hpp"
+#include "LAppPal.hpp"
+
+namespace {
+const wchar_t* kDirName = L"/GameData";
+
+rocksdb::Slice ToSlice(std::string_view s) {
+  return rocksdb::Slice(s.data(), s.size());
+}
+}  // namespace
+
+RocksStore::Family RocksStore::family(std::string_view key) {
+  auto starts = [key](std::string_view prefix) {
+    return key.substr(0, prefix.size()) == prefix;
+  };
+  if (starts(keys::kAttrPrefix)) {
+    return kAttr;
+  }
+  if (starts(keys::kTaskPrefix)) {
+    return kTask;
+  }
+  if (starts(keys::kPartPrefix)) {
+    return kPart;
+  }
+  if (starts(keys::kShortcutPrefix)) {
+    return kShortcut;
+  }
+  if (key == keys::Cookies.name.View() || key == keys::UserAgent.name.View() ||
+      key == keys::Uid.name.View()) {
+    return kCredentials;
+  }
+  return kDefault;
+}
+
+/**
+ * Defaults reserve a 64MB memtable per column family, several background
+ * threads and an 8MB block cache, all of it idle for this store.
+ */
+rocksdb::DBOptions RocksStore::dbOptions() {
+  rocksdb::DBOptions options;
+  options.create_if_missing = true;
+  options.create_missing_column_families = true;
+  options.max_background_jobs = 1;
+  options.max_subcompactions = 1;
+  options.max_open_files = 16;
+  // the WAL is shared by all families, a small cap forces idle families
+  // to flush so old log files can be recycled instead of piling up
+  options.max_total_wal_size = 1 << 20;
+  options.db_write_buffer_size = 1 << 20;
+  options.keep_log_file_num = 2;
+  options.max_log_file_size = 256 << 10;
+  options.stats_dump_period_sec = 0;
+  options.stats_persist_period_sec = 0;
+  options.info_log_level = rocksdb::InfoLogLevel::WARN_LEVEL;
+  return options;
+}
+
+rocksdb::ColumnFamilyOptions RocksStore::familyOptions() {
+  rocksdb::ColumnFamilyOptions options;
+  options.write_buffer_size = 64 << 10;
+  options.max_write_buffer_number = 2;
+  options.target_file_size_base = 256 << 10;
+  options.max_bytes_for_level_base = 1 << 20;
+  options.level0_file_num_compaction_trigger = 2;
+  // values are 1-4 bytes, compression only costs cpu
+  options.compression = rocksdb::kNoCompression;
+  options.bottommost_compression = rocksdb::kNoCompression;
+  rocksdb::BlockBasedTableOptions table;
+  table.block_cache = blockCache_;
+  table.block_size = 1 << 10;
+  table.cache_index_and_filter_blocks = true;
+  options.table_factory.reset(rocksdb::NewBlockBasedTableFactory(table));
+  return options;
+}
+
+bool RocksStore::Exists(const std::wstring& dir) const {
+  return std::filesystem::exists(std::filesystem::path(dir + kDirName));
+}
+
+void RocksStore::Remove(const std::wstring& dir) const {
+  std::filesystem::remove_all(std::filesystem::path(dir + kDirName));
+}
+
+bool RocksStore::Open(const std::wstring& dir) {
+  blockCache_ = rocksdb::NewLRUCache(256 << 10);
+  auto familyOpts = familyOptions();
+  std::vector<rocksdb::ColumnFamilyDescriptor> descriptors;
+  for (const char* name : kFamilyNames) {
+    descriptors.emplace_back(name, familyOpts);
+  }
+  std::vector<rocksdb::ColumnFamilyHandle*> handles;
+  auto begin = std::chrono::steady_clock::now();
+  auto status = rocksdb::DB::Open(dbOptions(),
+                                  LAppPal::WStringToString(dir + kDirName),
+                                  descriptors, &handles, &db);
+  if (!status.ok()) {
+    LAppPal::PrintLog(LogLevel::Error, "[RocksStore]Failed to open db: %d",
+                      status.code());
+    db = nullptr;
+    return false;
+  }
+  std::copy(handles.begin(), handles.end(), families_.begin());
+  LAppPal::PrintLog(
+      LogLevel::Debug, "[RocksStore]Opened in %lldms",
+      static_cast<long long>(
+          std::chrono::duration_cast<std::chrono::milliseconds>(
+              std::chrono::steady_clock::now() - begin)
+              .count()));
+  splitFamilies();
+  return true;
+}
+
+void RocksStore::Close() {
+  if (db == nullptr) {
+    return;
+  }
+  for (auto* handle : families_) {
+    db->DestroyColumnFamilyHandle(handle);
+  }
+  families_ = {};
+  db->Close();
+  delete db;
+  db = nullptr;
+}
+
+/**
+ * Move keys written before column families existed out of the default
+ * family. Runs once, kLayoutKey marks it done.
+ */
+void RocksStore::splitFamilies() {
+  std::string marker;
+  if (db->Get(rocksdb::ReadOptions(), families_[kDefault], ToSlice(kLayoutKey),
+              &marker)
+          .ok()) {
+    return;
+  }
+  rocksdb::WriteBatch batch;
+  int moved = 0;
+  std::unique_ptr<rocksdb::Iterator> it(
+      db->NewIterator(rocksdb::ReadOptions(), families_[kDefault]));
+  for (it->SeekToFirst(); it->Valid(); it->Next()) {
+    auto key = it->key();
+    Family target = family(std::string_view(key.data(), key.size()));
+    if (target == kDefault) {
+      continue;
+    }
+    batch.Put(families_[target], key, it->value());
+    batch.Delete(families_[kDefault], key);
+    moved++;
+  }
+  if (!it->status().ok()) {
+    LAppPal::PrintLog(LogLevel::Error,
+                      "[RocksStore]Scan default family failed: %d",
+                      it->status().code());
+    return;
+  }
+  batch.Put(families_[kDefault], ToSlice(kLayoutKey), "1");
+  rocksdb::WriteOptions options;
+  options.sync = true;
+  if (db->Write(options, &batch).ok()) {
+    LAppPal::PrintLog(LogLevel::Info,
+                      "[RocksStore]Moved %d keys to column families", moved);
+  }
+}
+
+bool RocksStore::Get(std::string_view key, std::string& value) {
+  return db->Get(rocksdb::ReadOptions(), route(key), ToSlice(key), &value).ok();
+}
+
+std::vector<std::optional<std::string>> RocksStore::MultiGet(
+    const std::vector<std::string_view>& keys) {
+  std::vector<rocksdb::ColumnFamilyHandle*> families;
+  std::vector<rocksdb::Slice> slices;
+  for (auto key : keys) {
+    families.push_back(route(key));
+    slices.push_back(ToSlice(key));
+  }
+  std::vector<std::string> values;
+  auto statuses =
+      db->MultiGet(rocksdb::ReadOptions(), families, slices, &values);
+  std::vector<std::optional<std::string>> result(keys.size());
+  for (size_t i = 0; i < keys.size(); i++) {
+    if (statuses[i].ok()) {
+      result[i] = std::move(values[i]);
+    }
+  }
+  return result;
+}
+
+bool RocksStore::scanFamily(rocksdb::ColumnFamilyHandle* handle,
+                            std::string_view prefix, const Visitor& visit) {
+  std::unique_ptr<rocksdb::Iterator> it(
+      db->NewIterator(rocksdb::ReadOptions(), handle));
+  for (it->Seek(ToSlice(prefix)); it->Valid(); it->Next()) {
+    auto key = it->key();
+    std::string_view view(key.data(), key.size());
+    if (view.substr(0, prefix.size()) != prefix) {
+      break;
+    }
+    if (handle == families_[kDefault] && view == kLayoutKey) {
+      continue;
+    }
+    auto value = it->value();
+    visit(view, std::string_view(value.data(), value.size()));
+  }
+  if (!it->status().ok()) {
+    LAppPal::PrintLog(LogLevel::Error, "[RocksStore]Scan %s failed: %d",
+                      std::string(prefix).c_str(), it->status().code());
+    return false;
+  }
+  return true;
+}
+
+// a non-empty prefix must select a single family, e.g. "task." or "part.".
+// an empty prefix walks every family in turn
+bool RocksStore::Scan(std::string_view prefix, const Visitor& visit) {
+  if (!prefix.empty()) {
+    return scanFamily(route(prefix), prefix, visit);
+  }
+  bool ok = true;
+  for (auto* handle : families_) {
+    ok = scanFamily(handle, prefix, visit) && ok;
+  }
+  return ok;
+}
+
+bool RocksStore::Write(const std::vector<Entry>& puts, bool sync) {
+  rocksdb::WriteBatch batch;
+  for (const auto& [key, value] : puts) {
+    batch.Put(route(key), ToSlice(key), ToSlice(value));
+  }
+  rocksdb::WriteOptions options;
+  options.sync = sync;
+  auto status = db->Write(options, &batch);
+  if (!status.ok()) {
+    LAppPal::PrintLog(LogLevel::Error, "[RocksStore]Write batch failed: %d",
+                      status.code());
+    return false;
+  }
+  return true;
+}
+
+bool RocksStore::Clear(bool sync) {
+  rocksdb::Slice start("");
+  rocksdb::Slice end("\xFF");
+  rocksdb::WriteBatch batch;
+  for (auto* handle : families_) {
+    batch.DeleteRange(handle, start, end);
+  }
+  // the layout is unchanged, keep the marker
+  batch.Put(families_[kDefault], ToSlice(kLayoutKey), "1");
+  rocksdb::WriteOptions options;
+  options.sync = sync;
+  auto status = db->Write(options, &batch);
+  if (!status.ok()) {
+    LAppPal::PrintLog(LogLevel::Error, "[RocksStore]Clear failed: %d",
+                      status.code());
+    return false;
+  }
+  return true;
+}
+
+bool RocksStore::Sync() {
+  auto status = db->SyncWAL();
+  if (!status.ok()) {
+    LAppPal::PrintLog(LogLevel::Error, "[RocksStore]Sync WAL failed: %d",
+                      status.code());
+    return false;
+  }
+  return true;
+}
+
+void RocksStore::LogStats() {
+  uint64_t memtables = 0;
+  db->GetAggregatedIntProperty("rocksdb.cur-size-all-mem-tables", &memtables);
+  LAppPal::PrintLog(LogLevel::Debug,
+                    "[RocksStore]Memtables %lluKB, block cache %lluKB",
+                    static_cast<unsigned long long>(memtables >> 10),
+                    static_cast<unsigned long long>(blockCache_->GetUsage() >> 10));
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <array>
+#include <memory>
+#include <rocksdb/cache.h>
+#include <rocksdb/db.h>
+#include <rocksdb/options.h>
+
+#include "GameStore.hpp"
+
+/**
+ * @brief  GameStore on RocksDB, tuned for a few hundred tiny values.
+ */
+class RocksStore : public GameStore {
+ private:
+  // column families, one per key family so a hot family never shares a
+  // memtable or compaction with an unrelated one
+  enum Family : size_t {
+    kDefault,
+    kAttr,
+    kTask,
+    kPart,
+    kShortcut,
+    kCredentials,
+    kFamilyCount,
+  };
+  static constexpr std::array<const char*, kFamilyCount> kFamilyNames = {
+      "default", "attr", "task", "part", "shortcut", "credentials"};
+  // written once keys of the default column family were split out
+  static constexpr std::string_view kLayoutKey = "storage.layout";
+
+  rocksdb::DB* db = nullptr;
+  std::array<rocksdb::ColumnFamilyHandle*, kFamilyCount> families_{};
+  std::shared_ptr<rocksdb::Cache> blockCache_;
+
+  static Family family(std::string_view key);
+
+  rocksdb::ColumnFamilyHandle* route(std::string_view key) const {
+    return families_[family(key)];
+  }
+
+  rocksdb::DBOptions dbOptions();
+
+  rocksdb::ColumnFamilyOptions familyOptions();
+
+  void splitFamilies();
+
+  bool scanFamily(rocksdb::ColumnFamilyHandle* handle, std::string_view prefix,
+                  const Visitor& visit);
+
+ public:
+  ~RocksStore() override { Close(); }
+
+  const char* Name() const override { return "rocksdb"; }
+
+  bool Exists(const std::wstring& dir) const override;
+
+  void Remove(const std::wstring& dir) const override;
+
+  bool Open(const std::wstring& dir) override;
+
+  void Close() override;
+
+  bool Get(std::string_view key, std::string& value) override;
+
+  std::vector<std::optional<std::string>> MultiGet(
+      const std::vector<std::string_view>& keys) override;
+
+  bool Scan(std::string_view prefix, const Visitor& visit) override;
+
+  bool Write(const std::vector<Entry>& puts, bool sync) override;
+
+  bool Clear(bool sync) override;
+
+  bool Sync() override;
+
+  void LogStats() override;
+};
@@ -0,0 +1,456 @@
+#include "SseHub.hpp"
+
+#include <cctype>
+#include <charconv>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <arpa/inet.h>
+#include <cerrno>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+#ifdef _WIN32
+using socket_t = SOCKET;
+constexpr socket_t kInvalidSocket = INVALID_SOCKET;
+constexpr int kSendFlags = 0;
+
+int Poll(std::vector<pollfd>& fds, int timeout_ms) {
+  return WSAPoll(fds.data(), static_cast<ULONG>(fds.size()), timeout_ms);
+}
+
+void CloseSocket(socket_t s) { closesocket(s); }
+
+bool SetNonBlocking(socket_t s) {
+  u_long on = 1;
+  return ioctlsocket(s, FIONBIO, &on) == 0;
+}
+
+bool WouldBlock() { return WSAGetLastError() == WSAEWOULDBLOCK; }
+#else
+using socket_t = int;
+constexpr socket_t kInvalidSocket = -1;
+constexpr int kSendFlags = MSG_NOSIGNAL;
+
+int Poll(std::vector<pollfd>& fds, int timeout_ms) {
+  return poll(fds.data(), fds.size(), timeout_ms);
+}
+
+void CloseSocket(socket_t s) { close(s); }
+
+bool SetNonBlocking(socket_t s) {
+  int flags = fcntl(s, F_GETFL, 0);
+  return flags >= 0 && fcntl(s, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+
+bool WouldBlock() {
+  return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+}
+#endif
+
+constexpr size_t kMaxRequest = 8192;
+
+bool EqualsIgnoreCase(std::string_view a, std::string_view b) {
+  if (a.size() != b.size()) {
+    return false;
+  }
+  for (size_t i = 0; i < a.size(); i++) {
+    if (std::tolower(static_cast<unsigned char>(a[i])) !=
+        std::tolower(static_cast<unsigned char>(b[i]))) {
+      return false;
+    }
+  }
+  return true;
+}
+
+std::string_view Trim(std::string_view s) {
+  size_t begin = s.find_first_not_of(" \t\r");
+  if (begin == std::string_view::npos) {
+    return {};
+  }
+  return s.substr(begin, s.find_last_not_of(" \t\r") - begin + 1);
+}
+
+std::optional<uint64_t> ParseId(std::string_view s) {
+  uint64_t id = 0;
+  auto [end, ec] = std::from_chars(s.data(), s.data() + s.size(), id);
+  if (ec != std::errc() || end != s.data() + s.size()) {
+    return std::nullopt;
+  }
+  return id;
+}
+
+struct SseRequest {
+  bool valid = false;
+  std::optional<uint64_t> last_id;
+};
+
+// "GET /api/sse?last_id=N HTTP/1.1" and its headers up to the blank line
+SseRequest ParseRequest(std::string_view head) {
+  SseRequest request;
+  size_t eol = head.find('\n');
+  std::string_view line = Trim(head.substr(0, eol));
+  size_t space = line.find(' ');
+  if (space == std::string_view::npos || line.substr(0, space) != "GET") {
+    return request;
+  }
+  std::string_view target = line.substr(space + 1);
+  target = target.substr(0, target.find(' '));
+  size_t question = target.find('?');
+  if (target.substr(0, question) != "/api/sse") {
+    return request;
+  }
+  request.valid = true;
+  if (question != std::string_view::npos) {
+    std::string_view query = target.substr(question + 1);
+    while (!query.empty()) {
+      size_t amp = query.find('&');
+      std::string_view param = query.substr(0, amp);
+      if (param.substr(0, 8) == "last_id=") {
+        if (auto id = ParseId(param.substr(8))) {
+          request.last_id = id;
+        }
+      }
+      query = amp == std::string_view::npos ? std::string_view()
+                                            : query.substr(amp + 1);
+    }
+  }
+  // the header, sent by EventSource when it reconnects, wins
+  while (eol != std::string_view::npos) {
+    head = head.substr(eol + 1);
+    eol = head.find('\n');
+    std::string_view header = head.substr(0, eol);
+    size_t colon = header.find(':');
+    if (colon != std::string_view::npos &&
+        EqualsIgnoreCase(Trim(header.substr(0, colon)), "Last-Event-ID")) {
+      if (auto id = ParseId(Trim(header.substr(colon + 1)))) {
+        request.last_id = id;
+      }
+    }
+  }
+  return request;
+}
+
+}  // namespace
+
+struct SseHub::Sockets {
+  socket_t listen = kInvalidSocket;
+  // a datagram socket connected to itself, run() polls it to wake up
+  socket_t wake = kInvalidSocket;
+  // a wake up is on its way, more publishes need not send another
+  std::atomic<bool> woken{false};
+
+  Sockets() {
+#ifdef _WIN32
+    WSADATA data;
+    WSAStartup(MAKEWORD(2, 2), &data);
+#endif
+  }
+
+  ~Sockets() {
+    if (listen != kInvalidSocket) {
+      CloseSocket(listen);
+    }
+    if (wake != kInvalidSocket) {
+      CloseSocket(wake);
+    }
+#ifdef _WIN32
+    WSACleanup();
+#endif
+  }
+
+  void Wake() {
+    if (!woken.exchange(true)) {
+      send(wake, "w", 1, kSendFlags);
+    }
+  }
+};
+
+struct SseHub::Client {
+  socket_t fd = kInvalidSocket;
+  // reading the request until then
+  bool streaming = false;
+  // close once out is sent
+  bool closing = false;
+  std::string request;
+  uint64_t cursor = 0;
+  std::string out;
+  size_t sent = 0;
+  Clock::time_point accepted;
+  Clock::time_point last_write;
+};
+
+SseHub::SseHub(EventBus& bus, const SseHubOptions& options)
+    : _bus(bus), _options(options) {}
+
+SseHub::~SseHub() { Stop(); }
+
+bool SseHub::Start(const std::string& addr, int port) {
+  if (_thread.joinable()) {
+    return true;
+  }
+  auto sockets = std::make_shared<Sockets>();
+  sockaddr_in address{};
+  address.sin_family = AF_INET;
+  address.sin_port = htons(static_cast<uint16_t>(port));
+  if (inet_pton(AF_INET, addr.c_str(), &address.sin_addr) != 1) {
+    return false;
+  }
+  sockets->listen = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+  if (sockets->listen == kInvalidSocket) {
+    return false;
+  }
+#ifndef _WIN32
+  int on = 1;
+  setsockopt(sockets->listen, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+#endif
+  socklen_t length = sizeof(address);
+  if (bind(sockets->listen, reinterpret_cast<sockaddr*>(&address),
+           sizeof(address)) != 0 ||
+      listen(sockets->listen, SOMAXCONN) != 0 ||
+      !SetNonBlocking(sockets->listen) ||
+      getsockname(sockets->listen, reinterpret_cast<sockaddr*>(&address),
+                  &length) != 0) {
+    return false;
+  }
+  int listen_port = ntohs(address.sin_port);
+
+  sockaddr_in loopback{};
+  loopback.sin_family = AF_INET;
+  loopback.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  sockets->wake = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+  length = sizeof(loopback);
+  if (sockets->wake == kInvalidSocket ||
+      bind(sockets->wake, reinterpret_cast<sockaddr*>(&loopback),
+           sizeof(loopback)) != 0 ||
+      getsockname(sockets->wake, reinterpret_cast<sockaddr*>(&loopback),
+                  &length) != 0 ||
+      connect(sockets->wake, reinterpret_cast<sockaddr*>(&loopback),
+              sizeof(loopback)) != 0 ||
+      !SetNonBlocking(sockets->wake)) {
+    return false;
+  }
+
+  _sockets = sockets;
+  _port = listen_port;
+  _stop = false;
+  _bus.SetListener([sockets] { sockets->Wake(); });
+  _thread = std::thread(&SseHub::run, this);
+  return true;
+}
+
+void SseHub::Stop() {
+  if (!_thread.joinable()) {
+    return;
+  }
+  _stop = true;
+  _sockets->Wake();
+  _thread.join();
+  _bus.SetListener(nullptr);
+  _sockets.reset();
+}
+
+SseHubStats SseHub::Stats() const {
+  std::lock_guard<std::mutex> lock(_stats_mutex);
+  return _stats;
+}
+
+void SseHub::run() {
+  std::vector<std::unique_ptr<Client>> clients;
+  std::vector<pollfd> fds;
+  char buffer[4096];
+  while (!_stop) {
+    fds.clear();
+    fds.push_back({_sockets->wake, POLLIN, 0});
+    fds.push_back({_sockets->listen, POLLIN, 0});
+    for (const auto& client : clients) {
+      short events = POLLIN;
+      if (client->sent < client->out.size()) {
+        events |= POLLOUT;
+      }
+      fds.push_back({client->fd, events, 0});
+    }
+    // wakes up for the heartbeats, else only when there is something to do
+    Poll(fds, static_cast<int>(_options.heartbeat.count()));
+    if (_stop) {
+      break;
+    }
+    SseHubStats stats;
+    auto now = Clock::now();
+    if (fds[0].revents & POLLIN) {
+      while (recv(_sockets->wake, buffer, sizeof(buffer), 0) > 0) {
+      }
+      // cleared after draining and before reading the bus: a publish from
+      // now on sends a wake up that is still there for the next poll
+      _sockets->woken = false;
+    }
+    if (fds[1].revents & POLLIN) {
+      while (true) {
+        socket_t fd = accept(_sockets->listen, nullptr, nullptr);
+        if (fd == kInvalidSocket) {
+          break;
+        }
+        if (clients.size() >= _options.max_clients || !SetNonBlocking(fd)) {
+          CloseSocket(fd);
+          stats.rejected++;
+          continue;
+        }
+        int on = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY,
+                   reinterpret_cast<const char*>(&on), sizeof(on));
+        auto client = std::make_unique<Client>();
+        client->fd = fd;
+        client->accepted = now;
+        client->last_write = now;
+        clients.push_back(std::move(client));
+        stats.accepted++;
+      }
+    }
+    for (size_t i = 0; i < clients.size(); i++) {
+      Client& client = *clients[i];
+      // clients accepted just now were not polled
+      short revents = i + 2 < fds.size() ? fds[i + 2].revents : 0;
+      bool gone = false;
+      if (revents & (POLLIN | POLLHUP | POLLERR)) {
+        while (true) {
+          auto n = recv(client.fd, buffer, sizeof(buffer), 0);
+          if (n > 0) {
+            // nothing is expected once streaming
+            if (!client.streaming) {
+              client.request.append(buffer, static_cast<size_t>(n));
+            }
+            continue;
+          }
+          gone = n == 0 || !WouldBlock();
+          break;
+        }
+      }
+      if (!gone && !client.streaming) {
+        if (client.request.find("\r\n\r\n") != std::string::npos ||
+            client.request.find("\n\n") != std::string::npos) {
+          serve(client);
+        } else if (client.request.size() > kMaxRequest ||
+                   now - client.accepted > _options.request_timeout) {
+          gone = true;
+        }
+      }
+      if (!gone && client.streaming && client.sent == client.out.size() &&
+          now - client.last_write >= _options.heartbeat) {
+        client.out.append(":\n\n");
+      }
+      // a client that took all it was sent may read on right away
+      while (!gone) {
+        bool more = fill(client, stats);
+        gone = !flush(client, stats);
+        if (!more || client.sent < client.out.size()) {
+          break;
+        }
+      }
+      if (gone) {
+        CloseSocket(client.fd);
+        stats.closed++;
+        clients[i] = std::move(clients.back());
+        clients.pop_back();
+        i--;
+      }
+    }
+    _clients_count = clients.size();
+    std::lock_guard<std::mutex> lock(_stats_mutex);
+    _stats.accepted += stats.accepted;
+    _stats.rejected += stats.rejected;
+    _stats.closed += stats.closed;
+    _stats.events += stats.events;
+    _stats.bytes += stats.bytes;
+  }
+  for (const auto& client : clients) {
+    CloseSocket(client->fd);
+  }
+  _clients_count = 0;
+}
+
+void SseHub::serve(Client& client) {
+  SseRequest request = ParseRequest(client.request);
+  client.request.clear();
+  client.request.shrink_to_fit();
+  if (!request.valid) {
+    client.out =
+        "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\n"
+        "Connection: close\r\n\r\n";
+    client.closing = true;
+    return;
+  }
+  // without an id only what comes next
+  client.cursor = request.last_id.value_or(_bus.Last());
+  client.streaming = true;
+  // the body lasts until the connection closes, the panel is served from
+  // another port
+  client.out =
+      "HTTP/1.1 200 OK\r\nContent-Type: text/event-stream\r\n"
+      "Cache-Control: no-cache\r\nAccess-Control-Allow-Origin: *\r\n\r\n"
+      "retry: " +
+      std::to_string(_options.retry.count()) + "\n\n";
+}
+
+bool SseHub::fill(Client& client, SseHubStats& stats) {
+  if (!client.streaming || client.closing ||
+      client.out.size() - client.sent >= _options.max_buffer) {
+    return false;
+  }
+  if (client.sent == client.out.size()) {
+    client.out.clear();
+    client.sent = 0;
+  }
+  uint64_t cursor = client.cursor;
+  client.cursor = _bus.Read(
+      client.cursor, [&](uint64_t id, const std::string& data) {
+        client.out.append("id: ").append(std::to_string(id)).append("\n");
+        // every line of the data in its own field
+        size_t begin = 0;
+        while (true) {
+          size_t end = data.find('\n', begin);
+          client.out.append("data: ")
+              .append(data, begin,
+                      end == std::string::npos ? std::string::npos
+                                               : end - begin)
+              .append("\n");
+          if (end == std::string::npos) {
+            break;
+          }
+          begin = end + 1;
+        }
+        client.out.append("\n");
+        stats.events++;
+        return client.out.size() - client.sent < _options.max_buffer;
+      });
+  return client.cursor != cursor;
+}
+
+bool SseHub::flush(Client& client, SseHubStats& stats) {
+  while (client.sent < client.out.size()) {
+    auto n = send(client.fd, client.out.data() + client.sent,
+                  static_cast<int>(client.out.size() - client.sent),
+                  kSendFlags);
+    if (n > 0) {
+      client.sent += static_cast<size_t>(n);
+      client.last_write = Clock::now();
+      stats.bytes += static_cast<uint64_t>(n);
+      continue;
+    }
+    return n < 0 && WouldBlock();
+  }
+  return !client.closing;
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "EventBus.hpp"
+
+struct SseHubOptions {
+  size_t max_clients = 1024;
+  // a comment line to idle clients, finds closed ones
+  std::chrono::milliseconds heartbeat{15000};
+  // a client that sent no full request in time is closed
+  std::chrono::milliseconds request_timeout{5000};
+  // events queued per client before it is read from the bus again, a slow
+  // client holds its cursor instead of memory
+  size_t max_buffer = 64 * 1024;
+  // reconnect delay the clients are told
+  std::chrono::milliseconds retry{1000};
+};
+
+struct SseHubStats {
+  uint64_t accepted = 0;
+  uint64_t rejected = 0;
+  uint64_t closed = 0;
+  uint64_t events = 0;
+  uint64_t bytes = 0;
+};
+
+/**
+ * @brief  Streams an EventBus to any number of EventSource clients from a
+ * single thread. Every client is a non-blocking socket with its own cursor
+ * into the bus, so a slow or gone client never holds up the others or a
+ * worker thread. The cursor starts at the Last-Event-ID header, or the
+ * last_id query parameter, to resume, else at the newest event.
+ */
+class SseHub {
+ public:
+  explicit SseHub(EventBus& bus, const SseHubOptions& options = {});
+
+  // out of line, Client is only complete in SseHub.cpp
+  ~SseHub();
+
+  /**
+   * @brief  Listen on addr, port 0 picks a free one, and serve until Stop().
+   * @return false if the address cannot be bound
+   */
+  bool Start(const std::string& addr = "127.0.0.1", int port = 0);
+
+  void Stop();
+
+  int Port() const { return _port; }
+
+  size_t Clients() const { return _clients_count; }
+
+  SseHubStats Stats() const;
+
+ private:
+  struct Client;
+  struct Sockets;
+
+  EventBus& _bus;
+  SseHubOptions _options;
+  // shared with the bus listener, which may still run after Stop()
+  std::shared_ptr<Sockets> _sockets;
+  std::thread _thread;
+  std::atomic<bool> _stop{false};
+  std::atomic<size_t> _clients_count{0};
+  int _port = 0;
+  mutable std::mutex _stats_mutex;
+  SseHubStats _stats;
+
+  void run();
+  void serve(Client& client);
+  // false if there was nothing new
+  bool fill(Client& client, SseHubStats& stats);
+  // false if the client is gone
+  bool flush(Client& client, SseHubStats& stats);
+};
@@ -0,0 +1,5 @@
+#include "Task.hpp"
+
+#include "DataManager.hpp"
+
+void ExpTask::Execute() { DataManager::GetInstance()->AccrueExp(); }
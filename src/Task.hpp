@@ -1,60 +1,63 @@
 #pragma once
 
+#include <chrono>
 #include <croncpp.h>
-
-#include "DataManager.hpp"
+#include <ctime>
+#include <functional>
+#include <optional>
 
 class Task {
  public:
-  virtual bool ShouldExecute() = 0;
+  using Clock = std::chrono::system_clock;
+
+  /**
+   * @brief  When the task should run next.
+   * @param  now  current time, after the previous run if there was one
+   * @return nullopt once the task is done, the scheduler then drops it
+   */
+  virtual std::optional<Clock::time_point> Next(Clock::time_point now) = 0;
   virtual void Execute() = 0;
-  virtual bool IsDone() = 0;
-  virtual void SetDone() = 0;
   virtual ~Task() {}
 };
 
+/**
+ * @brief  Settles exp every quarter hour. Exp is owed per minute, this only
+ * decides how often it shows up, see DataManager::AccrueExp().
+ */
 class ExpTask : public Task {
  public:
-  bool ShouldExecute() override {
-    static std::time_t next = cron::cron_next(_cron, std::time(0));
-    std::time_t now = std::time(0);
-    if (now < next) {
-      return false;
-    }
-    next = cron::cron_next(_cron, now);
-    return true;
+  std::optional<Clock::time_point> Next(Clock::time_point now) override {
+    return Clock::from_time_t(cron::cron_next(_cron, Clock::to_time_t(now)));
   }
-  void Execute() override { DataManager::GetInstance()->AddExp(); }
-  bool IsDone() override {
-    // ExpTask never done
-    return false;
-  }
-  void SetDone() override {}
+  void Execute() override;
 
  private:
-  cron::cronexpr _cron = cron::make_cron("0 * * * * *");
+  cron::cronexpr _cron = cron::make_cron("0 */15 * * * *");
 };
 
-class CheckTask : public Task {
+/**
+ * @brief  Settles a running game task once, at start time + cost, by
+ * calling settle, see DataManager::scheduleSettle().
+ */
+class SettleTimer : public Task {
  public:
-  bool ShouldExecute() override {
-    static std::time_t last = std::time(0);
-    std::time_t now = std::time(0);
-    if (now - last >= 1) {
-      last = now;
-      return true;
+  SettleTimer(time_t deadline, std::function<void()> settle)
+      : _deadline(deadline), _settle(std::move(settle)) {}
+
+  std::optional<Clock::time_point> Next(Clock::time_point now) override {
+    if (_fired) {
+      return std::nullopt;
     }
-    return false;
+    // a deadline in the past, e.g. after a restart, fires right away
+    return Clock::from_time_t(_deadline);
   }
   void Execute() override {
-    auto gameTasks = DataManager::GetInstance()->GetTasks();
-    for (auto& task : gameTasks) {
-      task->TryDone();
-    }
-  }
-  bool IsDone() override {
-    return false;
-  }
-  void SetDone() override {
+    _fired = true;
+    _settle();
   }
+
+ private:
+  time_t _deadline;
+  std::function<void()> _settle;
+  bool _fired = false;
 };
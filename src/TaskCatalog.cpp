@@ -0,0 +1,150 @@
+#include "TaskCatalog.hpp"
+
+#ifdef _WIN32
+#include <Windows.h>
+#endif
+
+#include <chrono>
+#include <fstream>
+
+#include "LAppPal.hpp"
+
+std::shared_ptr<const TaskCatalog> TaskCatalog::Load(
+    const std::filesystem::path& path) {
+  std::ifstream file(path, std::ios::binary | std::ios::ate);
+  if (!file.is_open()) {
+    LAppPal::PrintLog(LogLevel::Error, L"[TaskCatalog]Failed to open %ls",
+                      path.wstring().c_str());
+    return nullptr;
+  }
+  auto catalog = std::make_shared<TaskCatalog>();
+  catalog->bytes_.resize(static_cast<size_t>(file.tellg()));
+  file.seekg(0);
+  file.read(catalog->bytes_.data(), catalog->bytes_.size());
+  if (!file || !catalog->parse()) {
+    LAppPal::PrintLog(LogLevel::Error, L"[TaskCatalog]Invalid catalog %ls",
+                      path.wstring().c_str());
+    return nullptr;
+  }
+  LAppPal::PrintLog(LogLevel::Debug, "[TaskCatalog]Loaded %zu tasks, %zu bytes",
+                    catalog->Size(), catalog->bytes_.size());
+  return catalog;
+}
+
+bool TaskCatalog::parse() {
+  using catalog::CatalogHeader;
+  // bytes_ is a heap block, aligned for any of the structs
+  if (bytes_.size() < sizeof(CatalogHeader)) {
+    return false;
+  }
+  header_ = reinterpret_cast<const CatalogHeader*>(bytes_.data());
+  if (header_->magic != catalog::kMagic ||
+      header_->version != catalog::kVersion) {
+    return false;
+  }
+  size_t defs_size = size_t(header_->count) * sizeof(TaskDef);
+  if (bytes_.size() !=
+      sizeof(CatalogHeader) + defs_size + header_->strings_size) {
+    return false;
+  }
+  defs_ = reinterpret_cast<const TaskDef*>(bytes_.data() +
+                                           sizeof(CatalogHeader));
+  strings_ = bytes_.data() + sizeof(CatalogHeader) + defs_size;
+  auto valid = [this](catalog::StrRef ref) {
+    return ref.offset <= header_->strings_size &&
+           ref.size <= header_->strings_size - ref.offset;
+  };
+  for (const TaskDef& def : *this) {
+    if (!valid(def.title) || !valid(def.desc) || !valid(def.special_title) ||
+        !valid(def.special_desc) || !valid(def.special_key)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+const TaskDef* TaskCatalog::Find(int id) const {
+  for (const TaskDef& def : *this) {
+    if (def.id == id) {
+      return &def;
+    }
+  }
+  return nullptr;
+}
+
+TaskCatalogWatcher::TaskCatalogWatcher(std::filesystem::path path,
+                                       Callback onReload)
+    : path_(std::move(path)), on_reload_(std::move(onReload)) {
+  std::error_code ec;
+  loaded_ = std::filesystem::last_write_time(path_, ec);
+#ifdef _WIN32
+  stop_ = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+#endif
+  worker_ = std::thread(&TaskCatalogWatcher::thread, this);
+}
+
+TaskCatalogWatcher::~TaskCatalogWatcher() {
+#ifdef _WIN32
+  SetEvent(stop_);
+  worker_.join();
+  CloseHandle(stop_);
+#else
+  {
+    std::lock_guard<std::mutex> lock(mtx_);
+    stopping_ = true;
+  }
+  cv_.notify_one();
+  worker_.join();
+#endif
+}
+
+void TaskCatalogWatcher::reload() {
+  std::error_code ec;
+  auto mtime = std::filesystem::last_write_time(path_, ec);
+  if (ec || mtime == loaded_) {
+    return;
+  }
+  // a bad file keeps the current catalog, the next change retries
+  auto catalog = TaskCatalog::Load(path_);
+  if (!catalog) {
+    return;
+  }
+  loaded_ = mtime;
+  LAppPal::PrintLog(LogLevel::Info, "[TaskCatalog]Reloaded %zu tasks",
+                    catalog->Size());
+  on_reload_(catalog);
+}
+
+#ifdef _WIN32
+void TaskCatalogWatcher::thread() {
+  HANDLE change = FindFirstChangeNotificationW(
+      path_.parent_path().c_str(), FALSE,
+      FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_FILE_NAME);
+  if (change == INVALID_HANDLE_VALUE) {
+    LAppPal::PrintLog(LogLevel::Warn, "[TaskCatalog]Cannot watch for changes");
+    return;
+  }
+  HANDLE handles[] = {stop_, change};
+  while (WaitForMultipleObjects(2, handles, FALSE, INFINITE) ==
+         WAIT_OBJECT_0 + 1) {
+    // let the writer finish, changes from here on signal again
+    if (WaitForSingleObject(stop_, 200) == WAIT_OBJECT_0) {
+      break;
+    }
+    FindNextChangeNotification(change);
+    reload();
+  }
+  FindCloseChangeNotification(change);
+}
+#else
+void TaskCatalogWatcher::thread() {
+  // no change notification here, look at the modification time instead
+  std::unique_lock<std::mutex> lock(mtx_);
+  while (!cv_.wait_for(lock, std::chrono::seconds(1),
+                       [this] { return stopping_; })) {
+    lock.unlock();
+    reload();
+    lock.lock();
+  }
+}
+#endif
@@ -0,0 +1,135 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+
+#include "GameSchema.hpp"
+
+/**
+ * @brief  Layout of resources/tasks.bin, written by tools/taskc from
+ * resources/tasks.json:
+ *   CatalogHeader | TaskDef[count] | strings
+ * Strings are UTF-8, not terminated, referenced by offset into the strings
+ * blob. Host byte order; the tool is built with the app, so struct layout
+ * matches.
+ */
+namespace catalog {
+
+constexpr uint32_t kMagic = 0x4354504a;  // "JPTC"
+// bump when the layout below changes
+constexpr uint32_t kVersion = 1;
+
+enum Flag : uint8_t {
+  kRepeatable = 1 << 0,
+  kSpecial = 1 << 1,
+  // only loaded when LAppDefine::DebugLogEnable
+  kDebug = 1 << 2,
+};
+
+struct StrRef {
+  uint32_t offset;
+  uint32_t size;
+};
+
+struct CatalogHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t count;
+  uint32_t strings_size;
+};
+
+struct TaskDef {
+  int32_t id;
+  int32_t cost;
+  StrRef title;
+  StrRef desc;
+  // special reward, only with kSpecial
+  StrRef special_title;
+  StrRef special_desc;
+  StrRef special_key;
+  AttrMap requirements;
+  AttrMap rewards;
+  uint8_t flags;
+  uint8_t reserved[3];
+};
+
+static_assert(std::is_trivially_copyable_v<TaskDef>);
+static_assert(std::is_trivially_copyable_v<CatalogHeader>);
+
+}  // namespace catalog
+
+using catalog::TaskDef;
+
+/**
+ * @brief  Read-only task definitions, loaded from one buffer. Definitions
+ * point into it, so the catalog must outlive every task built from it;
+ * tasks hold it by shared_ptr.
+ */
+class TaskCatalog {
+ public:
+  /**
+   * @brief  Load and validate a compiled catalog.
+   * @return nullptr if the file is missing, truncated or inconsistent
+   */
+  static std::shared_ptr<const TaskCatalog> Load(
+      const std::filesystem::path& path);
+
+  size_t Size() const { return header_->count; }
+
+  const TaskDef& operator[](size_t i) const { return defs_[i]; }
+
+  const TaskDef* begin() const { return defs_; }
+
+  const TaskDef* end() const { return defs_ + header_->count; }
+
+  const TaskDef* Find(int id) const;
+
+  std::string_view Str(catalog::StrRef ref) const {
+    return std::string_view(strings_ + ref.offset, ref.size);
+  }
+
+ private:
+  std::string bytes_;
+  const catalog::CatalogHeader* header_ = nullptr;
+  const TaskDef* defs_ = nullptr;
+  const char* strings_ = nullptr;
+
+  bool parse();
+};
+
+/**
+ * @brief  Reload a catalog file whenever it changes on disk, e.g. after
+ * `cmake --build . --target task_catalog`.
+ */
+class TaskCatalogWatcher {
+ public:
+  using Callback = std::function<void(std::shared_ptr<const TaskCatalog>)>;
+
+  TaskCatalogWatcher(std::filesystem::path path, Callback onReload);
+  ~TaskCatalogWatcher();
+
+ private:
+  std::filesystem::path path_;
+  Callback on_reload_;
+  std::filesystem::file_time_type loaded_;
+#ifdef _WIN32
+  void* stop_ = nullptr;
+#else
+  std::mutex mtx_;
+  std::condition_variable cv_;
+  bool stopping_ = false;
+#endif
+  std::thread worker_;
+
+  // load the file again if it changed since the last load
+  void reload();
+  void thread();
+};
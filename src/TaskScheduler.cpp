@@ -1,57 +1,102 @@
 #include "TaskScheduler.hpp"
 #include "LAppPal.hpp"
+#include <algorithm>
 #include <memory>
 
-TaskScheduler::TaskScheduler() {
+TaskScheduler::TaskScheduler(std::shared_ptr<SchedulerClock> clock)
+    : _clock(std::move(clock)) {
   _worker = std::thread(&TaskScheduler::doRun, this);
 }
 
 TaskScheduler::~TaskScheduler() {
-  _running = false;
-  _mutex.lock();
-  _tasks.clear();
-  _mutex.unlock();
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _running = false;
+    _heap.clear();
+    _tasks.clear();
+  }
+  _cv.notify_one();
   // wait for worker thread
   _worker.join();
 }
 
 void TaskScheduler::AddTask(std::shared_ptr<Task> task) {
-  std::lock_guard<std::mutex> lock(_mutex);
-  _tasks.push_back(task);
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_tasks.count(task.get()) > 0) {
+      return;
+    }
+    uint64_t generation = ++_generation;
+    _tasks[task.get()] = generation;
+    schedule(task, generation);
+  }
+  // the new task may be due before whatever the worker waits for
+  _cv.notify_one();
 }
 
 void TaskScheduler::RemoveTask(std::shared_ptr<Task> task) {
-  std::lock_guard<std::mutex> lock(_mutex);
-  auto it = std::find(_tasks.begin(), _tasks.end(), task);
-  if (it != _tasks.end()) {
-    _tasks.erase(it);
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_tasks.erase(task.get()) == 0) {
+      return;
+    }
   }
+  _cv.notify_one();
 }
 
-void TaskScheduler::doRun() {
-  LAppPal::PrintLog(LogLevel::Info, "[TaskScheduler]Worker running %d", std::this_thread::get_id());
-  while (_running) {
-    std::this_thread::sleep_for(std::chrono::milliseconds(500));
-    tick();
+uint64_t TaskScheduler::Wakeups() {
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _wakeups;
+}
+
+// _mutex must be held
+void TaskScheduler::schedule(const std::shared_ptr<Task>& task,
+                             uint64_t generation) {
+  auto next = task->Next(_clock->Now());
+  if (!next) {
+    _tasks.erase(task.get());
+    return;
   }
-  LAppPal::PrintLog(LogLevel::Info, "[TaskScheduler]Worker exit");
+  _heap.push_back({*next, task, generation});
+  std::push_heap(_heap.begin(), _heap.end());
 }
 
-void TaskScheduler::tick() {
-  std::lock_guard<std::mutex> lock(_mutex);
-  for (auto it = _tasks.begin(); it != _tasks.end();) {
-    if (!_running) {
-      break;
+void TaskScheduler::doRun() {
+  LAppPal::PrintLog(LogLevel::Info, "[TaskScheduler]Worker running");
+  std::unique_lock<std::mutex> lock(_mutex);
+  while (_running) {
+    // drop entries of removed tasks so they never hold the worker awake
+    while (!_heap.empty()) {
+      auto it = _tasks.find(_heap.front().task.get());
+      if (it != _tasks.end() && it->second == _heap.front().generation) {
+        break;
+      }
+      std::pop_heap(_heap.begin(), _heap.end());
+      _heap.pop_back();
+    }
+    if (_heap.empty()) {
+      _cv.wait(lock);
+      _wakeups++;
+      continue;
     }
-    std::shared_ptr<Task> task = *it;
-    if (task->IsDone()) {
-      it = _tasks.erase(it);
+    if (_clock->Now() < _heap.front().deadline) {
+      _clock->WaitUntil(_cv, lock, _heap.front().deadline);
+      _wakeups++;
+      // woken early, by a change or spuriously, look again
       continue;
     }
-    if (task->ShouldExecute()) {
-      task->Execute();
-      task->SetDone();
+    std::pop_heap(_heap.begin(), _heap.end());
+    Entry entry = std::move(_heap.back());
+    _heap.pop_back();
+    // run unlocked, so a task may add or remove tasks
+    lock.unlock();
+    entry.task->Execute();
+    lock.lock();
+    auto it = _tasks.find(entry.task.get());
+    if (_running && it != _tasks.end() && it->second == entry.generation) {
+      schedule(entry.task, entry.generation);
     }
-    ++it;
   }
+  LAppPal::PrintLog(LogLevel::Info, "[TaskScheduler]Worker exit after %llu wakeups",
+                    static_cast<unsigned long long>(_wakeups));
 }
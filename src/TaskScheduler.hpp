@@ -1,33 +1,87 @@
 #pragma once
 
+#include <condition_variable>
 #include <memory>
 #include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
 
 #include "Task.hpp"
 
+/**
+ * @brief Time source of the scheduler, replaceable so a run can be simulated
+ * without waiting in real time.
+ */
+class SchedulerClock {
+  public:
+    virtual ~SchedulerClock() = default;
+
+    virtual Task::Clock::time_point Now() { return Task::Clock::now(); }
+
+    /**
+     * @brief Block until deadline, or until cv is notified.
+     */
+    virtual void WaitUntil(std::condition_variable& cv,
+                           std::unique_lock<std::mutex>& lock,
+                           Task::Clock::time_point deadline) {
+      cv.wait_until(lock, deadline);
+    }
+};
 
 /**
  * @brief TaskScheduler manages a list of tasks and executes them in a separate thread.
  * such as game exp and game task timer etc.
+ * Tasks sit in a min-heap by their next deadline, the worker sleeps until
+ * the earliest one is due or the task set changes, so it never wakes up
+ * while nothing is due.
  */
 class TaskScheduler {
   public:
+    explicit TaskScheduler(std::shared_ptr<SchedulerClock> clock);
     ~TaskScheduler();
 
     static TaskScheduler* GetInstance() {
-      static TaskScheduler instance;
+      static TaskScheduler instance(std::make_shared<SchedulerClock>());
       return &instance;
     }
 
     void AddTask(std::shared_ptr<Task> task);
+
+    /**
+     * @brief Cancel task, it never runs again once this returns, unless it
+     * is executing right now.
+     */
     void RemoveTask(std::shared_ptr<Task> task);
 
+    /**
+     * @brief Times the worker woke up, due or not.
+     */
+    uint64_t Wakeups();
+
   private:
-    TaskScheduler();
-    std::vector<std::shared_ptr<Task>> _tasks;
+    struct Entry {
+      Task::Clock::time_point deadline;
+      std::shared_ptr<Task> task;
+      uint64_t generation;
+
+      // std heap functions build a max-heap, invert for the earliest first
+      bool operator<(const Entry& other) const {
+        return deadline > other.deadline;
+      }
+    };
+
+    std::shared_ptr<SchedulerClock> _clock;
+    std::vector<Entry> _heap;
+    // scheduled tasks by the generation they were added in, heap entries of
+    // removed or re-added tasks no longer match and are skipped when popped
+    std::unordered_map<Task*, uint64_t> _tasks;
+    uint64_t _generation = 0;
     std::mutex _mutex;
+    std::condition_variable _cv;
     std::thread _worker;
     bool _running = true;
+    uint64_t _wakeups = 0;
     void doRun();
-    void tick();
+    void schedule(const std::shared_ptr<Task>& task, uint64_t generation);
 };
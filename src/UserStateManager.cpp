@@ -1,7 +1,9 @@
 ﻿#include "UserStateManager.h"
 #include "DataManager.hpp"
+#include "HttpPool.hpp"
 #include "LAppDefine.hpp"
 #include "LAppPal.hpp"
+#include "WbiSigner.hpp"
 
 #ifndef CPPHTTPLIB_OPENSSL_SUPPORT
 #define CPPHTTPLIB_OPENSSL_SUPPORT
@@ -13,11 +15,11 @@
 using namespace WinToastLib;
 
 void UserStateManager::CheckUpdate(bool notify) {
-  httplib::SSLClient live_cli("pet.vjoi.cn", 443);
-  live_cli.set_follow_location(true);
-  live_cli.enable_server_certificate_verification(false);
-  live_cli.set_connection_timeout(std::chrono::seconds(1));
-  auto res = live_cli.Get("/version.txt");
+  HttpOptions options;
+  options.follow_location = true;
+  options.verify = false;
+  auto res = HttpPool::GetInstance()->Get("pet.vjoi.cn", "/version.txt", {},
+                                          options);
   if (res && res->status == 200) {
     LAppPal::PrintLog(
         LogLevel::Debug,
@@ -44,19 +46,19 @@ void UserStateManager::CheckUpdate(bool notify) {
     if (local_version < latest_version) {
       LAppPal::PrintLog("[UserStateWatcher]Need Update: %s -> %s ", VERSION,
                         res->body.c_str());
-      DataManager::GetInstance()->SetRaw("need_update", 1);
-      DataManager::GetInstance()->SetRaw("latest_version", latest_version.to_string());
+      DataManager::GetInstance()->Set(keys::NeedUpdate, 1);
+      DataManager::GetInstance()->Set(keys::LatestVersion, latest_version.to_string());
       if (notify) {
         Notify(L"检测到新版本", L"请前往项目页面下载",
                new WinToastEventHandler("https://pet.vjoi.cn"));
       }
     } else {
-      DataManager::GetInstance()->SetRaw("latest_version",
+      DataManager::GetInstance()->Set(keys::LatestVersion,
                                          latest_version.to_string());
-      DataManager::GetInstance()->SetRaw("need_update", 0);
+      DataManager::GetInstance()->Set(keys::NeedUpdate, 0);
     }
   } else {
-    DataManager::GetInstance()->SetRaw("need_update", 0);
+    DataManager::GetInstance()->Set(keys::NeedUpdate, 0);
     LAppPal::PrintLog(LogLevel::Error, "[UserStateWatcher]Check Update Failed");
   }
 }
@@ -81,78 +83,166 @@ void UserStateManager::Init(const std::vector<std::string>& list, HWND parent) {
   WinToast::instance()->setAppUserModelId(aumi);
   WinToast::instance()->initialize();
 
-  _wbi_config = Wbi::Get_wbi_key();
+  WbiSigner::GetInstance()->Start();
 
   // init cookie window
   _cookieWindow = new CookieWindow(parent, GetModuleHandle(nullptr));
-  // running check thread
-  _checkThread = std::thread(&UserStateManager::CheckThread, this, list);
-  _checkThread.detach();
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    for (auto uid : list) {
+      _watchers.push_back(std::make_shared<UserStateWatcher>(
+          uid, _cookieWindow->userAgent));
+    }
+  }
+  _live = std::make_unique<LiveStatusProvider>(
+      std::make_unique<BatchLiveBackend>(),
+      std::make_unique<RoomInfoLiveBackend>());
+  DataManager* dm = DataManager::GetInstance();
+  WatchSchedulerOptions options;
+  options.workers = dm->GetConfig<int>("watch", "workers", 4);
+  options.rate = dm->GetConfig<double>("watch", "rate", 1.0 / 3);
+  _scheduler = std::make_unique<WatchScheduler>(
+      [this](const std::string& uid) { return CheckOne(uid); }, options);
+  for (auto uid : list) {
+    // wait for the cookie window
+    _scheduler->Add(uid, std::chrono::seconds(3));
+  }
+  // after the first round of basic info, which finds the rooms
+  _scheduler->Add(kLiveKey, std::chrono::seconds(5));
+  _scheduler->SetCost(kLiveKey, _live->Requests(list.size()));
 }
 
-void UserStateManager::CheckThread(const vector<string>& list) {
-  // sleep for 3 seconds to wait for cookie window
-  std::this_thread::sleep_for(std::chrono::seconds(3));
-  _mutex.lock();
-  for (auto uid : list) {
-    std::shared_ptr<UserStateWatcher> watcher =
-      std::make_shared<UserStateWatcher>(uid,
-          _cookieWindow->userAgent, _wbi_config);
-    _watchers.push_back(watcher);
-  }
-  _mutex.unlock();
-  int check_delay = 3;
-  while (_running) {
-    // copy a shadow of _watchers
-    _mutex.lock();
-    std::vector<std::shared_ptr<UserStateWatcher>> watchers = _watchers;
-    _mutex.unlock();
-    for (auto watcher : watchers) {
-      if (!_running) return;
-      
-      CheckStatus status = watcher->Check(_messageQueue, FetchCookies());
-      // notify message process
-      auto msg = FetchOne();
-      if (msg.has_value()) {
-        auto messageInfo = msg.value();
-        auto wuname = LAppPal::StringToWString(messageInfo.target.uname);
-        auto wroomtitle =
-            LAppPal::StringToWString(messageInfo.target.roomtitle);
-        if (messageInfo.type == MessageType::LiveMessage &&
-            _liveNotifyEnabled) {
-          Notify(wuname + L" - 直播中", wroomtitle,
-                 new WinToastEventHandler("https://live.bilibili.com/" +
-                                          messageInfo.target.roomid));
-        }
-        if (messageInfo.type == MessageType::DynamicMessage &&
-            _dynamicNotifyEnabled) {
-          auto wdesc = LAppPal::StringToWString(messageInfo.extra2);
-          Notify(wuname + L" - 新动态", wdesc,
-                 new WinToastEventHandler("https://t.bilibili.com/" +
-                                          messageInfo.extra1));
-        }
-      }
-      if (status != CheckStatus::SUCCESS) {
-        check_delay *= 2;
-        LAppPal::PrintLog(LogLevel::Warn, "[UserStateManager]API failure make delay updated to %d", check_delay);
-        if (status == CheckStatus::RESTRICT) {
-          _cookieWindow->UpdateCookie();
-        }
-      } else {
-        if (check_delay >= 12) {
-          check_delay /= 3;
-        } 
-      }
-      if (check_delay >= 60) {
-        MessageBox(nullptr, L"获取动态信息失败，请在出现的窗口中点击完成可能出现的验证码，随后关闭窗口",
-                   L"Error", MB_OK);
-        _cookieWindow->Show();
-        goto skip;
+WatchResult UserStateManager::CheckOne(const std::string& uid) {
+  if (uid == kLiveKey) {
+    return checkLive();
+  }
+  std::shared_ptr<UserStateWatcher> watcher;
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    for (auto w : _watchers) {
+      if (w->target.uid == uid) {
+        watcher = w;
+        break;
       }
-      std::this_thread::sleep_for(std::chrono::seconds(check_delay));
     }
-  skip:
-    // sleep for 10 seconds
-    std::this_thread::sleep_for(std::chrono::seconds(check_delay));
+  }
+  if (!watcher) {
+    return WatchResult::Unchanged;
+  }
+  queue<StateMessage> messages;
+  auto cookies = FetchCookies();
+  CheckStatus status = watcher->Check(messages, cookies->Header());
+  bool changed = !messages.empty();
+  while (!messages.empty()) {
+    notifyMessage(messages.front());
+    messages.pop();
+  }
+  if (status == CheckStatus::SUCCESS) {
+    _restricts = 0;
+    return changed ? WatchResult::Changed : WatchResult::Unchanged;
+  }
+  if (status == CheckStatus::FAST) {
+    LAppPal::PrintLog(LogLevel::Warn,
+                      "[UserStateManager][%s]Check failed, backing off",
+                      uid.c_str());
+    return WatchResult::Failed;
+  }
+  return restricted();
+}
+
+WatchResult UserStateManager::restricted() {
+  int restricts = ++_restricts;
+  LAppPal::PrintLog(LogLevel::Warn,
+                    "[UserStateManager]API restricted %d times in a row",
+                    restricts);
+  {
+    // workers restricted together reload the cookie window one by one
+    std::lock_guard<std::mutex> lock(_cookieMutex);
+    _cookieWindow->UpdateCookie();
+  }
+  // rotated keys are refused the same way
+  WbiSigner::GetInstance()->Refresh();
+  // one prompt at a time, other workers go on while it is open
+  if (restricts >= kRestrictPrompt && !_prompting.exchange(true)) {
+    MessageBox(nullptr, L"获取动态信息失败，请在出现的窗口中点击完成可能出现的验证码，随后关闭窗口",
+               L"Error", MB_OK);
+    _cookieWindow->Show();
+    _restricts = 0;
+    _prompting = false;
+  }
+  return WatchResult::Restricted;
+}
+
+WatchResult UserStateManager::checkLive() {
+  std::vector<std::shared_ptr<UserStateWatcher>> watchers;
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    watchers = _watchers;
+  }
+  std::vector<std::string> uids;
+  for (auto watcher : watchers) {
+    // rooms are known after basic info
+    if (watcher->Initialized()) {
+      uids.push_back(watcher->target.uid);
+    }
+  }
+  if (uids.empty()) {
+    return WatchResult::Unchanged;
+  }
+  httplib::Headers headers = {{"cookie", FetchCookies()->Header()},
+                              {"User-Agent", _cookieWindow->userAgent}};
+  LiveFetch fetch;
+  auto statuses = _live->Fetch(uids, headers, fetch);
+  // the check took the tokens of the batches, not of a fallback
+  _scheduler->Charge(kLiveKey, static_cast<int>(fetch.requests));
+  uint64_t failures = _live->BatchFailures();
+  if (failures != _liveBatchFailures) {
+    _liveBatchFailures = failures;
+    LAppPal::PrintLog(LogLevel::Warn,
+                      "[UserStateManager]Batch live status failed, asking "
+                      "uid by uid for %d min",
+                      static_cast<int>(LiveStatusProvider::kBatchRetry / 60));
+  }
+  _scheduler->SetCost(kLiveKey, _live->Requests(watchers.size()));
+  if (fetch.code == -352) {
+    LAppPal::PrintLog(LogLevel::Warn,
+                      "[UserStateManager]Fetch live status restricted");
+    return restricted();
+  }
+  if (!statuses) {
+    LAppPal::PrintLog(LogLevel::Error,
+                      "[UserStateManager]Fetch live status failed");
+    return WatchResult::Failed;
+  }
+  _restricts = 0;
+  bool changed = false;
+  queue<StateMessage> messages;
+  for (auto watcher : watchers) {
+    auto it = statuses->find(watcher->target.uid);
+    if (it != statuses->end()) {
+      changed |= watcher->ApplyLive(it->second, messages);
+    }
+  }
+  while (!messages.empty()) {
+    notifyMessage(messages.front());
+    messages.pop();
+  }
+  return changed ? WatchResult::Changed : WatchResult::Unchanged;
+}
+
+void UserStateManager::notifyMessage(const StateMessage& messageInfo) {
+  auto wuname = LAppPal::StringToWString(messageInfo.target.uname);
+  auto wroomtitle = LAppPal::StringToWString(messageInfo.target.roomtitle);
+  if (messageInfo.type == MessageType::LiveMessage && _liveNotifyEnabled) {
+    Notify(wuname + L" - 直播中", wroomtitle,
+           new WinToastEventHandler("https://live.bilibili.com/" +
+                                    messageInfo.target.roomid));
+  }
+  if (messageInfo.type == MessageType::DynamicMessage &&
+      _dynamicNotifyEnabled) {
+    auto wdesc = LAppPal::StringToWString(messageInfo.extra2);
+    Notify(wuname + L" - 新动态", wdesc,
+           new WinToastEventHandler("https://t.bilibili.com/" +
+                                    messageInfo.extra1));
   }
 }
@@ -1,18 +1,21 @@
 ﻿#pragma once
 
+#include <atomic>
 #include <memory>
 #include <queue>
-#include <thread>
 #include <optional>
 #include <map>
 #include <mutex>
 
 #include "StateMessage.hpp"
 #include "UserStateWatcher.h"
+#include "CookieStore.hpp"
 #include "CookieWindow.hpp"
 #include "LAppDefine.hpp"
 #include "DataManager.hpp"
-#include "Wbi.hpp"
+#include "LiveStatus.hpp"
+#include "WbiSigner.hpp"
+#include "WatchScheduler.hpp"
 #include "wintoastlib.h"
 #include "WinToastEventHandler.h"
 
@@ -25,7 +28,9 @@ class UserStateManager {
       : _dynamicNotifyEnabled(dynamicNotifyEnabled),
         _liveNotifyEnabled(liveNotifyEnabled) {}
   ~UserStateManager() {
-    _running = false;
+    // joins the workers before the watchers go away
+    _scheduler.reset();
+    WbiSigner::GetInstance()->Stop();
     _mutex.lock();
     _watchers.clear();
     _mutex.unlock();
@@ -33,20 +38,25 @@ class UserStateManager {
   void Init(const std::vector<std::string>& list, HWND parent);
 
   void AddWatcher(const std::string& uid) {
-    std::lock_guard<std::mutex> lock(_mutex);
-    // check if already exist
-    for (auto watcher : _watchers) {
-      if (watcher->target.uid == uid) {
-        return;
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      // check if already exist
+      for (auto watcher : _watchers) {
+        if (watcher->target.uid == uid) {
+          return;
+        }
       }
+      std::shared_ptr<UserStateWatcher> watcher = std::make_shared<UserStateWatcher>(uid,
+          _cookieWindow->userAgent);
+      _watchers.push_back(watcher);
+      _scheduler->SetCost(kLiveKey, _live->Requests(_watchers.size()));
     }
-    std::shared_ptr<UserStateWatcher> watcher = std::make_shared<UserStateWatcher>(uid,
-        _cookieWindow->userAgent, _wbi_config);
-    _watchers.push_back(watcher);
+    _scheduler->Add(uid);
     LAppPal::PrintLog("[UserStateManager]Add watcher %s", uid.c_str());
   }
 
   void RemoveWatcher(const std::string& uid) {
+    _scheduler->Remove(uid);
     std::lock_guard<std::mutex> lock(_mutex);
     for (auto it = _watchers.begin(); it != _watchers.end(); it++) {
       if ((*it)->target.uid == uid) {
@@ -54,40 +64,28 @@ class UserStateManager {
         break;
       }
     }
+    _scheduler->SetCost(kLiveKey, _live->Requests(_watchers.size()));
     LAppPal::PrintLog("[UserStateManager]Remove watcher %s", uid.c_str());
   }
 
   void GetTargetList(std::map<string, WatchTarget>& mtarget) {
     std::lock_guard<std::mutex> lock(_mutex);
     for (auto watcher : _watchers) {
-      auto target = watcher->target;
+      auto target = watcher->Target();
       mtarget.insert(std::pair<string, WatchTarget>(target.uid, target));
     }
   }
 
   void CheckUpdate(bool notify);
 
-  void CheckThread(const vector<string>& list);
+  /**
+   * @brief  Check one followed user, or with kLiveKey the live status of
+   * all of them. Runs on a WatchScheduler worker.
+   */
+  WatchResult CheckOne(const std::string& uid);
 
-  std::optional<StateMessage> FetchOne() {
-    if (!_messageQueue.empty()) {
-      StateMessage message = _messageQueue.front();
-      _messageQueue.pop();
-      return message;
-    }
-    return std::nullopt;
-  }
-
-  string FetchCookies() {
-    auto cookies = DataManager::GetInstance()->GetWithDefault("cookies", "");
-    if (cookies.empty()) {
-      cookies = _cookieWindow->cookie;
-    }
-    return cookies;
-  }
-
-  shared_ptr<WbiConfig> GetWbiKey() {
-    return _wbi_config;
+  std::shared_ptr<const CookieJar> FetchCookies() {
+    return CookieStore::GetInstance()->Requests();
   }
 
   void Notify(const wstring& title, const wstring& content,
@@ -96,14 +94,26 @@ class UserStateManager {
  private:
   vector<std::shared_ptr<UserStateWatcher>> _watchers;
   std::mutex _mutex;
-  queue<StateMessage> _messageQueue;
   wstring _exePath;
   const bool& _dynamicNotifyEnabled;
   const bool& _liveNotifyEnabled;
-  shared_ptr<WbiConfig> _wbi_config;
 
   CookieWindow* _cookieWindow = nullptr;
+  std::mutex _cookieMutex;
+
+  std::unique_ptr<WatchScheduler> _scheduler;
+  // scheduler key of the batched live status, uids are all digits
+  static constexpr const char* kLiveKey = "live";
+  std::unique_ptr<LiveStatusProvider> _live;
+  uint64_t _liveBatchFailures = 0;
+  // restricted checks in a row, the user is asked to pass the captcha
+  // after kRestrictPrompt of them
+  static constexpr int kRestrictPrompt = 3;
+  std::atomic<int> _restricts{0};
+  std::atomic<bool> _prompting{false};
 
-  std::thread _checkThread;
-  bool _running = true;
+  void notifyMessage(const StateMessage& message);
+  WatchResult checkLive();
+  // a -352, fresh cookies and keys, the captcha prompt when it repeats
+  WatchResult restricted();
 };
@@ -1,12 +1,14 @@
-﻿#include <memory>
+﻿#include <atomic>
+#include <memory>
+#include <mutex>
 #include <queue>
 #include <string>
 #include <thread>
 #include <vector>
 
 #include "LAppPal.hpp"
+#include "LiveStatus.hpp"
 #include "StateMessage.hpp"
-#include "Wbi.hpp"
 
 using std::queue;
 using std::string;
@@ -17,16 +19,33 @@ enum class CheckStatus {
 
 class UserStateWatcher {
  public:
+  // uid is fixed, the rest is written by checks on any worker, hold
+  // _mutex or read a copy from Target()
   WatchTarget target;
   bool lastStatus = false;
   long long lastTime = 0;
-  UserStateWatcher(const string& uid,
-                   const string& userAgent, shared_ptr<WbiConfig> wbi_config);
+  UserStateWatcher(const string& uid, const string& userAgent);
+
+  /**
+   * @brief  Fetch basic info if still missing, then the latest dynamic.
+   * Live status comes in batches through ApplyLive().
+   */
   CheckStatus Check(queue<StateMessage>& messageQueue, const string& cookies);
 
+  /**
+   * @brief  Take the live status fetched by LiveStatusProvider, queues a
+   * LiveMessage when the target went live.
+   * @return true if the live status changed
+   */
+  bool ApplyLive(const LiveInfo& info, queue<StateMessage>& messageQueue);
+
+  WatchTarget Target();
+
+  bool Initialized() const { return _initialized; }
+
  private:
-  bool _initialized = false;
+  std::mutex _mutex;
+  std::atomic<bool> _initialized{false};
   const string& _userAgent;
-  shared_ptr<WbiConfig> _wbi_config;
   void initBasicInfo(const string& cookies);
 };
@@ -0,0 +1,227 @@
+#include "WatchScheduler.hpp"
+
+#include <algorithm>
+
+void TokenBucket::refill(Clock::time_point now) {
+  if (now < _paused) {
+    _tokens = 0;
+    _last = now;
+    return;
+  }
+  // refill from the end of a pause, not from before it
+  auto from = std::max(_last, _paused);
+  if (now > from) {
+    _tokens = std::min(
+        _burst,
+        _tokens + _rate * std::chrono::duration<double>(now - from).count());
+  }
+  _last = now;
+}
+
+TokenBucket::Clock::time_point TokenBucket::Ready(Clock::time_point now,
+                                                  int cost) {
+  refill(now);
+  double need = std::min<double>(cost, _burst);
+  if (now < _paused) {
+    return _paused + std::chrono::duration_cast<Clock::duration>(
+                         std::chrono::duration<double>(need / _rate));
+  }
+  if (_tokens >= need) {
+    return now;
+  }
+  return now + std::chrono::duration_cast<Clock::duration>(
+                   std::chrono::duration<double>((need - _tokens) / _rate));
+}
+
+void TokenBucket::Take(Clock::time_point now, int cost) {
+  refill(now);
+  _tokens -= cost;
+}
+
+void TokenBucket::Pause(Clock::time_point until) {
+  _paused = std::max(_paused, until);
+  _tokens = 0;
+}
+
+WatchScheduler::WatchScheduler(Check check,
+                               const WatchSchedulerOptions& options)
+    : _check(std::move(check)),
+      _options(options),
+      _bucket(options.rate, options.burst) {
+  for (size_t i = 0; i < std::max<size_t>(1, _options.workers); i++) {
+    _workers.emplace_back(&WatchScheduler::doRun, this);
+  }
+}
+
+WatchScheduler::~WatchScheduler() {
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _running = false;
+    _heap.clear();
+    _targets.clear();
+  }
+  _cv.notify_all();
+  // checks in flight finish first, HttpPool::CancelAll() cuts them short
+  for (auto& worker : _workers) {
+    worker.join();
+  }
+}
+
+void WatchScheduler::Add(const std::string& key,
+                         std::chrono::milliseconds delay) {
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_targets.count(key) > 0) {
+      return;
+    }
+    uint64_t generation = ++_generation;
+    Target& target = _targets[key];
+    target = {generation, _options.min_interval};
+    target.demand =
+        target.cost / std::chrono::duration<double>(target.interval).count();
+    _demand += target.demand;
+    _heap.push_back({Clock::now() + delay, key, generation});
+    std::push_heap(_heap.begin(), _heap.end());
+  }
+  _cv.notify_one();
+}
+
+void WatchScheduler::SetCost(const std::string& key, int cost) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  auto it = _targets.find(key);
+  if (it == _targets.end() || it->second.cost == cost) {
+    return;
+  }
+  Target& target = it->second;
+  _demand -= target.demand;
+  target.demand = target.demand * std::max(cost, 1) / target.cost;
+  target.cost = std::max(cost, 1);
+  _demand += target.demand;
+}
+
+void WatchScheduler::Charge(const std::string& key, int requests) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  auto it = _targets.find(key);
+  if (it == _targets.end() || requests <= it->second.cost) {
+    return;
+  }
+  // owed, later checks wait for it
+  _bucket.Take(Clock::now(), requests - it->second.cost);
+}
+
+void WatchScheduler::Remove(const std::string& key) {
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto it = _targets.find(key);
+    if (it == _targets.end()) {
+      return;
+    }
+    _demand -= it->second.demand;
+    _targets.erase(it);
+  }
+  _cv.notify_all();
+}
+
+WatchStats WatchScheduler::Stats() {
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _stats;
+}
+
+void WatchScheduler::reschedule(const Entry& entry, WatchResult result,
+                                Clock::time_point now) {
+  _stats.checks++;
+  if (result == WatchResult::Restricted) {
+    _stats.restricts++;
+    // checks that were in flight when the pause began do not stretch it
+    if (now >= _bucket.PausedUntil()) {
+      auto pause = _options.restrict_pause * (1LL << std::min(_restricts, 10));
+      _restricts++;
+      _bucket.Pause(now + std::min<Clock::duration>(
+                              pause, _options.max_restrict_pause));
+    }
+  } else {
+    _restricts = 0;
+  }
+  auto it = _targets.find(entry.key);
+  if (it == _targets.end() || it->second.generation != entry.generation) {
+    // removed, or removed and added again, while it was checked
+    return;
+  }
+  Target& target = it->second;
+  Clock::duration next = target.interval;
+  switch (result) {
+    case WatchResult::Changed:
+      _stats.changes++;
+      target.failures = 0;
+      target.interval = _options.min_interval;
+      next = target.interval;
+      break;
+    case WatchResult::Unchanged:
+      target.failures = 0;
+      target.interval = std::min<Clock::duration>(target.interval * 3 / 2,
+                                                  _options.max_interval);
+      next = target.interval;
+      break;
+    case WatchResult::Failed:
+      _stats.failures++;
+      target.failures = std::min(target.failures + 1, 16);
+      next = std::min<Clock::duration>(
+          _options.min_interval * (1LL << target.failures),
+          _options.max_backoff);
+      break;
+    case WatchResult::Restricted:
+      // the pause covers it, the target keeps its place
+      break;
+  }
+  _demand -= target.demand;
+  target.demand = target.cost / std::chrono::duration<double>(next).count();
+  _demand += target.demand;
+  // stretch every delay alike while the targets ask for more than the rate,
+  // below it each keeps its own, a quiet target stays backed off
+  next = std::chrono::duration_cast<Clock::duration>(
+      next * std::max(1.0, _demand / _options.rate));
+  _heap.push_back({now + next, entry.key, entry.generation});
+  std::push_heap(_heap.begin(), _heap.end());
+}
+
+void WatchScheduler::doRun() {
+  std::unique_lock<std::mutex> lock(_mutex);
+  while (_running) {
+    // drop entries of removed targets so they never hold a worker awake
+    while (!_heap.empty()) {
+      auto it = _targets.find(_heap.front().key);
+      if (it != _targets.end() &&
+          it->second.generation == _heap.front().generation) {
+        break;
+      }
+      std::pop_heap(_heap.begin(), _heap.end());
+      _heap.pop_back();
+    }
+    if (_heap.empty()) {
+      _cv.wait(lock);
+      continue;
+    }
+    auto now = Clock::now();
+    int cost = _targets[_heap.front().key].cost;
+    // the earliest due target waits for the tokens, later ones queue behind
+    auto due = std::max(_heap.front().deadline, _bucket.Ready(now, cost));
+    if (now < due) {
+      _cv.wait_until(lock, due);
+      continue;
+    }
+    _bucket.Take(now, cost);
+    std::pop_heap(_heap.begin(), _heap.end());
+    Entry entry = std::move(_heap.back());
+    _heap.pop_back();
+    // the target is out of the heap until it is rescheduled, so no other
+    // worker checks it meanwhile
+    lock.unlock();
+    WatchResult result = _check(entry.key);
+    lock.lock();
+    if (_running) {
+      reschedule(entry, result, Clock::now());
+    }
+    // the new deadline may be earlier than what the others wait for
+    _cv.notify_all();
+  }
+}
@@ -0,0 +1,171 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+enum class WatchResult {
+  Unchanged,
+  // the target posted or went live since the last check
+  Changed,
+  // this target failed, e.g. a bad uid, only it backs off
+  Failed,
+  // the API refused us, e.g. code -352, every target pauses
+  Restricted,
+};
+
+struct WatchSchedulerOptions {
+  size_t workers = 4;
+  // tokens per second of all targets together, and how many may be taken
+  // back to back after a quiet spell; a check takes one, or its cost
+  double rate = 1.0 / 3;
+  double burst = 4;
+  // a target that just changed is checked every min_interval, each check
+  // without a change stretches its interval by half up to max_interval
+  std::chrono::milliseconds min_interval{15000};
+  std::chrono::milliseconds max_interval{120000};
+  // a failing target doubles its interval per failure up to this
+  std::chrono::milliseconds max_backoff{600000};
+  // pause of all checks after a restriction, doubles while it repeats
+  std::chrono::milliseconds restrict_pause{30000};
+  std::chrono::milliseconds max_restrict_pause{600000};
+};
+
+struct WatchStats {
+  uint64_t checks = 0;
+  uint64_t changes = 0;
+  uint64_t failures = 0;
+  uint64_t restricts = 0;
+};
+
+/**
+ * @brief Token bucket shared by all checks, keeps the request rate of any
+ * number of targets under the limit of the API.
+ */
+class TokenBucket {
+  public:
+    using Clock = std::chrono::steady_clock;
+
+    TokenBucket(double rate, double burst)
+        : _rate(rate), _burst(burst), _tokens(burst), _last(Clock::now()) {}
+
+    /**
+     * @brief When there are tokens for a check of cost, now if there are
+     * already. A cost over the burst waits for a full bucket.
+     */
+    Clock::time_point Ready(Clock::time_point now, int cost = 1);
+
+    /**
+     * @brief Take cost tokens, only after Ready() returned a time not after
+     * now. What the bucket lacks is owed and delays later checks.
+     */
+    void Take(Clock::time_point now, int cost = 1);
+
+    /**
+     * @brief No token until then, the bucket refills from empty after.
+     */
+    void Pause(Clock::time_point until);
+
+    Clock::time_point PausedUntil() const { return _paused; }
+
+  private:
+    double _rate;
+    double _burst;
+    double _tokens;
+    Clock::time_point _last;
+    Clock::time_point _paused{};
+    void refill(Clock::time_point now);
+};
+
+/**
+ * @brief Polls every followed target on its own deadline. Targets sit in a
+ * min-heap by deadline, a small pool of workers takes the earliest due one
+ * once the shared TokenBucket has a token, so a target that changes often
+ * is polled often, a quiet or broken one rarely, and neither delays the
+ * others. All delays stretch alike when the targets ask for more than the
+ * rate.
+ * Checks of one target never overlap.
+ */
+class WatchScheduler {
+  public:
+    using Clock = std::chrono::steady_clock;
+    using Check = std::function<WatchResult(const std::string& key)>;
+
+    WatchScheduler(Check check, const WatchSchedulerOptions& options = {});
+    ~WatchScheduler();
+
+    /**
+     * @brief Start polling key, first check after delay.
+     */
+    void Add(const std::string& key,
+             std::chrono::milliseconds delay = std::chrono::milliseconds(0));
+
+    /**
+     * @brief Tokens a check of key takes, 1 unless it makes more requests,
+     * e.g. one batch per 50 users.
+     */
+    void SetCost(const std::string& key, int cost);
+
+    /**
+     * @brief A running check of key made requests, take the tokens its
+     * cost did not cover, e.g. when a batch failed and it asked one by one.
+     */
+    void Charge(const std::string& key, int requests);
+
+    /**
+     * @brief Stop polling key, it is not checked again once this returns,
+     * unless a check is running right now.
+     */
+    void Remove(const std::string& key);
+
+    WatchStats Stats();
+
+  private:
+    struct Target {
+      uint64_t generation;
+      Clock::duration interval;
+      int failures = 0;
+      int cost = 1;
+      // tokens per second this target asks for, cost / its next delay
+      double demand = 0;
+    };
+
+    struct Entry {
+      Clock::time_point deadline;
+      std::string key;
+      uint64_t generation;
+
+      // std heap functions build a max-heap, invert for the earliest first
+      bool operator<(const Entry& other) const {
+        return deadline > other.deadline;
+      }
+    };
+
+    Check _check;
+    WatchSchedulerOptions _options;
+    TokenBucket _bucket;
+    std::vector<Entry> _heap;
+    std::unordered_map<std::string, Target> _targets;
+    uint64_t _generation = 0;
+    // tokens per second all targets ask for, past the rate every delay is
+    // stretched by the same factor, so targets keep their shares instead of
+    // all falling behind into round robin
+    double _demand = 0;
+    // restrictions in a row, over all targets
+    int _restricts = 0;
+    WatchStats _stats;
+    std::mutex _mutex;
+    std::condition_variable _cv;
+    std::vector<std::thread> _workers;
+    bool _running = true;
+    void doRun();
+    // _mutex must be held
+    void reschedule(const Entry& entry, WatchResult result,
+                    Clock::time_point now);
+};
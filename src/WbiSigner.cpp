@@ -0,0 +1,260 @@
+#include "WbiSigner.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <vector>
+
+#define CRYPTOPP_ENABLE_NAMESPACE_WEAK 1
+#include <cryptopp/md5.h>
+
+#include "HttpPool.hpp"
+#include "JsonScan.hpp"
+#include "Wbi.hpp"
+
+namespace {
+
+constexpr std::array<uint8_t, 64> kMixinKeyEncTab = {
+    46, 47, 18, 2,  53, 8,  23, 32, 15, 50, 10, 31, 58, 3,  45, 35,
+    27, 43, 5,  49, 33, 9,  42, 19, 29, 28, 14, 39, 12, 38, 41, 13,
+    37, 48, 7,  16, 24, 55, 40, 61, 26, 17, 0,  1,  60, 51, 30, 4,
+    22, 25, 54, 21, 56, 59, 6,  63, 57, 62, 11, 36, 20, 34, 44, 52};
+
+// not logged in, the keys and w_webid are the same for everyone
+httplib::Headers Headers() {
+  return {
+      {"cookie", "SESSDATA=xxxxxxxxxxxx"},
+      {"User-Agent",
+       "Mozilla/5.0 (Windows NT 10.0; Win64; x64) AppleWebKit/537.36 (KHTML, "
+       "like Gecko) Chrome/58.0.3029.110 Safari/537.3"},
+      {"Referer", "https://www.bilibili.com/"},
+  };
+}
+
+HttpOptions Options() {
+  HttpOptions options;
+  options.follow_location = true;
+  return options;
+}
+
+// file name without extension of a key url, ".../wbi/<key>.png"
+std::string_view KeyOf(std::string_view url) {
+  size_t slash = url.rfind('/');
+  std::string_view name =
+      slash == std::string_view::npos ? url : url.substr(slash + 1);
+  return name.substr(0, name.find('.'));
+}
+
+}  // namespace
+
+std::string WbiSigner::MixinKey(std::string_view img_key,
+                                std::string_view sub_key) {
+  if (img_key.size() + sub_key.size() < kMixinKeyEncTab.size()) {
+    return {};
+  }
+  std::string raw = std::string(img_key).append(sub_key);
+  std::string mixin;
+  for (size_t i = 0; i < 32; i++) {
+    mixin.push_back(raw[kMixinKeyEncTab[i]]);
+  }
+  return mixin;
+}
+
+std::string WbiSigner::Sign(std::initializer_list<WbiParam> params,
+                            time_t wts) {
+  std::shared_ptr<const Keys> keys = std::atomic_load(&_keys);
+  bool sign = !keys->mixin_key.empty();
+  char wts_str[24];
+  auto wts_end = std::to_chars(wts_str, wts_str + sizeof(wts_str),
+                               static_cast<int64_t>(wts))
+                     .ptr;
+  // reused by every signature of this thread, no allocations once grown
+  thread_local std::vector<WbiParam> sorted;
+  thread_local std::string query;
+  sorted.assign(params.begin(), params.end());
+  if (sign) {
+    sorted.push_back({"w_webid", keys->webid});
+    sorted.push_back({"wts", std::string_view(wts_str, wts_end - wts_str)});
+  }
+  std::sort(sorted.begin(), sorted.end(),
+            [](const WbiParam& a, const WbiParam& b) { return a.key < b.key; });
+  query.clear();
+  for (const auto& param : sorted) {
+    if (!query.empty()) {
+      query.push_back('&');
+    }
+    query.append(param.key).push_back('=');
+    Wbi::Url_encode_append(query, param.value);
+  }
+  _signs.fetch_add(1, std::memory_order_relaxed);
+  if (!sign) {
+    _unsigned_signs.fetch_add(1, std::memory_order_relaxed);
+    return query;
+  }
+  CryptoPP::Weak1::MD5 md5;
+  md5.Update(reinterpret_cast<const CryptoPP::byte*>(query.data()),
+             query.size());
+  md5.Update(reinterpret_cast<const CryptoPP::byte*>(keys->mixin_key.data()),
+             keys->mixin_key.size());
+  CryptoPP::byte digest[CryptoPP::Weak1::MD5::DIGESTSIZE];
+  md5.Final(digest);
+  static const char hex[] = "0123456789abcdef";
+  std::string result;
+  result.reserve(query.size() + 7 + 2 * sizeof(digest));
+  result.append(query).append("&w_rid=");
+  for (CryptoPP::byte b : digest) {
+    result.push_back(hex[b >> 4]);
+    result.push_back(hex[b & 15]);
+  }
+  return result;
+}
+
+void WbiSigner::Start(const WbiSignerOptions& options) {
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_thread.joinable()) {
+      return;
+    }
+    _options = options;
+    _stop = false;
+  }
+  // the first fetch in the caller, so startup requests are signed
+  refresh(true, true);
+  std::lock_guard<std::mutex> lock(_mutex);
+  _thread = std::thread(&WbiSigner::run, this);
+}
+
+void WbiSigner::Stop() {
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _stop = true;
+  }
+  _cv.notify_all();
+  if (_thread.joinable()) {
+    _thread.join();
+  }
+}
+
+void WbiSigner::Refresh() {
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (std::chrono::steady_clock::now() < _refreshed + _options.retry) {
+      return;
+    }
+    _refresh = true;
+  }
+  _cv.notify_all();
+}
+
+bool WbiSigner::Ready() {
+  return !std::atomic_load(&_keys)->mixin_key.empty();
+}
+
+WbiSignerStats WbiSigner::Stats() {
+  std::lock_guard<std::mutex> lock(_mutex);
+  WbiSignerStats stats = _stats;
+  stats.signs = _signs.load(std::memory_order_relaxed);
+  stats.unsigned_signs = _unsigned_signs.load(std::memory_order_relaxed);
+  return stats;
+}
+
+void WbiSigner::run() {
+  std::unique_lock<std::mutex> lock(_mutex);
+  while (!_stop) {
+    auto now = std::chrono::steady_clock::now();
+    bool keys = _refresh || now >= _key_due;
+    bool webid = _refresh || now >= _webid_due;
+    if (!keys && !webid) {
+      _cv.wait_until(lock, std::min(_key_due, _webid_due));
+      continue;
+    }
+    _refresh = false;
+    lock.unlock();
+    refresh(keys, webid);
+    lock.lock();
+  }
+}
+
+void WbiSigner::refresh(bool keys, bool webid) {
+  std::optional<std::string> mixin_key;
+  std::optional<std::string> webid_value;
+  if (keys) {
+    mixin_key = fetchMixinKey();
+  }
+  if (webid) {
+    webid_value = fetchWebId();
+  }
+  auto now = std::chrono::steady_clock::now();
+  std::lock_guard<std::mutex> lock(_mutex);
+  _refreshed = now;
+  auto next = std::make_shared<Keys>(*_keys);
+  if (keys) {
+    _stats.key_fetches++;
+    if (mixin_key) {
+      next->mixin_key = std::move(*mixin_key);
+      _key_due = now + _options.key_ttl;
+    } else {
+      _stats.failures++;
+      _key_due = now + _options.retry;
+    }
+  }
+  if (webid) {
+    _stats.webid_fetches++;
+    if (webid_value) {
+      next->webid = std::move(*webid_value);
+      _webid_due = now + _options.webid_ttl;
+    } else {
+      _stats.failures++;
+      _webid_due = now + _options.retry;
+    }
+  }
+  std::atomic_store(&_keys, std::shared_ptr<const Keys>(std::move(next)));
+}
+
+std::optional<std::string> WbiSigner::fetchMixinKey() {
+  auto res = HttpPool::GetInstance()->Get(
+      "api.bilibili.com", "/x/web-interface/nav", Headers(), Options());
+  if (!res || res->status != 200) {
+    return std::nullopt;
+  }
+  // code is -101 when not logged in, wbi_img is there all the same
+  static constexpr std::string_view kNames[] = {"img_url", "sub_url"};
+  auto [img_url, sub_url] = JsonScan(res->body)
+                                .Field("data")
+                                .Field("wbi_img")
+                                .Fields(kNames);
+  std::string img = img_url.String();
+  std::string sub = sub_url.String();
+  std::string mixin_key = MixinKey(KeyOf(img), KeyOf(sub));
+  if (mixin_key.empty()) {
+    return std::nullopt;
+  }
+  return mixin_key;
+}
+
+std::optional<std::string> WbiSigner::fetchWebId() {
+  auto res = HttpPool::GetInstance()->Get("space.bilibili.com", "/475210",
+                                          Headers(), Options());
+  if (!res || res->status != 200) {
+    return std::nullopt;
+  }
+  // a plain search, the page is too large for std::regex
+  constexpr std::string_view kOpen =
+      R"(<script id="__RENDER_DATA__" type="application/json">)";
+  std::string_view page = res->body;
+  size_t begin = page.find(kOpen);
+  if (begin == std::string_view::npos) {
+    return std::nullopt;
+  }
+  begin += kOpen.size();
+  size_t end = page.find("</script>", begin);
+  if (end == std::string_view::npos) {
+    return std::nullopt;
+  }
+  std::string data =
+      Wbi::Url_decode(std::string(page.substr(begin, end - begin)));
+  JsonScan access_id = JsonScan(data).Field("access_id");
+  if (!access_id.IsString()) {
+    return std::nullopt;
+  }
+  return access_id.String();
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <ctime>
+#include <initializer_list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+
+// settings of WbiSigner::Start()
+struct WbiSignerOptions {
+  // nav keys rotate daily, fetched again after key_ttl
+  std::chrono::milliseconds key_ttl{std::chrono::hours(1)};
+  // w_webid may expire in 20 hours
+  std::chrono::milliseconds webid_ttl{std::chrono::hours(20)};
+  // a failed fetch is tried again after retry, the old value stays in use
+  std::chrono::milliseconds retry{std::chrono::minutes(1)};
+};
+
+struct WbiSignerStats {
+  uint64_t signs = 0;
+  // signed without keys, none were fetched yet
+  uint64_t unsigned_signs = 0;
+  uint64_t key_fetches = 0;
+  uint64_t webid_fetches = 0;
+  uint64_t failures = 0;
+};
+
+struct WbiParam {
+  std::string_view key;
+  std::string_view value;
+};
+
+/**
+ * @brief  Signs wbi requests. The mixin key and w_webid are cached and
+ * fetched again in the background before they go stale, a signature never
+ * waits for the network: until a refresh lands the old values are used.
+ */
+class WbiSigner {
+ public:
+  static WbiSigner* GetInstance() {
+    static WbiSigner instance;
+    return &instance;
+  }
+
+  ~WbiSigner() { Stop(); }
+
+  /**
+   * @brief  Fetch keys and w_webid once, then keep them fresh in the
+   * background until Stop().
+   */
+  void Start(const WbiSignerOptions& options = {});
+
+  void Stop();
+
+  /**
+   * @brief  Query string of params with wts, w_webid and w_rid, e.g.
+   * "mid=1&w_webid=...&wts=...&w_rid=...". Only params, sorted, while no
+   * keys were fetched yet.
+   */
+  std::string Sign(std::initializer_list<WbiParam> params) {
+    return Sign(params, time(nullptr));
+  }
+
+  std::string Sign(std::initializer_list<WbiParam> params, time_t wts);
+
+  /**
+   * @brief  Fetch keys and w_webid again soon, e.g. after a -352. At most
+   * once per retry interval.
+   */
+  void Refresh();
+
+  bool Ready();
+
+  WbiSignerStats Stats();
+
+  /**
+   * @brief  The 32 characters of img_key + sub_key the signature mixes in,
+   * empty if they are too short.
+   */
+  static std::string MixinKey(std::string_view img_key,
+                              std::string_view sub_key);
+
+ private:
+  struct Keys {
+    std::string mixin_key;
+    std::string webid;
+  };
+
+  std::mutex _mutex;
+  std::condition_variable _cv;
+  std::thread _thread;
+  bool _stop = false;
+  bool _refresh = false;
+  WbiSignerOptions _options;
+  std::chrono::steady_clock::time_point _key_due;
+  std::chrono::steady_clock::time_point _webid_due;
+  std::chrono::steady_clock::time_point _refreshed;
+  WbiSignerStats _stats;
+  // counted without the mutex, Stats() fills them in
+  std::atomic<uint64_t> _signs{0};
+  std::atomic<uint64_t> _unsigned_signs{0};
+  // replaced whole by refreshes, signers read it with std::atomic_load
+  std::shared_ptr<const Keys> _keys = std::make_shared<Keys>();
+
+  WbiSigner() = default;
+
+  void run();
+  void refresh(bool keys, bool webid);
+
+  static std::optional<std::string> fetchMixinKey();
+  static std::optional<std::string> fetchWebId();
+};
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <string>
+#include <thread>
+
+#include <httplib.h>
+#include <openssl/evp.h>
+#include <openssl/x509.h>
+
+/**
+ * @brief  A throwaway key and self-signed certificate for 127.0.0.1, valid
+ * for a day, for the tools that stand in for the remote APIs. Clients
+ * connect to them with HttpOptions::verify off.
+ */
+class LocalCert {
+ public:
+  LocalCert() {
+    key_ = EVP_EC_gen("P-256");
+    if (key_ == nullptr) {
+      return;
+    }
+    cert_ = X509_new();
+    ASN1_INTEGER_set(X509_get_serialNumber(cert_), 1);
+    X509_gmtime_adj(X509_getm_notBefore(cert_), 0);
+    X509_gmtime_adj(X509_getm_notAfter(cert_), 24 * 60 * 60);
+    X509_set_pubkey(cert_, key_);
+    X509_NAME* name = X509_get_subject_name(cert_);
+    X509_NAME_add_entry_by_txt(
+        name, "CN", MBSTRING_ASC,
+        reinterpret_cast<const unsigned char*>("127.0.0.1"), -1, -1, 0);
+    X509_set_issuer_name(cert_, name);
+    ok_ = X509_sign(cert_, key_, EVP_sha256()) > 0;
+  }
+
+  ~LocalCert() {
+    X509_free(cert_);
+    EVP_PKEY_free(key_);
+  }
+
+  LocalCert(const LocalCert&) = delete;
+  LocalCert& operator=(const LocalCert&) = delete;
+
+  bool Ok() const { return ok_; }
+  X509* Cert() const { return cert_; }
+  EVP_PKEY* Key() const { return key_; }
+
+ private:
+  EVP_PKEY* key_ = nullptr;
+  X509* cert_ = nullptr;
+  bool ok_ = false;
+};
+
+/**
+ * @brief  HTTPS server on 127.0.0.1 for the tools' stand-ins. Register
+ * handlers on Server(), then Start() listens on a thread of its own until
+ * Stop(). Owners whose handlers use their members call Stop() in their
+ * destructor, before those members go.
+ */
+class LocalServer {
+ public:
+  explicit LocalServer(const LocalCert& cert)
+      : server_(cert.Cert(), cert.Key()) {}
+
+  ~LocalServer() { Stop(); }
+
+  httplib::SSLServer& Server() { return server_; }
+
+  /**
+   * @brief  Listen on port, 0 for any free one. False if it is taken.
+   */
+  bool Start(int port = 0) {
+    if (port == 0) {
+      port_ = server_.bind_to_any_port("127.0.0.1");
+    } else if (server_.bind_to_port("127.0.0.1", port)) {
+      port_ = port;
+    } else {
+      return false;
+    }
+    thread_ = std::thread([this] { server_.listen_after_bind(); });
+    server_.wait_until_ready();
+    return true;
+  }
+
+  void Stop() {
+    if (thread_.joinable()) {
+      server_.stop();
+      thread_.join();
+    }
+  }
+
+  int Port() const { return port_; }
+
+ private:
+  httplib::SSLServer server_;
+  std::thread thread_;
+  int port_ = 0;
+};
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "TaskScheduler.hpp"
+
+/**
+ * @brief  Scheduler clock for tools/scheduler_bench and scheduler_check.
+ * Time stands still until RunUntil() moves the horizon, then the worker's
+ * waits return at once with the clock set to their deadline, so hours of
+ * schedule run in milliseconds. A wait past the horizon parks the worker
+ * until the horizon moves or the scheduler notifies it.
+ *
+ * The worker only parks in WaitUntil(), with no task at all it waits on
+ * its own, so keep one task scheduled at all times, a cron task does.
+ */
+class VirtualClock : public SchedulerClock {
+ public:
+  using time_point = Task::Clock::time_point;
+
+  explicit VirtualClock(time_point start) : now_(start), horizon_(start) {}
+
+  time_point Now() override {
+    std::lock_guard<std::mutex> lock(nowMutex_);
+    return now_;
+  }
+
+  // called with the scheduler's mutex held, which also guards the horizon
+  void WaitUntil(std::condition_variable& cv,
+                 std::unique_lock<std::mutex>& lock,
+                 time_point deadline) override {
+    waits_++;
+    if (deadline > horizon_) {
+      setNow(horizon_);
+      parked_ = horizon_;
+      cv_ = &cv;
+      mutex_ = lock.mutex();
+      cv.wait(lock);
+      parked_ = {};
+      if (deadline > horizon_) {
+        // the task set changed, the scheduler looks again
+        return;
+      }
+    }
+    setNow(deadline);
+  }
+
+  /**
+   * @brief  Let time run to horizon and return once the worker is idle
+   * there, with every task due by then run.
+   */
+  void RunUntil(time_point horizon) {
+    while (!mutex_) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    {
+      std::lock_guard<std::mutex> lock(*mutex_);
+      horizon_ = horizon;
+      parked_ = {};
+      cv_.load()->notify_all();
+    }
+    for (;;) {
+      {
+        std::lock_guard<std::mutex> lock(*mutex_);
+        if (parked_ == horizon_) {
+          return;
+        }
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  }
+
+  /**
+   * @brief  Times the worker waited on the clock.
+   */
+  uint64_t Waits() const { return waits_; }
+
+ private:
+  std::mutex nowMutex_;
+  time_point now_;
+  // guarded by the scheduler's mutex
+  time_point horizon_;
+  // the horizon the worker went idle at, cleared while it is not
+  time_point parked_{};
+  std::atomic<std::condition_variable*> cv_{nullptr};
+  std::atomic<std::mutex*> mutex_{nullptr};
+  std::atomic<uint64_t> waits_{0};
+
+  void setNow(time_point now) {
+    std::lock_guard<std::mutex> lock(nowMutex_);
+    now_ = now;
+  }
+};
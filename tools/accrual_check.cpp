@@ -0,0 +1,194 @@
+// Property checks of the closed form exp math against the per-minute tick
+// it replaced:
+//
+//   batch   formula::ExpPerMinuteBatch() against ExpPerMinute() for every
+//           player, over random buffs, calendar and players
+//   accrue  ExpTimeline::Accrue() (src/ExpAccrual.hpp) against adding
+//           ExpPerMinute() once per whole minute, with the buffs recorded
+//           at that minute, none once they went stale, and the calendar
+//           of that minute, over random buff timelines and checkpoints
+//
+//   accrual_check [--runs 200] [--seed 1]
+//
+// Timelines start a few days before a birthday, so checkpoints cross
+// midnights, a monday and the birthday. Gaps between buff records go past
+// ExpTimeline::kStale now and then, as while the machine sleeps.
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "ExpAccrual.hpp"
+#include "GameFormula.hpp"
+
+namespace {
+
+struct Tally {
+  uint64_t checked = 0;
+  uint64_t mismatched = 0;
+  uint64_t minutes = 0;
+};
+
+struct Record {
+  time_t at;
+  BuffState buffs;
+};
+
+BuffState RandomBuffs(std::mt19937& rng) {
+  BuffState buffs;
+  buffs.live = rng() % 4 == 0;
+  buffs.dynamic = rng() % 2 == 0;
+  buffs.guard = rng() % 3 == 0;
+  buffs.medal_level = rng() % 3 == 0 ? static_cast<int>(rng() % 41) : 0;
+  return buffs;
+}
+
+// buffs in effect at t: the latest record, unless it went stale
+BuffState BuffsAt(const std::vector<Record>& records, time_t t) {
+  auto it = std::upper_bound(
+      records.begin(), records.end(), t,
+      [](time_t at, const Record& record) { return at < record.at; });
+  if (it == records.begin()) {
+    return {};
+  }
+  --it;
+  return t < it->at + ExpTimeline::kStale ? it->buffs : BuffState{};
+}
+
+// the old ExpTask: one ExpPerMinute() at every whole minute in (from, to]
+int64_t Tick(const std::vector<Record>& records, time_t from, time_t to,
+             ExpFactors factors) {
+  int64_t exp = 0;
+  for (time_t minute = (from / 60 + 1) * 60; minute <= to; minute += 60) {
+    factors.buffs = BuffsAt(records, minute);
+    CalendarBuffs(minute, &factors.monday, &factors.birthday);
+    exp += formula::ExpPerMinute(factors);
+  }
+  return exp;
+}
+
+void CheckBatch(std::mt19937& rng, int runs, Tally& tally) {
+  constexpr size_t kPlayers = 257;
+  std::vector<int32_t> intellect(kPlayers), starcnt(kPlayers), out(kPlayers);
+  std::vector<uint8_t> fail(kPlayers);
+  for (int run = 0; run < runs; run++) {
+    ExpFactors shared;
+    shared.buffs = RandomBuffs(rng);
+    shared.monday = rng() % 2;
+    shared.birthday = rng() % 4 == 0;
+    shared.legacy = rng() % 2;
+    for (size_t i = 0; i < kPlayers; i++) {
+      intellect[i] = static_cast<int32_t>(rng() % 220);
+      starcnt[i] = static_cast<int32_t>(rng() % 16);
+      fail[i] = rng() % 3 == 0;
+    }
+    formula::ExpPerMinuteBatch(shared, kPlayers, intellect.data(),
+                               starcnt.data(), fail.data(), out.data());
+    for (size_t i = 0; i < kPlayers; i++) {
+      ExpFactors factors = shared;
+      factors.intellect = intellect[i];
+      factors.starcnt = starcnt[i];
+      factors.fail = fail[i];
+      tally.checked++;
+      if (out[i] != formula::ExpPerMinute(factors) &&
+          tally.mismatched++ < 5) {
+        std::printf("mismatch batch: intellect=%d starcnt=%d got %d want %d\n",
+                    intellect[i], starcnt[i], out[i],
+                    formula::ExpPerMinute(factors));
+      }
+    }
+  }
+}
+
+void CheckAccrue(std::mt19937& rng, int runs, Tally& tally) {
+  // local noon, four days before the birthday
+  tm day{};
+  day.tm_year = 2026 - 1900;
+  day.tm_mon = 10;
+  day.tm_mday = 21;
+  day.tm_hour = 12;
+  day.tm_isdst = -1;
+  const time_t base = mktime(&day);
+  for (int run = 0; run < runs; run++) {
+    ExpTimeline timeline;
+    std::vector<Record> records;
+    time_t now = base + static_cast<time_t>(rng() % 86400);
+    time_t checkpoint = now;
+    // a few days of records and checkpoints
+    for (int step = 0; step < 400; step++) {
+      // mostly refreshes, now and then a gap past kStale or a long sleep
+      int kind = rng() % 20;
+      now += kind == 0   ? 600 + rng() % 40000
+             : kind < 3 ? ExpTimeline::kStale + rng() % 300
+                        : 1 + rng() % 70;
+      if (rng() % 4 != 0) {
+        BuffState buffs =
+            records.empty() || rng() % 3 == 0 ? RandomBuffs(rng)
+                                              : records.back().buffs;
+        timeline.Record(now, buffs);
+        records.push_back({now, buffs});
+      }
+      if (rng() % 8 != 0) {
+        continue;
+      }
+      ExpFactors factors;
+      factors.intellect = static_cast<int>(rng() % 150);
+      factors.starcnt = static_cast<int>(rng() % 6);
+      factors.fail = rng() % 3 == 0;
+      factors.legacy = rng() % 2;
+      int64_t want = Tick(records, checkpoint, now, factors);
+      int64_t got = timeline.Accrue(checkpoint, now, factors);
+      tally.checked++;
+      tally.minutes += now / 60 - checkpoint / 60;
+      if (got != want && tally.mismatched++ < 5) {
+        std::printf("mismatch accrue: run %d (%lld, %lld] got %lld want %lld\n",
+                    run, static_cast<long long>(checkpoint),
+                    static_cast<long long>(now), static_cast<long long>(got),
+                    static_cast<long long>(want));
+      }
+      checkpoint = now;
+    }
+  }
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  int runs = 200;
+  unsigned seed = 1;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    std::string flag = argv[i];
+    if (flag == "--runs") {
+      runs = std::max(1, std::atoi(argv[i + 1]));
+    } else if (flag == "--seed") {
+      seed = static_cast<unsigned>(std::atoi(argv[i + 1]));
+    } else {
+      std::fprintf(stderr, "accrual_check: unknown option %s\n", flag.c_str());
+      return 2;
+    }
+  }
+  std::mt19937 rng(seed);
+  Tally batch, accrue;
+  CheckBatch(rng, runs, batch);
+  CheckAccrue(rng, runs, accrue);
+
+  std::printf("%-7s  %10s  %10s  %10s\n", "check", "checked", "minutes",
+              "mismatched");
+  std::printf("%-7s  %10llu  %10s  %10llu\n", "batch",
+              static_cast<unsigned long long>(batch.checked), "-",
+              static_cast<unsigned long long>(batch.mismatched));
+  std::printf("%-7s  %10llu  %10llu  %10llu\n", "accrue",
+              static_cast<unsigned long long>(accrue.checked),
+              static_cast<unsigned long long>(accrue.minutes),
+              static_cast<unsigned long long>(accrue.mismatched));
+  if (batch.mismatched > 0 || accrue.mismatched > 0) {
+    std::printf("FAILED\n");
+    return 1;
+  }
+  return 0;
+}
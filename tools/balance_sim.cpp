@@ -0,0 +1,435 @@
+// Plays simulated players through many days with the game's own formulas
+// (src/GameFormula.hpp) and task catalog, and prints what each buff mix
+// does to exp per day, time to the first star and task success, to tune
+// doc/attributes.md without playtesting for weeks.
+//
+//   balance_sim [--tasks resources/tasks.json] [--players 10000]
+//               [--days 120] [--online 8] [--step 15] [--seed 1]
+//               [--threads 0]
+//
+// Each player is online for the first --online hours of every day and
+// checks in every --step minutes: confirms a finished task, claims stars,
+// buys the lowest attribute while exp allows and starts the task with the
+// best expected points per second. Offline time accrues exp without
+// network buffs, as the game does. Results depend on --seed only, not on
+// the thread count.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+#include "GameFormula.hpp"
+#include "GameSchema.hpp"
+#include "Random.hpp"
+
+namespace {
+
+struct Options {
+  std::string tasks = "resources/tasks.json";
+  int players = 10000;
+  int days = 120;
+  int online_hours = 8;
+  int step_minutes = 15;
+  uint64_t seed = 1;
+  int threads = 0;
+};
+
+struct TaskSpec {
+  int id;
+  int cost;
+  AttrMap requirements;
+  AttrMap rewards;
+  bool repeatable;
+};
+
+struct Mix {
+  const char* name;
+  BuffState buffs;
+};
+
+// network buffs held while online
+const Mix kMixes[] = {
+    {"none", {}},
+    {"dynamic", {false, true, false, 0}},
+    {"live", {true, false, false, 0}},
+    {"guard", {false, false, true, 0}},
+    {"medal 21", {false, false, false, 21}},
+    {"all", {true, true, true, 21}},
+};
+
+constexpr size_t kBatch = 256;
+
+struct Player {
+  Xoshiro256 rng{0};
+  AttrArray attrs{};
+  int starcnt = 0;
+  int failcount = 0;
+  // index into the task list, -1 when idle
+  int task = -1;
+  int task_left = 0;
+  std::vector<bool> archived;
+  int first_star_day = -1;
+  int64_t exp_earned = 0;
+  int tasks_done = 0;
+  int tasks_ok = 0;
+};
+
+struct Result {
+  int first_star_day;
+  int stars;
+  double exp_per_day;
+  int tasks_done;
+  int tasks_ok;
+};
+
+int& At(Player& p, Attr attr) { return p.attrs[AttrIndex(attr)]; }
+
+void AddExp(Player& p, int64_t exp) {
+  int& value = At(p, Attr::Exp);
+  value = static_cast<int>(
+      std::min<int64_t>(std::max<int64_t>(value + exp, 0), formula::kMaxValue));
+}
+
+// DataManager::AddAttribute: points past the limit come back as exp
+void AddAttr(Player& p, Attr attr, int value) {
+  if (attr == Attr::Exp) {
+    AddExp(p, value);
+    return;
+  }
+  int limit = formula::AttrLimit(p.starcnt);
+  int next = std::max(At(p, attr) + value, 0);
+  if (next > limit) {
+    AddExp(p, int64_t(next - limit) * formula::kFlatCost / 2);
+    next = limit;
+  }
+  At(p, attr) = next;
+}
+
+int Lack(const Player& p, const TaskSpec& task) {
+  int lack = 0;
+  task.requirements.ForEach([&](Attr attr, int required) {
+    lack += std::max(required - p.attrs[AttrIndex(attr)], 0);
+  });
+  return lack;
+}
+
+class Simulation {
+ public:
+  Simulation(const Options& options, std::vector<TaskSpec> tasks)
+      : options_(options), tasks_(std::move(tasks)) {}
+
+  std::vector<Result> Run(size_t mix) {
+    std::vector<Result> results(options_.players);
+    std::atomic<size_t> next{0};
+    auto worker = [&]() {
+      for (;;) {
+        size_t begin = next.fetch_add(kBatch);
+        if (begin >= results.size()) {
+          return;
+        }
+        size_t end = std::min(begin + kBatch, results.size());
+        runBatch(mix, begin, end, results);
+      }
+    };
+    std::vector<std::thread> threads;
+    for (int i = 0; i < options_.threads; i++) {
+      threads.emplace_back(worker);
+    }
+    for (auto& thread : threads) {
+      thread.join();
+    }
+    return results;
+  }
+
+ private:
+  const Options& options_;
+  std::vector<TaskSpec> tasks_;
+
+  void runBatch(size_t mix, size_t begin, size_t end,
+                std::vector<Result>& results) {
+    const size_t n = end - begin;
+    std::vector<Player> players(n);
+    for (size_t i = 0; i < n; i++) {
+      Player& p = players[i];
+      // one stream per player, so threads never change the outcome
+      p.rng = Xoshiro256(options_.seed ^ (uint64_t(mix) << 48) ^ (begin + i));
+      // a fresh save, see DataManager::init()
+      At(p, Attr::Speed) = 2;
+      At(p, Attr::Strength) = 1;
+      At(p, Attr::Endurance) = 1;
+      At(p, Attr::Will) = 3;
+      At(p, Attr::Intellect) = 4;
+      p.archived.assign(tasks_.size(), false);
+    }
+    // exp inputs gathered per step, structure of arrays for the batch pass
+    std::vector<int32_t> intellect(n), starcnt(n), rate(n);
+    std::vector<uint8_t> fail(n);
+
+    const int steps = 24 * 60 / options_.step_minutes;
+    const int online_steps = options_.online_hours * 60 / options_.step_minutes;
+    for (int day = 0; day < options_.days; day++) {
+      for (int step = 0; step < steps; step++) {
+        const bool online = step < online_steps;
+        ExpFactors shared;
+        shared.buffs = online ? kMixes[mix].buffs : BuffState{};
+        shared.monday = day % 7 == 0;
+        for (size_t i = 0; i < n; i++) {
+          intellect[i] = At(players[i], Attr::Intellect);
+          starcnt[i] = players[i].starcnt;
+          fail[i] = players[i].failcount >= 2;
+        }
+        formula::ExpPerMinuteBatch(shared, n, intellect.data(), starcnt.data(),
+                                   fail.data(), rate.data());
+        for (size_t i = 0; i < n; i++) {
+          Player& p = players[i];
+          int64_t gain = int64_t(rate[i]) * options_.step_minutes;
+          AddExp(p, gain);
+          p.exp_earned += gain;
+          if (p.task >= 0) {
+            p.task_left -= options_.step_minutes * 60;
+          }
+          if (online) {
+            play(p, rate[i], day);
+          }
+        }
+      }
+    }
+    for (size_t i = 0; i < n; i++) {
+      const Player& p = players[i];
+      results[begin + i] = {p.first_star_day, p.starcnt,
+                            double(p.exp_earned) / options_.days, p.tasks_done,
+                            p.tasks_ok};
+    }
+  }
+
+  void play(Player& p, int rate, int day) {
+    if (p.task >= 0 && p.task_left <= 0) {
+      settle(p, rate);
+    }
+    // DataManager::FetchStar
+    while (std::all_of(kBaseAttrs.begin(), kBaseAttrs.end(), [&](Attr attr) {
+      return At(p, attr) >= formula::kStarCost;
+    })) {
+      for (Attr attr : kBaseAttrs) {
+        At(p, attr) -= formula::kStarCost;
+      }
+      p.starcnt++;
+      if (p.first_star_day < 0) {
+        p.first_star_day = day;
+      }
+    }
+    buy(p);
+    if (p.task < 0) {
+      start(p, rate);
+    }
+  }
+
+  // GameTask::Settle and DataManager::ConfirmTask
+  void settle(Player& p, int rate) {
+    const TaskSpec& task = tasks_[p.task];
+    int threshold = formula::FailThreshold(Lack(p, task), At(p, Attr::Will),
+                                           p.starcnt);
+    bool success = threshold < formula::kRollRange &&
+                   p.rng.Below(formula::kRollRange) >= threshold;
+    p.tasks_done++;
+    if (success) {
+      p.tasks_ok++;
+      task.rewards.ForEach(
+          [&](Attr attr, int value) { AddAttr(p, attr, value); });
+      if (task.id == 1) {
+        AddExp(p, 10 * int64_t(rate));
+      }
+      p.failcount = 0;
+      if (!task.repeatable) {
+        p.archived[p.task] = true;
+      }
+    } else {
+      p.failcount++;
+    }
+    p.task = -1;
+  }
+
+  // spend exp on the lowest attribute, one point at a time
+  void buy(Player& p) {
+    const int limit = formula::AttrLimit(p.starcnt);
+    for (;;) {
+      Attr lowest = *std::min_element(
+          kBaseAttrs.begin(), kBaseAttrs.end(),
+          [&](Attr a, Attr b) { return At(p, a) < At(p, b); });
+      int cost = formula::BuyCost(At(p, Attr::BuyCnt));
+      if (At(p, lowest) >= limit || At(p, Attr::Exp) < cost) {
+        return;
+      }
+      At(p, lowest)++;
+      At(p, Attr::Exp) -= cost;
+      At(p, Attr::BuyCnt)++;
+    }
+  }
+
+  // the task with the most expected attribute points per second
+  void start(Player& p, int rate) {
+    const double point = formula::BuyCost(At(p, Attr::BuyCnt));
+    double best = 0;
+    for (size_t i = 0; i < tasks_.size(); i++) {
+      const TaskSpec& task = tasks_[i];
+      if (p.archived[i]) {
+        continue;
+      }
+      int threshold = formula::FailThreshold(Lack(p, task), At(p, Attr::Will),
+                                             p.starcnt);
+      if (threshold >= formula::kRollRange) {
+        continue;
+      }
+      double value = 0;
+      task.rewards.ForEach([&](Attr attr, int v) {
+        value += attr == Attr::Exp ? v / point : v;
+      });
+      if (task.id == 1) {
+        value += 10.0 * rate / point;
+      }
+      double chance = 1 - double(threshold) / formula::kRollRange;
+      int seconds = formula::TaskCost(task.cost, At(p, Attr::Speed));
+      double score = value * chance / std::max(seconds, 1);
+      if (score > best) {
+        best = score;
+        p.task = static_cast<int>(i);
+        p.task_left = seconds;
+      }
+    }
+  }
+};
+
+std::vector<TaskSpec> LoadTasks(const std::string& path) {
+  std::ifstream in(path);
+  if (!in.is_open()) {
+    std::fprintf(stderr, "balance_sim: cannot open %s\n", path.c_str());
+    std::exit(1);
+  }
+  auto parse = [](const nlohmann::json& j, AttrMap& attrs) {
+    for (const auto& [key, value] : j.items()) {
+      if (auto attr = ParseAttr(key)) {
+        attrs.Set(*attr, value.get<int>());
+      }
+    }
+  };
+  std::vector<TaskSpec> tasks;
+  for (const auto& t : nlohmann::json::parse(in)) {
+    if (t.value("debug", false)) {
+      continue;
+    }
+    TaskSpec task{t["id"].get<int>(), t["cost"].get<int>(), {}, {},
+                  t["repeatable"].get<bool>()};
+    parse(t["requirements"], task.requirements);
+    if (t.contains("rewards")) {
+      parse(t["rewards"], task.rewards);
+    }
+    tasks.push_back(task);
+  }
+  return tasks;
+}
+
+template <typename T>
+T Percentile(std::vector<T> values, double q) {
+  if (values.empty()) {
+    return T{};
+  }
+  size_t k = std::min(values.size() - 1, size_t(q * values.size()));
+  std::nth_element(values.begin(), values.begin() + k, values.end());
+  return values[k];
+}
+
+Options ParseOptions(int argc, char** argv) {
+  Options options;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    std::string flag = argv[i];
+    const char* value = argv[i + 1];
+    if (flag == "--tasks") {
+      options.tasks = value;
+    } else if (flag == "--players") {
+      options.players = std::atoi(value);
+    } else if (flag == "--days") {
+      options.days = std::atoi(value);
+    } else if (flag == "--online") {
+      options.online_hours = std::atoi(value);
+    } else if (flag == "--step") {
+      options.step_minutes = std::atoi(value);
+    } else if (flag == "--seed") {
+      options.seed = std::strtoull(value, nullptr, 10);
+    } else if (flag == "--threads") {
+      options.threads = std::atoi(value);
+    } else {
+      std::fprintf(stderr, "balance_sim: unknown option %s\n", flag.c_str());
+      std::exit(2);
+    }
+  }
+  if (options.threads <= 0) {
+    options.threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  if (options.step_minutes <= 0 || 24 * 60 % options.step_minutes != 0 ||
+      options.players <= 0 || options.days <= 0) {
+    std::fprintf(stderr, "balance_sim: bad --players, --days or --step\n");
+    std::exit(2);
+  }
+  return options;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  Options options = ParseOptions(argc, argv);
+  Simulation simulation(options, LoadTasks(options.tasks));
+  std::printf("%d players x %d days, online %dh, check-in every %d min, "
+              "seed %llu, %d threads\n\n",
+              options.players, options.days, options.online_hours,
+              options.step_minutes,
+              static_cast<unsigned long long>(options.seed), options.threads);
+  std::printf("%-9s %27s %27s %7s %8s\n", "mix", "exp/day p10/p50/p90",
+              "first star day p10/p50/p90", "stars", "success");
+  auto started = std::chrono::steady_clock::now();
+  for (size_t mix = 0; mix < std::size(kMixes); mix++) {
+    std::vector<Result> results = simulation.Run(mix);
+    std::vector<double> exp_per_day;
+    std::vector<int> star_days;
+    double stars = 0;
+    int64_t done = 0, ok = 0;
+    for (const Result& r : results) {
+      exp_per_day.push_back(r.exp_per_day);
+      // players without a star sort last
+      star_days.push_back(r.first_star_day < 0 ? options.days
+                                               : r.first_star_day);
+      stars += r.stars;
+      done += r.tasks_done;
+      ok += r.tasks_ok;
+    }
+    auto day = [&](double q) {
+      int d = Percentile(star_days, q);
+      return d >= options.days ? std::string("-") : std::to_string(d);
+    };
+    char exp_cell[64], star_cell[64];
+    std::snprintf(exp_cell, sizeof(exp_cell), "%.0f/%.0f/%.0f",
+                  Percentile(exp_per_day, 0.1), Percentile(exp_per_day, 0.5),
+                  Percentile(exp_per_day, 0.9));
+    std::snprintf(star_cell, sizeof(star_cell), "%s/%s/%s", day(0.1).c_str(),
+                  day(0.5).c_str(), day(0.9).c_str());
+    std::printf("%-9s %27s %27s %7.2f %7.1f%%\n", kMixes[mix].name, exp_cell,
+                star_cell, stars / results.size(),
+                done ? 100.0 * ok / done : 0.0);
+  }
+  double seconds = std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - started)
+                       .count();
+  double player_days =
+      double(options.players) * options.days * std::size(kMixes);
+  std::printf("\n%.0f player-days in %.1fs, %.2fM player-days/s\n",
+              player_days, seconds, player_days / seconds / 1e6);
+  return 0;
+}
@@ -0,0 +1,321 @@
+// Drives BuffTimeline (src/BuffTimeline.hpp) and ExpTimeline
+// (src/ExpAccrual.hpp) on a fake clock, time is only ever passed in, and
+// checks:
+//
+//   checkpoint  ExpTimeline::Settle() moves a checkpoint of 0 or in the
+//               future to now with nothing owed, keeps one in the current
+//               minute, and moves any other to now
+//   cap         exp owed after a long shutdown stops at kMaxAccrual
+//   dynamic     the dynamic buff ends exactly kDynamicLasts after the post
+//   midnight    monday starts and ends on local midnight
+//   refresh     remote refreshes back off while nothing changes
+//   drive       days of the BuffManager worker loop with random remote
+//               changes, sleeps and the quarter hour settle: every
+//               transition is published on its instant while awake, and
+//               settled exp equals a per-minute tick over what was recorded
+//
+//   buff_check [--days 14] [--seed 1]
+//
+// Prints one line per case and FAILED if any check did not hold.
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "BuffTimeline.hpp"
+#include "ExpAccrual.hpp"
+#include "GameFormula.hpp"
+
+namespace {
+
+struct Record {
+  time_t at;
+  BuffState buffs;
+};
+
+int failures = 0;
+
+void Check(const char* name, bool ok, const char* what) {
+  if (!ok) {
+    std::printf("%-10s  FAILED: %s\n", name, what);
+    failures++;
+  }
+}
+
+time_t LocalTime(int mday, int hour, int min, int sec) {
+  tm day{};
+  day.tm_year = 2026 - 1900;
+  day.tm_mon = 10;
+  day.tm_mday = mday;
+  day.tm_hour = hour;
+  day.tm_min = min;
+  day.tm_sec = sec;
+  day.tm_isdst = -1;
+  return mktime(&day);
+}
+
+// Sunday 22 November 2026, the week of the birthday
+const time_t kSunday = LocalTime(22, 12, 0, 0);
+
+// the per-minute tick over recorded buffs, see tools/accrual_check
+int64_t Tick(const std::vector<Record>& records, time_t from, time_t to,
+             ExpFactors factors) {
+  int64_t exp = 0;
+  size_t next = 0;
+  for (time_t minute = (from / 60 + 1) * 60; minute <= to; minute += 60) {
+    while (next < records.size() && records[next].at <= minute) {
+      next++;
+    }
+    factors.buffs = BuffState{};
+    if (next > 0 && minute < records[next - 1].at + ExpTimeline::kStale) {
+      factors.buffs = records[next - 1].buffs;
+    }
+    CalendarBuffs(minute, &factors.monday, &factors.birthday);
+    exp += formula::ExpPerMinute(factors);
+  }
+  return exp;
+}
+
+ExpFactors BaseFactors() {
+  ExpFactors factors;
+  factors.intellect = 30;
+  factors.starcnt = 1;
+  return factors;
+}
+
+void Checkpoint() {
+  const char* name = "checkpoint";
+  ExpTimeline timeline;
+  const ExpFactors factors = BaseFactors();
+  time_t now = kSunday + 30;
+  time_t checkpoint = 0;
+  Check(name, timeline.Settle(checkpoint, now, factors) == 0 &&
+                  checkpoint == now,
+        "a first run did not start at now");
+  checkpoint = now + 3600;
+  Check(name, timeline.Settle(checkpoint, now, factors) == 0 &&
+                  checkpoint == now,
+        "a future checkpoint did not come back to now");
+  Check(name, timeline.Settle(checkpoint, now + 29, factors) == 0 &&
+                  checkpoint == now,
+        "moved within its minute");
+  int64_t exp = timeline.Settle(checkpoint, now + 30, factors);
+  Check(name, checkpoint == now + 30, "did not move on the next minute");
+  Check(name, exp == Tick({}, now, now + 30, factors),
+        "did not owe the minute that started");
+  exp = timeline.Settle(checkpoint, now + 3630, factors);
+  Check(name,
+        checkpoint == now + 3630 && exp == Tick({}, now + 30, now + 3630,
+                                                 factors),
+        "did not owe the hour since");
+}
+
+void Cap() {
+  const char* name = "cap";
+  const ExpFactors factors = BaseFactors();
+  const time_t now = kSunday + 3 * 86400 + 17;
+  const time_t cap = ExpTimeline::kMaxAccrual;
+  struct Case {
+    time_t away;
+    time_t owed;
+  };
+  const Case cases[] = {{6 * 86400, 6 * 86400},
+                        {cap, cap},
+                        {cap + 60, cap},
+                        {30 * 86400, cap}};
+  for (const Case& c : cases) {
+    ExpTimeline timeline;
+    time_t checkpoint = now - c.away;
+    int64_t exp = timeline.Settle(checkpoint, now, factors);
+    if (exp != Tick({}, now - c.owed, now, factors) || checkpoint != now) {
+      std::printf("%-10s  FAILED: %llds away\n", name,
+                  static_cast<long long>(c.away));
+      failures++;
+    }
+  }
+}
+
+void Dynamic() {
+  const char* name = "dynamic";
+  BuffTimeline timeline;
+  const time_t post = kSunday + 100;
+  const time_t end = post + BuffTimeline::kDynamicLasts;
+  timeline.SetDynamic(post);
+  timeline.Publish(post - 60);
+  Check(name, !timeline.At(post - 1).buffs.dynamic, "started before the post");
+  Check(name, timeline.At(post).buffs.dynamic, "did not start at the post");
+  Check(name, timeline.At(end - 1).buffs.dynamic, "ended early");
+  Check(name, !timeline.At(end).buffs.dynamic, "did not end on time");
+  Check(name, timeline.NextTransition(post + 60) == end,
+        "no wakeup at the end");
+  Check(name, timeline.NextTransition(post - 60) == post,
+        "no wakeup at a post ahead of the clock");
+}
+
+void Midnight() {
+  const char* name = "midnight";
+  BuffTimeline timeline;
+  const time_t midnight = LocalTime(23, 0, 0, 0);
+  timeline.Publish(midnight - 1);
+  Check(name, !timeline.Published().monday, "monday on sunday");
+  Check(name, timeline.NextTransition(midnight - 1) == midnight,
+        "no wakeup at midnight");
+  Check(name, timeline.Publish(midnight) && timeline.Published().monday,
+        "monday did not start at midnight");
+  const time_t tuesday = LocalTime(24, 0, 0, 0);
+  Check(name, !timeline.Publish(tuesday - 1), "changed within monday");
+  Check(name, timeline.Publish(tuesday) && !timeline.Published().monday,
+        "monday did not end at midnight");
+}
+
+void Refresh() {
+  const char* name = "refresh";
+  BuffTimeline timeline;
+  time_t now = kSunday;
+  const time_t want[] = {20, 40, 60, 60};
+  bool ok = true;
+  for (time_t interval : want) {
+    timeline.Refreshed(now, false);
+    ok = ok && timeline.NextRefresh() == now + interval;
+    now = timeline.NextRefresh();
+  }
+  Check(name, ok, "did not back off to kMaxRefresh");
+  timeline.Refreshed(now, true);
+  Check(name, timeline.NextRefresh() == now + BuffTimeline::kMinRefresh,
+        "a change did not bring refreshes back");
+  timeline.RefreshNow();
+  Check(name, timeline.NextRefresh() <= now, "RefreshNow() waited");
+}
+
+void Drive(int days, unsigned seed) {
+  const char* name = "drive";
+  std::mt19937 rng(seed);
+  BuffTimeline buffs;
+  ExpTimeline exp_timeline;
+  std::vector<Record> records;
+  const ExpFactors factors = BaseFactors();
+  time_t now = kSunday - 2 * 86400 + rng() % 86400;
+  const time_t end = now + days * 86400;
+  time_t checkpoint = 0;
+  exp_timeline.Settle(checkpoint, now, factors);
+  time_t next_settle = (now / 900 + 1) * 900;
+  time_t latest_post = 0;
+  time_t awake_since = now;
+  ExpFactors published = buffs.At(now);
+  int64_t settled = 0;
+  int64_t ticked = 0;
+  uint64_t late = 0;
+  uint64_t publishes = 0;
+
+  // BuffManager::publish()
+  auto publish = [&](bool refreshed) {
+    bool changed = buffs.Publish(now);
+    if (refreshed) {
+      buffs.Refreshed(now, changed);
+    }
+    const ExpFactors& current = buffs.Published();
+    if (changed && now > awake_since) {
+      // a buff that ended by itself ends on its instant
+      if (published.buffs.dynamic && !current.buffs.dynamic &&
+          now != latest_post + BuffTimeline::kDynamicLasts) {
+        late++;
+      }
+      if (published.monday != current.monday && NextMidnight(now - 1) != now) {
+        late++;
+      }
+    }
+    published = current;
+    publishes += changed;
+    if (changed || refreshed) {
+      exp_timeline.Record(now, current.buffs);
+      records.push_back({now, current.buffs});
+    }
+  };
+
+  while (now < end) {
+    time_t wake = std::min(buffs.NextRefresh(), buffs.NextTransition(now));
+    if (next_settle <= wake) {
+      // the quarter hour ExpTask
+      now = std::max(now, next_settle);
+      time_t before = checkpoint;
+      settled += exp_timeline.Settle(checkpoint, now, factors);
+      ticked += Tick(records, before, now, factors);
+      next_settle = (now / 900 + 1) * 900;
+      continue;
+    }
+    now = std::max(now, wake);
+    if (rng() % 2000 == 0) {
+      // asleep for hours, the worker wakes up late
+      now += 3600 + rng() % 36000;
+      awake_since = now;
+      publish(false);
+      continue;
+    }
+    if (now < buffs.NextRefresh()) {
+      publish(false);
+      continue;
+    }
+    // a remote refresh, now and then something changed remotely
+    if (rng() % 40 == 0) {
+      latest_post = now - rng() % 7200;
+      buffs.SetDynamic(latest_post);
+    }
+    if (rng() % 60 == 0) {
+      buffs.SetLive(rng() % 2);
+    }
+    if (rng() % 200 == 0) {
+      buffs.SetGuard(rng() % 2, rng() % 30);
+    }
+    publish(true);
+  }
+  Check(name, late == 0, "a transition was published late while awake");
+  Check(name, settled == ticked, "settled exp differs from the tick");
+  std::printf("%-10s  %llu publishes, %lld exp over %d days\n", name,
+              static_cast<unsigned long long>(publishes),
+              static_cast<long long>(settled), days);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  int days = 14;
+  unsigned seed = 1;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    std::string flag = argv[i];
+    if (flag == "--days") {
+      days = std::max(1, std::atoi(argv[i + 1]));
+    } else if (flag == "--seed") {
+      seed = static_cast<unsigned>(std::atoi(argv[i + 1]));
+    } else {
+      std::fprintf(stderr, "buff_check: unknown option %s\n", flag.c_str());
+      return 2;
+    }
+  }
+  struct Case {
+    const char* name;
+    void (*run)();
+  };
+  const Case cases[] = {{"checkpoint", Checkpoint},
+                        {"cap", Cap},
+                        {"dynamic", Dynamic},
+                        {"midnight", Midnight},
+                        {"refresh", Refresh}};
+  for (const auto& c : cases) {
+    int before = failures;
+    c.run();
+    if (failures == before) {
+      std::printf("%-10s  ok\n", c.name);
+    }
+  }
+  Drive(days, seed);
+  if (failures > 0) {
+    std::printf("FAILED\n");
+    return 1;
+  }
+  return 0;
+}
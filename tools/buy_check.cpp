@@ -0,0 +1,159 @@
+// Checks the bulk purchase math in src/GameFormula.hpp (TotalCost(),
+// Affordable(), BulkRefund(), what DataManager::BuyAttribute() and
+// RevertAttribute() charge and pay) against buying and reverting one point
+// at a time with BuyCost().
+//
+//   buy_check [--buycnt 60] [--samples 200] [--seed 1]
+//
+// Every buycnt in [0, --buycnt] is tried with exp of 0, around the curve
+// steps, --samples random amounts and kMaxValue, and with no room left, a
+// few points of room and a full attribute's worth. Cases are grouped by
+// where the single-step buyer stops: at the limit, at zero exp, part way
+// through a request, or never.
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "GameFormula.hpp"
+
+namespace {
+
+enum Group { AT_LIMIT, ZERO_EXP, PARTIAL, FULL, PREFIX, REFUND, GROUP_COUNT };
+
+const char* kGroupNames[] = {"at limit", "zero exp", "partial", "full",
+                             "prefix sum", "refund"};
+
+struct Tally {
+  uint64_t checked = 0;
+  uint64_t mismatched = 0;
+};
+
+// BuyAttribute() as single purchases: the next point while there is room
+// and exp covers it
+int BuySteps(int buycnt, int64_t exp, int room, int64_t* spent) {
+  int n = 0;
+  *spent = 0;
+  while (n < room && *spent + formula::BuyCost(buycnt + n) <= exp) {
+    *spent += formula::BuyCost(buycnt + n);
+    n++;
+  }
+  return n;
+}
+
+// RevertAttribute() as single reverts: half the latest purchase, half the
+// first once buycnt is down to 0
+int64_t RevertSteps(int buycnt, int n) {
+  int64_t refund = 0;
+  for (int i = 0; i < n; i++) {
+    buycnt = std::max(buycnt - 1, 0);
+    refund += formula::BuyCost(buycnt) / 2;
+  }
+  return refund;
+}
+
+void Check(Tally& tally, bool ok, const char* what, int buycnt, int64_t exp,
+           int room) {
+  tally.checked++;
+  if (!ok) {
+    if (tally.mismatched++ < 5) {
+      std::printf("mismatch %s: buycnt=%d exp=%lld room=%d\n", what, buycnt,
+                  static_cast<long long>(exp), room);
+    }
+  }
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  int max_buycnt = 60;
+  int samples = 200;
+  unsigned seed = 1;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    std::string flag = argv[i];
+    if (flag == "--buycnt") {
+      max_buycnt = std::max(0, std::atoi(argv[i + 1]));
+    } else if (flag == "--samples") {
+      samples = std::max(0, std::atoi(argv[i + 1]));
+    } else if (flag == "--seed") {
+      seed = static_cast<unsigned>(std::atoi(argv[i + 1]));
+    } else {
+      std::fprintf(stderr, "buy_check: unknown option %s\n", flag.c_str());
+      return 2;
+    }
+  }
+  const int limit = formula::AttrLimit(0);
+  const int rooms[] = {0, 1, 2, 5, limit};
+  std::mt19937 rng(seed);
+  std::uniform_int_distribution<int> any_exp(0, formula::kMaxValue);
+  Tally tally[GROUP_COUNT];
+
+  for (int buycnt = 0; buycnt <= max_buycnt; buycnt++) {
+    // n purchases in one go cost what n single ones do
+    int64_t sum = 0;
+    for (int n = 0; n <= limit; n++) {
+      Check(tally[PREFIX], formula::BulkCost(buycnt, n) == sum, "cost", buycnt,
+            sum, n);
+      sum += formula::BuyCost(buycnt + n);
+    }
+    for (int n = 1; n <= limit; n++) {
+      Check(tally[REFUND],
+            formula::BulkRefund(buycnt, n) == RevertSteps(buycnt, n),
+            "refund", buycnt, 0, n);
+    }
+
+    std::vector<int64_t> amounts = {0, formula::kMaxValue};
+    for (int n = 0; n <= 3; n++) {
+      int64_t step = formula::BulkCost(buycnt, n);
+      amounts.insert(amounts.end(), {step - 1, step, step + 1});
+    }
+    for (int s = 0; s < samples; s++) {
+      amounts.push_back(any_exp(rng));
+    }
+    for (int64_t exp : amounts) {
+      if (exp < 0) {
+        continue;
+      }
+      for (int room : rooms) {
+        int64_t spent = 0;
+        int steps = BuySteps(buycnt, exp, room, &spent);
+        Group group = room == 0  ? AT_LIMIT
+                      : exp == 0 ? ZERO_EXP
+                      : steps < room ? PARTIAL
+                                     : FULL;
+        // no count: as many as exp covers
+        int n = formula::Affordable(buycnt, static_cast<int>(exp), room);
+        Check(tally[group], n == steps && formula::BulkCost(buycnt, n) == spent,
+              "affordable", buycnt, exp, room);
+        // a count: all of it or nothing
+        for (int count = 1; count <= room; count++) {
+          int64_t single = 0;
+          bool covered = BuySteps(buycnt, exp, count, &single) == count;
+          bool bulk = formula::BulkCost(buycnt, count) <= exp;
+          Check(tally[group],
+                bulk == covered &&
+                    (!bulk || formula::BulkCost(buycnt, count) == single),
+                "count", buycnt, exp, count);
+        }
+      }
+    }
+  }
+
+  std::printf("%-10s  %10s  %10s\n", "case", "checked", "mismatched");
+  uint64_t mismatched = 0;
+  for (int g = 0; g < GROUP_COUNT; g++) {
+    std::printf("%-10s  %10llu  %10llu\n", kGroupNames[g],
+                static_cast<unsigned long long>(tally[g].checked),
+                static_cast<unsigned long long>(tally[g].mismatched));
+    mismatched += tally[g].mismatched;
+  }
+  if (mismatched > 0) {
+    std::printf("FAILED\n");
+    return 1;
+  }
+  return 0;
+}
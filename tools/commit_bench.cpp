@@ -0,0 +1,129 @@
+// Commit latency of game data writes on every compiled-in GameStore
+// backend (src/GameStore.hpp): one synced write per key as GameData did
+// before transactions, one synced GameData::Transaction per operation, and
+// transactions under a group-commit window ([data] commit_window).
+//
+//   commit_bench [--ops 200] [--keys 5] [--window 100] [--dir path]
+//
+// An operation writes --keys keys, 5 is a DataManager::DumpTask and 23 a
+// PartStateManager::SnapshotState. Latency is what the calling thread
+// waits, e.g. the render thread at the end of a motion. Under a window the
+// flusher syncs once per window instead. --dir is wiped before and after.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "GameData.hpp"
+#include "GameStore.hpp"
+#include "LAppDefine.hpp"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+enum class Mode { PER_KEY, BATCH, WINDOW };
+
+struct Result {
+  double ops_per_second;
+  double mean_us;
+  double p99_us;
+};
+
+Result Run(std::string_view backend, Mode mode, int ops,
+           const std::vector<std::string>& keys, int window) {
+  GameData::Destroy(LAppDefine::documentPath);
+  std::vector<double> latencies;
+  auto start = Clock::now();
+  {
+    GameData data(LAppDefine::documentPath + L"/jpet.dat", backend);
+    if (!data.Initialized()) {
+      std::fprintf(stderr, "commit_bench: cannot open %s\n",
+                   std::string(backend).c_str());
+      std::exit(1);
+    }
+    if (mode == Mode::WINDOW) {
+      data.SetDurabilityWindow(std::chrono::milliseconds(window));
+    }
+    start = Clock::now();
+    for (int i = 0; i < ops; i++) {
+      auto begin = Clock::now();
+      if (mode == Mode::PER_KEY) {
+        for (const auto& key : keys) {
+          data.Update(key, i);
+        }
+      } else {
+        auto txn = data.Begin();
+        for (const auto& key : keys) {
+          txn.Update(key, i);
+        }
+        txn.Commit();
+      }
+      latencies.push_back(
+          std::chrono::duration<double, std::micro>(Clock::now() - begin)
+              .count());
+    }
+  }
+  // the closing sync is part of the run, or a window would look free
+  double seconds =
+      std::chrono::duration<double>(Clock::now() - start).count();
+  std::sort(latencies.begin(), latencies.end());
+  double sum = 0;
+  for (double latency : latencies) {
+    sum += latency;
+  }
+  return {ops / seconds, sum / latencies.size(),
+          latencies[static_cast<size_t>(0.99 * (latencies.size() - 1))]};
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  int ops = 200;
+  int key_count = 5;
+  int window = 100;
+  std::filesystem::path dir =
+      std::filesystem::temp_directory_path() / "jpet_commit_bench";
+  for (int i = 1; i + 1 < argc; i += 2) {
+    std::string flag = argv[i];
+    if (flag == "--ops") {
+      ops = std::atoi(argv[i + 1]);
+    } else if (flag == "--keys") {
+      key_count = std::atoi(argv[i + 1]);
+    } else if (flag == "--window") {
+      window = std::atoi(argv[i + 1]);
+    } else if (flag == "--dir") {
+      dir = argv[i + 1];
+    } else {
+      std::fprintf(stderr, "commit_bench: unknown option %s\n", flag.c_str());
+      return 2;
+    }
+  }
+  std::filesystem::create_directories(dir);
+  LAppDefine::documentPath = dir.wstring();
+  std::vector<std::string> keys;
+  for (int i = 0; i < key_count; i++) {
+    keys.push_back("part.Param" + std::to_string(i));
+  }
+  std::printf("%d operations of %d keys each\n\n", ops, key_count);
+  std::printf("%-8s  %-14s  %9s  %10s  %10s\n", "backend", "commit", "ops/s",
+              "mean us", "p99 us");
+  for (auto backend : GameStore::Backends()) {
+    for (Mode mode : {Mode::PER_KEY, Mode::BATCH, Mode::WINDOW}) {
+      Result result = Run(backend, mode, ops, keys, window);
+      std::string name = mode == Mode::PER_KEY ? "synced per key"
+                         : mode == Mode::BATCH
+                             ? "synced batch"
+                             : "window " + std::to_string(window) + "ms";
+      std::printf("%-8s  %-14s  %9.0f  %10.1f  %10.1f\n",
+                  std::string(backend).c_str(), name.c_str(),
+                  result.ops_per_second, result.mean_us, result.p99_us);
+    }
+  }
+  GameData::Destroy(LAppDefine::documentPath);
+  return 0;
+}
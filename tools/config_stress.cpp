@@ -0,0 +1,162 @@
+// Readers of DataManager::Config() against writers publishing new
+// snapshots (src/ConfigSnapshot.hpp), the way the render and audio threads
+// read while panel handlers change settings. Build it with
+// -fsanitize=thread where the toolchain has it, the checks below only see
+// torn snapshots, ThreadSanitizer also sees the races that did not tear.
+//
+//   config_stress [--readers 8] [--writers 4] [--seconds 3] [--dir path]
+//
+// Every write sets all fields of [audio] or [display] from one counter, so
+// each snapshot must agree with itself. Each reader checks that, that the
+// version it sees never goes back, and that the snapshot it holds does not
+// change under it. --dir is wiped first and gets a fresh jpet.toml and
+// game data.
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "DataManager.hpp"
+#include "LAppDefine.hpp"
+
+namespace {
+
+// volume is the counter, the flags follow from it
+bool AudioConsistent(const ConfigSnapshot& c) {
+  return c.mute == (c.volume % 2 == 1) &&
+         c.idle_audio == (c.volume % 3 == 0) &&
+         c.touch_audio == (c.volume % 5 == 0);
+}
+
+// scale is the counter, the flags follow from it
+bool DisplayConsistent(const ConfigSnapshot& c) {
+  int n = static_cast<int>(c.scale * 4);
+  return c.green == (n % 2 == 1) && c.rate_limit == (n % 3 == 0);
+}
+
+struct ReaderStats {
+  uint64_t reads = 0;
+  uint64_t torn = 0;
+  uint64_t backwards = 0;
+  uint64_t changed = 0;
+};
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  int readers = 8;
+  int writers = 4;
+  double seconds = 3;
+  std::filesystem::path dir =
+      std::filesystem::temp_directory_path() / "jpet_config_stress";
+  for (int i = 1; i + 1 < argc; i += 2) {
+    std::string flag = argv[i];
+    if (flag == "--readers") {
+      readers = std::atoi(argv[i + 1]);
+    } else if (flag == "--writers") {
+      writers = std::atoi(argv[i + 1]);
+    } else if (flag == "--seconds") {
+      seconds = std::atof(argv[i + 1]);
+    } else if (flag == "--dir") {
+      dir = argv[i + 1];
+    } else {
+      std::fprintf(stderr, "config_stress: unknown option %s\n", flag.c_str());
+      return 2;
+    }
+  }
+  std::filesystem::remove_all(dir);
+  std::filesystem::create_directories(dir);
+  LAppDefine::documentPath = dir.wstring();
+  DataManager* dm = DataManager::GetInstance();
+  dm->UpdateAudio(0, false, true, true);
+  dm->UpdateDisplay(0.0f, false, true);
+
+  std::atomic<bool> stop{false};
+  std::atomic<uint64_t> writes{0};
+  std::vector<ReaderStats> stats(readers);
+  std::vector<std::thread> threads;
+  for (int r = 0; r < readers; r++) {
+    threads.emplace_back([&, r] {
+      ReaderStats& s = stats[r];
+      uint64_t last = 0;
+      while (!stop.load(std::memory_order_relaxed)) {
+        const ConfigSnapshot& c = dm->Config();
+        int volume = c.volume;
+        size_t follows = c.follow_list.size();
+        if (!AudioConsistent(c) || !DisplayConsistent(c)) {
+          s.torn++;
+        }
+        if (c.version < last) {
+          s.backwards++;
+        }
+        last = c.version;
+        std::this_thread::yield();
+        // still the same snapshot until this thread asks again
+        if (c.volume != volume || c.follow_list.size() != follows) {
+          s.changed++;
+        }
+        s.reads++;
+      }
+    });
+  }
+  for (int w = 0; w < writers; w++) {
+    threads.emplace_back([&, w] {
+      int n = w;
+      std::string uid = "uid" + std::to_string(w);
+      while (!stop.load(std::memory_order_relaxed)) {
+        switch (n % 3) {
+          case 0:
+            dm->UpdateAudio(n % 101, n % 101 % 2 == 1, n % 101 % 3 == 0,
+                            n % 101 % 5 == 0);
+            break;
+          case 1: {
+            int s = n % 16;
+            dm->UpdateDisplay(s / 4.0f, s % 2 == 1, s % 3 == 0);
+            break;
+          }
+          default:
+            if (n % 2) {
+              dm->AddFollow(uid);
+            } else {
+              dm->RemoveFollow(uid);
+            }
+        }
+        n += writers;
+        writes.fetch_add(1, std::memory_order_relaxed);
+      }
+    });
+  }
+  std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+  stop = true;
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  ReaderStats total;
+  for (const auto& s : stats) {
+    total.reads += s.reads;
+    total.torn += s.torn;
+    total.backwards += s.backwards;
+    total.changed += s.changed;
+  }
+  std::printf("%d readers, %d writers, %.1fs\n", readers, writers, seconds);
+  std::printf("reads      %12.0f/s\n", total.reads / seconds);
+  std::printf("publishes  %12.0f/s\n", writes.load() / seconds);
+  std::printf("torn       %12llu\n",
+              static_cast<unsigned long long>(total.torn));
+  std::printf("backwards  %12llu\n",
+              static_cast<unsigned long long>(total.backwards));
+  std::printf("changed    %12llu\n",
+              static_cast<unsigned long long>(total.changed));
+  dm->Flush();
+  bool ok = total.torn == 0 && total.backwards == 0 && total.changed == 0;
+  if (!ok) {
+    std::printf("FAILED\n");
+  }
+  return ok ? 0 : 1;
+}
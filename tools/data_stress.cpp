@@ -0,0 +1,214 @@
+// Throughput of the DataManager API under contention, at 1 to --threads
+// threads. Every thread runs a random mix of what the render, scheduler,
+// buff and panel threads call: Config() and GetCurrentTask() reads, task
+// start, settle, confirm and cancel, attribute purchases and reverts, and
+// the /api/profile read. Settling calls SettleTask() directly instead of
+// waiting for the deadline, so tasks go round. Build it with
+// -fsanitize=thread where the toolchain has it.
+//
+//   data_stress [--threads 16] [--seconds 2] [--app dir] [--dir path]
+//
+// --app is the app's output directory, the one holding resources/tasks.bin,
+// the current directory by default. Counts invariant breaks along the
+// way: more than one active task, a current task that is not active, an
+// attribute out of range in a profile. --dir is wiped first and gets a
+// fresh jpet.toml and game data.
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "DataManager.hpp"
+#include "GameSchema.hpp"
+#include "LAppDefine.hpp"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+enum Op {
+  READ_CONFIG,
+  READ_CURRENT,
+  START,
+  SETTLE,
+  CONFIRM,
+  CANCEL,
+  BUY,
+  REVERT,
+  PROFILE,
+  LIST_TASKS,
+  ADD_EXP,
+  OP_COUNT,
+};
+
+struct Counters {
+  std::atomic<uint64_t> ops{0};
+  std::atomic<uint64_t> started{0};
+  std::atomic<uint64_t> confirmed{0};
+  std::atomic<uint64_t> bought{0};
+  std::atomic<uint64_t> broken{0};
+};
+
+void Worker(DataManager* dm, const std::vector<int>& ids, int limit,
+            unsigned seed, const std::atomic<bool>& stop, Counters& counters) {
+  std::mt19937 rng(seed);
+  volatile int sink = 0;
+  uint64_t ops = 0;
+  while (!stop.load(std::memory_order_relaxed)) {
+    int id = ids[rng() % ids.size()];
+    Attr attr = kBaseAttrs[rng() % kBaseAttrs.size()];
+    auto current = dm->GetCurrentTask();
+    int done = 0;
+    switch (rng() % OP_COUNT) {
+      case READ_CONFIG:
+        sink = sink + dm->Config().volume;
+        break;
+      case READ_CURRENT:
+        if (current && !current->Active()) {
+          counters.broken++;
+        }
+        break;
+      case START:
+        if (dm->StartTask(id) == TaskResult::OK) {
+          counters.started++;
+        }
+        break;
+      case SETTLE:
+        if (current && current->status == TStatus::RUNNING) {
+          dm->SettleTask(current->id,
+                         current->start_time + current->cost_snapshot);
+        }
+        break;
+      case CONFIRM: {
+        bool success = false;
+        if (current &&
+            dm->ConfirmTask(current->id, &success) == TaskResult::OK) {
+          counters.confirmed++;
+        }
+        break;
+      }
+      case CANCEL:
+        if (current) {
+          dm->CancelTask(current->id);
+        }
+        break;
+      case BUY:
+        if (dm->BuyAttribute(attr, 1, &done) == BuyResult::OK) {
+          counters.bought++;
+        }
+        break;
+      case REVERT:
+        dm->RevertAttribute(attr, 1, &done);
+        break;
+      case PROFILE: {
+        Profile profile = dm->LoadProfile();
+        for (Attr base : kBaseAttrs) {
+          int value = profile.attributes[AttrIndex(base)];
+          if (value < 0 || value > limit) {
+            counters.broken++;
+          }
+        }
+        break;
+      }
+      case LIST_TASKS: {
+        int active = 0;
+        for (const auto& task : dm->GetTasks()) {
+          active += task.Active();
+        }
+        if (active > 1) {
+          counters.broken++;
+        }
+        break;
+      }
+      default:
+        dm->AddAttribute(Attr::Exp, 50);
+    }
+    ops++;
+  }
+  counters.ops += ops;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  int max_threads = 16;
+  double seconds = 2;
+  std::filesystem::path app = std::filesystem::current_path();
+  std::filesystem::path dir =
+      std::filesystem::temp_directory_path() / "jpet_data_stress";
+  for (int i = 1; i + 1 < argc; i += 2) {
+    std::string flag = argv[i];
+    if (flag == "--threads") {
+      max_threads = std::atoi(argv[i + 1]);
+    } else if (flag == "--seconds") {
+      seconds = std::atof(argv[i + 1]);
+    } else if (flag == "--app") {
+      app = argv[i + 1];
+    } else if (flag == "--dir") {
+      dir = argv[i + 1];
+    } else {
+      std::fprintf(stderr, "data_stress: unknown option %s\n", flag.c_str());
+      return 2;
+    }
+  }
+  std::filesystem::remove_all(dir);
+  std::filesystem::create_directories(dir);
+  LAppDefine::documentPath = dir.wstring();
+  LAppDefine::execPath = (app / "").wstring();
+  DataManager* dm = DataManager::GetInstance();
+  std::vector<int> ids;
+  for (const auto& task : dm->GetTasks()) {
+    ids.push_back(task.id);
+  }
+  if (ids.empty()) {
+    std::fprintf(stderr, "data_stress: no tasks in %s\n",
+                 (app / "resources" / "tasks.bin").string().c_str());
+    return 1;
+  }
+  int limit = dm->GetAttrLimit();
+  dm->AddAttribute(Attr::Exp, 100000);
+
+  std::printf("%zu tasks, %.1fs per run\n\n", ids.size(), seconds);
+  std::printf("%7s  %12s  %9s  %9s  %9s  %6s\n", "threads", "ops/s",
+              "started", "confirmed", "bought", "broken");
+  uint64_t broken = 0;
+  for (int threads = 1; threads <= max_threads; threads *= 2) {
+    Counters counters;
+    std::atomic<bool> stop{false};
+    std::vector<std::thread> workers;
+    auto begin = Clock::now();
+    for (int t = 0; t < threads; t++) {
+      workers.emplace_back(Worker, dm, std::cref(ids), limit, 1000 + t,
+                           std::cref(stop), std::ref(counters));
+    }
+    std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+    stop = true;
+    for (auto& worker : workers) {
+      worker.join();
+    }
+    double elapsed =
+        std::chrono::duration<double>(Clock::now() - begin).count();
+    std::printf("%7d  %12.0f  %9llu  %9llu  %9llu  %6llu\n", threads,
+                counters.ops / elapsed,
+                static_cast<unsigned long long>(counters.started),
+                static_cast<unsigned long long>(counters.confirmed),
+                static_cast<unsigned long long>(counters.bought),
+                static_cast<unsigned long long>(counters.broken));
+    broken += counters.broken;
+    if (threads < max_threads && threads * 2 > max_threads) {
+      threads = max_threads / 2;
+    }
+  }
+  dm->Flush();
+  if (broken > 0) {
+    std::printf("FAILED\n");
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,281 @@
+// Memory, open latency and disk size of the game data store, on a data
+// set the size of a long-running install. Profiles:
+//   rocksdb-default  RocksDB with default Options and one column family,
+//                    one synced Put per key, as GameData opened it before
+//                    RocksStore (src/RocksStore.hpp)
+//   rocksdb          GameData on RocksStore, small memtables and one
+//                    column family per key family
+//   log              GameData on LogStore (src/LogStore.hpp)
+//
+//   footprint_bench [--writes 200] [--parts 120] [--dir path]
+//
+// Each profile is populated, closed, then opened in a child process that
+// reads everything back and commits --writes part snapshots of 23 keys,
+// so its resident size is not mixed with the other profiles. Disk size is
+// taken after the child closed the store, --session is how the child is
+// started. --dir is wiped before and after.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#endif
+
+#ifdef JPET_WITH_ROCKSDB
+#include <rocksdb/db.h>
+#include <rocksdb/options.h>
+#endif
+
+#include "GameData.hpp"
+#include "GameSchema.hpp"
+#include "GameStore.hpp"
+#include "LAppDefine.hpp"
+#include "LAppPal.hpp"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr std::string_view kDefaultProfile = "rocksdb-default";
+constexpr int kSnapshotKeys = 23;
+
+struct Memory {
+  double rss_mb;
+  double peak_mb;
+};
+
+Memory ResidentMemory() {
+#ifdef _WIN32
+  PROCESS_MEMORY_COUNTERS counters{};
+  GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters));
+  return {counters.WorkingSetSize / 1048576.0,
+          counters.PeakWorkingSetSize / 1048576.0};
+#else
+  Memory memory{};
+  std::ifstream status("/proc/self/status");
+  std::string line;
+  while (std::getline(status, line)) {
+    if (line.rfind("VmRSS:", 0) == 0) {
+      memory.rss_mb = std::atof(line.c_str() + 6) / 1024.0;
+    } else if (line.rfind("VmHWM:", 0) == 0) {
+      memory.peak_mb = std::atof(line.c_str() + 6) / 1024.0;
+    }
+  }
+  return memory;
+#endif
+}
+
+double DiskMegabytes(const std::filesystem::path& dir) {
+  uintmax_t bytes = 0;
+  for (const auto& entry :
+       std::filesystem::recursive_directory_iterator(dir)) {
+    if (entry.is_regular_file()) {
+      bytes += entry.file_size();
+    }
+  }
+  return bytes / 1048576.0;
+}
+
+// what a long-running install holds: attributes, task state, model parts,
+// shortcuts, credentials and a few counters
+std::vector<std::pair<std::string, std::string>> DataSet(int parts) {
+  auto encode = [](auto value) {
+    return std::string(reinterpret_cast<const char*>(&value), sizeof(value));
+  };
+  std::vector<std::pair<std::string, std::string>> data;
+  for (size_t i = 0; i < kAttrCount; i++) {
+    data.emplace_back(keys::Attrs[i].View(), encode(int32_t(40 + i)));
+  }
+  for (int id = 1; id <= 30; id++) {
+    for (size_t field = 0; field < kTaskFields.size(); field++) {
+      data.emplace_back(keys::MakeTaskKey(id, field).View(),
+                        encode(int32_t(1700000000 + id)));
+    }
+  }
+  for (int i = 0; i < parts; i++) {
+    data.emplace_back("part.Param" + std::to_string(i), encode(0.5f));
+  }
+  for (size_t i = 0; i < keys::kShortcutCount; i++) {
+    data.emplace_back(keys::ShortcutType[i].name.View(), encode(int32_t(1)));
+    data.emplace_back(keys::ShortcutParam[i].name.View(),
+                      "C:\\Games\\launcher.exe");
+  }
+  for (const auto& key : keys::ClothesActive) {
+    data.emplace_back(key.name.View(), encode(int32_t(1)));
+  }
+  data.emplace_back(keys::Cookies.name.View(), std::string(1500, 'c'));
+  data.emplace_back(keys::UserAgent.name.View(), std::string(120, 'u'));
+  data.emplace_back(keys::Uid.name.View(), "12345678");
+  data.emplace_back(keys::StarCnt.name.View(), encode(int32_t(3)));
+  data.emplace_back(keys::DataVersion.name.View(), encode(int32_t(2)));
+  data.emplace_back(keys::ExpCheckpoint.name.View(),
+                    encode(int32_t(1700000000)));
+  return data;
+}
+
+void Populate(std::string_view profile, int parts) {
+  GameData::Destroy(LAppDefine::documentPath);
+  auto data = DataSet(parts);
+#ifdef JPET_WITH_ROCKSDB
+  if (profile == kDefaultProfile) {
+    rocksdb::Options options;
+    options.create_if_missing = true;
+    rocksdb::DB* db = nullptr;
+    rocksdb::DB::Open(options, DefaultPath(), &db);
+    for (const auto& [key, value] : data) {
+      db->Put(rocksdb::WriteOptions(), key, value);
+    }
+    delete db;
+    return;
+  }
+#endif
+  GameData store(LAppDefine::documentPath + L"/jpet.dat", profile);
+  auto txn = store.Begin();
+  for (const auto& [key, value] : data) {
+    txn.Update(key, value);
+  }
+  txn.Commit();
+}
+
+#ifdef JPET_WITH_ROCKSDB
+// where RocksStore keeps its files, so Destroy() cleans this profile too
+std::string DefaultPath() {
+  return LAppPal::WStringToString(LAppDefine::documentPath + L"/GameData");
+}
+#endif
+
+void Report(std::string_view profile, size_t read, double open_ms) {
+  Memory memory = ResidentMemory();
+  std::printf("%-16s  %8zu  %8.1f  %8.1f  %8.1f", std::string(profile).c_str(),
+              read, open_ms, memory.rss_mb, memory.peak_mb);
+}
+
+// the child: open, read everything, commit part snapshots, report
+int Session(std::string_view profile, int writes, int parts) {
+  double open_ms = 0;
+  size_t read = 0;
+#ifdef JPET_WITH_ROCKSDB
+  if (profile == kDefaultProfile) {
+    auto begin = Clock::now();
+    rocksdb::Options options;
+    options.create_if_missing = true;
+    rocksdb::DB* db = nullptr;
+    auto status = rocksdb::DB::Open(options, DefaultPath(), &db);
+    open_ms = std::chrono::duration<double, std::milli>(Clock::now() - begin)
+                  .count();
+    if (!status.ok()) {
+      std::fprintf(stderr, "footprint_bench: cannot open %s\n",
+                   std::string(profile).c_str());
+      return 1;
+    }
+    std::unique_ptr<rocksdb::Iterator> it(
+        db->NewIterator(rocksdb::ReadOptions()));
+    for (it->SeekToFirst(); it->Valid(); it->Next()) {
+      read++;
+    }
+    it.reset();
+    rocksdb::WriteOptions sync;
+    sync.sync = true;
+    float value = 0.25f;
+    std::string raw(reinterpret_cast<char*>(&value), sizeof(value));
+    for (int i = 0; i < writes; i++) {
+      for (int k = 0; k < kSnapshotKeys; k++) {
+        db->Put(sync, "part.Param" + std::to_string((i + k) % parts), raw);
+      }
+    }
+    Report(profile, read, open_ms);
+    delete db;
+    return 0;
+  }
+#endif
+  auto begin = Clock::now();
+  GameData data(LAppDefine::documentPath + L"/jpet.dat", profile);
+  open_ms =
+      std::chrono::duration<double, std::milli>(Clock::now() - begin).count();
+  if (!data.Initialized()) {
+    std::fprintf(stderr, "footprint_bench: cannot open %s\n",
+                 std::string(profile).c_str());
+    return 1;
+  }
+  auto count = [&read](std::string_view, const std::string&) { read++; };
+  for (auto prefix : {keys::kAttrPrefix, keys::kTaskPrefix, keys::kPartPrefix,
+                      keys::kShortcutPrefix}) {
+    data.Scan<std::string>(prefix, count);
+  }
+  for (int i = 0; i < writes; i++) {
+    auto txn = data.Begin();
+    for (int k = 0; k < kSnapshotKeys; k++) {
+      txn.Update("part.Param" + std::to_string((i + k) % parts), 0.25f);
+    }
+    txn.Commit();
+  }
+  Report(profile, read, open_ms);
+  return 0;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  int writes = 200;
+  int parts = 120;
+  std::string session;
+  std::filesystem::path dir =
+      std::filesystem::temp_directory_path() / "jpet_footprint_bench";
+  for (int i = 1; i + 1 < argc; i += 2) {
+    std::string flag = argv[i];
+    if (flag == "--writes") {
+      writes = std::atoi(argv[i + 1]);
+    } else if (flag == "--parts") {
+      parts = std::atoi(argv[i + 1]);
+    } else if (flag == "--dir") {
+      dir = argv[i + 1];
+    } else if (flag == "--session") {
+      session = argv[i + 1];
+    } else {
+      std::fprintf(stderr, "footprint_bench: unknown option %s\n",
+                   flag.c_str());
+      return 2;
+    }
+  }
+  std::filesystem::create_directories(dir);
+  LAppDefine::documentPath = dir.wstring();
+  if (!session.empty()) {
+    return Session(session, writes, parts);
+  }
+  std::vector<std::string> profiles;
+#ifdef JPET_WITH_ROCKSDB
+  profiles.emplace_back(kDefaultProfile);
+#endif
+  for (auto backend : GameStore::Backends()) {
+    profiles.emplace_back(backend);
+  }
+  std::printf("%zu keys, %d snapshots of %d keys\n\n", DataSet(parts).size(),
+              writes, kSnapshotKeys);
+  std::printf("%-16s  %8s  %8s  %8s  %8s  %8s\n", "profile", "scanned",
+              "open ms", "rss MB", "peak MB", "disk MB");
+  for (const auto& profile : profiles) {
+    Populate(profile, parts);
+    std::string command = "\"" + std::string(argv[0]) + "\" --session " +
+                          profile + " --writes " + std::to_string(writes) +
+                          " --parts " + std::to_string(parts) + " --dir \"" +
+                          dir.string() + "\"";
+#ifdef _WIN32
+    // cmd strips the outer quotes
+    command = "\"" + command + "\"";
+#endif
+    std::fflush(stdout);
+    if (std::system(command.c_str()) != 0) {
+      return 1;
+    }
+    std::printf("  %8.2f\n", DiskMegabytes(dir));
+  }
+  GameData::Destroy(LAppDefine::documentPath);
+  return 0;
+}
@@ -0,0 +1,134 @@
+// Compares a new HTTPS client per request, as the app did before
+// HttpPool, with pooled keep-alive connections and with pooled
+// connections the server closes after every request, which resume their
+// TLS session. Runs against a local stub server with a throwaway
+// certificate, so no network is needed.
+//
+//   http_bench [--requests 300] [--rate 18]
+//
+// --rate is requests per minute of the app, 18 is BuffManager's three
+// APIs every 10 s, used to extrapolate handshakes and time per hour.
+// Loopback has no round trip, every avoided handshake also saves one to
+// two network round trips in the field.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <string>
+
+#include <httplib.h>
+
+#include "HttpPool.hpp"
+#include "LocalServer.hpp"
+
+namespace {
+
+// a stub API server on a free local port
+class Stub {
+ public:
+  Stub(const LocalCert& cert, bool close_each) : server_(cert) {
+    server_.Server().Get(
+        "/x", [](const httplib::Request&, httplib::Response& res) {
+          res.set_content("{\"code\":0}", "application/json");
+        });
+    if (close_each) {
+      server_.Server().set_keep_alive_max_count(1);
+    }
+    server_.Start();
+  }
+
+  int Port() const { return server_.Port(); }
+
+ private:
+  LocalServer server_;
+};
+
+struct Run {
+  int ok = 0;
+  double ms = 0;
+  double cpu_ms = 0;
+};
+
+template <typename F>
+Run Measure(int requests, F&& request) {
+  Run run;
+  auto start = std::chrono::steady_clock::now();
+  std::clock_t cpu = std::clock();
+  for (int i = 0; i < requests; i++) {
+    run.ok += request() ? 1 : 0;
+  }
+  run.ms = std::chrono::duration<double, std::milli>(
+               std::chrono::steady_clock::now() - start)
+               .count();
+  run.cpu_ms = 1000.0 * (std::clock() - cpu) / CLOCKS_PER_SEC;
+  return run;
+}
+
+void Print(const char* name, const Run& run, int requests, uint64_t handshakes,
+           double rate) {
+  double per_request = run.ms / requests;
+  double per_hour = rate * 60;
+  std::printf(
+      "%-30s %4d/%d ok %7.3f ms/req %7.3f cpu ms/req %5llu handshakes"
+      "  -> %6.0f handshakes, %6.0f ms per hour\n",
+      name, run.ok, requests, per_request, run.cpu_ms / requests,
+      static_cast<unsigned long long>(handshakes),
+      per_hour * handshakes / requests, per_hour * per_request);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  int requests = 300;
+  double rate = 18;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    std::string flag = argv[i];
+    if (flag == "--requests") {
+      requests = std::atoi(argv[i + 1]);
+    } else if (flag == "--rate") {
+      rate = std::atof(argv[i + 1]);
+    } else {
+      std::fprintf(stderr, "http_bench: unknown option %s\n", flag.c_str());
+      return 2;
+    }
+  }
+  LocalCert cert;
+  if (!cert.Ok()) {
+    std::fprintf(stderr, "http_bench: cannot create a certificate\n");
+    return 1;
+  }
+  Stub keep(cert, false);
+  Stub close(cert, true);
+  HttpPool* pool = HttpPool::GetInstance();
+
+  Run fresh = Measure(requests, [&] {
+    httplib::SSLClient client("127.0.0.1", keep.Port());
+    client.enable_server_certificate_verification(false);
+    auto res = client.Get("/x");
+    return res && res->status == 200;
+  });
+  Print("new client per request", fresh, requests, requests, rate);
+
+  HttpOptions options;
+  options.verify = false;
+  options.port = keep.Port();
+  Run pooled = Measure(requests, [&] {
+    auto res = pool->Get("127.0.0.1", "/x", {}, options);
+    return res && res->status == 200;
+  });
+  auto stats = pool->Stats()["127.0.0.1:" + std::to_string(keep.Port())];
+  Print("pool, keep-alive", pooled, requests, stats.handshakes, rate);
+
+  options.port = close.Port();
+  Run resumed = Measure(requests, [&] {
+    auto res = pool->Get("127.0.0.1", "/x", {}, options);
+    return res && res->status == 200;
+  });
+  stats = pool->Stats()["127.0.0.1:" + std::to_string(close.Port())];
+  Print("pool, server closes each", resumed, requests, stats.handshakes, rate);
+  std::printf("%30s %llu of %llu handshakes resumed a session\n", "",
+              static_cast<unsigned long long>(stats.resumed),
+              static_cast<unsigned long long>(stats.handshakes));
+  return 0;
+}
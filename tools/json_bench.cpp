@@ -0,0 +1,379 @@
+// Parse time and heap allocations per poll, reading the fields JPet needs
+// from each API response with bili::Parse* (src/BiliResponse.hpp) and with
+// a full nlohmann::json parse as the watchers did before, and checks both
+// read the same values.
+//
+//   json_bench [--iterations 2000] [--feed file] [--account file]
+//              [--room file] [--batch file] [--medal file]
+//
+// Each file is a response body saved from the API. A payload without a
+// file is made up here in the shape of the real one: a feed/space page of
+// 12 items with a pinned dynamic and a live card in front, a medal wall of
+// 40 medals, and so on.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <new>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+#include "BiliResponse.hpp"
+
+namespace {
+
+size_t g_allocations = 0;
+
+}  // namespace
+
+void* operator new(size_t size) {
+  g_allocations++;
+  if (void* p = std::malloc(size == 0 ? 1 : size)) {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+
+namespace {
+
+constexpr int64_t kMedalTarget = 61639371;
+
+std::string Text(const std::string& prefix, int i) {
+  // escapes and non ASCII text as the API sends them
+  return prefix + " " + std::to_string(i) +
+         " 测试 \\\"quoted\\\" \\u5b57\\u5e55 \\ud83d\\ude00";
+}
+
+std::string MakeFeed() {
+  std::ostringstream out;
+  out << R"({"code":0,"message":"0","ttl":1,"data":{"has_more":true,)"
+      << R"("offset":"1000000000000000000","update_baseline":"","update_num":0,"items":[)";
+  for (int i = 0; i < 12; i++) {
+    const char* type = i == 1 ? "DYNAMIC_TYPE_LIVE_RCMD"
+                       : i % 3 == 2 ? "DYNAMIC_TYPE_AV"
+                                    : "DYNAMIC_TYPE_DRAW";
+    if (i > 0) {
+      out << ",";
+    }
+    out << R"({"basic":{"comment_id_str":")" << 900000 + i
+        << R"(","comment_type":11,"like_icon":{"action_url":"https://i0.hdslb.com/bfs/garb/item/action.bin","end_url":"","id":0,"start_url":""},"rid_str":")"
+        << 900000 + i << R"("},"id_str":")" << 1000000000000000000LL + i
+        << R"(","modules":{"module_author":{"face":"https://i0.hdslb.com/bfs/face/member/noface.jpg","face_nft":false,"following":null,"jump_url":"//space.bilibili.com/61639371/dynamic","label":"","mid":61639371,"name":"user","pub_action":"","pub_location_text":"","pub_time":"1 hour ago","pub_ts":)"
+        << 1700000000 - i * 3600 << R"(,"type":"AUTHOR_TYPE_NORMAL"},)";
+    if (i == 0) {
+      out << R"("module_tag":{"text":"pinned"},)";
+    }
+    out << R"("module_dynamic":{"additional":null,"desc":{"rich_text_nodes":[{"orig_text":")"
+        << Text("node", i) << R"(","text":")" << Text("node", i)
+        << R"(","type":"RICH_TEXT_NODE_TYPE_TEXT"}],"text":")"
+        << Text("desc", i) << R"("},"major":)";
+    if (std::string(type) == "DYNAMIC_TYPE_AV") {
+      out << R"({"archive":{"aid":")" << 100 + i
+          << R"(","badge":{"bg_color":"#FB7299","color":"#FFFFFF","text":"video"},"bvid":"BV1xx411c7mD","cover":"https://i0.hdslb.com/bfs/archive/cover.jpg","desc":")"
+          << Text("video desc", i) << R"(","duration_text":"10:00","jump_url":"//www.bilibili.com/video/BV1xx411c7mD/","stat":{"danmaku":"100","play":"10000"},"title":")"
+          << Text("title", i) << R"(","type":1},"type":"MAJOR_TYPE_ARCHIVE"})";
+    } else {
+      out << R"({"draw":{"id":)" << 200 + i << R"(,"items":[)";
+      for (int j = 0; j < 4; j++) {
+        out << (j ? "," : "")
+            << R"({"height":1080,"size":512.5,"src":"https://i0.hdslb.com/bfs/new_dyn/image.jpg","tags":[],"width":1920})";
+      }
+      out << R"(]},"type":"MAJOR_TYPE_DRAW"})";
+    }
+    out << R"(,"topic":null},"module_more":{"three_point_items":[{"label":"delete","type":"THREE_POINT_DELETE"}]},"module_stat":{"comment":{"count":)"
+        << 10 * i << R"(,"forbidden":false},"forward":{"count":1,"forbidden":false},"like":{"count":)"
+        << 100 * i << R"(,"forbidden":false,"status":false}}},"type":")" << type
+        << R"(","visible":true})";
+  }
+  out << "]}}";
+  return out.str();
+}
+
+std::string MakeAccount() {
+  return R"({"code":0,"message":"0","ttl":1,"data":{"mid":61639371,"name":"user 名","sex":"secret","face":"https://i0.hdslb.com/bfs/face/noface.jpg","face_nft":0,"sign":")" +
+         Text("sign", 0) +
+         R"(","rank":10000,"level":6,"jointime":0,"moral":0,"silence":0,"coins":0,"fans_badge":true,"official":{"role":0,"title":"","desc":"","type":-1},"vip":{"type":2,"status":1,"due_date":1700000000000,"label":{"path":"","text":"vip","label_theme":"annual_vip"}},"pendant":{"pid":0,"name":"","image":"","expire":0},"nameplate":{"nid":0,"name":"","image":"","image_small":"","level":"","condition":""},"is_followed":false,"top_photo":"https://i0.hdslb.com/bfs/space/top.png","live_room":{"roomStatus":1,"liveStatus":0,"url":"https://live.bilibili.com/21484828","title":")" +
+         Text("room", 0) +
+         R"(","cover":"https://i0.hdslb.com/bfs/live/cover.jpg","roomid":21484828,"roundStatus":0,"broadcast_type":0},"birthday":"","school":{"name":""},"profession":{"name":"","department":"","title":"","is_show":0},"tags":null,"series":{"user_upgrade_status":3,"show_upgrade_window":false},"is_senior_member":0}})";
+}
+
+std::string MakeRoom() {
+  return R"({"code":0,"msg":"ok","message":"ok","data":{"roomStatus":1,"roundStatus":0,"liveStatus":1,"url":"https://live.bilibili.com/21484828","title":")" +
+         Text("room", 0) +
+         R"(","cover":"https://i0.hdslb.com/bfs/live/cover.jpg","online":12345,"roomid":21484828,"broadcast_type":0,"online_hidden":0}})";
+}
+
+std::string MakeBatch() {
+  std::ostringstream out;
+  out << R"({"code":0,"msg":"success","message":"success","data":{)";
+  for (int i = 0; i < 50; i++) {
+    out << (i ? "," : "") << "\"" << 100000 + i << R"(":{"title":")"
+        << Text("room", i) << R"(","room_id":)" << 200000 + i
+        << R"(,"uid":)" << 100000 + i
+        << R"(,"online":0,"live_time":0,"live_status":)" << (i % 4 == 0)
+        << R"(,"short_id":0,"area":0,"area_name":"","area_v2_id":0,"area_v2_name":"","area_v2_parent_name":"","area_v2_parent_id":0,"uname":"user","face":"https://i0.hdslb.com/bfs/face/noface.jpg","tag_name":"","tags":"","cover_from_user":"","keyframe":"","lock_till":"0000-00-00 00:00:00","hidden_till":"0000-00-00 00:00:00","broadcast_type":0})";
+  }
+  out << "}}";
+  return out.str();
+}
+
+std::string MakeMedal() {
+  std::ostringstream out;
+  out << R"({"code":0,"message":"0","ttl":1,"data":{"list":[)";
+  for (int i = 0; i < 40; i++) {
+    int64_t target = i == 27 ? kMedalTarget : 1000 + i;
+    out << (i ? "," : "") << R"({"medal_info":{"target_id":)" << target
+        << R"(,"level":)" << i % 30 + 1
+        << R"(,"medal_name":"medal","medal_color_start":6067854,"medal_color_end":6067854,"medal_color_border":6067854,"guard_level":)"
+        << (i == 27 ? 3 : 0)
+        << R"(,"wearing_status":0,"medal_id":1,"intimacy":100,"next_intimacy":200,"today_feed":0,"day_limit":1500,"guard_icon":"","honor_icon":""},"target_name":"user","target_icon":"https://i0.hdslb.com/bfs/face/noface.jpg","link":"https://live.bilibili.com/1","live_status":0,"official":0,"uinfo_medal":{"name":"medal","level":)"
+        << i % 30 + 1 << R"(,"color_start":6067854,"color_end":6067854,"color_border":6067854,"color":0,"id":0,"typ":0,"is_light":1,"v2_medal_color_start":"","v2_medal_color_end":"","v2_medal_color_border":"","v2_medal_color_text":"","v2_medal_color_level":"","guard_level":)"
+        << (i == 27 ? 3 : 0) << R"(,"guard_icon":"","honor_icon":"","user_receive_count":0}})";
+  }
+  out << R"(],"count":40,"close_space_medal":0,"only_show_wearing":0,"name":"user","icon":"","uid":1,"level":10}})";
+  return out.str();
+}
+
+// the fields read before, with nlohmann::json, as a string to compare
+std::string OldFeed(const std::string& body) {
+  auto json = nlohmann::json::parse(body);
+  const auto& items = json.at("data").at("items");
+  int total = items.size();
+  int validIndex = -1;
+  for (int i = 0; i < total; i++) {
+    if (items.at(i).at("type").get<std::string>() != "DYNAMIC_TYPE_LIVE_RCMD") {
+      validIndex = i;
+      break;
+    }
+  }
+  if (validIndex == 0 && items.at(0).at("modules").contains("module_tag")) {
+    for (int i = 1; i < total; i++) {
+      if (items.at(i).at("type").get<std::string>() !=
+          "DYNAMIC_TYPE_LIVE_RCMD") {
+        validIndex = i;
+        break;
+      }
+    }
+  }
+  long long latest =
+      items.at(0).at("modules").at("module_author").at("pub_ts").get<long long>();
+  if (total > 1) {
+    latest = std::max(latest, items.at(1)
+                                  .at("modules")
+                                  .at("module_author")
+                                  .at("pub_ts")
+                                  .get<long long>());
+  }
+  const auto& item = items.at(validIndex);
+  std::string type = item.at("type").get<std::string>();
+  const auto& dynamic = item.at("modules").at("module_dynamic");
+  std::string desc =
+      type == "DYNAMIC_TYPE_AV"
+          ? dynamic.at("major").at("archive").at("title").get<std::string>()
+          : dynamic.at("desc").at("text").get<std::string>();
+  return std::to_string(latest) + "|" + item.at("id_str").get<std::string>() +
+         "|" + desc;
+}
+
+std::string NewFeed(const std::string& body) {
+  auto feed = bili::ParseFeed(body);
+  if (!feed) {
+    return "parse failed";
+  }
+  return std::to_string(feed->latest) + "|" + feed->id + "|" + feed->desc;
+}
+
+std::string OldAccount(const std::string& body) {
+  auto json = nlohmann::json::parse(body);
+  const auto& data = json.at("data");
+  return data.at("name").get<std::string>() + "|" +
+         data.at("live_room").at("title").get<std::string>() + "|" +
+         std::to_string(data.at("live_room").at("roomid").get<int>());
+}
+
+std::string NewAccount(const std::string& body) {
+  auto account = bili::ParseAccount(body);
+  if (!account) {
+    return "parse failed";
+  }
+  return account->name + "|" + account->room_title + "|" + account->room_id;
+}
+
+std::string OldRoom(const std::string& body) {
+  auto json = nlohmann::json::parse(body);
+  const auto& data = json.at("data");
+  return std::to_string(data.at("liveStatus").get<int>() == 1) + "|" +
+         data.at("title").get<std::string>() + "|" +
+         std::to_string(data.at("roomid").get<long long>());
+}
+
+std::string NewRoom(const std::string& body) {
+  auto room = bili::ParseRoom(body);
+  if (!room) {
+    return "parse failed";
+  }
+  return std::to_string(room->live) + "|" + room->title + "|" + room->room_id;
+}
+
+std::string OldBatch(const std::string& body) {
+  auto json = nlohmann::json::parse(body);
+  std::string out;
+  for (const auto& [uid, room] : json.at("data").items()) {
+    out += uid + "|" +
+           std::to_string(room.at("live_status").get<int>() == 1) + "|" +
+           room.at("title").get<std::string>() + "|" +
+           std::to_string(room.at("room_id").get<long long>()) + ";";
+  }
+  return out;
+}
+
+std::string NewBatch(const std::string& body) {
+  auto batch = bili::ParseRoomBatch(body);
+  if (!batch) {
+    return "parse failed";
+  }
+  std::string out;
+  for (const auto& [uid, room] : batch->rooms) {
+    out += uid + "|" + std::to_string(room.live) + "|" + room.title + "|" +
+           room.room_id + ";";
+  }
+  return out;
+}
+
+std::string OldMedal(const std::string& body) {
+  auto json = nlohmann::json::parse(body);
+  std::string out = "none";
+  for (const auto& entry : json["data"]["list"]) {
+    if (entry["medal_info"]["target_id"].get<long long>() != kMedalTarget) {
+      continue;
+    }
+    out = std::to_string(entry["uinfo_medal"]["level"].get<int>()) + "|" +
+          std::to_string(entry["uinfo_medal"]["guard_level"].get<int>());
+  }
+  return out;
+}
+
+std::string NewMedal(const std::string& body) {
+  auto medal = bili::ParseMedal(body, kMedalTarget);
+  if (!medal) {
+    return "parse failed";
+  }
+  if (!medal->found) {
+    return "none";
+  }
+  return std::to_string(medal->level) + "|" +
+         std::to_string(medal->guard_level);
+}
+
+struct Measure {
+  double us = 0;
+  double allocations = 0;
+};
+
+Measure Run(const std::function<std::string(const std::string&)>& read,
+            const std::string& body, int iterations) {
+  size_t bytes = 0;
+  size_t before = g_allocations;
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < iterations; i++) {
+    bytes += read(body).size();
+  }
+  auto elapsed = std::chrono::steady_clock::now() - start;
+  Measure m;
+  m.us = std::chrono::duration<double, std::micro>(elapsed).count() /
+         iterations;
+  m.allocations = static_cast<double>(g_allocations - before) / iterations;
+  // keeps the reads from being optimized away
+  if (bytes == 0) {
+    std::printf("\n");
+  }
+  return m;
+}
+
+struct Payload {
+  const char* name;
+  std::string file;
+  std::string body;
+  std::function<std::string(const std::string&)> old_read;
+  std::function<std::string(const std::string&)> new_read;
+  std::function<std::string()> make;
+};
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  int iterations = 2000;
+  std::vector<Payload> payloads = {
+      {"feed/space", "", "", OldFeed, NewFeed, MakeFeed},
+      {"acc/info", "", "", OldAccount, NewAccount, MakeAccount},
+      {"getRoomInfoOld", "", "", OldRoom, NewRoom, MakeRoom},
+      {"status_by_uids", "", "", OldBatch, NewBatch, MakeBatch},
+      {"MedalWall", "", "", OldMedal, NewMedal, MakeMedal},
+  };
+  const char* flags[] = {"--feed", "--account", "--room", "--batch", "--medal"};
+  for (int i = 1; i + 1 < argc; i += 2) {
+    std::string flag = argv[i];
+    bool known = false;
+    if (flag == "--iterations") {
+      iterations = std::atoi(argv[i + 1]);
+      known = true;
+    }
+    for (size_t p = 0; p < payloads.size(); p++) {
+      if (flag == flags[p]) {
+        payloads[p].file = argv[i + 1];
+        known = true;
+      }
+    }
+    if (!known) {
+      std::fprintf(stderr, "json_bench: unknown option %s\n", flag.c_str());
+      return 2;
+    }
+  }
+  int failed = 0;
+  std::printf("%-16s %8s %14s %14s %14s %14s  %s\n", "payload", "bytes",
+              "old us/poll", "new us/poll", "old allocs", "new allocs",
+              "source");
+  for (auto& payload : payloads) {
+    if (payload.file.empty()) {
+      payload.body = payload.make();
+    } else {
+      std::ifstream in(payload.file, std::ios::binary);
+      if (!in) {
+        std::fprintf(stderr, "json_bench: cannot read %s\n",
+                     payload.file.c_str());
+        return 1;
+      }
+      payload.body.assign(std::istreambuf_iterator<char>(in), {});
+    }
+    std::string expected;
+    try {
+      expected = payload.old_read(payload.body);
+    } catch (const std::exception& e) {
+      std::fprintf(stderr, "json_bench: %s: %s\n", payload.name, e.what());
+      failed++;
+      continue;
+    }
+    std::string got = payload.new_read(payload.body);
+    if (got != expected) {
+      std::fprintf(stderr, "json_bench: %s differs\n  old %s\n  new %s\n",
+                   payload.name, expected.c_str(), got.c_str());
+      failed++;
+    }
+    Measure old_m = Run(payload.old_read, payload.body, iterations);
+    Measure new_m = Run(payload.new_read, payload.body, iterations);
+    std::printf("%-16s %8zu %14.2f %14.2f %14.1f %14.1f  %s\n", payload.name,
+                payload.body.size(), old_m.us, new_m.us, old_m.allocations,
+                new_m.allocations,
+                payload.file.empty() ? "made up" : payload.file.c_str());
+  }
+  return failed == 0 ? 0 : 1;
+}
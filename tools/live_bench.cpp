@@ -0,0 +1,257 @@
+// Live status of a follow list through LiveStatusProvider, asked uid by
+// uid as UserStateWatcher did before, in batches, in batches from a batch
+// endpoint that fails so every uid falls back, and from one that answers
+// -352, which must end the round without a fallback. A local stand-in
+// serves Room/get_status_info_by_uids and Room/getRoomInfoOld, flips live
+// status between rounds, and checks every answer against what it served,
+// and the requests the provider reported against those it received.
+//
+//   live_bench [--rounds 3] [--latency 20] [--seed 1]
+//
+// --latency is the server side delay per request in ms, standing in for
+// the round trip to bilibili.
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <httplib.h>
+#include <nlohmann/json.hpp>
+
+#include "LiveStatus.hpp"
+#include "LocalServer.hpp"
+#include "Random.hpp"
+
+namespace {
+
+struct Room {
+  bool has_room = true;
+  bool live = false;
+  std::string title;
+};
+
+// the follow list as the stand-in serves it
+class World {
+ public:
+  World(int follows, uint64_t seed) : rng_(seed) {
+    for (int i = 0; i < follows; i++) {
+      std::string uid = std::to_string(100000 + i);
+      uids_.push_back(uid);
+      // every tenth user never opened a room
+      rooms_[uid].has_room = i % 10 != 3;
+    }
+    Flip();
+  }
+
+  void Flip() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    round_++;
+    for (auto& [uid, room] : rooms_) {
+      room.live = rng_.Below(4) == 0;
+      room.title = uid + " round " + std::to_string(round_);
+    }
+  }
+
+  const std::vector<std::string>& Uids() const { return uids_; }
+
+  Room Get(const std::string& uid) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = rooms_.find(uid);
+    return it == rooms_.end() ? Room{false} : it->second;
+  }
+
+ private:
+  Xoshiro256 rng_;
+  std::mutex mutex_;
+  int round_ = 0;
+  std::vector<std::string> uids_;
+  std::map<std::string, Room> rooms_;
+};
+
+class StandIn {
+ public:
+  StandIn(const LocalCert& cert, World& world, int latency_ms)
+      : server_(cert) {
+    auto delay = std::chrono::milliseconds(latency_ms);
+    server_.Server().Get(
+        "/room/v1/Room/get_status_info_by_uids",
+        [this, &world, delay](const httplib::Request& req,
+                              httplib::Response& res) {
+          batch_requests_++;
+          std::this_thread::sleep_for(delay);
+          if (int code = fail_batch_) {
+            nlohmann::json body = {{"code", code}, {"message", "error"}};
+            res.set_content(body.dump(), "application/json");
+            return;
+          }
+          nlohmann::json data = nlohmann::json::object();
+          size_t count = req.get_param_value_count("uids[]");
+          for (size_t i = 0; i < count; i++) {
+            std::string uid = req.get_param_value("uids[]", i);
+            Room room = world.Get(uid);
+            if (!room.has_room) {
+              continue;
+            }
+            data[uid] = {{"title", room.title},
+                         {"room_id", std::stoll(uid) + 7},
+                         {"uid", std::stoll(uid)},
+                         {"online", 0},
+                         {"live_status", room.live ? 1 : 0},
+                         {"uname", "user " + uid},
+                         {"cover_from_user", ""},
+                         {"keyframe", ""}};
+          }
+          nlohmann::json body = {{"code", 0},
+                                 {"msg", "success"},
+                                 {"message", "success"},
+                                 {"data", data}};
+          res.set_content(body.dump(), "application/json");
+        });
+    server_.Server().Get(
+        "/room/v1/Room/getRoomInfoOld",
+        [this, &world, delay](const httplib::Request& req,
+                              httplib::Response& res) {
+          single_requests_++;
+          std::this_thread::sleep_for(delay);
+          std::string uid = req.get_param_value("mid");
+          Room room = world.Get(uid);
+          nlohmann::json data = {
+              {"roomStatus", room.has_room ? 1 : 0},
+              {"roundStatus", 0},
+              {"liveStatus", room.live ? 1 : 0},
+              {"url", ""},
+              {"title", room.title},
+              {"cover", ""},
+              {"online", 0},
+              {"roomid", room.has_room ? std::stoll(uid) + 7 : 0},
+              {"broadcast_type", 0},
+              {"online_hidden", 0}};
+          nlohmann::json body = {{"code", 0},
+                                 {"message", "0"},
+                                 {"ttl", 1},
+                                 {"data", data}};
+          res.set_content(body.dump(), "application/json");
+        });
+    server_.Start();
+  }
+
+  ~StandIn() { server_.Stop(); }
+
+  int Port() const { return server_.Port(); }
+
+  // the code batches answer with, 0 to serve them
+  void FailBatch(int code) { fail_batch_ = code; }
+
+  // requests since the last call
+  int Requests() { return batch_requests_.exchange(0) + single_requests_.exchange(0); }
+
+ private:
+  LocalServer server_;
+  std::atomic<int> fail_batch_{0};
+  std::atomic<int> batch_requests_{0};
+  std::atomic<int> single_requests_{0};
+};
+
+// answers that differ from what the stand-in served
+int Mismatches(World& world, const std::map<std::string, LiveInfo>& result) {
+  int wrong = 0;
+  for (const auto& uid : world.Uids()) {
+    Room room = world.Get(uid);
+    auto it = result.find(uid);
+    if (!room.has_room) {
+      wrong += it != result.end();
+      continue;
+    }
+    if (it == result.end() || it->second.live != room.live ||
+        it->second.title != room.title ||
+        it->second.roomid != std::to_string(std::stoll(uid) + 7)) {
+      wrong++;
+    }
+  }
+  return wrong;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  int rounds = 3;
+  int latency = 20;
+  uint64_t seed = 1;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    std::string flag = argv[i];
+    if (flag == "--rounds") {
+      rounds = std::atoi(argv[i + 1]);
+    } else if (flag == "--latency") {
+      latency = std::atoi(argv[i + 1]);
+    } else if (flag == "--seed") {
+      seed = std::strtoull(argv[i + 1], nullptr, 10);
+    } else {
+      std::fprintf(stderr, "live_bench: unknown option %s\n", flag.c_str());
+      return 2;
+    }
+  }
+  LocalCert cert;
+  if (!cert.Ok()) {
+    std::fprintf(stderr, "live_bench: cannot create a certificate\n");
+    return 1;
+  }
+  int failed = 0;
+  for (int follows : {10, 100, 1000}) {
+    World world(follows, seed);
+    StandIn standin(cert, world, latency);
+    HttpOptions options;
+    options.port = standin.Port();
+    options.verify = false;
+    const char* names[] = {"per uid", "batch", "batch failing",
+                           "batch -352"};
+    const int codes[] = {0, 0, -400, -352};
+    for (int mode = 0; mode < 4; mode++) {
+      // a fresh provider per mode, so a failed batch does not rest into the
+      // next one
+      LiveStatusProvider provider(
+          mode == 0 ? nullptr
+                    : std::make_unique<BatchLiveBackend>("127.0.0.1", options),
+          std::make_unique<RoomInfoLiveBackend>(false, "127.0.0.1",
+                                                options));
+      standin.FailBatch(codes[mode]);
+      standin.Requests();
+      int wrong = 0;
+      size_t reported = 0;
+      auto start = std::chrono::steady_clock::now();
+      for (int round = 0; round < rounds; round++) {
+        world.Flip();
+        LiveFetch fetch;
+        auto result = provider.Fetch(world.Uids(), {}, fetch);
+        reported += fetch.requests;
+        if (codes[mode] == -352) {
+          // restricted after the first batch, nothing else asked
+          wrong += fetch.code != -352 || result || fetch.requests != 1;
+        } else {
+          wrong += result ? Mismatches(world, *result) : follows;
+        }
+      }
+      double ms = std::chrono::duration<double, std::milli>(
+                      std::chrono::steady_clock::now() - start)
+                      .count();
+      int requests = standin.Requests();
+      if (reported != static_cast<size_t>(requests)) {
+        std::printf("%5d follows  %-14s reported %zu requests of %d\n",
+                    follows, names[mode], reported, requests);
+        wrong++;
+      }
+      failed += wrong;
+      std::printf(
+          "%5d follows  %-14s %6.1f requests/round  %8.1f ms/round  "
+          "%d wrong answers\n",
+          follows, names[mode], static_cast<double>(requests) / rounds,
+          ms / rounds, wrong);
+    }
+  }
+  return failed == 0 ? 0 : 1;
+}
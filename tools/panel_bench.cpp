@@ -0,0 +1,471 @@
+// Requests and bytes an open panel costs per hour, with the panel polling
+// /api/profile as it did before and with the versioned snapshots of
+// src/PanelSnapshot.hpp pushing deltas, replayed minute by minute against a
+// stand-in of the game state. Checks that the deltas rebuild the server's
+// documents exactly on the panel side.
+//
+//   panel_bench [--tasks resources/tasks.json] [--hours 1] [--buffs 6]
+//               [--purchases 10] [--runs 2] [--trace trace.jsonl]
+//
+// --trace writes what the panel would see, one JSON line each: the
+// documents served with their ETag, POST answers and SSE frames, and a
+// step line once the frames of a change went out. The panel's own code
+// replays it in resources/panel/scripts/patch_check.js.
+//
+// Exp is paid every minute. Per hour, --buffs buff changes, --purchases
+// attribute purchases and --runs task runs (start, settle, confirm) are
+// spread evenly. Bytes are response bodies and SSE frames, HTTP headers
+// are left out. Every profile build is a dozen RocksDB reads and an
+// ExpDiff() in the real handler.
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+#include "EventBus.hpp"
+#include "GameSchema.hpp"
+#include "PanelSnapshot.hpp"
+
+namespace {
+
+struct Options {
+  std::string tasks = "resources/tasks.json";
+  int hours = 1;
+  int buffs = 6;
+  int purchases = 10;
+  int runs = 2;
+  std::string trace;
+};
+
+struct TaskState {
+  nlohmann::json spec;
+  int start_time = 0;
+  int end_time = 0;
+  int success = 0;
+  // 0 idle, 1 running, 2 waiting for confirm
+  int status = 0;
+};
+
+// what the panel shows, changed by the replay
+struct GameState {
+  AttrArray attributes{};
+  int clothes = 0;
+  int starcnt = 0;
+  std::vector<std::string> buffs;
+  std::vector<TaskState> tasks;
+
+  int ExpDiff() const {
+    return 10 + static_cast<int>(buffs.size()) * 5 + starcnt;
+  }
+
+  // the fields of PanelServer::getProfile()
+  nlohmann::json Profile() const {
+    auto json = nlohmann::json::object();
+    for (size_t i = 0; i < kAttrCount; i++) {
+      json["attributes"][std::string(kAttrNames[i])] = attributes[i];
+    }
+    json["clothes"]["current"] = clothes;
+    json["clothes"]["unlock"] = {true, false, false};
+    json["expdiff"] = ExpDiff();
+    json["buffs"] = buffs;
+    json["starcnt"] = starcnt;
+    return json;
+  }
+
+  // the fields of PanelServer::getTaskStatus()
+  nlohmann::json Tasks() const {
+    auto toJson = [](const TaskState& task) {
+      return nlohmann::json{{"id", task.spec["id"]},
+                            {"title", task.spec["title"]},
+                            {"desc", task.spec["desc"]},
+                            {"start_time", task.start_time},
+                            {"end_time", task.end_time},
+                            {"cost", task.spec["cost"]},
+                            {"success", task.success},
+                            {"status", task.status},
+                            {"requirements", task.spec["requirements"]},
+                            {"rewards", task.spec.value(
+                                            "rewards", nlohmann::json::object())},
+                            {"repeatable", task.spec["repeatable"]}};
+    };
+    nlohmann::json data = nlohmann::json::object();
+    nlohmann::json list = nlohmann::json::array();
+    for (const auto& task : tasks) {
+      if (task.status != 0) {
+        data["current"] = toJson(task);
+      } else {
+        list.push_back(toJson(task));
+      }
+    }
+    data["list"] = list;
+    return data;
+  }
+};
+
+struct Traffic {
+  uint64_t requests = 0;
+  uint64_t not_modified = 0;
+  uint64_t bytes = 0;
+  uint64_t events = 0;
+  uint64_t profile_builds = 0;
+};
+
+// the panel's copy of a snapshot, kept current by the deltas
+struct PanelCopy {
+  nlohmann::json doc;
+  uint64_t version = 0;
+  std::string etag;
+  uint64_t gaps = 0;
+};
+
+std::vector<TaskState> LoadTasks(const std::string& path) {
+  std::ifstream in(path);
+  if (!in.is_open()) {
+    std::fprintf(stderr, "panel_bench: cannot open %s\n", path.c_str());
+    std::exit(1);
+  }
+  std::vector<TaskState> tasks;
+  for (const auto& t : nlohmann::json::parse(in)) {
+    if (!t.value("debug", false)) {
+      tasks.push_back({t});
+    }
+  }
+  return tasks;
+}
+
+Options ParseOptions(int argc, char** argv) {
+  Options options;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    std::string flag = argv[i];
+    const char* value = argv[i + 1];
+    if (flag == "--tasks") {
+      options.tasks = value;
+    } else if (flag == "--hours") {
+      options.hours = std::atoi(value);
+    } else if (flag == "--buffs") {
+      options.buffs = std::atoi(value);
+    } else if (flag == "--purchases") {
+      options.purchases = std::atoi(value);
+    } else if (flag == "--runs") {
+      options.runs = std::atoi(value);
+    } else if (flag == "--trace") {
+      options.trace = value;
+    } else {
+      std::fprintf(stderr, "panel_bench: unknown option %s\n", flag.c_str());
+      std::exit(2);
+    }
+  }
+  if (options.hours <= 0 || options.buffs < 0 || options.purchases < 0 ||
+      options.runs < 0 || options.runs > 6) {
+    std::fprintf(stderr, "panel_bench: bad --hours, --buffs, --purchases "
+                         "or --runs\n");
+    std::exit(2);
+  }
+  return options;
+}
+
+// true if one of count events spread over an hour falls on minute
+bool Due(int minute, int count, int offset) {
+  if (count == 0) {
+    return false;
+  }
+  int period = 60 / count;
+  return period > 0 && (minute % 60) % period == offset % period &&
+         (minute % 60) / period < count;
+}
+
+// what happened in the replay
+enum class Event { MINUTE, BUFF, PURCHASE, TASK_START, TASK_SETTLE, TASK_CONFIRM };
+
+class Replay {
+ public:
+  Replay(const Options& options, std::vector<TaskState> tasks)
+      : _options(options) {
+    _state.tasks = std::move(tasks);
+    _state.attributes[AttrIndex(Attr::Exp)] = 5000;
+  }
+
+  /**
+   * @brief  Step through the hours, calling on(event) after each change.
+   */
+  template <typename F>
+  void Run(F&& on) {
+    for (int minute = 1; minute <= _options.hours * 60; minute++) {
+      _state.attributes[AttrIndex(Attr::Exp)] += _state.ExpDiff();
+      on(Event::MINUTE);
+      if (Due(minute, _options.buffs, 3)) {
+        toggleBuff();
+        on(Event::BUFF);
+      }
+      if (Due(minute, _options.purchases, 7)) {
+        buy();
+        on(Event::PURCHASE);
+      }
+      for (int run = 0; run < _options.runs; run++) {
+        // started at the first minute of its slot, settled five minutes
+        // later and confirmed a minute after that
+        int at = minute % 60 - run * (60 / _options.runs);
+        TaskState& task = _state.tasks[run % _state.tasks.size()];
+        if (at == 1) {
+          task.status = 1;
+          task.start_time = minute * 60;
+          on(Event::TASK_START);
+        } else if (at == 6) {
+          task.status = 2;
+          task.success = 1;
+          on(Event::TASK_SETTLE);
+        } else if (at == 7) {
+          task.status = 0;
+          task.end_time = minute * 60;
+          _state.attributes[AttrIndex(Attr::Will)]++;
+          on(Event::TASK_CONFIRM);
+        }
+      }
+    }
+  }
+
+  const GameState& State() const { return _state; }
+
+ private:
+  Options _options;
+  GameState _state;
+  size_t _buff = 0;
+
+  void toggleBuff() {
+    static const char* kBuffs[] = {"live", "dynamic", "guard"};
+    std::string buff = kBuffs[_buff++ % 3];
+    auto it = std::find(_state.buffs.begin(), _state.buffs.end(), buff);
+    if (it == _state.buffs.end()) {
+      _state.buffs.push_back(buff);
+    } else {
+      _state.buffs.erase(it);
+    }
+  }
+
+  void buy() {
+    Attr attr = kBaseAttrs[_state.attributes[AttrIndex(Attr::BuyCnt)] % 5];
+    _state.attributes[AttrIndex(attr)]++;
+    _state.attributes[AttrIndex(Attr::BuyCnt)]++;
+    _state.attributes[AttrIndex(Attr::Exp)] -= 100;
+  }
+};
+
+const std::string kPurchaseAnswer = nlohmann::json{{"count", 1}}.dump();
+
+// every change sends "data: UPDATE", the panel fetches the whole profile on
+// it and once a minute
+Traffic Before(const Options& options, std::vector<TaskState> tasks) {
+  Traffic traffic;
+  Replay replay(options, std::move(tasks));
+  auto getProfile = [&] {
+    traffic.requests++;
+    traffic.bytes += replay.State().Profile().dump().size();
+    traffic.profile_builds++;
+  };
+  auto getTasks = [&] {
+    traffic.requests++;
+    traffic.bytes += replay.State().Tasks().dump().size();
+  };
+  auto update = [&] {
+    traffic.events++;
+    traffic.bytes += std::string("data: UPDATE\n\n").size();
+    getProfile();
+  };
+  getProfile();
+  getTasks();
+  replay.Run([&](Event event) {
+    switch (event) {
+      case Event::MINUTE:
+        // the minute poll, whose accrual pays exp and notifies as well
+        getProfile();
+        update();
+        break;
+      case Event::BUFF:
+        update();
+        break;
+      case Event::PURCHASE:
+        traffic.requests++;
+        traffic.bytes += kPurchaseAnswer.size();
+        update();
+        break;
+      case Event::TASK_START:
+        // the POST answers with the task list
+        getTasks();
+        break;
+      case Event::TASK_SETTLE:
+        // the task page polls every second once the run is due, until it
+        // sees it settled
+        getTasks();
+        break;
+      case Event::TASK_CONFIRM:
+        getTasks();
+        update();
+        break;
+    }
+  });
+  return traffic;
+}
+
+Traffic After(const Options& options, std::vector<TaskState> tasks,
+              uint64_t* mismatches, std::ostream* trace) {
+  Traffic traffic;
+  Replay replay(options, std::move(tasks));
+  EventBus bus;
+  auto publish = [&](const std::string& event) { bus.Publish(event); };
+  PanelSnapshot profile("profile", [&] { return replay.State().Profile(); },
+                        publish);
+  PanelSnapshot taskStatus("tasks", [&] { return replay.State().Tasks(); },
+                           publish);
+  PanelCopy profileCopy;
+  PanelCopy tasksCopy;
+  auto traceLine = [&](const nlohmann::json& line) {
+    if (trace) {
+      *trace << line.dump() << '\n';
+    }
+  };
+  // what a GET of the snapshot answers now
+  auto traceServe = [&](const char* type, const PanelDocument& document) {
+    traceLine({{"serve", type},
+               {"etag", document.etag},
+               {"body", nlohmann::json::parse(document.body)}});
+  };
+  auto take = [](const PanelDocument& document, PanelCopy& copy) {
+    copy.doc = document.data;
+    copy.version = document.version;
+    copy.etag = document.etag;
+  };
+  auto get = [&](PanelSnapshot& snapshot, PanelCopy& copy) {
+    auto document = snapshot.Get();
+    traffic.requests++;
+    if (document->etag == copy.etag) {
+      traffic.not_modified++;
+      return;
+    }
+    traffic.bytes += document->body.size();
+    take(*document, copy);
+  };
+  get(profile, profileCopy);
+  get(taskStatus, tasksCopy);
+  traceServe("profile", *profile.Get());
+  traceServe("tasks", *taskStatus.Get());
+  uint64_t cursor = bus.Last();
+  // the frames SseHub sends for the new events, applied as the panel does
+  auto drain = [&] {
+    cursor = bus.Read(cursor, [&](uint64_t id, const std::string& data) {
+      traceLine({{"event", data}});
+      traffic.events++;
+      traffic.bytes += std::string("id: \ndata: \n\n").size() +
+                       std::to_string(id).size() + data.size();
+      auto delta = nlohmann::json::parse(data);
+      PanelCopy& copy = delta["type"] == "profile" ? profileCopy : tasksCopy;
+      if (delta["from"] == copy.version) {
+        copy.doc = copy.doc.patch(delta["patch"]);
+        copy.version = delta["version"];
+      } else if (delta["version"] > copy.version) {
+        // older ones are from before a POST answer the panel took
+        copy.gaps++;
+      }
+      return true;
+    });
+  };
+  replay.Run([&](Event event) {
+    switch (event) {
+      case Event::MINUTE:
+      case Event::BUFF:
+        profile.Invalidate();
+        break;
+      case Event::PURCHASE:
+        profile.Invalidate();
+        traffic.requests++;
+        traffic.bytes += kPurchaseAnswer.size();
+        break;
+      case Event::TASK_START:
+      case Event::TASK_CONFIRM: {
+        if (event == Event::TASK_CONFIRM) {
+          profile.Invalidate();
+        }
+        taskStatus.Invalidate();
+        // the POST answers with the snapshot
+        auto document = taskStatus.Get();
+        traffic.requests++;
+        traffic.bytes += document->body.size();
+        take(*document, tasksCopy);
+        traceServe("tasks", *document);
+        traceLine({{"post", "tasks"},
+                   {"body", nlohmann::json::parse(document->body)}});
+        break;
+      }
+      case Event::TASK_SETTLE:
+        taskStatus.Invalidate();
+        break;
+    }
+    // what the refresher does while the panel is open
+    profile.Refresh();
+    taskStatus.Refresh();
+    traceServe("profile", *profile.Get());
+    traceServe("tasks", *taskStatus.Get());
+    drain();
+    traceLine({{"step", static_cast<int>(event)}});
+    if (profileCopy.doc != profile.Get()->data ||
+        tasksCopy.doc != taskStatus.Get()->data) {
+      (*mismatches)++;
+    }
+  });
+  // a reconnect past the buffer fetches both again, unchanged they are 304
+  get(profile, profileCopy);
+  get(taskStatus, tasksCopy);
+  *mismatches += profileCopy.gaps + tasksCopy.gaps;
+  traffic.profile_builds = profile.Stats().builds;
+  return traffic;
+}
+
+void Print(const char* name, const Traffic& traffic, int hours) {
+  std::printf("%-7s %9.0f %9.0f %9.0f %10.1f %9.0f\n", name,
+              static_cast<double>(traffic.requests) / hours,
+              static_cast<double>(traffic.not_modified) / hours,
+              static_cast<double>(traffic.events) / hours,
+              static_cast<double>(traffic.bytes) / hours / 1024,
+              static_cast<double>(traffic.profile_builds) / hours);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  Options options = ParseOptions(argc, argv);
+  std::vector<TaskState> tasks = LoadTasks(options.tasks);
+  if (tasks.empty()) {
+    std::fprintf(stderr, "panel_bench: no tasks in %s\n",
+                 options.tasks.c_str());
+    return 1;
+  }
+  std::ofstream trace;
+  if (!options.trace.empty()) {
+    trace.open(options.trace);
+    if (!trace.is_open()) {
+      std::fprintf(stderr, "panel_bench: cannot write %s\n",
+                   options.trace.c_str());
+      return 1;
+    }
+  }
+  uint64_t mismatches = 0;
+  Traffic before = Before(options, tasks);
+  Traffic after =
+      After(options, tasks, &mismatches, trace.is_open() ? &trace : nullptr);
+  std::printf("%d h with the panel open, %d buff changes, %d purchases, "
+              "%d task runs per hour\n\n",
+              options.hours, options.buffs, options.purchases, options.runs);
+  std::printf("%-7s %9s %9s %9s %10s %9s\n", "", "requests", "304", "events",
+              "KiB", "builds");
+  Print("before", before, options.hours);
+  Print("after", after, options.hours);
+  std::printf("\nper hour; builds are /api/profile builds\n");
+  std::printf("panel copies off the server's: %llu\n",
+              static_cast<unsigned long long>(mismatches));
+  return mismatches == 0 ? 0 : 1;
+}
@@ -0,0 +1,176 @@
+// Cost of the game data reads on the frame and panel paths, on every
+// compiled-in GameStore backend (src/GameStore.hpp). "store" is how they
+// read before the cache: a key string built per call and a store Get.
+// "cached" is GameData with the keys:: handles, a hash lookup in its
+// read-through cache (src/GameData.hpp).
+//
+//   read_bench [--frames 100000] [--dir path]
+//
+// A frame reads the four shortcut.N.type keys MenuSprite::renderItems
+// draws, which are never written on most installs. A profile reads the
+// seven attributes /api/profile shows, which are. --dir is wiped before
+// and after.
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "GameData.hpp"
+#include "GameSchema.hpp"
+#include "GameStore.hpp"
+#include "LAppDefine.hpp"
+
+namespace {
+
+std::atomic<uint64_t> allocations{0};
+
+}  // namespace
+
+void* operator new(size_t size) {
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  if (void* p = std::malloc(size ? size : 1)) {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Result {
+  double ns_per_read;
+  double allocs_per_read;
+};
+
+template <typename F>
+Result Measure(int rounds, int reads_per_round, F&& round) {
+  // one untimed round fills the cache
+  round();
+  uint64_t allocs = allocations.load();
+  auto start = Clock::now();
+  for (int i = 0; i < rounds; i++) {
+    round();
+  }
+  double ns =
+      std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+  double reads = static_cast<double>(rounds) * reads_per_round;
+  return {ns / reads, (allocations.load() - allocs) / reads};
+}
+
+void Populate(std::string_view backend) {
+  GameData::Destroy(LAppDefine::documentPath);
+  GameData data(LAppDefine::documentPath + L"/jpet.dat", backend);
+  auto txn = data.Begin();
+  for (size_t i = 0; i < kAttrCount; i++) {
+    txn.Update(keys::Attrs[i], static_cast<int32_t>(10 + i));
+  }
+  // some unrelated state, so lookups do not run on an empty store
+  for (int id = 1; id <= 14; id++) {
+    for (size_t field = 0; field < kTaskFields.size(); field++) {
+      txn.Update(keys::MakeTaskKey(id, field), id);
+    }
+  }
+  txn.Commit();
+}
+
+// the baseline GetWithDefault: build the key, read the store, decode
+int StoreRead(GameStore& store, const std::string& key, int def) {
+  std::string raw;
+  if (!store.Get(key, raw) || raw.size() < sizeof(int32_t)) {
+    return def;
+  }
+  int32_t value;
+  std::memcpy(&value, raw.data(), sizeof(value));
+  return value;
+}
+
+int CachedRead(GameData& data, const Key<int>& key) {
+  int32_t value;
+  return data.Get(key.name, value) ? value : key.def;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  int frames = 100000;
+  std::filesystem::path dir =
+      std::filesystem::temp_directory_path() / "jpet_read_bench";
+  for (int i = 1; i + 1 < argc; i += 2) {
+    std::string flag = argv[i];
+    if (flag == "--frames") {
+      frames = std::atoi(argv[i + 1]);
+    } else if (flag == "--dir") {
+      dir = argv[i + 1];
+    } else {
+      std::fprintf(stderr, "read_bench: unknown option %s\n", flag.c_str());
+      return 2;
+    }
+  }
+  std::filesystem::create_directories(dir);
+  LAppDefine::documentPath = dir.wstring();
+  std::printf("%d rounds of each path\n\n", frames);
+  std::printf("%-8s  %-8s  %-7s  %10s  %10s\n", "backend", "path", "reads",
+              "ns/read", "allocs");
+  volatile int sink = 0;
+  for (auto backend : GameStore::Backends()) {
+    std::string name(backend);
+    Populate(backend);
+    Result store_frame, store_profile;
+    {
+      auto store = GameStore::Create(backend);
+      if (!store->Open(LAppDefine::documentPath)) {
+        std::fprintf(stderr, "read_bench: cannot open %s\n", name.c_str());
+        return 1;
+      }
+      store_frame = Measure(frames, keys::kShortcutCount, [&] {
+        for (size_t i = 0; i < keys::kShortcutCount; i++) {
+          sink = sink + StoreRead(*store,
+                                  "shortcut." + std::to_string(i) + ".type", 3);
+        }
+      });
+      store_profile = Measure(frames, kAttrCount, [&] {
+        for (size_t i = 0; i < kAttrCount; i++) {
+          sink = sink + StoreRead(*store, "attr." + std::string(kAttrNames[i]),
+                                  0);
+        }
+      });
+      store->Close();
+    }
+    GameData data(LAppDefine::documentPath + L"/jpet.dat", backend);
+    Result cached_frame = Measure(frames, keys::kShortcutCount, [&] {
+      for (const auto& key : keys::ShortcutType) {
+        sink = sink + CachedRead(data, key);
+      }
+    });
+    Result cached_profile = Measure(frames, kAttrCount, [&] {
+      for (const auto& key : keys::Attrs) {
+        int32_t value;
+        sink = sink + (data.Get(key, value) ? value : 0);
+      }
+    });
+    auto row = [&name](const char* path, const char* reads, Result r) {
+      std::printf("%-8s  %-8s  %-7s  %10.1f  %10.2f\n", name.c_str(), path,
+                  reads, r.ns_per_read, r.allocs_per_read);
+    };
+    row("store", "frame", store_frame);
+    row("cached", "frame", cached_frame);
+    row("store", "profile", store_profile);
+    row("cached", "profile", cached_profile);
+    std::printf("%-8s  cache hits %llu, misses %llu\n", name.c_str(),
+                static_cast<unsigned long long>(data.CacheHits()),
+                static_cast<unsigned long long>(data.CacheMisses()));
+  }
+  GameData::Destroy(LAppDefine::documentPath);
+  return 0;
+}
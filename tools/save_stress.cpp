@@ -0,0 +1,172 @@
+// Many threads changing settings and calling DataManager::Save() as fast
+// as they can, the way panel handlers do on every POST /api/config/*,
+// while another thread keeps reading jpet.toml back.
+//
+//   save_stress [--threads 16] [--seconds 3] [--dir path]
+//
+// Checks that the debounced saver writes at most once per save window
+// (500ms, DataManager::kSaveWindow) plus the final flush, that the file is
+// there and parses every time it is read, and that after Flush() it holds
+// the last published settings. --dir is wiped first and gets a fresh
+// jpet.toml and game data.
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <toml++/toml.hpp>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+#include "DataManager.hpp"
+#include "LAppDefine.hpp"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr double kSaveWindowSeconds = 0.5;
+
+// read the whole file without blocking the saver's rename, the way an
+// editor or a backup tool would
+bool ReadConfig(const std::filesystem::path& path, std::string& content) {
+#ifdef _WIN32
+  HANDLE file = CreateFileW(path.c_str(), GENERIC_READ,
+                            FILE_SHARE_READ | FILE_SHARE_WRITE |
+                                FILE_SHARE_DELETE,
+                            nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL,
+                            nullptr);
+  if (file == INVALID_HANDLE_VALUE) {
+    return false;
+  }
+  content.clear();
+  char buffer[4096];
+  DWORD read = 0;
+  while (ReadFile(file, buffer, sizeof(buffer), &read, nullptr) && read > 0) {
+    content.append(buffer, read);
+  }
+  CloseHandle(file);
+  return true;
+#else
+  std::ifstream file(path, std::ios::binary);
+  if (!file.is_open()) {
+    return false;
+  }
+  std::stringstream stream;
+  stream << file.rdbuf();
+  content = stream.str();
+  return true;
+#endif
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  int thread_count = 16;
+  double seconds = 3;
+  std::filesystem::path dir =
+      std::filesystem::temp_directory_path() / "jpet_save_stress";
+  for (int i = 1; i + 1 < argc; i += 2) {
+    std::string flag = argv[i];
+    if (flag == "--threads") {
+      thread_count = std::atoi(argv[i + 1]);
+    } else if (flag == "--seconds") {
+      seconds = std::atof(argv[i + 1]);
+    } else if (flag == "--dir") {
+      dir = argv[i + 1];
+    } else {
+      std::fprintf(stderr, "save_stress: unknown option %s\n", flag.c_str());
+      return 2;
+    }
+  }
+  std::filesystem::remove_all(dir);
+  std::filesystem::create_directories(dir);
+  LAppDefine::documentPath = dir.wstring();
+  const std::filesystem::path config_path = dir / "jpet.toml";
+  DataManager* dm = DataManager::GetInstance();
+  uint64_t writes_before = dm->ConfigWrites();
+
+  std::atomic<bool> stop{false};
+  std::atomic<uint64_t> saves{0};
+  std::vector<std::thread> threads;
+  for (int t = 0; t < thread_count; t++) {
+    threads.emplace_back([&, t] {
+      for (int n = t; !stop.load(std::memory_order_relaxed);
+           n += thread_count) {
+        if (n % 2) {
+          dm->UpdateAudio(n % 101, n % 3 == 0, true, true);
+        } else {
+          dm->UpdateNotify(n % 4 == 0, true, n % 3 == 0);
+        }
+        dm->Save();
+        saves.fetch_add(1, std::memory_order_relaxed);
+      }
+    });
+  }
+  uint64_t reads = 0;
+  uint64_t missing = 0;
+  uint64_t broken = 0;
+  std::thread checker([&] {
+    std::string content;
+    while (!stop.load(std::memory_order_relaxed)) {
+      if (!ReadConfig(config_path, content)) {
+        missing++;
+        continue;
+      }
+      try {
+        toml::parse(content);
+      } catch (const toml::parse_error&) {
+        broken++;
+      }
+      reads++;
+    }
+  });
+  auto begin = Clock::now();
+  std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+  stop = true;
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  checker.join();
+  dm->Flush();
+  double elapsed = std::chrono::duration<double>(Clock::now() - begin).count();
+
+  // the flushed file holds what Config() shows
+  std::string content;
+  int volume = -1;
+  if (ReadConfig(config_path, content)) {
+    try {
+      volume = toml::parse(content)["audio"]["volume"].value_or(-1);
+    } catch (const toml::parse_error&) {
+    }
+  }
+  uint64_t writes = dm->ConfigWrites() - writes_before;
+  uint64_t bound =
+      static_cast<uint64_t>(std::ceil(elapsed / kSaveWindowSeconds)) + 1;
+  std::printf("%d threads, %.1fs\n", thread_count, elapsed);
+  std::printf("saves      %10llu\n",
+              static_cast<unsigned long long>(saves.load()));
+  std::printf("writes     %10llu  (at most %llu)\n",
+              static_cast<unsigned long long>(writes),
+              static_cast<unsigned long long>(bound));
+  std::printf("reads      %10llu\n", static_cast<unsigned long long>(reads));
+  std::printf("missing    %10llu\n", static_cast<unsigned long long>(missing));
+  std::printf("unparsable %10llu\n", static_cast<unsigned long long>(broken));
+  std::printf("final      %s\n",
+              volume == dm->Config().volume ? "matches" : "differs");
+  bool ok = writes <= bound && missing == 0 && broken == 0 &&
+            volume == dm->Config().volume;
+  if (!ok) {
+    std::printf("FAILED\n");
+  }
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,211 @@
+// Wakeups and CPU time per hour of TaskScheduler (src/TaskScheduler.hpp)
+// against the loop it replaced, which slept 500ms and then asked every
+// task whether it was due. Both run the app's schedule on a virtual clock
+// (tools/VirtualClock.hpp), so a day takes milliseconds: ExpTask's quarter
+// hour cron, and a game task settling every --task minutes.
+//
+//   scheduler_bench [--hours 24] [--task 25]
+//
+// Late is how long after its deadline a task ran on average. CPU is what
+// the process spent per simulated hour, which leaves out what the OS
+// charges for waking a thread, so the polling loop costs more than shown.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+#include "Task.hpp"
+#include "TaskScheduler.hpp"
+#include "VirtualClock.hpp"
+
+namespace {
+
+using Clock = Task::Clock;
+using namespace std::chrono_literals;
+
+double CpuSeconds() {
+#ifdef _WIN32
+  FILETIME creation, exit, kernel, user;
+  GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user);
+  auto seconds = [](const FILETIME& time) {
+    return (static_cast<uint64_t>(time.dwHighDateTime) << 32 |
+            time.dwLowDateTime) /
+           1e7;
+  };
+  return seconds(kernel) + seconds(user);
+#else
+  timespec time{};
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &time);
+  return time.tv_sec + time.tv_nsec / 1e9;
+#endif
+}
+
+// keeps count of its runs and how late they were against its deadline
+class CountedTask : public Task {
+ public:
+  explicit CountedTask(std::function<Clock::time_point()> now)
+      : now_(std::move(now)) {}
+
+  std::optional<Clock::time_point> Next(Clock::time_point now) override {
+    due_ = deadline(now);
+    return due_;
+  }
+  void Execute() override {
+    runs++;
+    late += now_() - due_;
+  }
+
+  uint64_t runs = 0;
+  Clock::duration late{};
+
+ protected:
+  virtual Clock::time_point deadline(Clock::time_point now) = 0;
+
+ private:
+  std::function<Clock::time_point()> now_;
+  Clock::time_point due_;
+};
+
+// ExpTask's schedule
+class CronTask : public CountedTask {
+ public:
+  using CountedTask::CountedTask;
+
+ protected:
+  Clock::time_point deadline(Clock::time_point now) override {
+    return Clock::from_time_t(cron::cron_next(cron_, Clock::to_time_t(now)));
+  }
+
+ private:
+  cron::cronexpr cron_ = cron::make_cron("0 */15 * * * *");
+};
+
+// a game task started again as soon as it settles
+class RepeatTask : public CountedTask {
+ public:
+  RepeatTask(std::function<Clock::time_point()> now, Clock::duration period)
+      : CountedTask(std::move(now)), period_(period) {}
+
+ protected:
+  Clock::time_point deadline(Clock::time_point now) override {
+    return now + period_;
+  }
+
+ private:
+  Clock::duration period_;
+};
+
+struct Result {
+  uint64_t wakeups;
+  uint64_t runs;
+  Clock::duration late;
+  double cpu;
+};
+
+// the old TaskScheduler::doRun: sleep, then poll every task
+Result RunLoop(Clock::time_point start, int hours, Clock::duration task) {
+  Clock::time_point now = start;
+  auto clock = [&now] { return now; };
+  std::vector<std::shared_ptr<CountedTask>> tasks = {
+      std::make_shared<CronTask>(clock),
+      std::make_shared<RepeatTask>(clock, task)};
+  std::vector<Clock::time_point> due;
+  for (auto& t : tasks) {
+    due.push_back(*t->Next(now));
+  }
+  Result result{};
+  double cpu = CpuSeconds();
+  for (const auto end = start + std::chrono::hours(hours); now < end;) {
+    // sleep_for(500ms) plus the tick, so ticks drift against the deadlines
+    now += 501ms;
+    result.wakeups++;
+    for (size_t i = 0; i < tasks.size(); i++) {
+      if (now >= due[i]) {
+        tasks[i]->Execute();
+        due[i] = *tasks[i]->Next(now);
+      }
+    }
+  }
+  result.cpu = CpuSeconds() - cpu;
+  for (auto& t : tasks) {
+    result.runs += t->runs;
+    result.late += t->late;
+  }
+  return result;
+}
+
+Result RunHeap(Clock::time_point start, int hours, Clock::duration task) {
+  auto clock = std::make_shared<VirtualClock>(start);
+  auto now = [clock] { return clock->Now(); };
+  std::vector<std::shared_ptr<CountedTask>> tasks = {
+      std::make_shared<CronTask>(now),
+      std::make_shared<RepeatTask>(now, task)};
+  Result result{};
+  double cpu = CpuSeconds();
+  {
+    TaskScheduler scheduler(clock);
+    for (auto& t : tasks) {
+      scheduler.AddTask(t);
+    }
+    // the adds woke the worker, count from here
+    clock->RunUntil(start);
+    uint64_t before = scheduler.Wakeups();
+    clock->RunUntil(start + std::chrono::hours(hours));
+    result.wakeups = scheduler.Wakeups() - before;
+  }
+  result.cpu = CpuSeconds() - cpu;
+  for (auto& t : tasks) {
+    result.runs += t->runs;
+    result.late += t->late;
+  }
+  return result;
+}
+
+void Print(const char* name, const Result& result, int hours) {
+  double late_ms =
+      std::chrono::duration<double, std::milli>(result.late).count() /
+      std::max<uint64_t>(result.runs, 1);
+  std::printf("%-6s  %12.1f  %8.1f  %8.1f  %10.1f\n", name,
+              double(result.wakeups) / hours, double(result.runs) / hours,
+              late_ms, result.cpu * 1e6 / hours);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  int hours = 24;
+  int task_minutes = 25;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    std::string flag = argv[i];
+    if (flag == "--hours") {
+      hours = std::max(1, std::atoi(argv[i + 1]));
+    } else if (flag == "--task") {
+      task_minutes = std::max(1, std::atoi(argv[i + 1]));
+    } else {
+      std::fprintf(stderr, "scheduler_bench: unknown option %s\n",
+                   flag.c_str());
+      return 2;
+    }
+  }
+  // a whole second, cron deadlines are whole seconds too
+  auto start = Clock::from_time_t(std::time(nullptr));
+  auto task = std::chrono::minutes(task_minutes);
+  std::printf("%d simulated hours, a game task every %d minutes, per hour\n\n",
+              hours, task_minutes);
+  std::printf("%-6s  %12s  %8s  %8s  %10s\n", "loop", "wakeups", "runs",
+              "late ms", "cpu us");
+  Print("poll", RunLoop(start, hours, task), hours);
+  Print("heap", RunHeap(start, hours, task), hours);
+  return 0;
+}
@@ -0,0 +1,218 @@
+// Runs TaskScheduler (src/TaskScheduler.hpp) on a virtual clock
+// (tools/VirtualClock.hpp) through the cases game tasks and the exp cron
+// depend on, and checks when each task ran:
+//
+//   cron      the quarter hour cron runs once at every boundary, none
+//             before, also when the clock stops right on one
+//   settle    a task settles once, at start time + cost
+//   cancel    a cancelled task never settles
+//   restart   a task removed and added again with a new deadline runs at
+//             the new one only, the heap entry of the old one is skipped
+//   reboot    a deadline already past when the app starts settles right
+//             away, once, with its original deadline
+//
+//   scheduler_check
+//
+// Prints one line per case and FAILED if any check did not hold.
+
+#include <chrono>
+#include <cstdio>
+#include <ctime>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Task.hpp"
+#include "TaskScheduler.hpp"
+#include "VirtualClock.hpp"
+
+namespace {
+
+using Clock = Task::Clock;
+using namespace std::chrono_literals;
+
+// a whole hour, so quarter hours are whole multiples from here in any
+// time zone
+const Clock::time_point kHour = Clock::from_time_t(1700000000 / 3600 * 3600);
+
+// ExpTask's schedule, noting when it ran
+class CronTask : public Task {
+ public:
+  explicit CronTask(VirtualClock& clock) : clock_(clock) {}
+
+  std::optional<Clock::time_point> Next(Clock::time_point now) override {
+    return Clock::from_time_t(cron::cron_next(cron_, Clock::to_time_t(now)));
+  }
+  void Execute() override { runs.push_back(clock_.Now()); }
+
+  std::vector<Clock::time_point> runs;
+
+ private:
+  VirtualClock& clock_;
+  cron::cronexpr cron_ = cron::make_cron("0 */15 * * * *");
+};
+
+// a task whose deadline may change while it is not scheduled
+class AlarmTask : public Task {
+ public:
+  explicit AlarmTask(VirtualClock& clock) : clock_(clock) {}
+
+  std::optional<Clock::time_point> Next(Clock::time_point now) override {
+    if (fired_) {
+      return std::nullopt;
+    }
+    return deadline;
+  }
+  void Execute() override {
+    fired_ = true;
+    runs.push_back(clock_.Now());
+  }
+
+  Clock::time_point deadline;
+  std::vector<Clock::time_point> runs;
+
+ private:
+  VirtualClock& clock_;
+  bool fired_ = false;
+};
+
+struct Settled {
+  time_t deadline;
+  Clock::time_point at;
+};
+
+// one scheduler on its own clock, with the cron task the clock needs
+struct Fixture {
+  explicit Fixture(Clock::time_point start)
+      : clock(std::make_shared<VirtualClock>(start)),
+        cron(std::make_shared<CronTask>(*clock)),
+        scheduler(clock) {
+    scheduler.AddTask(cron);
+    clock->RunUntil(start);
+  }
+
+  // what DataManager::scheduleSettle() does for a run ending at deadline
+  std::shared_ptr<Task> Settle(Clock::time_point deadline) {
+    time_t end = Clock::to_time_t(deadline);
+    auto task = std::make_shared<SettleTimer>(end, [this, end] {
+      settled.push_back({end, clock->Now()});
+    });
+    scheduler.AddTask(task);
+    return task;
+  }
+
+  std::shared_ptr<VirtualClock> clock;
+  std::shared_ptr<CronTask> cron;
+  std::vector<Settled> settled;
+  TaskScheduler scheduler;
+};
+
+int failures = 0;
+
+void Check(const char* name, bool ok, const char* what) {
+  if (!ok) {
+    std::printf("%-8s  FAILED: %s\n", name, what);
+    failures++;
+  }
+}
+
+void Cron() {
+  Fixture f(kHour + 7min + 30s);
+  f.clock->RunUntil(kHour + 14min + 59s);
+  Check("cron", f.cron->runs.empty(), "ran before the boundary");
+  f.clock->RunUntil(kHour + 15min);
+  Check("cron",
+        f.cron->runs.size() == 1 && f.cron->runs[0] == kHour + 15min,
+        "did not run on the boundary the clock stopped at");
+  f.clock->RunUntil(kHour + 2h);
+  bool on_boundaries = f.cron->runs.size() == 8;
+  for (size_t i = 0; on_boundaries && i < f.cron->runs.size(); i++) {
+    on_boundaries = f.cron->runs[i] == kHour + 15min * (i + 1);
+  }
+  Check("cron", on_boundaries, "not once at every quarter hour");
+}
+
+void Settle() {
+  Fixture f(kHour + 1min);
+  f.Settle(kHour + 26min);
+  f.clock->RunUntil(kHour + 25min + 59s);
+  Check("settle", f.settled.empty(), "settled early");
+  f.clock->RunUntil(kHour + 26min);
+  Check("settle",
+        f.settled.size() == 1 && f.settled[0].at == kHour + 26min,
+        "did not settle at the deadline");
+  f.clock->RunUntil(kHour + 3h);
+  Check("settle", f.settled.size() == 1, "settled more than once");
+}
+
+void Cancel() {
+  Fixture f(kHour + 1min);
+  auto task = f.Settle(kHour + 26min);
+  f.clock->RunUntil(kHour + 10min);
+  f.scheduler.RemoveTask(task);
+  f.clock->RunUntil(kHour + 1h);
+  Check("cancel", f.settled.empty(), "settled after the cancel");
+  Check("cancel", f.cron->runs.size() == 4, "cron stopped with the cancel");
+}
+
+void Restart() {
+  Fixture f(kHour + 1min);
+  auto alarm = std::make_shared<AlarmTask>(*f.clock);
+  alarm->deadline = kHour + 20min;
+  f.scheduler.AddTask(alarm);
+  f.clock->RunUntil(kHour + 5min);
+  // the entry for 20min stays in the heap, from an older generation
+  f.scheduler.RemoveTask(alarm);
+  alarm->deadline = kHour + 40min;
+  f.scheduler.AddTask(alarm);
+  f.scheduler.RemoveTask(alarm);
+  f.scheduler.AddTask(alarm);
+  f.clock->RunUntil(kHour + 39min);
+  Check("restart", alarm->runs.empty(), "the old deadline still fired");
+  f.clock->RunUntil(kHour + 1h);
+  Check("restart",
+        alarm->runs.size() == 1 && alarm->runs[0] == kHour + 40min,
+        "did not run once at the new deadline");
+}
+
+void Reboot() {
+  // the app starts 3 hours after the task should have ended
+  Fixture f(kHour + 3h + 2min);
+  f.Settle(kHour + 26min);
+  f.clock->RunUntil(kHour + 3h + 2min);
+  Check("reboot",
+        f.settled.size() == 1 && f.settled[0].at == kHour + 3h + 2min,
+        "did not settle right away");
+  Check("reboot",
+        !f.settled.empty() &&
+            f.settled[0].deadline == Clock::to_time_t(kHour + 26min),
+        "settled with another deadline");
+  f.clock->RunUntil(kHour + 5h);
+  Check("reboot", f.settled.size() == 1, "settled more than once");
+}
+
+}  // namespace
+
+int main() {
+  struct Case {
+    const char* name;
+    void (*run)();
+  };
+  const Case cases[] = {{"cron", Cron},
+                        {"settle", Settle},
+                        {"cancel", Cancel},
+                        {"restart", Restart},
+                        {"reboot", Reboot}};
+  for (const auto& c : cases) {
+    int before = failures;
+    c.run();
+    if (failures == before) {
+      std::printf("%-8s  ok\n", c.name);
+    }
+  }
+  if (failures > 0) {
+    std::printf("FAILED\n");
+    return 1;
+  }
+  return 0;
+}
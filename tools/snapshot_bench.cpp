@@ -0,0 +1,145 @@
+// Startup read of task and attribute state on a synthetic database, on
+// every compiled-in GameStore backend (src/GameStore.hpp). "point" is how
+// tasks loaded before DataManager::LoadSnapshot: five Gets per task, one
+// per attribute. "bulk" is LoadSnapshot: one prefix Scan of task. and one
+// GetMany for the attributes.
+//
+//   snapshot_bench [--runs 5] [--dir path]
+//
+// Databases of 100, 1000 and 10000 tasks. Every run opens the store anew,
+// so the read cache starts cold as at startup, and the median run is
+// shown. --dir is wiped before and after.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "GameData.hpp"
+#include "GameSchema.hpp"
+#include "GameStore.hpp"
+#include "LAppDefine.hpp"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+using Tasks = std::unordered_map<int, TaskRecord>;
+
+void Populate(std::string_view backend, int tasks) {
+  GameData::Destroy(LAppDefine::documentPath);
+  GameData data(LAppDefine::documentPath + L"/jpet.dat", backend);
+  auto txn = data.Begin();
+  for (size_t i = 0; i < kAttrCount; i++) {
+    txn.Update(keys::Attrs[i], static_cast<int32_t>(40 + i));
+  }
+  for (int id = 1; id <= tasks; id++) {
+    for (size_t field = 0; field < kTaskFields.size(); field++) {
+      txn.Update(keys::MakeTaskKey(id, field), id);
+    }
+  }
+  txn.Commit();
+}
+
+Tasks PointRead(GameData& data, int tasks, AttrArray& attributes) {
+  Tasks records;
+  for (size_t i = 0; i < kAttrCount; i++) {
+    int32_t value = 0;
+    data.Get(keys::Attrs[i], value);
+    attributes[i] = value;
+  }
+  for (int id = 1; id <= tasks; id++) {
+    TaskRecord record{};
+    bool found = false;
+    for (size_t field = 0; field < kTaskFields.size(); field++) {
+      int32_t value = 0;
+      found |= data.Get(keys::MakeTaskKey(id, field), value);
+      record[field] = value;
+    }
+    if (found) {
+      records[id] = record;
+    }
+  }
+  return records;
+}
+
+Tasks BulkRead(GameData& data, AttrArray& attributes) {
+  std::vector<std::string_view> names(keys::Attrs.begin(), keys::Attrs.end());
+  std::vector<int32_t> values(kAttrCount, 0);
+  data.GetMany(names, values);
+  std::copy(values.begin(), values.end(), attributes.begin());
+  Tasks records;
+  data.Scan<int32_t>(keys::kTaskPrefix,
+                     [&records](std::string_view key, int32_t value) {
+                       int id = 0;
+                       size_t field = 0;
+                       if (keys::ParseTaskKey(key, id, field)) {
+                         records[id][field] = value;
+                       }
+                     });
+  return records;
+}
+
+// median of runs, each on a freshly opened store
+double Measure(std::string_view backend, int runs, int tasks, bool bulk) {
+  std::vector<double> times;
+  for (int run = 0; run < runs; run++) {
+    GameData data(LAppDefine::documentPath + L"/jpet.dat", backend);
+    AttrArray attributes{};
+    auto begin = Clock::now();
+    Tasks records =
+        bulk ? BulkRead(data, attributes) : PointRead(data, tasks, attributes);
+    times.push_back(
+        std::chrono::duration<double, std::milli>(Clock::now() - begin)
+            .count());
+    if (records.size() != static_cast<size_t>(tasks) ||
+        attributes[0] != 40) {
+      std::fprintf(stderr, "snapshot_bench: read %zu of %d tasks\n",
+                   records.size(), tasks);
+      std::exit(1);
+    }
+  }
+  std::sort(times.begin(), times.end());
+  return times[times.size() / 2];
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  int runs = 5;
+  std::filesystem::path dir =
+      std::filesystem::temp_directory_path() / "jpet_snapshot_bench";
+  for (int i = 1; i + 1 < argc; i += 2) {
+    std::string flag = argv[i];
+    if (flag == "--runs") {
+      runs = std::max(1, std::atoi(argv[i + 1]));
+    } else if (flag == "--dir") {
+      dir = argv[i + 1];
+    } else {
+      std::fprintf(stderr, "snapshot_bench: unknown option %s\n",
+                   flag.c_str());
+      return 2;
+    }
+  }
+  std::filesystem::create_directories(dir);
+  LAppDefine::documentPath = dir.wstring();
+  std::printf("%-8s  %7s  %8s  %10s  %10s  %7s\n", "backend", "tasks", "keys",
+              "point ms", "bulk ms", "speedup");
+  for (auto backend : GameStore::Backends()) {
+    for (int tasks : {100, 1000, 10000}) {
+      Populate(backend, tasks);
+      double point = Measure(backend, runs, tasks, false);
+      double bulk = Measure(backend, runs, tasks, true);
+      std::printf("%-8s  %7d  %8zu  %10.2f  %10.2f  %6.1fx\n",
+                  std::string(backend).c_str(), tasks,
+                  tasks * kTaskFields.size() + kAttrCount, point, bulk,
+                  point / bulk);
+    }
+  }
+  GameData::Destroy(LAppDefine::documentPath);
+  return 0;
+}
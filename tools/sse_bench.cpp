@@ -0,0 +1,344 @@
+// Many EventSource clients on one SseHub (src/SseHub.hpp) while events are
+// published fast: every tenth event is unique, the rest a flood of UPDATE
+// that the bus coalesces. A tenth of the clients drop their connection now
+// and then and come back with Last-Event-ID. Checks that every client saw
+// the events in order and every unique one, or a resync event in place of
+// those it fell too far behind for, and reports delivery latency.
+//
+//   sse_bench [--clients 500] [--rate 20000] [--seconds 2] [--capacity 256]
+//
+// --rate is events published per second.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <arpa/inet.h>
+#include <cerrno>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+#include "EventBus.hpp"
+#include "SseHub.hpp"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+#ifdef _WIN32
+using socket_t = SOCKET;
+constexpr socket_t kInvalidSocket = INVALID_SOCKET;
+
+int Poll(std::vector<pollfd>& fds, int timeout_ms) {
+  return WSAPoll(fds.data(), static_cast<ULONG>(fds.size()), timeout_ms);
+}
+
+void CloseSocket(socket_t s) { closesocket(s); }
+#else
+using socket_t = int;
+constexpr socket_t kInvalidSocket = -1;
+
+int Poll(std::vector<pollfd>& fds, int timeout_ms) {
+  return poll(fds.data(), fds.size(), timeout_ms);
+}
+
+void CloseSocket(socket_t s) { close(s); }
+#endif
+
+int64_t NowUs() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             Clock::now().time_since_epoch())
+      .count();
+}
+
+struct Subscriber {
+  socket_t fd = kInvalidSocket;
+  bool header_done = false;
+  std::string buffer;
+  // fields of the event being read
+  uint64_t event_id = 0;
+  std::string event_data;
+  uint64_t last_id = 0;
+  // next unique event expected, a gap is a loss unless a resync came first
+  int64_t next_unique = 0;
+  bool resynced = false;
+  uint64_t missed = 0;
+  uint64_t events = 0;
+  uint64_t out_of_order = 0;
+  uint64_t resyncs = 0;
+  uint64_t reconnects = 0;
+  bool done = false;
+  // drops the connection then, if flaky
+  bool flaky = false;
+  Clock::time_point drop;
+};
+
+// resume after last_id when there is one, like EventSource does
+socket_t Connect(int port, std::optional<uint64_t> last_id) {
+  socket_t fd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+  sockaddr_in address{};
+  address.sin_family = AF_INET;
+  address.sin_port = htons(static_cast<uint16_t>(port));
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) !=
+      0) {
+    CloseSocket(fd);
+    return kInvalidSocket;
+  }
+  std::string request = "GET /api/sse HTTP/1.1\r\nHost: 127.0.0.1\r\n";
+  if (last_id) {
+    request += "Last-Event-ID: " + std::to_string(*last_id) + "\r\n";
+  }
+  request += "\r\n";
+  send(fd, request.data(), static_cast<int>(request.size()), 0);
+  return fd;
+}
+
+class Publisher {
+ public:
+  explicit Publisher(EventBus& bus) : bus_(bus) {}
+
+  void Run(int rate, int seconds) {
+    auto start = Clock::now();
+    int64_t total = static_cast<int64_t>(rate) * seconds;
+    for (int64_t i = 0; i < total; i++) {
+      auto due = start + std::chrono::microseconds(i * 1000000 / rate);
+      std::this_thread::sleep_until(due);
+      if (i % 10 == 0) {
+        bus_.Publish("E " + std::to_string(unique_) + " " +
+                     std::to_string(NowUs()));
+        unique_++;
+      } else {
+        bus_.Publish("UPDATE");
+      }
+    }
+    bus_.Publish("END " + std::to_string(unique_));
+    finished_ = true;
+  }
+
+  // number of the next unique event
+  int64_t Unique() const { return unique_; }
+
+  bool Finished() const { return finished_; }
+
+ private:
+  EventBus& bus_;
+  std::atomic<int64_t> unique_{0};
+  std::atomic<bool> finished_{false};
+};
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  int clients = 500;
+  int rate = 20000;
+  int seconds = 2;
+  size_t capacity = 256;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    std::string flag = argv[i];
+    if (flag == "--clients") {
+      clients = std::atoi(argv[i + 1]);
+    } else if (flag == "--rate") {
+      rate = std::atoi(argv[i + 1]);
+    } else if (flag == "--seconds") {
+      seconds = std::atoi(argv[i + 1]);
+    } else if (flag == "--capacity") {
+      capacity = static_cast<size_t>(std::atoll(argv[i + 1]));
+    } else {
+      std::fprintf(stderr, "sse_bench: unknown option %s\n", flag.c_str());
+      return 2;
+    }
+  }
+#ifdef _WIN32
+  WSADATA data;
+  WSAStartup(MAKEWORD(2, 2), &data);
+#endif
+  EventBus bus(capacity, "RESYNC");
+  SseHub hub(bus);
+  if (!hub.Start()) {
+    std::fprintf(stderr, "sse_bench: cannot listen\n");
+    return 1;
+  }
+  std::vector<Subscriber> subscribers(clients);
+  for (int i = 0; i < clients; i++) {
+    subscribers[i].flaky = i % 10 == 0;
+    subscribers[i].fd = Connect(hub.Port(), std::nullopt);
+    if (subscribers[i].fd == kInvalidSocket) {
+      std::fprintf(stderr, "sse_bench: cannot connect client %d\n", i);
+      return 1;
+    }
+  }
+  // every client is streaming before the first event
+  while (hub.Clients() < static_cast<size_t>(clients) ||
+         hub.Stats().accepted < static_cast<uint64_t>(clients)) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+  Publisher publisher(bus);
+  std::vector<int64_t> latencies;
+  std::thread publish([&] { publisher.Run(rate, seconds); });
+  auto start = Clock::now();
+  for (int i = 0; i < clients; i++) {
+    // spread over the first 100 ms
+    subscribers[i].drop = start + std::chrono::milliseconds(i * 100 / clients);
+  }
+  std::vector<pollfd> fds;
+  char buffer[16384];
+  int remaining = clients;
+  auto deadline = start + std::chrono::seconds(seconds + 10);
+  while (remaining > 0 && Clock::now() < deadline) {
+    fds.clear();
+    for (auto& s : subscribers) {
+      fds.push_back({s.fd, static_cast<short>(s.done ? 0 : POLLIN), 0});
+    }
+    Poll(fds, 100);
+    for (size_t i = 0; i < subscribers.size(); i++) {
+      Subscriber& s = subscribers[i];
+      if (s.done || !(fds[i].revents & (POLLIN | POLLHUP | POLLERR))) {
+        continue;
+      }
+      auto n = recv(s.fd, buffer, sizeof(buffer), 0);
+      if (n <= 0) {
+        std::fprintf(stderr, "sse_bench: client %zu lost its connection\n",
+                     i);
+        s.done = true;
+        remaining--;
+        continue;
+      }
+      s.buffer.append(buffer, static_cast<size_t>(n));
+      if (!s.header_done) {
+        size_t end = s.buffer.find("\r\n\r\n");
+        if (end == std::string::npos) {
+          continue;
+        }
+        s.buffer.erase(0, end + 4);
+        s.header_done = true;
+      }
+      size_t pos = 0;
+      while (true) {
+        size_t eol = s.buffer.find('\n', pos);
+        if (eol == std::string::npos) {
+          break;
+        }
+        std::string line = s.buffer.substr(pos, eol - pos);
+        pos = eol + 1;
+        if (line.compare(0, 4, "id: ") == 0) {
+          s.event_id = std::strtoull(line.c_str() + 4, nullptr, 10);
+          continue;
+        }
+        if (line.compare(0, 6, "data: ") == 0) {
+          s.event_data = line.substr(6);
+          continue;
+        }
+        if (!line.empty() || s.event_data.empty()) {
+          // retry: and heartbeat comments
+          continue;
+        }
+        s.events++;
+        if (s.event_id <= s.last_id && s.event_data != "RESYNC") {
+          s.out_of_order++;
+        }
+        s.last_id = s.event_id;
+        if (s.event_data == "RESYNC") {
+          s.resyncs++;
+          s.resynced = true;
+        } else if (s.event_data.compare(0, 2, "E ") == 0 ||
+                   s.event_data.compare(0, 4, "END ") == 0) {
+          bool end = s.event_data[1] == 'N';
+          char* rest = nullptr;
+          int64_t unique =
+              std::strtoll(s.event_data.c_str() + (end ? 4 : 2), &rest, 10);
+          if (unique > s.next_unique && !s.resynced) {
+            s.missed += static_cast<uint64_t>(unique - s.next_unique);
+          }
+          s.next_unique = unique + 1;
+          s.resynced = false;
+          if (end) {
+            s.done = true;
+            remaining--;
+          } else {
+            latencies.push_back(NowUs() - std::strtoll(rest, nullptr, 10));
+          }
+        }
+        s.event_data.clear();
+      }
+      s.buffer.erase(0, pos);
+      // a flaky client drops every 100 ms and resumes at once
+      if (!s.done && s.flaky && !publisher.Finished() &&
+          Clock::now() >= s.drop) {
+        s.drop += std::chrono::milliseconds(100);
+        CloseSocket(s.fd);
+        s.fd = Connect(hub.Port(), s.last_id);
+        s.header_done = false;
+        s.buffer.clear();
+        s.reconnects++;
+      }
+    }
+  }
+  publish.join();
+  double elapsed =
+      std::chrono::duration<double>(Clock::now() - start).count();
+
+  uint64_t missed = 0;
+  uint64_t out_of_order = 0;
+  uint64_t resyncs = 0;
+  uint64_t reconnects = 0;
+  uint64_t events = 0;
+  int unfinished = 0;
+  for (auto& s : subscribers) {
+    unfinished += !s.done;
+    out_of_order += s.out_of_order;
+    resyncs += s.resyncs;
+    reconnects += s.reconnects;
+    events += s.events;
+    missed += s.missed;
+    CloseSocket(s.fd);
+  }
+  std::sort(latencies.begin(), latencies.end());
+  auto at = [&](double q) {
+    return latencies.empty()
+               ? 0
+               : latencies[static_cast<size_t>(q * (latencies.size() - 1))];
+  };
+  EventBusStats bus_stats = bus.Stats();
+  SseHubStats hub_stats = hub.Stats();
+  hub.Stop();
+  std::printf("%d clients, 1 hub thread, %.1f s\n", clients, elapsed);
+  std::printf("published  %llu events, %llu coalesced, %lld unique\n",
+              static_cast<unsigned long long>(bus_stats.published),
+              static_cast<unsigned long long>(bus_stats.coalesced),
+              static_cast<long long>(publisher.Unique()));
+  std::printf(
+      "delivered  %llu events (%.0f/client), %.1f MB, %llu reconnects, "
+      "%llu resyncs\n",
+      static_cast<unsigned long long>(events),
+      static_cast<double>(events) / clients, hub_stats.bytes / 1e6,
+      static_cast<unsigned long long>(reconnects),
+      static_cast<unsigned long long>(resyncs));
+  std::printf("latency    p50 %lld us  p99 %lld us  max %lld us\n",
+              static_cast<long long>(at(0.5)),
+              static_cast<long long>(at(0.99)),
+              static_cast<long long>(at(1.0)));
+  std::printf(
+      "checks     %llu unique events missed, %llu out of order, %d clients "
+      "unfinished\n",
+      static_cast<unsigned long long>(missed),
+      static_cast<unsigned long long>(out_of_order), unfinished);
+  return missed == 0 && out_of_order == 0 && unfinished == 0 ? 0 : 1;
+}
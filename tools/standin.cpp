@@ -0,0 +1,524 @@
+// Local HTTPS stand-in for every remote API JPet calls, so polling,
+// notifications and the panel's account pages run with no network.
+//
+//   standin record <captures.jsonl> [--port 8443] [--upstream addr:port]
+//   standin replay <captures.jsonl> [--port 8443] [--seed 1]
+//                  [--latency 0] [--jitter 0]
+//                  [--error-rate 0] [--error -352]
+//                  [--rate 0] [--burst 1] [--over wait|412]
+//                  [--duration 0] [--verbose]
+//
+// Point the app at it in jpet.toml, by host or for all of them:
+//
+//   [endpoints]
+//   "*" = "127.0.0.1:8443"
+//
+// The app keeps sending the real Host header, so one stand-in serves
+// api.bilibili.com, api.live.bilibili.com, passport.bilibili.com,
+// space.bilibili.com and pet.vjoi.cn alike.
+//
+// record forwards every request to the real host (or to --upstream) and
+// appends the response to the captures file, one JSON object per line:
+// {"method","host","target","status","headers","body"}. The file can be
+// written by hand as well.
+//
+// replay answers from the captures. Requests match on method, host, path
+// and query, without the wbi signature parameters that change on every
+// request. Several captures of one request are served in turn, the last
+// one again and again, so a capture of a dynamic feed before and after a
+// post replays the post. Unknown requests get 404.
+//
+//   --latency, --jitter  ms before each answer, plus up to jitter ms
+//   --error-rate         share of JSON answers replaced by a failure with
+//                        code --error, -352 is the risk control restriction
+//   --rate, --burst      requests per second the stand-in takes; more wait
+//                        for their turn, or get HTTP 412 with --over 412
+//                        as bilibili answers when it throttles
+//   --seed               jitter and errors repeat for the same seed and
+//                        request order
+//   --duration           stop after this many seconds, 0 runs until ^C
+//
+// On exit it prints requests, injected errors and throttled requests per
+// host, and the latency it added.
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <httplib.h>
+#include <nlohmann/json.hpp>
+
+#include "HttpPool.hpp"
+#include "LocalServer.hpp"
+#include "Random.hpp"
+
+namespace {
+
+std::atomic<bool> g_stop{false};
+
+void OnSignal(int) { g_stop = true; }
+
+// headers worth keeping from a response, the rest is the stand-in's own
+const char* kKeptHeaders[] = {"Content-Type", "Set-Cookie", "Location"};
+
+// request headers not forwarded, set by the client or by httplib
+const char* kDroppedHeaders[] = {"Host",        "Content-Length",
+                                 "Content-Type", "Connection",
+                                 "Accept-Encoding", "REMOTE_ADDR",
+                                 "REMOTE_PORT", "LOCAL_ADDR",
+                                 "LOCAL_PORT"};
+
+// query parameters that differ on every request, see Wbi::Calc_sign
+const char* kVolatileParams[] = {"w_rid", "wts", "w_webid"};
+
+// Host without the port the app connected to
+std::string HostOf(const httplib::Request& req) {
+  std::string host = req.get_header_value("Host");
+  size_t colon = host.rfind(':');
+  if (colon != std::string::npos &&
+      host.find(']', colon) == std::string::npos) {
+    host.resize(colon);
+  }
+  return host;
+}
+
+bool SameName(const std::string& a, const char* b) {
+  size_t i = 0;
+  for (; i < a.size() && b[i] != '\0'; i++) {
+    if (std::tolower(static_cast<unsigned char>(a[i])) !=
+        std::tolower(static_cast<unsigned char>(b[i]))) {
+      return false;
+    }
+  }
+  return i == a.size() && b[i] == '\0';
+}
+
+// what a request is matched on, the query sorted and without the
+// volatile parameters
+std::string KeyOf(const std::string& method, const std::string& host,
+                  const std::string& target) {
+  size_t mark = target.find('?');
+  std::string key = method + " " + host + target.substr(0, mark);
+  if (mark == std::string::npos) {
+    return key;
+  }
+  std::vector<std::string> params;
+  std::string query = target.substr(mark + 1);
+  size_t begin = 0;
+  while (begin <= query.size()) {
+    size_t end = std::min(query.find('&', begin), query.size());
+    std::string param = query.substr(begin, end - begin);
+    std::string name = param.substr(0, param.find('='));
+    bool keep = !param.empty();
+    for (const char* drop : kVolatileParams) {
+      keep = keep && name != drop;
+    }
+    if (keep) {
+      params.push_back(param);
+    }
+    begin = end + 1;
+  }
+  std::sort(params.begin(), params.end());
+  for (size_t i = 0; i < params.size(); i++) {
+    key += (i == 0 ? "?" : "&") + params[i];
+  }
+  return key;
+}
+
+struct Capture {
+  int status = 200;
+  httplib::Headers headers;
+  std::string body;
+};
+
+struct HostStats {
+  uint64_t requests = 0;
+  uint64_t missed = 0;
+  uint64_t errors = 0;
+  uint64_t throttled = 0;
+  double added_ms = 0;
+};
+
+struct Options {
+  int port = 8443;
+  std::string upstream;
+  uint64_t seed = 1;
+  int latency = 0;
+  int jitter = 0;
+  double error_rate = 0;
+  int error = -352;
+  double rate = 0;
+  double burst = 1;
+  bool over_412 = false;
+  int duration = 0;
+  bool verbose = false;
+};
+
+class StandIn {
+ public:
+  StandIn(const LocalCert& cert, const Options& options)
+      : server_(cert),
+        options_(options),
+        rng_(options.seed),
+        tokens_(options.burst),
+        refilled_(std::chrono::steady_clock::now()) {}
+
+  bool Load(const std::string& path) {
+    std::ifstream in(path);
+    if (!in) {
+      return false;
+    }
+    std::string line;
+    int number = 0;
+    while (std::getline(in, line)) {
+      number++;
+      if (line.empty()) {
+        continue;
+      }
+      try {
+        auto json = nlohmann::json::parse(line);
+        Capture capture;
+        capture.status = json.value("status", 200);
+        capture.body = json.at("body").get<std::string>();
+        auto headers = json.value("headers", nlohmann::json::object());
+        for (const auto& [name, value] : headers.items()) {
+          capture.headers.emplace(name, value.get<std::string>());
+        }
+        captures_[KeyOf(json.value("method", "GET"),
+                        json.at("host").get<std::string>(),
+                        json.at("target").get<std::string>())]
+            .push_back(std::move(capture));
+      } catch (const std::exception& e) {
+        std::fprintf(stderr, "standin: %s:%d: %s\n", path.c_str(), number,
+                     e.what());
+        return false;
+      }
+    }
+    return true;
+  }
+
+  void Replay() {
+    auto handler = [this](const httplib::Request& req,
+                          httplib::Response& res) { replay(req, res); };
+    server_.Server().Get(".*", handler);
+    server_.Server().Post(".*", handler);
+  }
+
+  bool Record(const std::string& path) {
+    out_.open(path, std::ios::app);
+    if (!out_) {
+      return false;
+    }
+    if (!options_.upstream.empty() &&
+        !HttpPool::GetInstance()->Redirect("*", options_.upstream)) {
+      return false;
+    }
+    auto handler = [this](const httplib::Request& req,
+                          httplib::Response& res) { record(req, res); };
+    server_.Server().Get(".*", handler);
+    server_.Server().Post(".*", handler);
+    return true;
+  }
+
+  int Run() {
+    if (!server_.Start(options_.port)) {
+      std::fprintf(stderr, "standin: cannot listen on port %d\n",
+                   options_.port);
+      return 1;
+    }
+    std::printf("standin: listening on 127.0.0.1:%d\n", server_.Port());
+    std::fflush(stdout);
+    auto start = std::chrono::steady_clock::now();
+    while (!g_stop &&
+           (options_.duration == 0 ||
+            std::chrono::steady_clock::now() - start <
+                std::chrono::seconds(options_.duration))) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+    server_.Stop();
+    print();
+    return 0;
+  }
+
+ private:
+  LocalServer server_;
+  Options options_;
+  std::mutex mutex_;
+  Xoshiro256 rng_;
+  // token bucket of --rate
+  double tokens_;
+  std::chrono::steady_clock::time_point refilled_;
+  std::map<std::string, std::vector<Capture>> captures_;
+  // next capture to serve by key
+  std::map<std::string, size_t> served_;
+  std::map<std::string, HostStats> stats_;
+  std::ofstream out_;
+
+  // wait for a token, false if the request is turned away instead
+  bool admit(HostStats& stats) {
+    if (options_.rate <= 0) {
+      return true;
+    }
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+      auto now = std::chrono::steady_clock::now();
+      tokens_ = std::min(
+          options_.burst,
+          tokens_ + options_.rate *
+                        std::chrono::duration<double>(now - refilled_).count());
+      refilled_ = now;
+      if (tokens_ >= 1) {
+        tokens_ -= 1;
+        return true;
+      }
+      stats.throttled++;
+      if (options_.over_412) {
+        return false;
+      }
+      auto wait = std::chrono::duration<double>((1 - tokens_) / options_.rate);
+      lock.unlock();
+      std::this_thread::sleep_for(wait);
+      lock.lock();
+    }
+  }
+
+  void replay(const httplib::Request& req, httplib::Response& res) {
+    std::string host = HostOf(req);
+    std::string key = KeyOf(req.method, host, req.target);
+    Capture capture;
+    bool found = false;
+    bool inject = false;
+    int delay = options_.latency;
+    HostStats* stats = nullptr;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stats = &stats_[host];
+      stats->requests++;
+      auto it = captures_.find(key);
+      if (it != captures_.end()) {
+        size_t& next = served_[key];
+        capture = it->second[std::min(next, it->second.size() - 1)];
+        next++;
+        found = true;
+      }
+      // drawn for every request, so one seed gives one sequence
+      if (options_.jitter > 0) {
+        delay += static_cast<int>(rng_.Below(options_.jitter + 1));
+      }
+      inject = std::uniform_real_distribution<double>(0, 1)(rng_) <
+               options_.error_rate;
+    }
+    if (!admit(*stats)) {
+      res.status = 412;
+      res.set_content("", "text/html");
+      log(req, host, res.status, "throttled");
+      return;
+    }
+    if (delay > 0) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(delay));
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats->added_ms += delay;
+    if (!found) {
+      stats->missed++;
+      res.status = 404;
+      res.set_content(R"({"code":-404,"message":"not recorded"})",
+                      "application/json");
+      log(req, host, res.status, "not recorded");
+      return;
+    }
+    bool json = capture.body.rfind("{", 0) == 0;
+    if (inject && json) {
+      stats->errors++;
+      nlohmann::json error = {{"code", options_.error},
+                              {"message", std::to_string(options_.error)},
+                              {"ttl", 1}};
+      res.status = 200;
+      res.set_content(error.dump(), "application/json");
+      log(req, host, res.status, "injected error");
+      return;
+    }
+    res.status = capture.status;
+    for (const auto& [name, value] : capture.headers) {
+      if (!SameName(name, "Content-Type")) {
+        res.set_header(name, value);
+      }
+    }
+    auto type = capture.headers.find("Content-Type");
+    res.set_content(capture.body, type == capture.headers.end()
+                                      ? "application/json"
+                                      : type->second.c_str());
+    log(req, host, res.status, "");
+  }
+
+  void record(const httplib::Request& req, httplib::Response& res) {
+    std::string host = HostOf(req);
+    const std::string& target = req.target;
+    httplib::Headers headers;
+    for (const auto& [name, value] : req.headers) {
+      bool keep = true;
+      for (const char* drop : kDroppedHeaders) {
+        keep = keep && !SameName(name, drop);
+      }
+      if (keep) {
+        headers.emplace(name, value);
+      }
+    }
+    HttpOptions options;
+    httplib::Result upstream =
+        req.method == "POST"
+            ? HttpPool::GetInstance()->Post(
+                  host, target, headers, req.body,
+                  req.get_header_value("Content-Type"), options)
+            : HttpPool::GetInstance()->Get(host, target, headers, options);
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats_[host].requests++;
+    if (!upstream) {
+      stats_[host].missed++;
+      res.status = 502;
+      log(req, host, res.status, "upstream failed");
+      return;
+    }
+    nlohmann::json kept = nlohmann::json::object();
+    for (const char* name : kKeptHeaders) {
+      std::string value = upstream->get_header_value(name);
+      if (!value.empty()) {
+        kept[name] = value;
+        if (std::string(name) != "Content-Type") {
+          res.set_header(name, value);
+        }
+      }
+    }
+    nlohmann::json line = {{"method", req.method},
+                           {"host", host},
+                           {"target", target},
+                           {"status", upstream->status},
+                           {"headers", kept},
+                           {"body", upstream->body}};
+    out_ << line.dump(-1, ' ', false,
+                      nlohmann::json::error_handler_t::replace)
+         << "\n";
+    out_.flush();
+    res.status = upstream->status;
+    res.set_content(upstream->body,
+                    kept.value("Content-Type", "application/json").c_str());
+    log(req, host, res.status, "recorded");
+  }
+
+  // mutex_ must be held
+  void log(const httplib::Request& req, const std::string& host, int status,
+           const char* note) {
+    if (options_.verbose) {
+      std::printf("%s %s%s -> %d %s\n", req.method.c_str(), host.c_str(),
+                  req.path.c_str(), status, note);
+      std::fflush(stdout);
+    }
+  }
+
+  void print() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::printf("%-24s %9s %9s %9s %9s %12s\n", "host", "requests", "missed",
+                "errors", "throttled", "added ms");
+    for (const auto& [host, stats] : stats_) {
+      std::printf("%-24s %9llu %9llu %9llu %9llu %12.0f\n", host.c_str(),
+                  static_cast<unsigned long long>(stats.requests),
+                  static_cast<unsigned long long>(stats.missed),
+                  static_cast<unsigned long long>(stats.errors),
+                  static_cast<unsigned long long>(stats.throttled),
+                  stats.added_ms);
+    }
+  }
+};
+
+int Usage() {
+  std::fprintf(stderr,
+               "usage: standin record|replay <captures.jsonl> [options], "
+               "see tools/standin.cpp\n");
+  return 2;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  if (argc < 3) {
+    return Usage();
+  }
+  std::string mode = argv[1];
+  std::string path = argv[2];
+  if (mode != "record" && mode != "replay") {
+    return Usage();
+  }
+  Options options;
+  for (int i = 3; i < argc; i++) {
+    std::string flag = argv[i];
+    if (flag == "--verbose") {
+      options.verbose = true;
+      continue;
+    }
+    if (i + 1 >= argc) {
+      return Usage();
+    }
+    std::string value = argv[++i];
+    if (flag == "--port") {
+      options.port = std::atoi(value.c_str());
+    } else if (flag == "--upstream") {
+      options.upstream = value;
+    } else if (flag == "--seed") {
+      options.seed = std::strtoull(value.c_str(), nullptr, 10);
+    } else if (flag == "--latency") {
+      options.latency = std::atoi(value.c_str());
+    } else if (flag == "--jitter") {
+      options.jitter = std::atoi(value.c_str());
+    } else if (flag == "--error-rate") {
+      options.error_rate = std::atof(value.c_str());
+    } else if (flag == "--error") {
+      options.error = std::atoi(value.c_str());
+    } else if (flag == "--rate") {
+      options.rate = std::atof(value.c_str());
+    } else if (flag == "--burst") {
+      options.burst = std::max(1.0, std::atof(value.c_str()));
+    } else if (flag == "--over") {
+      options.over_412 = value == "412";
+    } else if (flag == "--duration") {
+      options.duration = std::atoi(value.c_str());
+    } else {
+      std::fprintf(stderr, "standin: unknown option %s\n", flag.c_str());
+      return Usage();
+    }
+  }
+  LocalCert cert;
+  if (!cert.Ok()) {
+    std::fprintf(stderr, "standin: cannot create a certificate\n");
+    return 1;
+  }
+  std::signal(SIGINT, OnSignal);
+  std::signal(SIGTERM, OnSignal);
+  int result = 0;
+  {
+    StandIn standin(cert, options);
+    if (mode == "replay" && !standin.Load(path)) {
+      std::fprintf(stderr, "standin: cannot load %s\n", path.c_str());
+      result = 1;
+    } else if (mode == "record" && !standin.Record(path)) {
+      std::fprintf(stderr, "standin: cannot record to %s\n", path.c_str());
+      result = 1;
+    } else {
+      if (mode == "replay") {
+        standin.Replay();
+      }
+      result = standin.Run();
+    }
+  }
+  return result;
+}
@@ -0,0 +1,191 @@
+// GameStore backends side by side (src/GameStore.hpp): open time of an
+// existing store, point read latency, point write latency with and
+// without sync, and resident size, straight on the store so the GameData
+// read cache does not hide the backend.
+//
+//   store_bench [--keys 1000] [--reads 100000] [--writes 500] [--dir path]
+//
+// Each backend runs in a child process, --backend is how it is started, so
+// resident sizes are not mixed. --dir is wiped before and after.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#endif
+
+#include "GameData.hpp"
+#include "GameStore.hpp"
+#include "LAppDefine.hpp"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double ResidentMegabytes() {
+#ifdef _WIN32
+  PROCESS_MEMORY_COUNTERS counters{};
+  GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters));
+  return counters.WorkingSetSize / 1048576.0;
+#else
+  std::ifstream status("/proc/self/status");
+  std::string line;
+  while (std::getline(status, line)) {
+    if (line.rfind("VmRSS:", 0) == 0) {
+      return std::atof(line.c_str() + 6) / 1024.0;
+    }
+  }
+  return 0;
+#endif
+}
+
+std::string KeyName(int i) { return "part.Param" + std::to_string(i); }
+
+struct Latency {
+  double mean_us;
+  double p99_us;
+};
+
+Latency Summarize(std::vector<double>& samples) {
+  std::sort(samples.begin(), samples.end());
+  double sum = 0;
+  for (double sample : samples) {
+    sum += sample;
+  }
+  return {sum / samples.size(),
+          samples[static_cast<size_t>(0.99 * (samples.size() - 1))]};
+}
+
+template <typename F>
+Latency Time(int count, F&& op) {
+  std::vector<double> samples;
+  samples.reserve(count);
+  for (int i = 0; i < count; i++) {
+    auto begin = Clock::now();
+    op(i);
+    samples.push_back(
+        std::chrono::duration<double, std::micro>(Clock::now() - begin)
+            .count());
+  }
+  return Summarize(samples);
+}
+
+// the child: populate, reopen, time reads and writes, report one row
+int RunBackend(std::string_view backend, int keys, int reads, int writes) {
+  GameData::Destroy(LAppDefine::documentPath);
+  std::string value(4, '\x01');
+  {
+    auto store = GameStore::Create(backend);
+    if (!store->Open(LAppDefine::documentPath)) {
+      std::fprintf(stderr, "store_bench: cannot open %s\n",
+                   std::string(backend).c_str());
+      return 1;
+    }
+    std::vector<std::string> names;
+    for (int i = 0; i < keys; i++) {
+      names.push_back(KeyName(i));
+    }
+    std::vector<GameStore::Entry> entries;
+    for (const auto& name : names) {
+      entries.emplace_back(name, value);
+    }
+    store->Write(entries, true);
+    store->Close();
+  }
+  auto store = GameStore::Create(backend);
+  auto begin = Clock::now();
+  if (!store->Open(LAppDefine::documentPath)) {
+    std::fprintf(stderr, "store_bench: cannot reopen %s\n",
+                 std::string(backend).c_str());
+    return 1;
+  }
+  double open_ms =
+      std::chrono::duration<double, std::milli>(Clock::now() - begin).count();
+  std::mt19937 rng(1);
+  std::vector<std::string> order;
+  for (int i = 0; i < reads; i++) {
+    order.push_back(KeyName(rng() % keys));
+  }
+  std::string out;
+  Latency read = Time(reads, [&](int i) { store->Get(order[i], out); });
+  auto write = [&](bool sync) {
+    return Time(writes, [&](int i) {
+      store->Write({{order[i % reads], value}}, sync);
+    });
+  };
+  Latency unsynced = write(false);
+  Latency synced = write(true);
+  double rss = ResidentMegabytes();
+  store->Close();
+  std::printf("%-8s  %8.2f  %8.2f  %8.2f  %8.1f  %8.1f  %8.1f  %8.1f  %7.1f\n",
+              std::string(backend).c_str(), open_ms, read.mean_us,
+              read.p99_us, unsynced.mean_us, unsynced.p99_us, synced.mean_us,
+              synced.p99_us, rss);
+  return 0;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  int keys = 1000;
+  int reads = 100000;
+  int writes = 500;
+  std::string backend;
+  std::filesystem::path dir =
+      std::filesystem::temp_directory_path() / "jpet_store_bench";
+  for (int i = 1; i + 1 < argc; i += 2) {
+    std::string flag = argv[i];
+    if (flag == "--keys") {
+      keys = std::max(1, std::atoi(argv[i + 1]));
+    } else if (flag == "--reads") {
+      reads = std::max(1, std::atoi(argv[i + 1]));
+    } else if (flag == "--writes") {
+      writes = std::max(1, std::atoi(argv[i + 1]));
+    } else if (flag == "--dir") {
+      dir = argv[i + 1];
+    } else if (flag == "--backend") {
+      backend = argv[i + 1];
+    } else {
+      std::fprintf(stderr, "store_bench: unknown option %s\n", flag.c_str());
+      return 2;
+    }
+  }
+  std::filesystem::create_directories(dir);
+  LAppDefine::documentPath = dir.wstring();
+  if (!backend.empty()) {
+    return RunBackend(backend, keys, reads, writes);
+  }
+  std::printf("%d keys, %d reads, %d writes each way, times in us\n\n", keys,
+              reads, writes);
+  std::printf("%-8s  %8s  %8s  %8s  %8s  %8s  %8s  %8s  %7s\n", "backend",
+              "open ms", "get", "get p99", "put", "put p99", "sync", "sync p99",
+              "rss MB");
+  for (auto name : GameStore::Backends()) {
+    std::string command = "\"" + std::string(argv[0]) + "\" --backend " +
+                          std::string(name) + " --keys " +
+                          std::to_string(keys) + " --reads " +
+                          std::to_string(reads) + " --writes " +
+                          std::to_string(writes) + " --dir \"" +
+                          dir.string() + "\"";
+#ifdef _WIN32
+    // cmd strips the outer quotes
+    command = "\"" + command + "\"";
+#endif
+    std::fflush(stdout);
+    if (std::system(command.c_str()) != 0) {
+      return 1;
+    }
+  }
+  GameData::Destroy(LAppDefine::documentPath);
+  return 0;
+}
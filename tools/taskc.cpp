@@ -0,0 +1,134 @@
+// Compiles resources/tasks.json into the binary catalog the app loads, see
+// src/TaskCatalog.hpp for the layout.
+//
+//   taskc <tasks.json> <tasks.bin>
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+#include "TaskCatalog.hpp"
+
+namespace {
+
+struct Compiler {
+  std::vector<TaskDef> defs;
+  std::string strings;
+
+  catalog::StrRef add(const std::string& s) {
+    // titles repeat across special rewards, store each string once
+    size_t found = strings.find(s);
+    if (found == std::string::npos || s.empty()) {
+      found = strings.size();
+      strings += s;
+    }
+    return {static_cast<uint32_t>(found), static_cast<uint32_t>(s.size())};
+  }
+};
+
+[[noreturn]] void Fail(int id, const std::string& message) {
+  std::fprintf(stderr, "taskc: task %d: %s\n", id, message.c_str());
+  std::exit(1);
+}
+
+void ParseAttrs(int id, const nlohmann::json& j, AttrMap& attrs) {
+  for (const auto& [key, value] : j.items()) {
+    auto attr = ParseAttr(key);
+    if (!attr) {
+      Fail(id, "unknown attribute " + key);
+    }
+    attrs.Set(*attr, value.get<int>());
+  }
+}
+
+TaskDef Compile(Compiler& out, const nlohmann::json& t) {
+  TaskDef def{};
+  def.id = t.at("id").get<int>();
+  def.cost = t.at("cost").get<int>();
+  if (def.cost <= 0) {
+    Fail(def.id, "cost must be positive");
+  }
+  def.title = out.add(t.at("title").get<std::string>());
+  def.desc = out.add(t.at("desc").get<std::string>());
+  ParseAttrs(def.id, t.at("requirements"), def.requirements);
+  if (t.contains("rewards")) {
+    ParseAttrs(def.id, t["rewards"], def.rewards);
+  }
+  if (t.contains("special")) {
+    const auto& special = t["special"];
+    def.flags |= catalog::kSpecial;
+    def.special_title = out.add(special.at("title").get<std::string>());
+    def.special_desc = out.add(special.at("desc").get<std::string>());
+    def.special_key = out.add(special.at("linked_key").get<std::string>());
+  }
+  if (t.at("repeatable").get<bool>()) {
+    def.flags |= catalog::kRepeatable;
+  }
+  if (t.value("debug", false)) {
+    def.flags |= catalog::kDebug;
+  }
+  return def;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  if (argc != 3) {
+    std::fprintf(stderr, "usage: taskc <tasks.json> <tasks.bin>\n");
+    return 2;
+  }
+  std::ifstream in(argv[1]);
+  if (!in.is_open()) {
+    std::fprintf(stderr, "taskc: cannot open %s\n", argv[1]);
+    return 1;
+  }
+  Compiler out;
+  std::set<int> ids;
+  try {
+    auto tasks = nlohmann::json::parse(in);
+    for (const auto& t : tasks) {
+      TaskDef def = Compile(out, t);
+      if (!ids.insert(def.id).second) {
+        Fail(def.id, "duplicate id");
+      }
+      out.defs.push_back(def);
+    }
+  } catch (const nlohmann::json::exception& e) {
+    std::fprintf(stderr, "taskc: %s: %s\n", argv[1], e.what());
+    return 1;
+  }
+
+  catalog::CatalogHeader header{};
+  header.magic = catalog::kMagic;
+  header.version = catalog::kVersion;
+  header.count = static_cast<uint32_t>(out.defs.size());
+  header.strings_size = static_cast<uint32_t>(out.strings.size());
+  // write next to the target and rename, a running app may be watching it
+  std::string tmp = std::string(argv[2]) + ".tmp";
+  {
+    std::ofstream file(tmp, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(out.defs.data()),
+               out.defs.size() * sizeof(TaskDef));
+    file.write(out.strings.data(), out.strings.size());
+    if (!file) {
+      std::fprintf(stderr, "taskc: cannot write %s\n", tmp.c_str());
+      return 1;
+    }
+  }
+  std::error_code ec;
+  std::filesystem::rename(tmp, argv[2], ec);
+  if (ec) {
+    std::fprintf(stderr, "taskc: cannot write %s: %s\n", argv[2],
+                 ec.message().c_str());
+    return 1;
+  }
+  std::printf("taskc: %zu tasks, %zu bytes of strings\n", out.defs.size(),
+              out.strings.size());
+  return 0;
+}
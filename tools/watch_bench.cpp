@@ -0,0 +1,286 @@
+// Notification latency of followed users, polled the old way, one watcher
+// after another with a global delay that doubles on any failure, and by
+// WatchScheduler. A local stub API plays the followed users: some post or
+// go live every 20 minutes on average, most every 4 hours, and every 25th
+// uid is broken and always fails. Latency is the time from a change to the
+// check that sees it.
+//
+//   watch_bench [--minutes 180] [--scale 600] [--rate 1] [--seed 1]
+//
+// Time runs --scale times faster than real time, delays and intervals are
+// divided by it, latencies are reported in simulated seconds. Changes in
+// the first 30 minutes are not counted, the first check of a user only
+// learns where it stands and 1000 users take a while to go round.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <httplib.h>
+
+#include "HttpPool.hpp"
+#include "LocalServer.hpp"
+#include "Random.hpp"
+#include "WatchScheduler.hpp"
+
+namespace {
+
+constexpr double kWarmup = 30 * 60;
+
+// simulated seconds since start
+class SimClock {
+ public:
+  explicit SimClock(double scale)
+      : scale_(scale), start_(std::chrono::steady_clock::now()) {}
+
+  double Now() const {
+    return scale_ * std::chrono::duration<double>(
+                        std::chrono::steady_clock::now() - start_)
+                        .count();
+  }
+
+  // a simulated duration in real time
+  std::chrono::milliseconds Real(double seconds) const {
+    return std::chrono::milliseconds(
+        static_cast<int64_t>(std::ceil(1000 * seconds / scale_)));
+  }
+
+  void Sleep(double seconds) const { std::this_thread::sleep_for(Real(seconds)); }
+
+  double Scale() const { return scale_; }
+
+ private:
+  double scale_;
+  std::chrono::steady_clock::time_point start_;
+};
+
+struct User {
+  // when the user posted or went live, sorted
+  std::vector<double> changes;
+  bool broken = false;
+};
+
+std::vector<User> MakeUsers(int follows, double minutes, uint64_t seed) {
+  Xoshiro256 rng(seed);
+  std::vector<User> users(follows);
+  for (int i = 0; i < follows; i++) {
+    users[i].broken = i % 25 == 7;
+    double mean = i % 5 == 0 ? 20 * 60 : 4 * 60 * 60;
+    double t = 0;
+    while (true) {
+      double u = (rng() >> 11) * 0x1.0p-53;
+      t += -std::log(1 - u) * mean;
+      if (t >= minutes * 60) {
+        break;
+      }
+      users[i].changes.push_back(t);
+    }
+  }
+  return users;
+}
+
+// answers /check?uid=N with how many changes the user made so far
+class Stub {
+ public:
+  Stub(const LocalCert& cert, const std::vector<User>& users,
+       const SimClock& clock)
+      : server_(cert) {
+    server_.Server().Get(
+        "/check",
+        [&users, &clock](const httplib::Request& req, httplib::Response& res) {
+          size_t uid = std::stoul(req.get_param_value("uid"));
+          const User& user = users.at(uid);
+          if (user.broken) {
+            res.set_content("code=-404 version=0", "text/plain");
+            return;
+          }
+          auto seen = std::upper_bound(user.changes.begin(),
+                                       user.changes.end(), clock.Now()) -
+                      user.changes.begin();
+          res.set_content("code=0 version=" + std::to_string(seen),
+                          "text/plain");
+        });
+    server_.Start();
+  }
+
+  int Port() const { return server_.Port(); }
+
+ private:
+  LocalServer server_;
+};
+
+// the client side, one per run
+class Watcher {
+ public:
+  Watcher(const std::vector<User>& users, const SimClock& clock, int port)
+      : users_(users), clock_(clock), seen_(users.size(), -1) {
+    options_.port = port;
+    options_.verify = false;
+  }
+
+  WatchResult Check(size_t uid) {
+    checks_++;
+    auto res = HttpPool::GetInstance()->Get(
+        "127.0.0.1", "/check?uid=" + std::to_string(uid), {}, options_);
+    int code = -1;
+    long version = 0;
+    if (!res || res->status != 200 ||
+        std::sscanf(res->body.c_str(), "code=%d version=%ld", &code,
+                    &version) != 2 ||
+        code != 0) {
+      return WatchResult::Failed;
+    }
+    double now = clock_.Now();
+    long& seen = seen_[uid];
+    bool changed = seen >= 0 && version > seen;
+    if (changed) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      for (long i = seen; i < version; i++) {
+        if (users_[uid].changes[i] >= kWarmup) {
+          latencies_.push_back(now - users_[uid].changes[i]);
+        }
+      }
+    }
+    seen = version;
+    return changed ? WatchResult::Changed : WatchResult::Unchanged;
+  }
+
+  void Report(const char* name, double minutes) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    size_t total = 0;
+    for (const User& user : users_) {
+      if (!user.broken) {
+        total += std::count_if(user.changes.begin(), user.changes.end(),
+                               [](double t) { return t >= kWarmup; });
+      }
+    }
+    std::sort(latencies_.begin(), latencies_.end());
+    auto at = [&](double q) {
+      return latencies_.empty()
+                 ? 0.0
+                 : latencies_[std::min(latencies_.size() - 1,
+                                       static_cast<size_t>(q * latencies_.size()))];
+    };
+    double mean = 0;
+    for (double l : latencies_) {
+      mean += l;
+    }
+    mean = latencies_.empty() ? 0 : mean / latencies_.size();
+    std::printf(
+        "%5zu follows  %-22s %5.2f checks/s  %4zu/%-4zu seen  latency mean "
+        "%6.0f s  p50 %6.0f s  p95 %6.0f s  max %6.0f s\n",
+        users_.size(), name, checks_.load() / (minutes * 60),
+        latencies_.size(), total, mean, at(0.5), at(0.95), at(1.0));
+  }
+
+ private:
+  const std::vector<User>& users_;
+  const SimClock& clock_;
+  HttpOptions options_;
+  // change count at the last successful check, -1 before the first
+  std::vector<long> seen_;
+  std::atomic<uint64_t> checks_{0};
+  std::mutex mutex_;
+  std::vector<double> latencies_;
+};
+
+// UserStateManager before WatchScheduler
+void Serial(Watcher& watcher, size_t follows, const SimClock& clock,
+            double end) {
+  int check_delay = 3;
+  while (clock.Now() < end) {
+    for (size_t uid = 0; uid < follows && clock.Now() < end; uid++) {
+      if (watcher.Check(uid) == WatchResult::Failed) {
+        check_delay *= 2;
+      } else if (check_delay >= 12) {
+        check_delay /= 3;
+      }
+      if (check_delay >= 60) {
+        // the captcha prompt, start over
+        break;
+      }
+      clock.Sleep(check_delay);
+    }
+    clock.Sleep(check_delay);
+  }
+}
+
+void Scheduled(Watcher& watcher, size_t follows, const SimClock& clock,
+               double end, double rate) {
+  WatchSchedulerOptions defaults;
+  WatchSchedulerOptions options = defaults;
+  options.rate = rate * clock.Scale();
+  options.min_interval = clock.Real(defaults.min_interval.count() / 1000.0);
+  options.max_interval = clock.Real(defaults.max_interval.count() / 1000.0);
+  options.max_backoff = clock.Real(defaults.max_backoff.count() / 1000.0);
+  options.restrict_pause = clock.Real(defaults.restrict_pause.count() / 1000.0);
+  options.max_restrict_pause =
+      clock.Real(defaults.max_restrict_pause.count() / 1000.0);
+  {
+    WatchScheduler scheduler(
+        [&](const std::string& key) { return watcher.Check(std::stoul(key)); },
+        options);
+    for (size_t uid = 0; uid < follows; uid++) {
+      scheduler.Add(std::to_string(uid));
+    }
+    clock.Sleep(end - clock.Now());
+  }
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  double minutes = 180;
+  double scale = 600;
+  double rate = 1;
+  uint64_t seed = 1;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    std::string flag = argv[i];
+    if (flag == "--minutes") {
+      minutes = std::atof(argv[i + 1]);
+    } else if (flag == "--scale") {
+      scale = std::atof(argv[i + 1]);
+    } else if (flag == "--rate") {
+      rate = std::atof(argv[i + 1]);
+    } else if (flag == "--seed") {
+      seed = std::strtoull(argv[i + 1], nullptr, 10);
+    } else {
+      std::fprintf(stderr, "watch_bench: unknown option %s\n", flag.c_str());
+      return 2;
+    }
+  }
+  LocalCert cert;
+  if (!cert.Ok()) {
+    std::fprintf(stderr, "watch_bench: cannot create a certificate\n");
+    return 1;
+  }
+  for (int follows : {10, 100, 1000}) {
+    auto users = MakeUsers(follows, minutes, seed);
+    for (int mode = 0; mode < 3; mode++) {
+      SimClock clock(scale);
+      Stub stub(cert, users, clock);
+      Watcher watcher(users, clock, stub.Port());
+      if (mode == 0) {
+        Serial(watcher, follows, clock, minutes * 60);
+        watcher.Report("serial", minutes);
+      } else {
+        // the default rate is the old loop's one check per 3 s, compare at
+        // it and at --rate
+        double r = mode == 1 ? WatchSchedulerOptions{}.rate : rate;
+        Scheduled(watcher, follows, clock, minutes * 60, r);
+        char name[32];
+        std::snprintf(name, sizeof(name), "scheduler, %.2f/s", r);
+        watcher.Report(name, minutes);
+      }
+    }
+  }
+  return 0;
+}
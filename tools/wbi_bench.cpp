@@ -0,0 +1,356 @@
+// Wbi signatures per second and heap allocations per signature, signed by
+// WbiSigner (src/WbiSigner.hpp) and from scratch as the watchers did
+// before: a nlohmann::json of params, the mixin key rebuilt and the MD5
+// run through a Crypto++ filter pipeline on every request. Checks both
+// give the same query at a fixed wts.
+//
+// A local stand-in serves /x/web-interface/nav and the space page behind
+// HttpPool::Redirect(). In the last phase it hands out new keys on every
+// fetch and answers slowly, signing goes on meanwhile and the bench
+// reports the slowest Sign() and how many key generations were seen.
+//
+//   wbi_bench [--iterations 200000] [--threads 4] [--latency 200]
+//
+// --latency is the server side delay per request in ms.
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <new>
+#include <optional>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define CRYPTOPP_ENABLE_NAMESPACE_WEAK 1
+#include <cryptopp/hex.h>
+#include <cryptopp/md5.h>
+#include <httplib.h>
+#include <nlohmann/json.hpp>
+
+#include "HttpPool.hpp"
+#include "LocalServer.hpp"
+#include "Random.hpp"
+#include "Wbi.hpp"
+#include "WbiSigner.hpp"
+
+namespace {
+
+std::atomic<size_t> g_allocations{0};
+
+}  // namespace
+
+void* operator new(size_t size) {
+  g_allocations.fetch_add(1, std::memory_order_relaxed);
+  if (void* p = std::malloc(size == 0 ? 1 : size)) {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+
+namespace {
+
+constexpr std::array<uint8_t, 64> kMixinKeyEncTab = {
+    46, 47, 18, 2,  53, 8,  23, 32, 15, 50, 10, 31, 58, 3,  45, 35,
+    27, 43, 5,  49, 33, 9,  42, 19, 29, 28, 14, 39, 12, 38, 41, 13,
+    37, 48, 7,  16, 24, 55, 40, 61, 26, 17, 0,  1,  60, 51, 30, 4,
+    22, 25, 54, 21, 56, 59, 6,  63, 57, 62, 11, 36, 20, 34, 44, 52};
+
+// signing as Wbi::Calc_sign() and its callers did, w_webid already fetched
+class OldSigner {
+ public:
+  OldSigner(std::string img_key, std::string sub_key, std::string webid)
+      : img_key_(std::move(img_key)),
+        sub_key_(std::move(sub_key)),
+        webid_(std::move(webid)),
+        webid_ts_(Now()) {}
+
+  std::string Sign(const std::string& mid, time_t wts) {
+    nlohmann::json params;
+    params["mid"] = mid;
+    const auto mixin_key = MixinKey(img_key_, sub_key_);
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      if (!webid_.has_value() || webid_ts_ + 72000 < Now()) {
+        webid_ts_ = Now();
+      }
+      params["w_webid"] = webid_.value_or("");
+    }
+    params["wts"] = wts;
+    const std::string encode_str =
+        Wbi::Json_to_url_encode_str(params).append(mixin_key);
+    return Wbi::Json_to_url_encode_str(params) + "&w_rid=" + Md5Hex(encode_str);
+  }
+
+ private:
+  std::string img_key_;
+  std::string sub_key_;
+  std::optional<std::string> webid_;
+  long long webid_ts_;
+  std::mutex mutex_;
+
+  static long long Now() {
+    return std::chrono::duration_cast<std::chrono::seconds>(
+               std::chrono::system_clock::now().time_since_epoch())
+        .count();
+  }
+
+  static std::string MixinKey(const std::string& img_key,
+                              const std::string& sub_key) {
+    std::string raw = img_key + sub_key;
+    std::string result;
+    std::transform(kMixinKeyEncTab.begin(), kMixinKeyEncTab.end(),
+                   std::back_inserter(result),
+                   [&raw](const uint8_t x) { return raw.at(x); });
+    return result.substr(0, 32);
+  }
+
+  static std::string Md5Hex(const std::string& input) {
+    CryptoPP::Weak1::MD5 hash;
+    std::string md5_hex;
+    CryptoPP::StringSource ss(
+        input, true,
+        new CryptoPP::HashFilter(
+            hash, new CryptoPP::HexEncoder(new CryptoPP::StringSink(md5_hex))));
+    std::transform(md5_hex.begin(), md5_hex.end(), md5_hex.begin(),
+                   [](unsigned char c) { return std::tolower(c); });
+    return md5_hex;
+  }
+};
+
+// 32 hex characters, the same for the same generation
+std::string Key(int generation, int which) {
+  static const char hex[] = "0123456789abcdef";
+  Xoshiro256 rng(generation * 2 + which + 1);
+  std::string key;
+  for (int i = 0; i < 32; i++) {
+    key.push_back(hex[rng() & 15]);
+  }
+  return key;
+}
+
+std::string WebId(int generation) {
+  return "webid." + std::to_string(generation);
+}
+
+class StandIn {
+ public:
+  explicit StandIn(const LocalCert& cert) : server_(cert) {
+    httplib::SSLServer& server = server_.Server();
+    server.Get("/x/web-interface/nav", [this](const httplib::Request&,
+                                              httplib::Response& res) {
+      int generation = next();
+      nlohmann::json body = {
+          {"code", -101},
+          {"message", "账号未登录"},
+          {"data",
+           {{"isLogin", false},
+            {"wbi_img",
+             {{"img_url", "https://i0.hdslb.com/bfs/wbi/" +
+                              Key(generation, 0) + ".png"},
+              {"sub_url", "https://i0.hdslb.com/bfs/wbi/" +
+                              Key(generation, 1) + ".png"}}}}}};
+      res.set_content(body.dump(), "application/json");
+    });
+    server.Get("/475210", [this](const httplib::Request&,
+                                 httplib::Response& res) {
+      int generation = next();
+      nlohmann::json data = {{"access_id", WebId(generation)}};
+      // the real page is a few hundred kB of markup around the script
+      std::string page(200000, ' ');
+      page += R"(<script id="__RENDER_DATA__" type="application/json">)" +
+              Wbi::Url_encode(data.dump()) + "</script></body></html>";
+      res.set_content(page, "text/html");
+    });
+    server_.Start();
+  }
+
+  ~StandIn() { server_.Stop(); }
+
+  int Port() const { return server_.Port(); }
+
+  // from now on every fetch answers after latency with new keys
+  void Rotate(int latency_ms) {
+    latency_ms_ = latency_ms;
+    rotate_ = true;
+  }
+
+  int Fetches() const { return fetches_; }
+
+ private:
+  LocalServer server_;
+  std::atomic<bool> rotate_{false};
+  std::atomic<int> latency_ms_{0};
+  std::atomic<int> generation_{0};
+  std::atomic<int> fetches_{0};
+
+  int next() {
+    fetches_++;
+    if (!rotate_) {
+      return 0;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(latency_ms_));
+    return ++generation_;
+  }
+};
+
+// signatures per second on threads, and allocations per signature
+template <class F>
+void Measure(const char* name, int threads, int iterations, F&& sign) {
+  size_t allocations = g_allocations;
+  auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> workers;
+  for (int t = 0; t < threads; t++) {
+    workers.emplace_back([&, t] {
+      std::string mid = std::to_string(100000 + t);
+      size_t length = 0;
+      for (int i = 0; i < iterations / threads; i++) {
+        length += sign(mid).size();
+      }
+      if (length == 0) {
+        std::printf("empty signature\n");
+      }
+    });
+  }
+  for (auto& worker : workers) {
+    worker.join();
+  }
+  double seconds = std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - start)
+                       .count();
+  int signs = iterations / threads * threads;
+  std::printf("%-10s %d threads  %10.0f signatures/s  %6.2f allocs/signature\n",
+              name, threads, signs / seconds,
+              static_cast<double>(g_allocations - allocations) / signs);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  int iterations = 200000;
+  int threads = 4;
+  int latency = 200;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    std::string flag = argv[i];
+    if (flag == "--iterations") {
+      iterations = std::atoi(argv[i + 1]);
+    } else if (flag == "--threads") {
+      threads = std::atoi(argv[i + 1]);
+    } else if (flag == "--latency") {
+      latency = std::atoi(argv[i + 1]);
+    } else {
+      std::fprintf(stderr, "wbi_bench: unknown option %s\n", flag.c_str());
+      return 2;
+    }
+  }
+  LocalCert cert;
+  if (!cert.Ok()) {
+    std::fprintf(stderr, "wbi_bench: cannot create a certificate\n");
+    return 1;
+  }
+  int failed = 0;
+  {
+    StandIn standin(cert);
+    std::string target = "127.0.0.1:" + std::to_string(standin.Port());
+    HttpPool::GetInstance()->Redirect("api.bilibili.com", target);
+    HttpPool::GetInstance()->Redirect("space.bilibili.com", target);
+
+    WbiSigner* signer = WbiSigner::GetInstance();
+    WbiSignerOptions options;
+    options.key_ttl = std::chrono::milliseconds(latency * 2);
+    options.webid_ttl = std::chrono::milliseconds(latency * 5);
+    options.retry = std::chrono::milliseconds(latency);
+    signer->Start(options);
+    if (!signer->Ready()) {
+      std::fprintf(stderr, "wbi_bench: no keys from the stand-in\n");
+      return 1;
+    }
+
+    OldSigner old(Key(0, 0), Key(0, 1), WebId(0));
+    int mismatches = 0;
+    for (const char* mid : {"1", "475210", "3493271057730096", "a b&c=d",
+                            "测试", ""}) {
+      for (time_t wts : {time_t(0), time_t(1700000000), time(nullptr)}) {
+        if (old.Sign(mid, wts) != signer->Sign({{"mid", mid}}, wts)) {
+          std::printf("mismatch mid=%s wts=%lld\n  old %s\n  new %s\n", mid,
+                      static_cast<long long>(wts), old.Sign(mid, wts).c_str(),
+                      signer->Sign({{"mid", mid}}, wts).c_str());
+          mismatches++;
+        }
+      }
+    }
+    std::printf("%d mismatches against the old signature\n", mismatches);
+    failed += mismatches;
+
+    for (int n : {1, threads}) {
+      Measure("old", n, iterations / 10, [&](const std::string& mid) {
+        return old.Sign(mid, time(nullptr));
+      });
+      Measure("WbiSigner", n, iterations, [&](const std::string& mid) {
+        return signer->Sign({{"mid", mid}});
+      });
+    }
+
+    // keys rotate on every slow fetch while signing goes on
+    standin.Rotate(latency);
+    std::atomic<bool> done{false};
+    std::atomic<long long> slowest_us{0};
+    // a Sign() waiting for a fetch would take at least the latency
+    std::atomic<int> waited{0};
+    std::mutex seen_mutex;
+    std::set<std::string> seen;
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; t++) {
+      workers.emplace_back([&] {
+        while (!done) {
+          auto start = std::chrono::steady_clock::now();
+          std::string query = signer->Sign({{"mid", "1"}}, 1700000000);
+          long long us = std::chrono::duration_cast<std::chrono::microseconds>(
+                             std::chrono::steady_clock::now() - start)
+                             .count();
+          waited += us >= latency * 1000;
+          long long slowest = slowest_us;
+          while (us > slowest &&
+                 !slowest_us.compare_exchange_weak(slowest, us)) {
+          }
+          std::lock_guard<std::mutex> lock(seen_mutex);
+          seen.insert(query);
+        }
+      });
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(latency * 20));
+    done = true;
+    for (auto& worker : workers) {
+      worker.join();
+    }
+    signer->Stop();
+    WbiSignerStats stats = signer->Stats();
+    std::printf(
+        "rotating   %d fetches at %d ms  %zu signatures seen  slowest Sign() "
+        "%lld us  %d over %d ms\n",
+        standin.Fetches(), latency, seen.size(),
+        static_cast<long long>(slowest_us), static_cast<int>(waited), latency);
+    std::printf(
+        "stats      %llu signs  %llu unsigned  %llu key fetches  %llu webid "
+        "fetches  %llu failures\n",
+        static_cast<unsigned long long>(stats.signs),
+        static_cast<unsigned long long>(stats.unsigned_signs),
+        static_cast<unsigned long long>(stats.key_fetches),
+        static_cast<unsigned long long>(stats.webid_fetches),
+        static_cast<unsigned long long>(stats.failures));
+    if (seen.size() < 2) {
+      std::printf("keys did not rotate\n");
+      failed++;
+    }
+  }
+  return failed == 0 ? 0 : 1;
+}